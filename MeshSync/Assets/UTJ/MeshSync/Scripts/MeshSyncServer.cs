@@ -419,9 +419,10 @@ namespace UTJ.MeshSync
                 }
                 else
                 {
-                    texture = new Texture2D(src.width, src.height, ToUnityTextureFormat(src.format), false);
+                    // if the sender generated mipmaps, data contains all levels and they are uploaded as they are
+                    texture = new Texture2D(src.width, src.height, ToUnityTextureFormat(src.format), src.hasMipmaps);
                     texture.LoadRawTextureData(src.dataPtr, src.sizeInByte);
-                    texture.Apply();
+                    texture.Apply(false);
 #if UNITY_EDITOR
                     string path = assetDir + "/" + src.name + ".asset";
                     CreateAsset(texture, path);
@@ -744,22 +745,62 @@ namespace UTJ.MeshSync
         PinnedList<Vector3> m_tmpV3 = new PinnedList<Vector3>();
         PinnedList<Vector4> m_tmpV4 = new PinnedList<Vector4>();
         PinnedList<Color> m_tmpC = new PinnedList<Color>();
+#if UNITY_2019_3_OR_NEWER
+        PinnedList<byte> m_tmpB = new PinnedList<byte>();
+
+        // upload interleaved vertices as-is if the layout matches Unity's attribute order.
+        // formats with tangents can't: the server puts them after uv while Unity expects them right after normals.
+        bool UploadInterleavedVertices(Mesh mesh, MeshData data, SplitData split)
+        {
+            var format = data.vertexFormat;
+            bool hasColors = false, hasUV0 = false;
+            switch (format)
+            {
+                case VertexFormat.V3N3: break;
+                case VertexFormat.V3N3C4: hasColors = true; break;
+                case VertexFormat.V3N3U2: hasUV0 = true; break;
+                case VertexFormat.V3N3C4U2: hasColors = true; hasUV0 = true; break;
+                default: return false;
+            }
+
+            var attrs = new List<UnityEngine.Rendering.VertexAttributeDescriptor>();
+            attrs.Add(new UnityEngine.Rendering.VertexAttributeDescriptor(UnityEngine.Rendering.VertexAttribute.Position, UnityEngine.Rendering.VertexAttributeFormat.Float32, 3));
+            attrs.Add(new UnityEngine.Rendering.VertexAttributeDescriptor(UnityEngine.Rendering.VertexAttribute.Normal, UnityEngine.Rendering.VertexAttributeFormat.Float32, 3));
+            if (hasColors)
+                attrs.Add(new UnityEngine.Rendering.VertexAttributeDescriptor(UnityEngine.Rendering.VertexAttribute.Color, UnityEngine.Rendering.VertexAttributeFormat.Float32, 4));
+            if (hasUV0)
+                attrs.Add(new UnityEngine.Rendering.VertexAttributeDescriptor(UnityEngine.Rendering.VertexAttribute.TexCoord0, UnityEngine.Rendering.VertexAttributeFormat.Float32, 2));
+
+            int size = split.numPoints * data.vertexSize;
+            m_tmpB.Resize(size);
+            data.ReadVertices(m_tmpB, split);
+            mesh.SetVertexBufferParams(split.numPoints, attrs.ToArray());
+            mesh.SetVertexBufferData(m_tmpB.List, 0, 0, size);
+            return true;
+        }
+#endif
 
         Mesh CreateEditedMesh(MeshData data, SplitData split)
         {
             var mesh = new Mesh();
 #if UNITY_2017_3_OR_NEWER
-            mesh.indexFormat = UnityEngine.Rendering.IndexFormat.UInt32;
+            mesh.indexFormat = split.indexFormat == SplitData.IndexFormat.U16 ?
+                UnityEngine.Rendering.IndexFormat.UInt16 : UnityEngine.Rendering.IndexFormat.UInt32;
 #endif
 
             var flags = data.flags;
+            bool interleaved = false;
+#if UNITY_2019_3_OR_NEWER
             if (flags.hasPoints)
+                interleaved = UploadInterleavedVertices(mesh, data, split);
+#endif
+            if (flags.hasPoints && !interleaved)
             {
                 m_tmpV3.Resize(split.numPoints);
                 data.ReadPoints(m_tmpV3, split);
                 mesh.SetVertices(m_tmpV3.List);
             }
-            if (flags.hasNormals)
+            if (flags.hasNormals && !interleaved)
             {
                 m_tmpV3.Resize(split.numPoints);
                 data.ReadNormals(m_tmpV3, split);
@@ -771,7 +812,7 @@ namespace UTJ.MeshSync
                 data.ReadTangents(m_tmpV4, split);
                 mesh.SetTangents(m_tmpV4.List);
             }
-            if (flags.hasUV0)
+            if (flags.hasUV0 && !interleaved)
             {
                 m_tmpV2.Resize(split.numPoints);
                 data.ReadUV0(m_tmpV2, split);
@@ -783,7 +824,7 @@ namespace UTJ.MeshSync
                 data.ReadUV1(m_tmpV2, split);
                 mesh.SetUVs(1, m_tmpV2.List);
             }
-            if (flags.hasColors)
+            if (flags.hasColors && !interleaved)
             {
                 m_tmpC.Resize(split.numPoints);
                 data.ReadColors(m_tmpC, split);
@@ -462,6 +462,10 @@ namespace UTJ.MeshSync
             RGBAi32   = Type_i32 | 4,
 
             RawFile = 0x10 << 4,
+            BC1 = 0x11 << 4,
+            BC3 = 0x12 << 4,
+            BC5 = 0x13 << 4,
+            BC7 = 0x14 << 4,
         }
 
         public static UnityEngine.TextureFormat ToUnityTextureFormat(TextureFormat v)
@@ -477,6 +481,10 @@ namespace UTJ.MeshSync
                 case TextureFormat.Rf32: return UnityEngine.TextureFormat.RFloat;
                 case TextureFormat.RGf32: return UnityEngine.TextureFormat.RGFloat;
                 case TextureFormat.RGBAf32: return UnityEngine.TextureFormat.RGBAFloat;
+                case TextureFormat.BC1: return UnityEngine.TextureFormat.DXT1;
+                case TextureFormat.BC3: return UnityEngine.TextureFormat.DXT5;
+                case TextureFormat.BC5: return UnityEngine.TextureFormat.BC5;
+                case TextureFormat.BC7: return UnityEngine.TextureFormat.BC7;
                 default: return UnityEngine.TextureFormat.Alpha8;
             }
         }
@@ -515,6 +523,8 @@ namespace UTJ.MeshSync
             [DllImport("MeshSyncServer")] static extern void msTextureSetWidth(IntPtr _this, int v);
             [DllImport("MeshSyncServer")] static extern int msTextureGetHeight(IntPtr _this);
             [DllImport("MeshSyncServer")] static extern void msTextureSetHeight(IntPtr _this, int v);
+            [DllImport("MeshSyncServer")] static extern byte msTextureGetHasMipmaps(IntPtr _this);
+            [DllImport("MeshSyncServer")] static extern void msTextureSetHasMipmaps(IntPtr _this, byte v);
             [DllImport("MeshSyncServer")] static extern IntPtr msTextureGetDataPtr(IntPtr _this);
             [DllImport("MeshSyncServer")] static extern int msTextureGetSizeInByte(IntPtr _this);
             [DllImport("MeshSyncServer")] static extern byte msTextureWriteToFile(IntPtr _this, string v);
@@ -552,6 +562,11 @@ namespace UTJ.MeshSync
                 get { return msTextureGetHeight(_this); }
                 set { msTextureSetHeight(_this, value); }
             }
+            public bool hasMipmaps
+            {
+                get { return msTextureGetHasMipmaps(_this) != 0; }
+                set { msTextureSetHasMipmaps(_this, (byte)(value ? 1 : 0)); }
+            }
             public int sizeInByte
             {
                 get { return msTextureGetSizeInByte(_this); }
@@ -1452,6 +1467,17 @@ namespace UTJ.MeshSync
             }
         }
 
+        public enum VertexFormat
+        {
+            Unknown,
+            V3N3,
+            V3N3C4,
+            V3N3U2,
+            V3N3C4U2,
+            V3N3U2T4,
+            V3N3C4U2T4,
+        }
+
         public struct MeshData
         {
             #region internal
@@ -1480,6 +1506,9 @@ namespace UTJ.MeshSync
             [DllImport("MeshSyncServer")] static extern void msMeshReadIndices(IntPtr _this, IntPtr dst, SplitData split);
             [DllImport("MeshSyncServer")] static extern void msMeshWriteIndices(IntPtr _this, int[] v, int size);
             [DllImport("MeshSyncServer")] static extern void msMeshWriteSubmeshTriangles(IntPtr _this, int[] v, int size, int materialID);
+            [DllImport("MeshSyncServer")] static extern VertexFormat msMeshGetVertexFormat(IntPtr _this);
+            [DllImport("MeshSyncServer")] static extern int msMeshGetVertexSize(IntPtr _this);
+            [DllImport("MeshSyncServer")] static extern void msMeshReadVertices(IntPtr _this, IntPtr dst, SplitData split);
 
             [DllImport("MeshSyncServer")] static extern int msMeshGetNumBones(IntPtr _this);
             [DllImport("MeshSyncServer")] static extern IntPtr msMeshGetRootBonePath(IntPtr _this);
@@ -1527,6 +1556,9 @@ namespace UTJ.MeshSync
             public int numPoints { get { return msMeshGetNumPoints(_this); } }
             public int numIndices { get { return msMeshGetNumIndices(_this); } }
             public int numSplits { get { return msMeshGetNumSplits(_this); } }
+            // interleaved vertices. Unknown unless ServerSettings.vertex_format is set
+            public VertexFormat vertexFormat { get { return msMeshGetVertexFormat(_this); } }
+            public int vertexSize { get { return msMeshGetVertexSize(_this); } }
 
             public void ReadPoints(PinnedList<Vector3> dst, SplitData split) { msMeshReadPoints(_this, dst, split); }
             public void ReadNormals(PinnedList<Vector3> dst, SplitData split) { msMeshReadNormals(_this, dst, split); }
@@ -1536,6 +1568,7 @@ namespace UTJ.MeshSync
             public void ReadColors(PinnedList<Color> dst, SplitData split) { msMeshReadColors(_this, dst, split); }
             public void ReadBoneWeights(IntPtr dst, SplitData split) { msMeshReadWeights4(_this, dst, split); }
             public void ReadIndices(IntPtr dst, SplitData split) { msMeshReadIndices(_this, dst, split); }
+            public void ReadVertices(IntPtr dst, SplitData split) { msMeshReadVertices(_this, dst, split); }
 
             public void WritePoints(Vector3[] v) { msMeshWritePoints(_this, v, v.Length); }
             public void WriteNormals(Vector3[] v) { msMeshWriteNormals(_this, v, v.Length); }
@@ -1619,13 +1652,21 @@ namespace UTJ.MeshSync
             [DllImport("MeshSyncServer")] static extern int msSplitGetNumIndices(IntPtr _this);
             [DllImport("MeshSyncServer")] static extern Vector3 msSplitGetBoundsCenter(IntPtr _this);
             [DllImport("MeshSyncServer")] static extern Vector3 msSplitGetBoundsSize(IntPtr _this);
+            [DllImport("MeshSyncServer")] static extern IndexFormat msSplitGetIndexFormat(IntPtr _this);
             [DllImport("MeshSyncServer")] static extern int msSplitGetNumSubmeshes(IntPtr _this);
             [DllImport("MeshSyncServer")] static extern SubmeshData msSplitGetSubmesh(IntPtr _this, int i);
             #endregion
 
+            public enum IndexFormat
+            {
+                U16,
+                U32,
+            };
+
             public int numPoints { get { return msSplitGetNumPoints(_this); } }
             public int numIndices { get { return msSplitGetNumIndices(_this); } }
             public Bounds bounds { get { return new Bounds(msSplitGetBoundsCenter(_this), msSplitGetBoundsSize(_this)); } }
+            public IndexFormat indexFormat { get { return msSplitGetIndexFormat(_this); } }
             public int numSubmeshes { get { return msSplitGetNumSubmeshes(_this); } }
 
             public SubmeshData GetSubmesh(int i)
@@ -1850,6 +1891,14 @@ namespace UTJ.MeshSync
             public int max_threads;
             public ushort port;
             public uint mesh_split_unit;
+            public ulong max_message_size;
+            public uint shared_memory_size;
+            public ulong texture_cache_size;
+            public ulong max_history_size;
+            public VertexFormat vertex_format;
+            public int transfer_timeout_ms;
+            public int material_timeout_ms;
+            public int framed_timeout_ms;
 
             public static ServerSettings default_value
             {
@@ -1865,6 +1914,14 @@ namespace UTJ.MeshSync
 #else
                         mesh_split_unit = 65000,
 #endif
+                        max_message_size = 0,
+                        shared_memory_size = 64 * 1024 * 1024,
+                        texture_cache_size = 512 * 1024 * 1024,
+                        max_history_size = 1024 * 1024 * 1024,
+                        vertex_format = VertexFormat.Unknown,
+                        transfer_timeout_ms = 60000,
+                        material_timeout_ms = 10 * 60 * 1000,
+                        framed_timeout_ms = 60000,
                     };
                 }
             }
@@ -5,7 +5,9 @@
 #include "msSceneGraph.h"
 #include "msConstraints.h"
 #include "msAnimation.h"
+#include "msAnimationBaker.h"
 #include "msMaterial.h"
+#include "msTextureLoader.h"
 #include "msClient.h"
 #include "msServer.h"
 
@@ -1,47 +1,258 @@
 #include "pch.h"
 #include "msSceneGraph.h"
 #include "msAnimation.h"
+#include "msProtocol.h"
 #include "msSceneGraphImpl.h"
 
 
 #define Clear(V) V.clear();
 #define Empty(V) && V.empty()
-#define Reduce(V) DoReduction(V);
+#define Reduce(V) tasks.push_back([this, settings]() { DoReduction(V, settings); });
 #define Reserve(V) V.reserve(n);
+#define Append(V) V.append(s.V);
 
 namespace ms {
 
+// distance between an original sample and the interpolated value
+static inline float ReductionError(float a, float b) { return std::abs(a - b); }
+static inline float ReductionError(const float3& a, const float3& b) { return length(a - b); }
+static inline float ReductionError(const float4& a, const float4& b) { return length(a - b); }
+// angle in radians. q and -q are the same rotation.
+// acos(dot) is too imprecise for small angles in float. use the chord length instead.
+static inline float ReductionError(const quatf& a, const quatf& b)
+{
+    auto a4 = normalize((const float4&)a);
+    auto b4 = normalize((const float4&)b);
+    if (dot(a4, b4) < 0.0f)
+        b4 = -b4;
+    return 4.0f * std::atan2(length(a4 - b4), length(a4 + b4));
+}
+
 template<class T>
-struct Equals
+static inline T ReductionLerp(const T& a, const T& b, float t) { return lerp(a, b, t); }
+// quaternion tracks end up as 4 per-component curves on the Unity side. component-wise lerp + normalize.
+static inline quatf ReductionLerp(const quatf& a, const quatf& b, float t)
 {
-    bool operator()(const T& a, const T& b) const
-    {
-        return mu::near_equal(a, b);
+    auto r = normalize(lerp((const float4&)a, (const float4&)b, t));
+    return (const quatf&)r;
+}
+
+// Ramer-Douglas-Peucker on time-value pairs: keep the sample farthest from the line between kept keys
+// until every removed sample is within eps.
+template<class T>
+static void ReduceLinear(AnimationTrack<T>& data, float eps, KeyframeReductionSettings::Pass pass)
+{
+    using Pass = KeyframeReductionSettings::Pass;
+    auto& times = data.times;
+    auto& values = data.values;
+    int n = (int)data.size();
+    if (pass == Pass::Finish) {
+        // chunks are reduced already. running the reduction again would add up the errors.
+        for (int i = 1; i < n; ++i) {
+            if (ReductionError(values[0], values[i]) > eps)
+                return;
+        }
+        data.clear();
+        return;
     }
-};
-template<>
-struct Equals<bool>
-{
-    bool operator()(bool a, bool b) const
-    {
-        return a == b;
+    if (pass == Pass::Partial && n <= 2)
+        return;
+    if (n == 1) {
+        data.clear();
+        return;
+    }
+    if (n <= 2) {
+        // constant tracks are omitted
+        if (n == 2 && ReductionError(values[0], values[1]) <= eps)
+            data.clear();
+        return;
+    }
+
+    RawVector<char> keep;
+    keep.resize_zeroclear(n);
+    keep[0] = keep[n - 1] = 1;
+
+    RawVector<std::pair<int, int>> ranges;
+    ranges.push_back({ 0, n - 1 });
+    while (!ranges.empty()) {
+        auto range = ranges.back();
+        ranges.pop_back();
+        int first = range.first;
+        int last = range.second;
+        if (last - first < 2)
+            continue;
+
+        float span = times[last] - times[first];
+        float max_error = 0.0f;
+        int max_index = -1;
+        for (int i = first + 1; i < last; ++i) {
+            float t = span > 0.0f ? (times[i] - times[first]) / span : 0.0f;
+            float error = ReductionError(values[i], ReductionLerp(values[first], values[last], t));
+            if (error > max_error) {
+                max_error = error;
+                max_index = i;
+            }
+        }
+        if (max_error > eps) {
+            keep[max_index] = 1;
+            ranges.push_back({ first, max_index });
+            ranges.push_back({ max_index, last });
+        }
+    }
+
+    int num_kept = 0;
+    for (int i = 0; i < n; ++i) {
+        if (keep[i]) {
+            times[num_kept] = times[i];
+            values[num_kept] = values[i];
+            ++num_kept;
+        }
     }
+    data.resize(num_kept);
+
+    if (pass == Pass::Whole && num_kept == 2 && ReductionError(values[0], values[1]) <= eps)
+        data.clear();
+}
+
+// bool tracks are stepped. only keys that change the value are needed.
+// the result of reducing chunks and then the whole (Finish) is the same as reducing the whole at once.
+static void ReduceStep(AnimationTrack<bool>& data, KeyframeReductionSettings::Pass pass)
+{
+    using Pass = KeyframeReductionSettings::Pass;
+    auto& times = data.times;
+    auto& values = data.values;
+    int n = (int)data.size();
+    int num_kept = 0;
+    for (int i = 0; i < n; ++i) {
+        if (i == 0 || values[i] != values[num_kept - 1] || (pass == Pass::Partial && i == n - 1)) {
+            times[num_kept] = times[i];
+            values[num_kept] = values[i];
+            ++num_kept;
+        }
+    }
+    data.resize(num_kept);
+    if (pass != Pass::Partial && data.size() == 1)
+        data.clear();
+}
+
+template<class T>
+static void DoReduction(AnimationTrack<T>& data, const KeyframeReductionSettings& settings)
+{
+    ReduceLinear(data, settings.threshold, settings.pass);
+}
+static void DoReduction(AnimationTrack<quatf>& data, const KeyframeReductionSettings& settings)
+{
+    ReduceLinear(data, settings.rotation_threshold * Deg2Rad, settings.pass);
+}
+static void DoReduction(AnimationTrack<bool>& data, const KeyframeReductionSettings& settings)
+{
+    ReduceStep(data, settings.pass);
+}
+
+static void RunReductionTasks(ReductionTasks& tasks)
+{
+    mu::parallel_for_each(tasks.begin(), tasks.end(), [](std::function<void()>& task) {
+        task();
+    });
+}
+
+
+// track serialization.
+// protocol 110 layout: RawVector<TVP<T>>. this is written unless the receiver supports
+// FeatureFlags::animation_shared_times. in that case, the layout is:
+// int mode; (if mode == Own) times; values
+// Shared: times are identical to the first non-empty track of the animation and omitted.
+// baked clips sample all channels at the same frames, so this roughly halves their size.
+// the animation type is written with SharedTimesBit so that the reader knows which layout follows.
+enum class TrackTimes : int
+{
+    Own,
+    Shared,
 };
+static const int SharedTimesBit = 0x10000;
+
+template<class T>
+static bool ShareTimes(const AnimationTrack<T>& v, const RawVector<float> *shared)
+{
+    return shared && !v.empty() && shared->size() == v.times.size() &&
+        memcmp(shared->data(), v.times.data(), sizeof(float) * v.times.size()) == 0;
+}
 
 template<class T>
-static void DoReduction(RawVector<TVP<T>>& data)
+static uint32_t TrackSerializeSize(const AnimationTrack<T>& v, Animation::TrackSerializeContext& ctx)
 {
-    while (data.size() >= 2) {
-        if (Equals<T>()(data[data.size()-2].value, data.back().value))
-            data.pop_back();
-        else
-            break;
+    if (!ctx.share_times)
+        return uint32_t(4 + sizeof(TVP<T>) * v.size());
+
+    uint32_t ret = sizeof(int);
+    if (!ShareTimes(v, ctx.shared_times)) {
+        ret += ssize(v.times);
+        if (!ctx.shared_times && !v.empty())
+            ctx.shared_times = &v.times;
     }
-    if (data.size() == 1) {
-        data.clear();
+    ret += ssize(v.values);
+    return ret;
+}
+
+template<class T>
+static void TrackSerialize(std::ostream& os, const AnimationTrack<T>& v, Animation::TrackSerializeContext& ctx)
+{
+    if (!ctx.share_times) {
+        // same layout as RawVector<TVP<T>>
+        auto size = (uint32_t)v.size();
+        write(os, size);
+        for (uint32_t i = 0; i < size; ++i) {
+            TVP<T> tvp{}; // zero padding
+            tvp.time = v.times[i];
+            tvp.value = v.values[i];
+            os.write((const char*)&tvp, sizeof(tvp));
+        }
+        return;
+    }
+
+    if (ShareTimes(v, ctx.shared_times)) {
+        write(os, (int)TrackTimes::Shared);
     }
+    else {
+        write(os, (int)TrackTimes::Own);
+        write(os, v.times);
+        if (!ctx.shared_times && !v.empty())
+            ctx.shared_times = &v.times;
+    }
+    write(os, v.values);
 }
 
+template<class T>
+static void TrackDeserialize(std::istream& is, AnimationTrack<T>& v, Animation::TrackSerializeContext& ctx)
+{
+    if (!ctx.share_times) {
+        RawVector<TVP<T>> tmp;
+        read(is, tmp);
+        v.resize(tmp.size());
+        for (size_t i = 0; i < tmp.size(); ++i) {
+            v.times[i] = tmp[i].time;
+            v.values[i] = tmp[i].value;
+        }
+        return;
+    }
+
+    int mode;
+    read(is, mode);
+    if ((TrackTimes)mode == TrackTimes::Shared && ctx.shared_times) {
+        v.times = *ctx.shared_times;
+    }
+    else {
+        read(is, v.times);
+        if (!ctx.shared_times && !v.times.empty())
+            ctx.shared_times = &v.times;
+    }
+    read(is, v.values);
+}
+
+#define msTrackSize(V) ret += TrackSerializeSize(V, ctx);
+#define msTrackWrite(V) TrackSerialize(os, V, ctx);
+#define msTrackRead(V) TrackDeserialize(is, V, ctx);
+
 
 std::shared_ptr<Animation> Animation::create(std::istream & is)
 {
@@ -49,7 +260,7 @@ std::shared_ptr<Animation> Animation::create(std::istream & is)
 
     int type;
     read(is, type);
-    switch ((Type)type) {
+    switch ((Type)(type & ~SharedTimesBit)) {
     case Type::Transform: ret = TransformAnimation::create(); break;
     case Type::Camera: ret = CameraAnimation::create(); break;
     case Type::Light: ret = LightAnimation::create(); break;
@@ -57,11 +268,22 @@ std::shared_ptr<Animation> Animation::create(std::istream & is)
     default: break;
     }
     if (ret) {
-        ret->deserialize(is);
+        ret->deserialize(is, (type & SharedTimesBit) != 0);
     }
     return ret;
 }
 
+std::shared_ptr<Animation> Animation::create(Type type)
+{
+    switch (type) {
+    case Type::Transform: return TransformAnimation::create();
+    case Type::Camera: return CameraAnimation::create();
+    case Type::Light: return LightAnimation::create();
+    case Type::Mesh: return MeshAnimation::create();
+    default: return nullptr;
+    }
+}
+
 
 Animation::Animation() {}
 Animation::~Animation() {}
@@ -75,21 +297,51 @@ uint32_t Animation::getSerializeSize() const
 {
     uint32_t ret = 0;
     ret += sizeof(int);
-    ret += ssize(path);
+    ret += ssize_path(path);
+
+    TrackSerializeContext ctx;
+    ctx.share_times = WireFormatScope::current().animation_shared_times != 0;
+    ret += getTracksSerializeSize(ctx);
     return ret;
 }
 
 void Animation::serialize(std::ostream & os) const
 {
-    int type = (int)getType();
+    TrackSerializeContext ctx;
+    ctx.share_times = WireFormatScope::current().animation_shared_times != 0;
+
+    int type = (int)getType() | (ctx.share_times ? SharedTimesBit : 0);
     write(os, type);
-    write(os, path);
+    write_path(os, path);
+    serializeTracks(os, ctx);
 }
 
 void Animation::deserialize(std::istream & is)
 {
-    // type is consumed by make()
-    read(is, path);
+    deserialize(is, false);
+}
+
+void Animation::deserialize(std::istream & is, bool share_times)
+{
+    // type is consumed by create()
+    read_path(is, path);
+
+    TrackSerializeContext ctx;
+    ctx.share_times = share_times;
+    deserializeTracks(is, ctx);
+}
+
+uint32_t Animation::getTracksSerializeSize(TrackSerializeContext& /*ctx*/) const
+{
+    return 0;
+}
+
+void Animation::serializeTracks(std::ostream& /*os*/, TrackSerializeContext& /*ctx*/) const
+{
+}
+
+void Animation::deserializeTracks(std::istream& /*is*/, TrackSerializeContext& /*ctx*/)
+{
 }
 
 void Animation::clear()
@@ -97,6 +349,18 @@ void Animation::clear()
     path.clear();
 }
 
+void Animation::reduction(const KeyframeReductionSettings& settings)
+{
+    ReductionTasks tasks;
+    collectReductionTasks(tasks, settings);
+    RunReductionTasks(tasks);
+    eraseEmptyTracks();
+}
+
+void Animation::eraseEmptyTracks()
+{
+}
+
 
 
 TransformAnimation::TransformAnimation() {}
@@ -110,21 +374,21 @@ Animation::Type TransformAnimation::getType() const
 #define EachMember(F)\
     F(translation) F(rotation) F(scale) F(visible)
 
-uint32_t TransformAnimation::getSerializeSize() const
+uint32_t TransformAnimation::getTracksSerializeSize(TrackSerializeContext& ctx) const
 {
-    uint32_t ret = super::getSerializeSize();
-    EachMember(msSize);
+    uint32_t ret = super::getTracksSerializeSize(ctx);
+    EachMember(msTrackSize);
     return ret;
 }
-void TransformAnimation::serialize(std::ostream & os) const
+void TransformAnimation::serializeTracks(std::ostream& os, TrackSerializeContext& ctx) const
 {
-    super::serialize(os);
-    EachMember(msWrite);
+    super::serializeTracks(os, ctx);
+    EachMember(msTrackWrite);
 }
-void TransformAnimation::deserialize(std::istream & is)
+void TransformAnimation::deserializeTracks(std::istream& is, TrackSerializeContext& ctx)
 {
-    super::deserialize(is);
-    EachMember(msRead);
+    super::deserializeTracks(is, ctx);
+    EachMember(msTrackRead);
 }
 void TransformAnimation::clear()
 {
@@ -137,7 +401,7 @@ bool TransformAnimation::empty() const
     ret = ret EachMember(Empty);
     return ret;
 }
-void TransformAnimation::reduction()
+void TransformAnimation::collectReductionTasks(ReductionTasks& tasks, const KeyframeReductionSettings& settings)
 {
     EachMember(Reduce);
 }
@@ -145,30 +409,32 @@ void TransformAnimation::reserve(size_t n)
 {
     EachMember(Reserve);
 }
+void TransformAnimation::append(const Animation& src)
+{
+    auto& s = static_cast<const TransformAnimation&>(src);
+    EachMember(Append);
+}
 #undef EachMember
 
+// quaternions are processed as float4. see swap_handedness() / swap_yz() in muMath.h
 void TransformAnimation::convertHandedness(bool x, bool yz)
 {
+    auto *rot = (float4*)rotation.values.data();
     if (x) {
-        for (auto& tvp : translation)
-            tvp.value = swap_handedness(tvp.value);
-        for (auto& tvp : rotation)
-            tvp.value = swap_handedness(tvp.value);
+        InvertX(translation.values.data(), translation.size());
+        Scale(rot, float4{ 1.0f, -1.0f, -1.0f, 1.0f }, rotation.size());
     }
     if (yz) {
-        for (auto& tvp : translation)
-            tvp.value = swap_yz(tvp.value);
-        for (auto& tvp : rotation)
-            tvp.value = swap_yz(tvp.value);
-        for (auto& tvp : scale)
-            tvp.value = swap_yz(tvp.value);
+        SwapYZ(translation.values.data(), translation.size());
+        SwapYZ(rot, rotation.size());
+        Scale(rot, float4{ -1.0f, -1.0f, -1.0f, 1.0f }, rotation.size());
+        SwapYZ(scale.values.data(), scale.size());
     }
 }
 
 void TransformAnimation::applyScaleFactor(float s)
 {
-    for (auto& tvp : translation)
-        tvp.value *= s;
+    Scale(translation.values.data(), s, translation.size());
 }
 
 
@@ -184,21 +450,21 @@ Animation::Type CameraAnimation::getType() const
 #define EachMember(F)\
     F(fov) F(near_plane) F(far_plane) F(horizontal_aperture) F(vertical_aperture) F(focal_length) F(focus_distance)
 
-uint32_t CameraAnimation::getSerializeSize() const
+uint32_t CameraAnimation::getTracksSerializeSize(TrackSerializeContext& ctx) const
 {
-    uint32_t ret = super::getSerializeSize();
-    EachMember(msSize);
+    uint32_t ret = super::getTracksSerializeSize(ctx);
+    EachMember(msTrackSize);
     return ret;
 }
-void CameraAnimation::serialize(std::ostream & os) const
+void CameraAnimation::serializeTracks(std::ostream& os, TrackSerializeContext& ctx) const
 {
-    super::serialize(os);
-    EachMember(msWrite);
+    super::serializeTracks(os, ctx);
+    EachMember(msTrackWrite);
 }
-void CameraAnimation::deserialize(std::istream & is)
+void CameraAnimation::deserializeTracks(std::istream& is, TrackSerializeContext& ctx)
 {
-    super::deserialize(is);
-    EachMember(msRead);
+    super::deserializeTracks(is, ctx);
+    EachMember(msTrackRead);
 }
 void CameraAnimation::clear()
 {
@@ -209,9 +475,9 @@ bool CameraAnimation::empty() const
 {
     return super::empty() EachMember(Empty);
 }
-void CameraAnimation::reduction()
+void CameraAnimation::collectReductionTasks(ReductionTasks& tasks, const KeyframeReductionSettings& settings)
 {
-    super::reduction();
+    super::collectReductionTasks(tasks, settings);
     EachMember(Reduce);
 }
 void CameraAnimation::reserve(size_t n)
@@ -219,15 +485,19 @@ void CameraAnimation::reserve(size_t n)
     super::reserve(n);
     EachMember(Reserve);
 }
+void CameraAnimation::append(const Animation& src)
+{
+    super::append(src);
+    auto& s = static_cast<const CameraAnimation&>(src);
+    EachMember(Append);
+}
 #undef EachMember
 
 void CameraAnimation::applyScaleFactor(float s)
 {
     super::applyScaleFactor(s);
-    for (auto& tvp : near_plane)
-        tvp.value *= s;
-    for (auto& tvp : far_plane)
-        tvp.value *= s;
+    Scale(near_plane.values.data(), s, near_plane.size());
+    Scale(far_plane.values.data(), s, far_plane.size());
 }
 
 
@@ -242,21 +512,21 @@ Animation::Type LightAnimation::getType() const
 #define EachMember(F)\
     F(color) F(intensity) F(range) F(spot_angle)
 
-uint32_t LightAnimation::getSerializeSize() const
+uint32_t LightAnimation::getTracksSerializeSize(TrackSerializeContext& ctx) const
 {
-    uint32_t ret = super::getSerializeSize();
-    EachMember(msSize);
+    uint32_t ret = super::getTracksSerializeSize(ctx);
+    EachMember(msTrackSize);
     return ret;
 }
-void LightAnimation::serialize(std::ostream & os) const
+void LightAnimation::serializeTracks(std::ostream& os, TrackSerializeContext& ctx) const
 {
-    super::serialize(os);
-    EachMember(msWrite);
+    super::serializeTracks(os, ctx);
+    EachMember(msTrackWrite);
 }
-void LightAnimation::deserialize(std::istream & is)
+void LightAnimation::deserializeTracks(std::istream& is, TrackSerializeContext& ctx)
 {
-    super::deserialize(is);
-    EachMember(msRead);
+    super::deserializeTracks(is, ctx);
+    EachMember(msTrackRead);
 }
 void LightAnimation::clear()
 {
@@ -267,9 +537,9 @@ bool LightAnimation::empty() const
 {
     return super::empty() EachMember(Empty);
 }
-void LightAnimation::reduction()
+void LightAnimation::collectReductionTasks(ReductionTasks& tasks, const KeyframeReductionSettings& settings)
 {
-    super::reduction();
+    super::collectReductionTasks(tasks, settings);
     EachMember(Reduce);
 }
 void LightAnimation::reserve(size_t n)
@@ -277,13 +547,18 @@ void LightAnimation::reserve(size_t n)
     super::reserve(n);
     EachMember(Reserve);
 }
+void LightAnimation::append(const Animation& src)
+{
+    super::append(src);
+    auto& s = static_cast<const LightAnimation&>(src);
+    EachMember(Append);
+}
 #undef EachMember
 
 void LightAnimation::applyScaleFactor(float s)
 {
     super::applyScaleFactor(s);
-    for (auto& tvp : range)
-        tvp.value *= s;
+    Scale(range.values.data(), s, range.size());
 }
 
 
@@ -297,21 +572,25 @@ std::shared_ptr<BlendshapeAnimation> BlendshapeAnimation::create(std::istream &
 BlendshapeAnimation::BlendshapeAnimation() {}
 BlendshapeAnimation::~BlendshapeAnimation() {}
 
+// standalone blendshape animations have no type to mark the layout. they are always written in the 110 layout.
 uint32_t BlendshapeAnimation::getSerializeSize() const
 {
-    return ssize(name) + ssize(weight);
+    Animation::TrackSerializeContext ctx;
+    return ssize(name) + TrackSerializeSize(weight, ctx);
 }
 
 void BlendshapeAnimation::serialize(std::ostream & os) const
 {
+    Animation::TrackSerializeContext ctx;
     write(os, name);
-    write(os, weight);
+    TrackSerialize(os, weight, ctx);
 }
 
 void BlendshapeAnimation::deserialize(std::istream & is)
 {
+    Animation::TrackSerializeContext ctx;
     read(is, name);
-    read(is, weight);
+    TrackDeserialize(is, weight, ctx);
 }
 
 void BlendshapeAnimation::clear()
@@ -333,23 +612,39 @@ Animation::Type MeshAnimation::getType() const
     return Type::Mesh;
 }
 
-uint32_t MeshAnimation::getSerializeSize() const
+// blendshape weights are written here rather than by BlendshapeAnimation::serialize() to share times
+uint32_t MeshAnimation::getTracksSerializeSize(TrackSerializeContext& ctx) const
 {
-    uint32_t ret = super::getSerializeSize();
-    ret += ssize(blendshapes);
+    uint32_t ret = super::getTracksSerializeSize(ctx);
+    ret += sizeof(int);
+    for (auto& bs : blendshapes) {
+        ret += ssize(bs->name);
+        ret += TrackSerializeSize(bs->weight, ctx);
+    }
     return ret;
 }
 
-void MeshAnimation::serialize(std::ostream & os) const
+void MeshAnimation::serializeTracks(std::ostream& os, TrackSerializeContext& ctx) const
 {
-    super::serialize(os);
-    write(os, blendshapes);
+    super::serializeTracks(os, ctx);
+    write(os, (int)blendshapes.size());
+    for (auto& bs : blendshapes) {
+        write(os, bs->name);
+        TrackSerialize(os, bs->weight, ctx);
+    }
 }
 
-void MeshAnimation::deserialize(std::istream & is)
+void MeshAnimation::deserializeTracks(std::istream& is, TrackSerializeContext& ctx)
 {
-    super::deserialize(is);
-    read(is, blendshapes);
+    super::deserializeTracks(is, ctx);
+    int num_blendshapes;
+    read(is, num_blendshapes);
+    blendshapes.resize(num_blendshapes);
+    for (auto& bs : blendshapes) {
+        bs = BlendshapeAnimation::create();
+        read(is, bs->name);
+        TrackDeserialize(is, bs->weight, ctx);
+    }
 }
 
 void MeshAnimation::clear()
@@ -363,12 +658,25 @@ bool MeshAnimation::empty() const
     return super::empty() && blendshapes.empty();
 }
 
-void MeshAnimation::reduction()
+void MeshAnimation::append(const Animation& src)
+{
+    super::append(src);
+    auto& s = static_cast<const MeshAnimation&>(src);
+    for (auto& bs : s.blendshapes)
+        findOrCreateBlendshapeAnimation(bs->name.c_str())->weight.append(bs->weight);
+}
+
+void MeshAnimation::collectReductionTasks(ReductionTasks& tasks, const KeyframeReductionSettings& settings)
 {
-    super::reduction();
+    super::collectReductionTasks(tasks, settings);
+    for (auto& bs : blendshapes) {
+        auto *weight = &bs->weight;
+        tasks.push_back([weight, settings]() { DoReduction(*weight, settings); });
+    }
+}
 
-    for (auto& bs : blendshapes)
-        DoReduction(bs->weight);
+void MeshAnimation::eraseEmptyTracks()
+{
     blendshapes.erase(
         std::remove_if(blendshapes.begin(), blendshapes.end(), [](BlendshapeAnimationPtr& p) { return p->empty(); }),
         blendshapes.end());
@@ -435,11 +743,17 @@ bool AnimationClip::empty() const
     return animations.empty();
 }
 
-void AnimationClip::reduction()
+void AnimationClip::reduction(const KeyframeReductionSettings& settings)
 {
-    mu::parallel_for_each(animations.begin(), animations.end(), [](ms::AnimationPtr& p) {
-        p->reduction();
-    });
+    // tracks are independent. parallelize across all tracks of all animations rather than per animation,
+    // as a clip often has a few animations with long tracks.
+    ReductionTasks tasks;
+    for (auto& p : animations)
+        p->collectReductionTasks(tasks, settings);
+    RunReductionTasks(tasks);
+    for (auto& p : animations)
+        p->eraseEmptyTracks();
+
     animations.erase(
         std::remove_if(animations.begin(), animations.end(), [](ms::AnimationPtr& p) { return p->empty(); }),
         animations.end());
@@ -2,6 +2,7 @@
 
 #include <string>
 #include <vector>
+#include <functional>
 #include "MeshUtils/MeshUtils.h"
 #include "msConfig.h"
 #include "msSceneGraph.h"
@@ -16,6 +17,50 @@ struct TVP
     T value;
 };
 
+// structure of arrays: times and values are separate contiguous arrays, so per-key conversions run on
+// plain value arrays (see muSIMD.h). baked tracks of an animation usually share identical times.
+// serialization sends such times only once per animation (FeatureFlags::animation_shared_times), but in memory
+// each track owns its times: keyframe reduction removes different keys from each track, so shared times
+// would have to be split again right after baking.
+template<class T>
+struct AnimationTrack
+{
+    using value_type = T;
+
+    RawVector<float> times;
+    RawVector<T> values;
+
+    size_t size() const { return values.size(); }
+    bool empty() const { return values.empty(); }
+    void clear() { times.clear(); values.clear(); }
+    void reserve(size_t n) { times.reserve(n); values.reserve(n); }
+    void resize(size_t n) { times.resize(n); values.resize(n); }
+    void push_back(const TVP<T>& v) { times.push_back(v.time); values.push_back(v.value); }
+    void append(const AnimationTrack& v)
+    {
+        times.insert(times.end(), v.times.begin(), v.times.end());
+        values.insert(values.end(), v.values.begin(), v.values.end());
+    }
+    TVP<T> operator[](size_t i) const { return{ times[i], values[i] }; }
+    TVP<T> front() const { return (*this)[0]; }
+    TVP<T> back() const { return (*this)[size() - 1]; }
+};
+
+// error bounds of keyframe reduction. keys are removed as long as linear interpolation of the remaining keys
+// stays within these of the original samples.
+struct KeyframeReductionSettings
+{
+    // tracks baked in chunks are reduced chunk by chunk (see AnimationBaker::Settings::chunk_frames).
+    // Partial: the keys are a chunk of a track that continues. the first and last keys are kept and the track is never emptied.
+    // Finish: all chunks have been reduced. only omits constant tracks and repeated keys of bool tracks.
+    enum class Pass { Whole, Partial, Finish };
+
+    float threshold = 0.001f;           // float / float3 / float4 tracks. absolute distance
+    float rotation_threshold = 0.05f;   // quaternion tracks. angle in degrees
+    Pass pass = Pass::Whole;
+};
+using ReductionTasks = std::vector<std::function<void()>>;
+
 class Animation
 {
 public:
@@ -28,17 +73,36 @@ protected:
     virtual ~Animation();
 public:
     static std::shared_ptr<Animation> create(std::istream& is);
+    static std::shared_ptr<Animation> create(Type type);
     virtual Type getType() const;
     virtual uint32_t getSerializeSize() const;
     virtual void serialize(std::ostream& os) const;
     virtual void deserialize(std::istream& is);
     virtual void clear();
     virtual bool empty() const = 0;
-    virtual void reduction() = 0;
     virtual void reserve(size_t n) = 0;
+    // append keys of src. src must be the same type.
+    virtual void append(const Animation& src) = 0;
+
+    void reduction(const KeyframeReductionSettings& settings = KeyframeReductionSettings());
+    // one task per track. AnimationClip::reduction() runs tasks of all animations in parallel.
+    virtual void collectReductionTasks(ReductionTasks& tasks, const KeyframeReductionSettings& settings) = 0;
+    virtual void eraseEmptyTracks();
 
     virtual void convertHandedness(bool x, bool yz) = 0;
     virtual void applyScaleFactor(float scale) = 0;
+
+    struct TrackSerializeContext
+    {
+        bool share_times = false; // see FeatureFlags::animation_shared_times
+        const RawVector<float> *shared_times = nullptr;
+    };
+
+protected:
+    void deserialize(std::istream& is, bool share_times);
+    virtual uint32_t getTracksSerializeSize(TrackSerializeContext& ctx) const;
+    virtual void serializeTracks(std::ostream& os, TrackSerializeContext& ctx) const;
+    virtual void deserializeTracks(std::istream& is, TrackSerializeContext& ctx);
 };
 msHasSerializer(Animation);
 using AnimationPtr = std::shared_ptr<Animation>;
@@ -48,10 +112,10 @@ class TransformAnimation : public Animation
 {
 using super = Animation;
 public:
-    RawVector<TVP<float3>>  translation;
-    RawVector<TVP<quatf>>   rotation;
-    RawVector<TVP<float3>>  scale;
-    RawVector<TVP<bool>>    visible;
+    AnimationTrack<float3>  translation;
+    AnimationTrack<quatf>   rotation;
+    AnimationTrack<float3>  scale;
+    AnimationTrack<bool>    visible;
 
 protected:
     TransformAnimation();
@@ -59,16 +123,19 @@ protected:
 public:
     msDefinePool(TransformAnimation);
     Type getType() const override;
-    uint32_t getSerializeSize() const override;
-    void serialize(std::ostream& os) const override;
-    void deserialize(std::istream& is) override;
     void clear() override;
     bool empty() const override;
-    void reduction() override;
     void reserve(size_t n) override;
+    void append(const Animation& src) override;
+    void collectReductionTasks(ReductionTasks& tasks, const KeyframeReductionSettings& settings) override;
 
     void convertHandedness(bool x, bool yz) override;
     void applyScaleFactor(float scale) override;
+
+protected:
+    uint32_t getTracksSerializeSize(TrackSerializeContext& ctx) const override;
+    void serializeTracks(std::ostream& os, TrackSerializeContext& ctx) const override;
+    void deserializeTracks(std::istream& is, TrackSerializeContext& ctx) override;
 };
 msHasSerializer(TransformAnimation);
 
@@ -77,13 +144,13 @@ class CameraAnimation : public TransformAnimation
 {
 using super = TransformAnimation;
 public:
-    RawVector<TVP<float>>   fov;
-    RawVector<TVP<float>>   near_plane;
-    RawVector<TVP<float>>   far_plane;
-    RawVector<TVP<float>>   horizontal_aperture;
-    RawVector<TVP<float>>   vertical_aperture;
-    RawVector<TVP<float>>   focal_length;
-    RawVector<TVP<float>>   focus_distance;
+    AnimationTrack<float>   fov;
+    AnimationTrack<float>   near_plane;
+    AnimationTrack<float>   far_plane;
+    AnimationTrack<float>   horizontal_aperture;
+    AnimationTrack<float>   vertical_aperture;
+    AnimationTrack<float>   focal_length;
+    AnimationTrack<float>   focus_distance;
 
 protected:
     CameraAnimation();
@@ -91,15 +158,18 @@ protected:
 public:
     msDefinePool(CameraAnimation);
     Type getType() const override;
-    uint32_t getSerializeSize() const override;
-    void serialize(std::ostream& os) const override;
-    void deserialize(std::istream& is) override;
     void clear() override;
     bool empty() const override;
-    void reduction() override;
     void reserve(size_t n) override;
+    void append(const Animation& src) override;
+    void collectReductionTasks(ReductionTasks& tasks, const KeyframeReductionSettings& settings) override;
 
     void applyScaleFactor(float scale) override;
+
+protected:
+    uint32_t getTracksSerializeSize(TrackSerializeContext& ctx) const override;
+    void serializeTracks(std::ostream& os, TrackSerializeContext& ctx) const override;
+    void deserializeTracks(std::istream& is, TrackSerializeContext& ctx) override;
 };
 msHasSerializer(CameraAnimation);
 
@@ -108,10 +178,10 @@ class LightAnimation : public TransformAnimation
 {
 using super = TransformAnimation;
 public:
-    RawVector<TVP<float4>>  color;
-    RawVector<TVP<float>>   intensity;
-    RawVector<TVP<float>>   range;
-    RawVector<TVP<float>>   spot_angle; // for spot light
+    AnimationTrack<float4>  color;
+    AnimationTrack<float>   intensity;
+    AnimationTrack<float>   range;
+    AnimationTrack<float>   spot_angle; // for spot light
 
 protected:
     LightAnimation();
@@ -119,15 +189,18 @@ protected:
 public:
     msDefinePool(LightAnimation);
     Type getType() const override;
-    uint32_t getSerializeSize() const override;
-    void serialize(std::ostream& os) const override;
-    void deserialize(std::istream& is) override;
     void clear() override;
     bool empty() const override;
-    void reduction() override;
     void reserve(size_t n) override;
+    void append(const Animation& src) override;
+    void collectReductionTasks(ReductionTasks& tasks, const KeyframeReductionSettings& settings) override;
 
     void applyScaleFactor(float scale) override;
+
+protected:
+    uint32_t getTracksSerializeSize(TrackSerializeContext& ctx) const override;
+    void serializeTracks(std::ostream& os, TrackSerializeContext& ctx) const override;
+    void deserializeTracks(std::istream& is, TrackSerializeContext& ctx) override;
 };
 msHasSerializer(LightAnimation);
 
@@ -135,7 +208,7 @@ msHasSerializer(LightAnimation);
 struct BlendshapeAnimation
 {
     std::string name;
-    RawVector<TVP<float>> weight;
+    AnimationTrack<float> weight;
 
 protected:
     BlendshapeAnimation();
@@ -164,14 +237,18 @@ protected:
 public:
     msDefinePool(MeshAnimation);
     Type getType() const override;
-    uint32_t getSerializeSize() const override;
-    void serialize(std::ostream& os) const override;
-    void deserialize(std::istream& is) override;
     void clear() override;
     bool empty() const override;
-    void reduction() override;
+    void append(const Animation& src) override;
+    void collectReductionTasks(ReductionTasks& tasks, const KeyframeReductionSettings& settings) override;
+    void eraseEmptyTracks() override;
 
     BlendshapeAnimation* findOrCreateBlendshapeAnimation(const char *name);
+
+protected:
+    uint32_t getTracksSerializeSize(TrackSerializeContext& ctx) const override;
+    void serializeTracks(std::ostream& os, TrackSerializeContext& ctx) const override;
+    void deserializeTracks(std::istream& is, TrackSerializeContext& ctx) override;
 };
 msHasSerializer(MeshAnimation);
 
@@ -193,7 +270,7 @@ public:
     void deserialize(std::istream& is);
     void clear();
     bool empty() const;
-    void reduction();
+    void reduction(const KeyframeReductionSettings& settings = KeyframeReductionSettings());
 
     void convertHandedness(bool x, bool yz);
     void applyScaleFactor(float scale);
@@ -0,0 +1,172 @@
+#include "pch.h"
+#include "msAnimationBaker.h"
+
+namespace ms {
+
+void AnimationBaker::addTarget(const AnimationPtr& dst, const Capture& capture)
+{
+    if (!dst || !capture)
+        return;
+    m_targets.push_back({ dst, capture });
+}
+
+size_t AnimationBaker::getNumTargets() const
+{
+    return m_targets.size();
+}
+
+void AnimationBaker::clear()
+{
+    m_targets.clear();
+}
+
+void AnimationBaker::bake(const Settings& settings, const SetFrame& set_frame, AnimationClip *clip, const ChunkHandler& on_chunk)
+{
+    int interval = std::max(settings.frame_interval, 1);
+    if (m_targets.empty() || settings.frame_end < settings.frame_start)
+        return;
+
+    int num_frames = (settings.frame_end - settings.frame_start) / interval + 1;
+    int num_targets = (int)m_targets.size();
+    for (auto& t : m_targets)
+        t.dst->reserve(num_frames);
+
+    // snapshots: one sample animation per target
+    using Snapshot = std::vector<AnimationPtr>;
+    int num_snapshots = std::min(std::max(settings.max_frames_in_flight, 1), num_frames);
+    std::vector<Snapshot> snapshots(num_snapshots);
+    for (auto& snapshot : snapshots) {
+        snapshot.resize(num_targets);
+        for (int ti = 0; ti < num_targets; ++ti) {
+            snapshot[ti] = Animation::create(m_targets[ti].dst->getType());
+            snapshot[ti]->reserve(1);
+        }
+    }
+
+    std::mutex mutex;
+    std::condition_variable cond;
+    std::deque<Snapshot*> free_snapshots, captured_snapshots;
+    for (auto& snapshot : snapshots)
+        free_snapshots.push_back(&snapshot);
+    bool capture_finished = false;
+
+    // chunked: snapshots are gathered into chunk animations, which are reduced and appended to the targets as a whole
+    int chunk_frames = settings.chunk_frames > 0 ? std::min(settings.chunk_frames, num_frames) : 0;
+    std::vector<AnimationPtr> chunks;
+    if (chunk_frames > 0) {
+        chunks.resize(num_targets);
+        for (int ti = 0; ti < num_targets; ++ti) {
+            chunks[ti] = Animation::create(m_targets[ti].dst->getType());
+            chunks[ti]->reserve(chunk_frames);
+        }
+    }
+    auto reduction_settings = settings.reduction_settings;
+
+    int num_merged = 0, chunk_begin = 0;
+    auto flush_chunk = [&]() {
+        bool last = num_merged == num_frames;
+        if (!chunks.empty()) {
+            if (settings.reduction) {
+                reduction_settings.pass = KeyframeReductionSettings::Pass::Partial;
+                ReductionTasks tasks;
+                for (auto& chunk : chunks)
+                    chunk->collectReductionTasks(tasks, reduction_settings);
+                parallel_for_each(tasks.begin(), tasks.end(), [](std::function<void()>& task) {
+                    task();
+                });
+            }
+            parallel_for(0, num_targets, [&](int ti) {
+                m_targets[ti].dst->append(*chunks[ti]);
+                chunks[ti]->clear();
+            });
+        }
+        if (on_chunk) {
+            int frame_begin = settings.frame_start + chunk_begin * interval;
+            int frame_end = settings.frame_start + (num_merged - 1) * interval;
+            on_chunk(frame_begin, frame_end, last);
+        }
+        chunk_begin = num_merged;
+    };
+
+    // merge snapshots in frame order. targets are independent, so each snapshot is merged in parallel.
+    std::thread merger([&]() {
+        for (;;) {
+            Snapshot *snapshot = nullptr;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                cond.wait(lock, [&]() { return !captured_snapshots.empty() || capture_finished; });
+                if (captured_snapshots.empty())
+                    break;
+                snapshot = captured_snapshots.front();
+                captured_snapshots.pop_front();
+            }
+
+            parallel_for(0, num_targets, [&](int ti) {
+                auto& sample = *(*snapshot)[ti];
+                (chunks.empty() ? m_targets[ti].dst : chunks[ti])->append(sample);
+                sample.clear();
+            });
+            ++num_merged;
+            if (num_merged == num_frames || (chunk_frames > 0 && num_merged - chunk_begin == chunk_frames))
+                flush_chunk();
+
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                free_snapshots.push_back(snapshot);
+            }
+            cond.notify_all();
+        }
+    });
+
+    for (int f = settings.frame_start; f <= settings.frame_end; f += interval) {
+        Snapshot *snapshot = nullptr;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            cond.wait(lock, [&]() { return !free_snapshots.empty(); });
+            snapshot = free_snapshots.front();
+            free_snapshots.pop_front();
+        }
+
+        set_frame(f);
+        auto capture = [&](int ti) {
+            m_targets[ti].capture(*(*snapshot)[ti]);
+        };
+        if (settings.parallel_capture)
+            parallel_for(0, num_targets, capture);
+        else
+            for (int ti = 0; ti < num_targets; ++ti)
+                capture(ti);
+
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            captured_snapshots.push_back(snapshot);
+        }
+        cond.notify_all();
+    }
+
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        capture_finished = true;
+    }
+    cond.notify_all();
+    merger.join();
+
+    if (settings.reduction) {
+        reduction_settings.pass = chunks.empty() ? KeyframeReductionSettings::Pass::Whole : KeyframeReductionSettings::Pass::Finish;
+        if (clip) {
+            clip->reduction(reduction_settings);
+        }
+        else {
+            ReductionTasks tasks;
+            for (auto& t : m_targets)
+                t.dst->collectReductionTasks(tasks, reduction_settings);
+            parallel_for_each(tasks.begin(), tasks.end(), [](std::function<void()>& task) {
+                task();
+            });
+            for (auto& t : m_targets)
+                t.dst->eraseEmptyTracks();
+        }
+    }
+}
+
+} // namespace ms
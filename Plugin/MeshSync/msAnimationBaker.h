@@ -0,0 +1,58 @@
+#pragma once
+
+#include <functional>
+#include "msAnimation.h"
+
+namespace ms {
+
+// bakes animations by stepping the timeline of a DCC tool.
+// evaluating the DCC scene is the only serial part: each frame, targets are captured into a snapshot
+// (sample animations that receive one key per track), and a worker thread merges snapshots into the
+// destination animations while the DCC evaluates the following frames.
+// keyframe reduction runs across all tracks once the last frame is merged, or if chunk_frames is set,
+// on the worker chunk by chunk while the DCC is still evaluating.
+class AnimationBaker
+{
+public:
+    struct Settings
+    {
+        int frame_start = 0;
+        int frame_end = 0;
+        int frame_interval = 1;
+        int max_frames_in_flight = 8;   // number of snapshots. capturing waits for the worker if all are in use.
+        bool parallel_capture = true;   // capture targets in parallel. disable if the DCC can't be read from worker threads.
+        bool reduction = true;
+        KeyframeReductionSettings reduction_settings;
+        // > 0: frames are merged into the targets in chunks of this many frames, and each chunk is reduced on the worker.
+        // keys at chunk boundaries are kept, so the result has a few more keys than reducing the whole at once.
+        int chunk_frames = 0;
+    };
+
+    // called while the frame is set. pushes keys of the current frame into dst.
+    // dst is a sample of the same type as the target, not the target itself.
+    using Capture = std::function<void(Animation& dst)>;
+    // evaluates the DCC scene at the frame. always called on the thread that called bake().
+    using SetFrame = std::function<void(int frame)>;
+    // called on the worker when a chunk is merged into the targets (and reduced). keys of the chunk are at the end of
+    // the tracks and nothing modifies the targets during the call. e.g. serialize and send them while later frames are baked.
+    // last is true for the final chunk. tracks may still be omitted by the reduction that follows it.
+    using ChunkHandler = std::function<void(int frame_begin, int frame_end, bool last)>;
+
+    void addTarget(const AnimationPtr& dst, const Capture& capture);
+    size_t getNumTargets() const;
+    void clear();
+
+    // bake all frames of settings into targets. returns when all keys are merged (and reduced).
+    // if clip is given, reduction runs on the clip and erases empty animations from it.
+    void bake(const Settings& settings, const SetFrame& set_frame, AnimationClip *clip = nullptr, const ChunkHandler& on_chunk = nullptr);
+
+private:
+    struct Target
+    {
+        AnimationPtr dst;
+        Capture capture;
+    };
+    std::vector<Target> m_targets;
+};
+
+} // namespace ms
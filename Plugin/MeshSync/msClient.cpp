@@ -6,13 +6,413 @@ namespace ms {
 using namespace Poco;
 using namespace Poco::Net;
 
+void MaterialCache::startSession()
+{
+    static std::atomic<uint64_t> s_session_count{ 0 };
+    m_last_sent = Now();
+    m_session = ((uint64_t)m_last_sent << 8) + (s_session_count++ & 0xff);
+    m_materials.clear();
+    m_texture_hashes.clear();
+}
+
+void MaterialCache::filter(std::vector<MaterialPtr>& materials, std::vector<TexturePtr>& textures, bool use_references, uint64_t server_epoch)
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    auto now = Now();
+    if (m_session == 0 || server_epoch != m_server_epoch || now - m_last_sent > (nanosec)SessionLifetimeMS * 1000000) {
+        m_server_epoch = server_epoch;
+        startSession();
+    }
+
+    // textures without data are references to the server's cache. they are sent as they are.
+    std::vector<char> unchanged(textures.size(), 0);
+    parallel_for(0, (int)textures.size(), [&](int i) {
+        auto& tex = *textures[i];
+        if (tex.getDataSize() == 0)
+            return;
+        auto hash = tex.updateHash();
+        auto it = m_texture_hashes.find(tex.id);
+        unchanged[i] = it != m_texture_hashes.end() && it->second == hash;
+    });
+    std::vector<int> changed_textures;
+    {
+        size_t n = 0;
+        for (size_t i = 0; i < textures.size(); ++i) {
+            if (unchanged[i])
+                continue;
+            auto& tex = textures[i];
+            if (tex->getDataSize() != 0) {
+                m_texture_hashes[tex->id] = tex->hash;
+                changed_textures.push_back(tex->id);
+            }
+            textures[n++] = tex;
+        }
+        textures.resize(n);
+    }
+
+    if (materials.empty())
+        return;
+
+    bool same_list = materials.size() == m_materials.size();
+    bool changed_any = false;
+    std::vector<char> changed(materials.size(), 0);
+    for (size_t i = 0; i < materials.size(); ++i) {
+        auto& mat = *materials[i];
+        if (same_list && mat.id != m_materials[i]->id)
+            same_list = false;
+
+        auto it = std::find_if(m_materials.begin(), m_materials.end(), [&mat](const MaterialPtr& v) { return v->id == mat.id; });
+        changed[i] = it == m_materials.end() || **it != mat;
+        for (int tid : changed_textures) {
+            if (changed[i])
+                break;
+            changed[i] = mat.usesTexture(tid);
+        }
+        changed_any = changed_any || changed[i];
+    }
+
+    std::vector<MaterialPtr> sent(materials.size());
+    for (size_t i = 0; i < materials.size(); ++i) {
+        sent[i] = Material::create();
+        *sent[i] = *materials[i];
+    }
+    m_materials.swap(sent);
+
+    if (same_list && !changed_any) {
+        materials.clear();
+        return;
+    }
+    m_last_sent = now;
+    if (use_references) {
+        // the list is always complete. the server replaces the materials of the session with it.
+        for (size_t i = 0; i < materials.size(); ++i) {
+            MaterialPtr mat;
+            if (changed[i]) {
+                mat = Material::create();
+                *mat = *materials[i];
+            }
+            else
+                mat = materials[i]->makeReference();
+            mat->session = m_session;
+            mat->flags.has_session = 1;
+            materials[i] = mat;
+        }
+    }
+}
+
+void MaterialCache::clear()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_session = 0;
+    m_materials.clear();
+    m_texture_hashes.clear();
+}
+
+
+// DCC plugins create Client for each send. without this, each of them would do an HTTP handshake and a TCP connect.
+// one entry per server. a Client takes the entry out while it is alive, so a connection is never shared.
+struct PooledConnection
+{
+    Capabilities caps;
+    std::shared_ptr<StreamSocket> socket;
+    std::shared_ptr<SocketStream> stream;
+    nanosec released = 0;
+};
+static std::mutex g_pool_mutex;
+static std::map<std::string, PooledConnection> g_pool;
+
+static std::string GetPoolKey(const ClientSettings& settings)
+{
+    return settings.server + ":" + std::to_string(settings.port);
+}
+
+// entries are reused for half the server's idle timeout so that the server never closes them under us
+static nanosec GetPoolLifetime(const Capabilities& caps)
+{
+    const nanosec default_lifetime = 10000000000; // 10 sec
+    return caps.framed_timeout_ms > 0 ?
+        std::min(default_lifetime, (nanosec)caps.framed_timeout_ms * 1000000 / 2) : default_lifetime;
+}
+
+
 Client::Client(const ClientSettings & settings)
     : m_settings(settings)
 {
 }
 
+Client::~Client()
+{
+    releaseConnection();
+}
+
+bool Client::acquireConnection()
+{
+    PooledConnection entry;
+    {
+        std::unique_lock<std::mutex> lock(g_pool_mutex);
+        auto it = g_pool.find(GetPoolKey(m_settings));
+        if (it == g_pool.end())
+            return false;
+        entry = std::move(it->second);
+        g_pool.erase(it);
+    }
+    if (Now() - entry.released > GetPoolLifetime(entry.caps))
+        return false;
+
+    if (entry.socket) {
+        // responses of the last Client are all consumed. anything readable means the server closed it.
+        bool alive = false;
+        try {
+            alive = !entry.socket->poll(Timespan(0), Socket::SELECT_READ);
+        }
+        catch (...) {
+        }
+        if (!alive) {
+            try {
+                entry.socket->close();
+            }
+            catch (...) {
+            }
+            return false;
+        }
+        if (m_settings.use_framed_transport) {
+            m_socket = entry.socket;
+            m_framed_stream = entry.stream;
+            m_last_request_id = m_last_response_id = 0;
+        }
+    }
+    m_caps = entry.caps;
+    m_caps_pooled = true;
+    m_handshaked = true;
+    return true;
+}
+
+void Client::releaseConnection()
+{
+    if (!m_handshaked || !m_caps.isCompatible())
+        return;
+
+    // the next user of the connection must not see our acks
+    if (m_framed_stream && m_last_response_id != m_last_request_id) {
+        FrameHeader response;
+        waitFramed(m_last_request_id, response); // disconnects on failure
+        if (m_framed_stream && response.size > 0 && !m_framed_stream->ignore((std::streamsize)response.size))
+            disconnectFramed();
+    }
+
+    PooledConnection entry;
+    entry.caps = m_caps;
+    entry.socket = m_socket;
+    entry.stream = m_framed_stream;
+    entry.released = Now();
+    m_framed_stream.reset();
+    m_socket.reset();
+
+    std::unique_lock<std::mutex> lock(g_pool_mutex);
+    // if several Clients were alive at the same time, the last one wins and the rest are closed with their owners
+    g_pool[GetPoolKey(m_settings)] = std::move(entry);
+}
+
+void Client::setMaterialCache(MaterialCache *cache)
+{
+    m_material_cache = cache;
+}
+
+bool Client::handshake()
+{
+    if (!m_handshaked && acquireConnection())
+        return m_caps.isCompatible();
+
+    try {
+        HTTPClientSession session{ m_settings.server, m_settings.port };
+        session.setTimeout(m_settings.timeout_ms * 1000);
+
+        HandshakeMessage mes;
+        mes.caps = Capabilities::current();
+        {
+            HTTPRequest request{ HTTPRequest::HTTP_POST, "handshake" };
+            request.setContentType("application/octet-stream");
+            request.setExpectContinue(true);
+            request.setContentLength(mes.getSerializeSize());
+            auto& os = session.sendRequest(request);
+            mes.serialize(os);
+            os.flush();
+        }
+
+        {
+            HTTPResponse response;
+            auto& is = session.receiveResponse(response);
+            HandshakeMessage ret;
+            if (response.getContentType() == "application/octet-stream" && ret.deserialize(is)) {
+                m_caps = Capabilities::negotiate(mes.caps, ret.caps);
+            }
+            else {
+                // old server responds the text form
+                std::ostringstream ostr;
+                StreamCopier::copyStream(is, ostr);
+                m_caps = Capabilities::negotiate(mes.caps, Capabilities::legacy());
+            }
+        }
+        m_handshaked = true;
+        m_caps_pooled = false;
+        return m_caps.isCompatible();
+    }
+    catch (...) {
+        return false;
+    }
+}
+
+const Capabilities& Client::getCapabilities() const
+{
+    return m_caps;
+}
+
+bool Client::sendSharedMemory(FrameType type, const Message& mes)
+{
+    if (!m_settings.use_shared_memory || m_shm_unavailable)
+        return false;
+
+    if (!m_shm) {
+        if (m_settings.server != "127.0.0.1" && m_settings.server != "localhost") {
+            m_shm_unavailable = true;
+            return false;
+        }
+        auto shm = std::make_shared<SharedMemoryChannel>();
+        if (!shm->open(SharedMemoryChannel::getName(m_settings.port)) || !shm->isServerAlive()) {
+            m_shm_unavailable = true;
+            return false;
+        }
+        m_shm = shm;
+    }
+
+    if (!m_shm->writeMessage(type, mes, m_settings.timeout_ms)) {
+        // fall back to HTTP from now on
+        m_shm.reset();
+        m_shm_unavailable = true;
+        return false;
+    }
+    return true;
+}
+
+bool Client::connectFramed()
+{
+    if (m_framed_stream)
+        return true;
+    if (!m_settings.use_framed_transport || m_framed_unavailable)
+        return false;
+
+    if (!m_handshaked)
+        handshake();
+    if (m_caps.framed_port == 0) {
+        m_framed_unavailable = true;
+        return false;
+    }
+
+    try {
+        Timespan timeout((Timespan::TimeDiff)m_settings.timeout_ms * 1000);
+        m_socket.reset(new StreamSocket());
+        m_socket->connect(SocketAddress(m_settings.server, m_caps.framed_port), timeout);
+        m_socket->setNoDelay(true);
+        m_socket->setReceiveTimeout(timeout);
+        m_socket->setSendTimeout(timeout);
+        m_framed_stream.reset(new SocketStream(*m_socket));
+        m_last_request_id = m_last_response_id = 0;
+        return true;
+    }
+    catch (...) {
+        disconnectFramed();
+        m_framed_unavailable = true;
+        return false;
+    }
+}
+
+void Client::disconnectFramed()
+{
+    m_framed_stream.reset();
+    if (m_socket) {
+        try {
+            m_socket->close();
+        }
+        catch (...) {
+        }
+        m_socket.reset();
+    }
+}
+
+bool Client::sendFramed(FrameType type, const Message& mes, uint32_t& request_id)
+{
+    const uint32_t max_pending = 256;
+
+    if (!connectFramed())
+        return false;
+
+    try {
+        // keep the server from blocking on writing acks nobody reads
+        if (m_last_request_id - m_last_response_id >= max_pending) {
+            FrameHeader response;
+            if (!waitFramed(m_last_response_id + 1, response))
+                return false;
+            m_framed_stream->ignore((std::streamsize)response.size);
+        }
+
+        FrameHeader header;
+        header.type = type;
+        header.request_id = request_id = ++m_last_request_id;
+        header.size = mes.getSerializeSize();
+
+        auto& os = *m_framed_stream;
+        os.write((const char*)&header, sizeof(header));
+        mes.serialize(os);
+        os.flush();
+        if (!os.good())
+            throw std::runtime_error("write failed");
+        return true;
+    }
+    catch (...) {
+        disconnectFramed();
+        m_framed_unavailable = true;
+        return false;
+    }
+}
+
+bool Client::waitFramed(uint32_t request_id, FrameHeader& response)
+{
+    if (!m_framed_stream)
+        return false;
+
+    try {
+        // responses come in the order of requests
+        auto& is = *m_framed_stream;
+        for (;;) {
+            if (!is.read((char*)&response, sizeof(response)))
+                throw std::runtime_error("read failed");
+            m_last_response_id = response.request_id;
+            if (response.request_id == request_id)
+                return response.type == FrameType::Ack;
+            is.ignore((std::streamsize)response.size);
+        }
+    }
+    catch (...) {
+        disconnectFramed();
+        m_framed_unavailable = true;
+        return false;
+    }
+}
+
 ScenePtr Client::send(const GetMessage& mes)
 {
+    uint32_t id;
+    if (sendFramed(FrameType::Get, mes, id)) {
+        ScenePtr ret;
+        FrameHeader response;
+        if (waitFramed(id, response)) {
+            ret.reset(new Scene());
+            if (response.size > 0)
+                ret->deserialize(*m_framed_stream);
+        }
+        return ret;
+    }
+
     ScenePtr ret;
     try {
         HTTPClientSession session{ m_settings.server, m_settings.port };
@@ -40,13 +440,13 @@ ScenePtr Client::send(const GetMessage& mes)
     return ret;
 }
 
-bool Client::send(const SetMessage& mes)
+bool Client::sendHTTP(const char *uri, const Message& mes)
 {
     try {
         HTTPClientSession session{ m_settings.server, m_settings.port };
         session.setTimeout(m_settings.timeout_ms * 1000);
 
-        HTTPRequest request{ HTTPRequest::HTTP_POST, "set" };
+        HTTPRequest request{ HTTPRequest::HTTP_POST, uri };
         request.setContentType("application/octet-stream");
         request.setExpectContinue(true);
         request.setContentLength(mes.getSerializeSize());
@@ -65,58 +465,303 @@ bool Client::send(const SetMessage& mes)
     }
 }
 
-bool Client::send(const DeleteMessage& mes)
+bool Client::sendMessage(FrameType type, const char *uri, const Message& mes)
 {
-    try {
-        HTTPClientSession session{ m_settings.server, m_settings.port };
-        session.setTimeout(m_settings.timeout_ms * 1000);
-
-        HTTPRequest request{ HTTPRequest::HTTP_POST, "delete" };
-        request.setContentType("application/octet-stream");
-        request.setExpectContinue(true);
-        request.setContentLength(mes.getSerializeSize());
-        auto& os = session.sendRequest(request);
-        mes.serialize(os);
-        os.flush();
+    // formats newer than protocol 110 are used only if the server can read them
+    auto features = m_caps.features;
+    if (!m_settings.compact_indices)
+        features.compact_indices = 0;
+    WireFormatScope scope(features);
+    uint32_t id;
+    if (sendSharedMemory(type, mes))
+        return true;
+    if (sendFramed(type, mes, id))
+        return true;
+    return sendHTTP(uri, mes);
+}
 
-        HTTPResponse response;
-        auto& rs = session.receiveResponse(response);
-        std::ostringstream ostr;
-        StreamCopier::copyStream(rs, ostr);
+bool Client::send(const SetMessage& mes)
+{
+    if (m_material_cache && (!mes.scene.materials.empty() || !mes.scene.textures.empty())) {
+        if (!mes.scene.materials.empty()) {
+            if (!m_handshaked)
+                handshake();
+            // references are resolved only by the server instance that received the materials.
+            // pooled capabilities may be older than a restart or clear() of the server, so its epoch is asked again.
+            if (m_caps_pooled && m_caps.features.material_reference)
+                handshake();
+        }
+        SetMessage tmp;
+        tmp.scene = mes.scene;
+        m_material_cache->filter(tmp.scene.materials, tmp.scene.textures, m_caps.features.material_reference != 0, m_caps.server_epoch);
+        if ((m_settings.use_texture_cache || m_settings.compress_textures || m_settings.generate_mipmaps) && !tmp.scene.textures.empty())
+            prepareTextures(tmp.scene.textures);
+        if (!sendSet(tmp)) {
+            // the server may not have received them
+            m_material_cache->clear();
+            return false;
+        }
         return true;
     }
-    catch (...) {
+    if ((m_settings.use_texture_cache || m_settings.compress_textures || m_settings.generate_mipmaps) && !mes.scene.textures.empty()) {
+        SetMessage tmp;
+        tmp.scene = mes.scene;
+        if (prepareTextures(tmp.scene.textures))
+            return sendSet(tmp);
+    }
+    return sendSet(mes);
+}
+
+bool Client::prepareTextures(std::vector<TexturePtr>& textures)
+{
+    bool use_cache = m_settings.use_texture_cache;
+    if (use_cache) {
+        if (!m_handshaked)
+            handshake();
+        use_cache = m_caps.features.texture_cache != 0;
+    }
+    bool compress = m_settings.compress_textures;
+    bool mipmaps = m_settings.generate_mipmaps;
+    if (mipmaps) {
+        if (!m_handshaked)
+            handshake();
+        mipmaps = m_caps.features.texture_mipmaps != 0;
+    }
+    if (!use_cache && !compress && !mipmaps)
         return false;
+
+    // data may have been modified since the last send. always hash again.
+    // processed textures are identified by the hash of the source and the processing settings,
+    // so that textures in the server's cache are not processed again.
+    auto quality = m_settings.texture_compression_quality;
+    auto filter = m_settings.mipmap_filter;
+    size_t num_textures = textures.size();
+    std::vector<TextureFormat> formats(num_textures, TextureFormat::Unknown);
+    std::vector<char> gen_mipmaps(num_textures, 0);
+    std::vector<uint64_t> hashes(num_textures, 0);
+    parallel_for(0, (int)num_textures, [&](int i) {
+        auto& tex = *textures[i];
+        if (compress)
+            formats[i] = tex.getCompressedFormat(quality);
+        if (mipmaps)
+            gen_mipmaps[i] = !tex.has_mipmaps && !tex.data.empty() && GetPixelSize(tex.format) != 0;
+        if (use_cache) {
+            hashes[i] = tex.updateHash();
+            if (formats[i] != TextureFormat::Unknown || gen_mipmaps[i]) {
+                uint64_t settings = (uint64_t)formats[i] | ((uint64_t)quality << 32);
+                if (gen_mipmaps[i])
+                    settings |= (1ull << 40) | ((uint64_t)filter << 41);
+                uint64_t key[2] = { hashes[i], settings };
+                hashes[i] = Hash64(key, sizeof(key));
+            }
+        }
+    });
+
+    bool ret = false;
+    if (use_cache) {
+        TextureQueryMessage query, cached;
+        for (auto h : hashes) {
+            if (h != 0)
+                query.hashes.push_back(h);
+        }
+        if (!query.hashes.empty() && sendTextureQuery(query, cached)) {
+            std::sort(cached.hashes.begin(), cached.hashes.end());
+            for (size_t i = 0; i < num_textures; ++i) {
+                if (hashes[i] == 0 || !std::binary_search(cached.hashes.begin(), cached.hashes.end(), hashes[i]))
+                    continue;
+                auto ref = textures[i]->makeReference();
+                if (formats[i] != TextureFormat::Unknown)
+                    ref->format = formats[i];
+                if (gen_mipmaps[i])
+                    ref->has_mipmaps = true;
+                ref->hash = hashes[i];
+                textures[i] = ref;
+                formats[i] = TextureFormat::Unknown;
+                gen_mipmaps[i] = 0;
+                ret = true;
+            }
+        }
+    }
+
+    // mipmap generation and compression of each texture are parallelized internally
+    for (size_t i = 0; i < num_textures; ++i) {
+        if (gen_mipmaps[i]) {
+            auto dst = Texture::create();
+            *dst = *textures[i];
+            if (dst->generateMipmaps(filter)) {
+                dst->hash = hashes[i];
+                textures[i] = dst;
+                ret = true;
+            }
+        }
+        if (formats[i] != TextureFormat::Unknown) {
+            auto dst = Texture::create();
+            if (textures[i]->compress(*dst, formats[i], quality)) {
+                dst->hash = hashes[i];
+                textures[i] = dst;
+                ret = true;
+            }
+        }
     }
+    return ret;
 }
 
-bool Client::send(const FenceMessage & mes)
+bool Client::sendTextureQuery(const TextureQueryMessage& mes, TextureQueryMessage& ret)
 {
+    uint32_t id;
+    if (sendFramed(FrameType::TextureQuery, mes, id)) {
+        FrameHeader response;
+        return waitFramed(id, response) && ret.deserialize(*m_framed_stream);
+    }
+
     try {
         HTTPClientSession session{ m_settings.server, m_settings.port };
         session.setTimeout(m_settings.timeout_ms * 1000);
 
-        HTTPRequest request{ HTTPRequest::HTTP_POST, "fence" };
-        request.setContentType("application/octet-stream");
-        request.setExpectContinue(true);
-        request.setContentLength(mes.getSerializeSize());
-        auto& os = session.sendRequest(request);
-        mes.serialize(os);
-        os.flush();
+        {
+            HTTPRequest request{ HTTPRequest::HTTP_POST, "texture_query" };
+            request.setContentType("application/octet-stream");
+            request.setExpectContinue(true);
+            request.setContentLength(mes.getSerializeSize());
+            auto& os = session.sendRequest(request);
+            mes.serialize(os);
+            os.flush();
+        }
 
-        HTTPResponse response;
-        auto& rs = session.receiveResponse(response);
-        std::ostringstream ostr;
-        StreamCopier::copyStream(rs, ostr);
-        return true;
+        {
+            HTTPResponse response;
+            auto& is = session.receiveResponse(response);
+            return response.getContentType() == "application/octet-stream" && ret.deserialize(is);
+        }
     }
     catch (...) {
         return false;
     }
 }
 
+bool Client::sendSet(const SetMessage& mes)
+{
+    if (!m_handshaked)
+        handshake();
+    if (m_settings.mesh_chunk_size > 0) {
+        for (auto& obj : mes.scene.objects) {
+            if (obj->getType() == Entity::Type::Mesh && static_cast<Mesh&>(*obj).getVertexDataSize() > m_settings.mesh_chunk_size)
+                return sendChunked(mes);
+        }
+    }
+    return sendMessage(FrameType::Set, "set", mes);
+}
+
+bool Client::sendChunked(const SetMessage& mes)
+{
+    using Attribute = MeshChunkMessage::Attribute;
+
+    if (!m_handshaked)
+        handshake();
+    if (!m_caps.features.mesh_chunk)
+        return sendMessage(FrameType::Set, "set", mes);
+
+    // send small objects as usual
+    SetMessage rest;
+    rest.scene = mes.scene;
+    rest.scene.objects.clear();
+    std::vector<const Mesh*> large_meshes;
+    for (auto& obj : mes.scene.objects) {
+        if (obj->getType() == Entity::Type::Mesh && static_cast<Mesh&>(*obj).getVertexDataSize() > m_settings.mesh_chunk_size)
+            large_meshes.push_back(static_cast<const Mesh*>(obj.get()));
+        else
+            rest.scene.objects.push_back(obj);
+    }
+    bool has_rest = !rest.scene.objects.empty() || !rest.scene.constraints.empty() || !rest.scene.animations.empty() ||
+        !rest.scene.textures.empty() || !rest.scene.materials.empty();
+    if (has_rest) {
+        if (!sendMessage(FrameType::Set, "set", rest))
+            return false;
+    }
+
+    // chunk size is limited by uint32_t serialize size of messages
+    uint64_t chunk_size = std::min<uint64_t>(m_settings.mesh_chunk_size, 0x40000000);
+
+    // chunks point to the source arrays directly. no copies are made on this side.
+    static std::atomic<uint64_t> s_transfer_count{ 0 };
+    for (auto *mesh : large_meshes) {
+        MeshChunkMessage chunk;
+        chunk.transfer_id = ((uint64_t)Now() << 8) + (s_transfer_count++ & 0xff);
+
+        chunk.attribute = Attribute::Header;
+        chunk.scene_settings = mes.scene.settings;
+        chunk.flags = mesh->flags;
+        chunk.flags.compact_indices = 0; // chunks are always 32 bit
+        chunk.source = mesh;
+        if (!sendMessage(FrameType::MeshChunk, "chunk", chunk))
+            return false;
+        chunk.source = nullptr;
+
+        for (int a = (int)Attribute::Points; a < (int)Attribute::End; ++a) {
+            chunk.attribute = (Attribute)a;
+            auto elem_size = MeshChunkMessage::getElementSize(chunk.attribute);
+            auto src = MeshChunkMessage::getAttribute(*mesh, chunk.attribute);
+            uint64_t count = src.size() / elem_size;
+            uint64_t step = std::max<uint64_t>(chunk_size / elem_size, 1);
+
+            chunk.total_count = count;
+            for (uint64_t offset = 0; offset < count; offset += step) {
+                uint64_t n = std::min(step, count - offset);
+                chunk.offset = offset;
+                chunk.data = IArray<char>(src.data() + offset * elem_size, (size_t)(n * elem_size));
+                if (!sendMessage(FrameType::MeshChunk, "chunk", chunk))
+                    return false;
+            }
+        }
+        chunk.data.reset();
+
+        chunk.attribute = Attribute::End;
+        if (!sendMessage(FrameType::MeshChunk, "chunk", chunk))
+            return false;
+    }
+    return true;
+}
+
+bool Client::send(const DeleteMessage& mes)
+{
+    return sendMessage(FrameType::Delete, "delete", mes);
+}
+
+bool Client::send(const AnimationChunkMessage& mes)
+{
+    if (!m_handshaked)
+        handshake();
+    if (!m_caps.features.animation_chunk)
+        return false;
+    return sendMessage(FrameType::AnimationChunk, "anim_chunk", mes);
+}
+
+bool Client::send(const FenceMessage& mes)
+{
+    uint32_t id;
+    if (sendSharedMemory(FrameType::Fence, mes))
+        return true;
+    if (sendFramed(FrameType::Fence, mes, id)) {
+        // wait for the server to catch up. this also consumes acks of pipelined requests.
+        FrameHeader response;
+        return waitFramed(id, response);
+    }
+    return sendHTTP("fence", mes);
+}
+
 MessagePtr Client::send(const QueryMessage & mes)
 {
+    uint32_t id;
+    if (sendFramed(FrameType::Query, mes, id)) {
+        MessagePtr ret;
+        FrameHeader response;
+        if (waitFramed(id, response) && response.size > 0) {
+            ret.reset(new ResponseMessage());
+            ret->deserialize(*m_framed_stream);
+        }
+        return ret;
+    }
+
     MessagePtr ret;
     try {
         HTTPClientSession session{ m_settings.server, m_settings.port };
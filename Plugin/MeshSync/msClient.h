@@ -1,6 +1,17 @@
 #pragma once
 
+#include <map>
+#include <mutex>
 #include "msProtocol.h"
+#include "msMaterial.h"
+#include "msSharedMemory.h"
+
+namespace Poco {
+    namespace Net {
+        class StreamSocket;
+        class SocketStream;
+    }
+}
 
 namespace ms {
 
@@ -9,21 +20,106 @@ struct ClientSettings
     std::string server = "127.0.0.1";
     uint16_t port = 8080;
     int timeout_ms = 30000;
+    bool use_shared_memory = true; // Set/Delete/Fence go through shared memory if the server is on the same host
+    bool use_framed_transport = true; // use a persistent binary framed connection instead of HTTP if the server supports it
+    uint64_t mesh_chunk_size = 64 * 1024 * 1024; // meshes larger than this are sent in chunks of this size. 0: disabled
+    bool compact_indices = true; // send indices of meshes that have 65536 or less vertices in 16 bit if the server supports it
+    bool use_texture_cache = true; // send textures the server already has as references by content hash
+    bool compress_textures = false; // block compress 8 bit textures before sending. see Texture::getCompressedFormat()
+    BCQuality texture_compression_quality = BCQuality::Normal;
+    bool generate_mipmaps = false; // send full mip chains so that the receiver can upload them as they are
+    MipFilter mipmap_filter = MipFilter::Box;
+};
+
+// client side record of the materials and textures sent last time. clients usually create Client for each send,
+// so this is kept by the caller and given by Client::setMaterialCache().
+class MaterialCache
+{
+public:
+    // drop textures whose content is unchanged, and replace unchanged materials with references.
+    // if the material list is the same as the last one and nothing is changed, materials are cleared.
+    // materials that use changed textures are regarded as changed so that the receiver binds the new textures.
+    // if use_references is false (the server can't resolve them), changed material lists are left as they are.
+    // if server_epoch differs from the last one (see Capabilities::server_epoch), the server has lost what was sent
+    // and everything is sent again.
+    void filter(std::vector<MaterialPtr>& materials, std::vector<TexturePtr>& textures, bool use_references, uint64_t server_epoch = 0);
+    // forget everything and start a new session. call this when the server may have lost its state. (e.g. sending everything again)
+    void clear();
+
+    // the server drops the materials of a session after ServerSettings::material_timeout_ms without receiving any.
+    // the cache starts over if it has sent nothing for this long. must be shorter than the server's timeout.
+    static const int SessionLifetimeMS = 5 * 60 * 1000;
+
+private:
+    void startSession();
+
+    std::mutex m_mutex;
+    uint64_t m_session = 0; // sent with materials when references are used. the server resolves references within a session
+    nanosec m_last_sent = 0;
+    uint64_t m_server_epoch = 0;
+    std::vector<MaterialPtr> m_materials; // copies of the last sent ones, in order
+    std::map<int, uint64_t> m_texture_hashes; // texture id -> content hash
 };
 
 class Client
 {
 public:
     Client(const ClientSettings& settings);
+    // the framed connection and the negotiated capabilities are handed over to the next Client for the same server
+    ~Client();
+    Client(const Client&) = delete;
+    Client& operator=(const Client&) = delete;
+    // send(const SetMessage&) skips materials and textures that are unchanged since the last send. null to disable.
+    void setMaterialCache(MaterialCache *cache);
+
+    // exchange capabilities with the server. if the server doesn't support handshake, legacy capabilities are assumed.
+    // returns false if the server is unreachable or incompatible.
+    // if a previous Client for the same server finished recently, its result and connection are reused instead.
+    bool handshake();
+    const Capabilities& getCapabilities() const;
 
     ScenePtr send(const GetMessage& mes);
     bool send(const SetMessage& mes);
     bool send(const DeleteMessage& mes);
     bool send(const FenceMessage& mes);
+    // returns false without sending if the server doesn't support animation chunks. see Capabilities::features.
+    bool send(const AnimationChunkMessage& mes);
     MessagePtr send(const QueryMessage& mes);
 
 private:
+    bool sendHTTP(const char *uri, const Message& mes);
+    // try shared memory, framed transport and HTTP in this order
+    bool sendMessage(FrameType type, const char *uri, const Message& mes);
+    bool sendSet(const SetMessage& mes);
+    bool sendChunked(const SetMessage& mes);
+    // generate mipmaps, compress textures and replace ones that are in the server's cache with references. returns false if nothing is replaced.
+    bool prepareTextures(std::vector<TexturePtr>& textures);
+    bool sendTextureQuery(const TextureQueryMessage& mes, TextureQueryMessage& ret);
+    bool sendSharedMemory(FrameType type, const Message& mes);
+    // take over / hand over the connection state kept per server. see ConnectionPool in msClient.cpp.
+    bool acquireConnection();
+    void releaseConnection();
+    bool connectFramed();
+    void disconnectFramed();
+    // Set and Delete don't wait for the response (pipelined). their acks are consumed by later waitFramed().
+    bool sendFramed(FrameType type, const Message& mes, uint32_t& request_id);
+    // wait for the response of request_id. the payload is left in the stream.
+    bool waitFramed(uint32_t request_id, FrameHeader& response);
+
     ClientSettings m_settings;
+    bool m_handshaked = false;
+    bool m_caps_pooled = false; // m_caps was handed over by a previous Client. it may predate a clear() of the server
+
+    std::shared_ptr<Poco::Net::StreamSocket> m_socket;
+    std::shared_ptr<Poco::Net::SocketStream> m_framed_stream;
+    bool m_framed_unavailable = false;
+    uint32_t m_last_request_id = 0;
+    uint32_t m_last_response_id = 0;
+
+    SharedMemoryChannelPtr m_shm;
+    bool m_shm_unavailable = false;
+    Capabilities m_caps = Capabilities::legacy();
+    MaterialCache *m_material_cache = nullptr;
 };
 
 } // namespace ms
@@ -4,7 +4,8 @@
 #define msReleaseDateStr "20180918"
 #define msVendor "Unity Technologies"
 #define msProtocolVersion 110
-//#define msEnableProfiling
+#define msProtocolVersionMin 110 // oldest protocol version that can still be deserialized
+#define msEnableProfiling // per-stage timing of Mesh::refine(). see msProfiling.h
 
 
 namespace ms {
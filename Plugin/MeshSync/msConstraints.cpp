@@ -38,8 +38,8 @@ uint32_t Constraint::getSerializeSize() const
 {
     uint32_t ret = 0;
     ret += sizeof(int);
-    ret += ssize(path);
-    ret += ssize(source_paths);
+    ret += ssize_path(path);
+    ret += ssize_path(source_paths);
     return ret;
 }
 
@@ -47,15 +47,15 @@ void Constraint::serialize(std::ostream& os) const
 {
     int type = (int)getType();
     write(os, type);
-    write(os, path);
-    write(os, source_paths);
+    write_path(os, path);
+    write_path(os, source_paths);
 }
 
 void Constraint::deserialize(std::istream& is)
 {
     // type is consumed by make()
-    read(is, path);
-    read(is, source_paths);
+    read_path(is, path);
+    read_path(is, source_paths);
 }
 
 void Constraint::clear()
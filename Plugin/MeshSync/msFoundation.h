@@ -3,15 +3,58 @@
 #include <memory>
 #include <vector>
 #include <mutex>
+#include <atomic>
+#include <algorithm>
 
 namespace ms {
 
 template<class T> struct has_serializer { static const bool result = false; };
 
+struct PoolStats
+{
+    uint64_t capacity = 0;  // number of living objects. in use + retained
+    uint64_t in_use = 0;
+    uint64_t hits = 0;      // pulls served by retained objects
+    uint64_t misses = 0;    // pulls that allocated new objects
+};
+
+class PoolBase
+{
+public:
+    virtual ~PoolBase() {}
+    virtual const char* getName() const = 0;
+    virtual PoolStats getStats() const = 0;
+    virtual void trim() = 0;
+};
+
+// all pools of this module. pools register themselves on construction.
+inline std::vector<PoolBase*>& GetPools()
+{
+    static std::vector<PoolBase*> s_pools;
+    return s_pools;
+}
+inline std::mutex& GetPoolsMutex()
+{
+    static std::mutex s_mutex;
+    return s_mutex;
+}
+inline void TrimPools()
+{
+    std::unique_lock<std::mutex> lock(GetPoolsMutex());
+    for (auto *pool : GetPools())
+        pool->trim();
+}
+
+// objects are recycled through a small per-thread cache and a lock-free global depot.
+// the depot has a fixed number of slots. objects pushed when it is full are deleted, so that
+// clearing a huge scene doesn't keep all of its objects forever.
 template<class T>
-class Pool
+class Pool : public PoolBase
 {
 public:
+    static const size_t ThreadCacheSize = 32;
+    static const uint32_t DepotSize = 1024;
+
     static Pool& instance()
     {
         static Pool s_instance;
@@ -20,44 +63,254 @@ public:
 
     T* pull()
     {
-        std::unique_lock<std::mutex> lock(m_mutex);
-        if (!m_pool.empty()) {
-            T* ret = m_pool.back();
-            m_pool.pop_back();
-            ++m_used;
-            return ret;
+        auto& cache = getThreadCache();
+        if (cache.count == 0) {
+            // refill half of the cache to avoid going to the depot on every pull
+            T *v;
+            while (cache.count < ThreadCacheSize / 2 && m_depot.pop(v))
+                cache.items[cache.count++] = v;
+        }
+
+        auto& c = cache.counters;
+        add(c.used, 1);
+        if (cache.count > 0) {
+            add(c.hits, 1);
+            return cache.items[--cache.count];
         }
         else {
-            ++m_capacity;
-            ++m_used;
+            add(c.misses, 1);
+            add(c.capacity, 1);
             return new T();
         }
     }
 
     void push(T *v)
     {
-        std::unique_lock<std::mutex> lock(m_mutex);
-        m_pool.push_back(v);
-        --m_used;
+        auto& cache = getThreadCache();
+        add(cache.counters.used, -1);
+        if (cache.count == ThreadCacheSize)
+            flush(cache, ThreadCacheSize / 2);
+        cache.items[cache.count++] = v;
     }
 
-    void release()
+    // delete objects in the depot and the cache of the calling thread.
+    // caches of other threads are bounded by ThreadCacheSize and are returned when the threads exit.
+    void trim() override
     {
-        std::unique_lock<std::mutex> lock(m_mutex);
-        for (T *v : m_pool)
+        auto& cache = getThreadCache();
+        flush(cache, cache.count);
+        T *v;
+        while (m_depot.pop(v)) {
             delete v;
-        m_pool.clear();
-        m_capacity = m_used = 0;
+            add(cache.counters.capacity, -1);
+        }
+    }
+
+    void release()
+    {
+        trim();
+    }
+
+    const char* getName() const override
+    {
+        return T::getPoolName();
+    }
+
+    // sum of the counters of living threads and the ones that have exited
+    PoolStats getStats() const override
+    {
+        std::unique_lock<std::mutex> lock(m_caches_mutex);
+        int64_t capacity = m_retired.capacity, used = m_retired.used;
+        uint64_t hits = m_retired.hits, misses = m_retired.misses;
+        for (auto *cache : m_caches) {
+            auto& c = cache->counters;
+            capacity += c.capacity.load(std::memory_order_relaxed);
+            used += c.used.load(std::memory_order_relaxed);
+            hits += c.hits.load(std::memory_order_relaxed);
+            misses += c.misses.load(std::memory_order_relaxed);
+        }
+
+        PoolStats ret;
+        // objects may be pulled on one thread and pushed on another, so a thread's own counts can be negative
+        ret.capacity = (uint64_t)std::max<int64_t>(capacity, 0);
+        ret.in_use = (uint64_t)std::max<int64_t>(used, 0);
+        ret.hits = hits;
+        ret.misses = misses;
+        return ret;
     }
 
 private:
-    Pool() {}
-    ~Pool() { release(); }
+    // fixed number of slots managed by two lock-free stacks: filled ones and free ones.
+    // stack heads are tagged with a counter to avoid the ABA problem.
+    class Depot
+    {
+    public:
+        Depot()
+        {
+            for (uint32_t i = 0; i < DepotSize; ++i)
+                m_slots[i].next.store(i + 1 < DepotSize ? i + 1 : Nil, std::memory_order_relaxed);
+        }
+
+        // returns false if full
+        bool push(T *v)
+        {
+            uint32_t i = popSlot(m_free);
+            if (i == Nil)
+                return false;
+            m_slots[i].data = v;
+            pushSlot(m_filled, i);
+            return true;
+        }
+
+        // returns false if empty
+        bool pop(T *& v)
+        {
+            uint32_t i = popSlot(m_filled);
+            if (i == Nil)
+                return false;
+            v = m_slots[i].data;
+            pushSlot(m_free, i);
+            return true;
+        }
+
+    private:
+        static const uint32_t Nil = 0xffffffff;
+        static uint64_t pack(uint32_t index, uint32_t tag) { return ((uint64_t)tag << 32) | index; }
+
+        uint32_t popSlot(std::atomic<uint64_t>& head)
+        {
+            uint64_t h = head.load(std::memory_order_acquire);
+            for (;;) {
+                uint32_t i = (uint32_t)h;
+                if (i == Nil)
+                    return Nil;
+                uint32_t next = m_slots[i].next.load(std::memory_order_relaxed);
+                if (head.compare_exchange_weak(h, pack(next, (uint32_t)(h >> 32) + 1), std::memory_order_acq_rel, std::memory_order_acquire))
+                    return i;
+            }
+        }
+
+        void pushSlot(std::atomic<uint64_t>& head, uint32_t i)
+        {
+            uint64_t h = head.load(std::memory_order_relaxed);
+            for (;;) {
+                m_slots[i].next.store((uint32_t)h, std::memory_order_relaxed);
+                if (head.compare_exchange_weak(h, pack(i, (uint32_t)(h >> 32) + 1), std::memory_order_release, std::memory_order_relaxed))
+                    return;
+            }
+        }
+
+        struct Slot
+        {
+            std::atomic<uint32_t> next;
+            T *data = nullptr;
+        };
+        Slot m_slots[DepotSize];
+        std::atomic<uint64_t> m_filled{ pack(Nil, 0) };
+        std::atomic<uint64_t> m_free{ pack(0, 0) };
+    };
+
+    // statistics are counted per thread so that pull() and push() don't contend on shared counters.
+    // only the owning thread writes them. they are atomic so that getStats() can read them from other threads.
+    struct Counters
+    {
+        std::atomic<int64_t> capacity{ 0 };
+        std::atomic<int64_t> used{ 0 };
+        std::atomic<uint64_t> hits{ 0 };
+        std::atomic<uint64_t> misses{ 0 };
+    };
+    struct RetiredCounters
+    {
+        int64_t capacity = 0;
+        int64_t used = 0;
+        uint64_t hits = 0;
+        uint64_t misses = 0;
+    };
+
+    // a plain load and store. no read-modify-write, as there is a single writer.
+    template<class V, class D>
+    static void add(std::atomic<V>& counter, D n)
+    {
+        counter.store(counter.load(std::memory_order_relaxed) + (V)n, std::memory_order_relaxed);
+    }
+
+    struct ThreadCache
+    {
+        T *items[ThreadCacheSize];
+        size_t count = 0;
+        Counters counters;
+
+        ThreadCache()
+        {
+            Pool::instance().addCache(this);
+        }
+
+        ~ThreadCache()
+        {
+            auto& pool = Pool::instance();
+            pool.flush(*this, count);
+            pool.removeCache(this);
+        }
+    };
+
+    static ThreadCache& getThreadCache()
+    {
+        static thread_local ThreadCache s_cache;
+        return s_cache;
+    }
+
+    // move n objects from the top of the cache to the depot. ones that don't fit are deleted.
+    void flush(ThreadCache& cache, size_t n)
+    {
+        for (size_t i = 0; i < n; ++i) {
+            T *v = cache.items[--cache.count];
+            if (!m_depot.push(v)) {
+                delete v;
+                add(cache.counters.capacity, -1);
+            }
+        }
+    }
+
+    void addCache(ThreadCache *cache)
+    {
+        std::unique_lock<std::mutex> lock(m_caches_mutex);
+        m_caches.push_back(cache);
+    }
+
+    // the counters of exiting threads are kept in m_retired
+    void removeCache(ThreadCache *cache)
+    {
+        std::unique_lock<std::mutex> lock(m_caches_mutex);
+        auto& c = cache->counters;
+        m_retired.capacity += c.capacity.load(std::memory_order_relaxed);
+        m_retired.used += c.used.load(std::memory_order_relaxed);
+        m_retired.hits += c.hits.load(std::memory_order_relaxed);
+        m_retired.misses += c.misses.load(std::memory_order_relaxed);
+        m_caches.erase(std::remove(m_caches.begin(), m_caches.end(), cache), m_caches.end());
+    }
+
+    Pool()
+    {
+        std::unique_lock<std::mutex> lock(GetPoolsMutex());
+        GetPools().push_back(this);
+    }
+
+    ~Pool()
+    {
+        {
+            std::unique_lock<std::mutex> lock(GetPoolsMutex());
+            auto& pools = GetPools();
+            pools.erase(std::remove(pools.begin(), pools.end(), this), pools.end());
+        }
+        T *v;
+        while (m_depot.pop(v))
+            delete v;
+    }
 
-    std::vector<T*> m_pool;
-    std::mutex m_mutex;
-    int m_capacity = 0;
-    int m_used = 0;
+    Depot m_depot;
+    mutable std::mutex m_caches_mutex;
+    std::vector<ThreadCache*> m_caches; // of living threads. guarded by m_caches_mutex
+    RetiredCounters m_retired;          // guarded by m_caches_mutex
 };
 
 template<class T>
@@ -85,6 +338,7 @@ std::shared_ptr<T> make_shared_ptr(T *p)
 
 #define msDefinePool(T)\
     friend class Pool<T>;\
+    static const char* getPoolName() { return #T; }\
     static T* create_raw()\
     {\
         return Pool<T>::instance().pull();\
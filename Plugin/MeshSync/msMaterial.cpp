@@ -1,5 +1,6 @@
 #include "pch.h"
 #include "msMaterial.h"
+#include "msProtocol.h"
 #include "msSceneGraphImpl.h"
 
 
@@ -27,6 +28,37 @@ int GetPixelSize(TextureFormat format)
     return 0;
 }
 
+static bool ToBCFormat(TextureFormat format, BCFormat& dst)
+{
+    switch (format) {
+    case TextureFormat::BC1: dst = BCFormat::BC1; return true;
+    case TextureFormat::BC3: dst = BCFormat::BC3; return true;
+    case TextureFormat::BC5: dst = BCFormat::BC5; return true;
+    case TextureFormat::BC7: dst = BCFormat::BC7; return true;
+    default: return false;
+    }
+}
+
+bool IsBlockCompressed(TextureFormat format)
+{
+    BCFormat tmp;
+    return ToBCFormat(format, tmp);
+}
+
+size_t GetTextureDataSize(TextureFormat format, int width, int height, bool mipmaps)
+{
+    BCFormat bc;
+    bool block_compressed = ToBCFormat(format, bc);
+    int num_levels = mipmaps ? GetMipCount(width, height) : 1;
+    size_t ret = 0;
+    for (int level = 0; level < num_levels; ++level) {
+        int w, h;
+        GetMipSize(width, height, level, w, h);
+        ret += block_compressed ? GetBCDataSize(bc, w, h) : size_t(w) * size_t(h) * GetPixelSize(format);
+    }
+    return ret;
+}
+
 bool FileToByteArray(const char *path, RawVector<char> &dst)
 {
     FILE *f = fopen(path, "rb");
@@ -63,24 +95,69 @@ std::shared_ptr<Texture> Texture::create(std::istream & is)
 Texture::Texture() {}
 Texture::~Texture() {}
 
+// protocol 110 layout: id name type format width height data.
+// has_mipmaps and hash were added later. they are written only if the receiver supports them (see WireFormatScope)
+// and are marked by bits in type. without mipmap support, only the top level of the chain is written.
+static const int TextureHashBit = 0x10000;
+static const int TextureMipmapsBit = 0x20000;
+
+static int GetTextureTypeBits(const Texture& tex)
+{
+    auto features = WireFormatScope::current();
+    int ret = (int)tex.type;
+    if (features.texture_cache)
+        ret |= TextureHashBit;
+    if (features.texture_mipmaps && tex.has_mipmaps)
+        ret |= TextureMipmapsBit;
+    return ret;
+}
+
+static size_t GetTextureWriteSize(const Texture& tex, int type_bits)
+{
+    if (tex.has_mipmaps && !(type_bits & TextureMipmapsBit) && tex.getDataSize() != 0)
+        return std::min(tex.getDataSize(), GetTextureDataSize(tex.format, tex.width, tex.height));
+    return tex.getDataSize();
+}
+
+// data is handled separately. it may be written from mapped_file.
 #define EachMember(F)\
-    F(id) F(name) F(type) F(format) F(width) F(height) F(data)
+    F(id) F(name) F(type_bits) F(format) F(width) F(height)
 
 uint32_t Texture::getSerializeSize() const
 {
+    int type_bits = GetTextureTypeBits(*this);
     uint32_t ret = 0;
     EachMember(msSize);
+    if (type_bits & TextureHashBit)
+        ret += ssize(hash);
+    ret += uint32_t(4 + GetTextureWriteSize(*this, type_bits));
     return ret;
 }
 
 void Texture::serialize(std::ostream & os) const
 {
+    int type_bits = GetTextureTypeBits(*this);
     EachMember(msWrite);
+    if (type_bits & TextureHashBit)
+        write(os, hash);
+
+    // same layout as RawVector<char>
+    auto size = (uint32_t)GetTextureWriteSize(*this, type_bits);
+    os.write((const char*)&size, 4);
+    os.write(getDataPtr(), size);
 }
 
 void Texture::deserialize(std::istream & is)
 {
+    int type_bits = 0;
     EachMember(msRead);
+    type = (TextureType)(type_bits & 0xffff);
+    has_mipmaps = (type_bits & TextureMipmapsBit) != 0;
+    hash = 0;
+    if (type_bits & TextureHashBit)
+        read(is, hash);
+    read(is, data);
+    mapped_file.reset();
 }
 
 void Texture::clear()
@@ -91,12 +168,16 @@ void Texture::clear()
     type = TextureType::Default;
     format = TextureFormat::Unknown;
     width = height = 0;
+    has_mipmaps = false;
+    hash = 0;
     data.clear();
+    mapped_file.reset();
 }
 
 void Texture::setData(const void * src)
 {
-    size_t data_size = width * height * GetPixelSize(format);
+    size_t data_size = GetTextureDataSize(format, width, height, has_mipmaps);
+    mapped_file.reset();
     data.assign((const char*)src, (const char*)src + data_size);
 }
 
@@ -104,14 +185,197 @@ void Texture::getData(void * dst) const
 {
     if (!dst)
         return;
-    data.copy_to((char*)dst);
+    memcpy(dst, getDataPtr(), getDataSize());
+}
+
+const char* Texture::getDataPtr() const
+{
+    return mapped_file ? mapped_file->data() : data.cdata();
+}
+
+size_t Texture::getDataSize() const
+{
+    return mapped_file ? mapped_file->size() : data.size();
+}
+
+bool Texture::readFile(const char * path)
+{
+    auto size = GetFileSizeInByte(path);
+    if (size <= 0)
+        return false;
+
+    if ((size_t)size >= MappedFileThreshold) {
+        auto file = std::make_shared<MappedFile>();
+        if (file->open(path)) {
+            data.clear();
+            mapped_file = file;
+            return true;
+        }
+    }
+    mapped_file.reset();
+    return FileToByteArray(path, data);
 }
 
 bool Texture::writeToFile(const char * path)
 {
-    if (data.empty())
+    size_t size = getDataSize();
+    if (size == 0)
         return false;
-    return ByteArrayToFile(path, data);
+    FILE *f = fopen(path, "wb");
+    if (!f)
+        return false;
+    fwrite(getDataPtr(), 1, size, f);
+    fclose(f);
+    return true;
+}
+
+int Texture::getMipCount() const
+{
+    return has_mipmaps ? GetMipCount(width, height) : 1;
+}
+
+bool Texture::generateMipmaps(MipFilter filter)
+{
+    if (has_mipmaps)
+        return true;
+    int num_channels = (int)format & (int)TextureFormat::ChannelMask;
+    if (getDataSize() == 0 || GetPixelSize(format) == 0 || (int)format & ~((int)TextureFormat::TypeMask | (int)TextureFormat::ChannelMask))
+        return false;
+
+    // the top level may come from mapped_file. the chain always ends up in data.
+    size_t top_size = GetTextureDataSize(format, width, height);
+    if (getDataSize() < top_size)
+        return false;
+    RawVector<char> chain;
+    chain.resize_discard(GetTextureDataSize(format, width, height, true));
+    memcpy(chain.data(), getDataPtr(), top_size);
+
+    // each level is downsampled from the previous one. levels are processed in parallel internally.
+    char *src = chain.data();
+    int num_levels = GetMipCount(width, height);
+    for (int level = 1; level < num_levels; ++level) {
+        int w, h;
+        GetMipSize(width, height, level - 1, w, h);
+        char *dst = src + GetTextureDataSize(format, w, h);
+        switch ((int)format & (int)TextureFormat::TypeMask) {
+        case (int)TextureFormat::Type_u8: Downsample((uint8_t*)dst, (const uint8_t*)src, w, h, num_channels, filter); break;
+        case (int)TextureFormat::Type_i16: Downsample((int16_t*)dst, (const int16_t*)src, w, h, num_channels, filter); break;
+        case (int)TextureFormat::Type_i32: Downsample((int32_t*)dst, (const int32_t*)src, w, h, num_channels, filter); break;
+        case (int)TextureFormat::Type_f16: Downsample((half*)dst, (const half*)src, w, h, num_channels, filter); break;
+        case (int)TextureFormat::Type_f32: Downsample((float*)dst, (const float*)src, w, h, num_channels, filter); break;
+        }
+        src = dst;
+    }
+    data.swap(chain);
+    mapped_file.reset();
+    has_mipmaps = true;
+    hash = 0;
+    return true;
+}
+
+TextureFormat Texture::getCompressedFormat(BCQuality quality) const
+{
+    if ((int)format & ~((int)TextureFormat::TypeMask | (int)TextureFormat::ChannelMask) ||
+        ((int)format & (int)TextureFormat::TypeMask) != (int)TextureFormat::Type_u8 ||
+        width % 4 != 0 || height % 4 != 0 || getDataSize() == 0 ||
+        getDataSize() < GetTextureDataSize(format, width, height, has_mipmaps))
+        return TextureFormat::Unknown;
+
+    if (type == TextureType::NormalMap)
+        return TextureFormat::BC5;
+    if (quality == BCQuality::High)
+        return TextureFormat::BC7;
+
+    if (format == TextureFormat::RGBAu8) {
+        auto *pixels = (const unorm8x4*)getDataPtr();
+        size_t num_pixels = size_t(width) * height;
+        for (size_t i = 0; i < num_pixels; ++i) {
+            if (pixels[i].w.value != 255)
+                return TextureFormat::BC3;
+        }
+    }
+    return TextureFormat::BC1;
+}
+
+bool Texture::compress(Texture& dst, TextureFormat dst_format, BCQuality quality) const
+{
+    BCFormat bc;
+    if (!ToBCFormat(dst_format, bc) || getCompressedFormat(quality) == TextureFormat::Unknown)
+        return false;
+
+    dst.id = id;
+    dst.name = name;
+    dst.type = type;
+    dst.format = dst_format;
+    dst.width = width;
+    dst.height = height;
+    dst.has_mipmaps = has_mipmaps;
+    dst.hash = 0;
+    dst.mapped_file.reset();
+    dst.data.resize_discard(GetTextureDataSize(dst_format, width, height, has_mipmaps));
+
+    int num_channels = (int)format & (int)TextureFormat::ChannelMask;
+    RawVector<unorm8x4> rgba;
+    const char *src_level = getDataPtr();
+    char *dst_level = dst.data.data();
+    int num_levels = getMipCount();
+    for (int level = 0; level < num_levels; ++level) {
+        int w, h;
+        GetMipSize(width, height, level, w, h);
+        size_t num_pixels = size_t(w) * h;
+
+        // expand to RGBA8. missing channels are 0 except alpha (255).
+        const unorm8x4 *src = (const unorm8x4*)src_level;
+        if (num_channels != 4) {
+            rgba.resize_discard(num_pixels);
+            auto *s = (const uint8_t*)src_level;
+            auto *d = (uint8_t*)rgba.data();
+            for (size_t i = 0; i < num_pixels; ++i, s += num_channels, d += 4) {
+                d[0] = s[0];
+                d[1] = num_channels > 1 ? s[1] : 0;
+                d[2] = num_channels > 2 ? s[2] : 0;
+                d[3] = 255;
+            }
+            src = rgba.cdata();
+        }
+        CompressBC(bc, dst_level, src, w, h, quality);
+        src_level += num_pixels * num_channels;
+        dst_level += GetBCDataSize(bc, w, h);
+    }
+    return true;
+}
+
+uint64_t Texture::updateHash()
+{
+    size_t size = getDataSize();
+    if (size == 0) {
+        hash = 0;
+    }
+    else {
+        hash = Hash64(getDataPtr(), size);
+        if (hash == 0)
+            hash = 1; // 0 is reserved for 'not computed'
+    }
+    return hash;
+}
+
+bool Texture::isReference() const
+{
+    return getDataSize() == 0 && hash != 0;
+}
+
+std::shared_ptr<Texture> Texture::makeReference() const
+{
+    auto ret = create();
+    ret->id = id;
+    ret->name = name;
+    ret->type = type;
+    ret->format = format;
+    ret->width = width;
+    ret->height = height;
+    ret->has_mipmaps = has_mipmaps;
+    ret->hash = hash;
+    return ret;
 }
 
 #undef EachMember
@@ -138,15 +402,22 @@ uint32_t Material::getSerializeSize() const
 {
     uint32_t ret = 0;
     EachMember(msSize);
+    if (flags.has_session)
+        ret += ssize(session);
     return ret;
 }
 void Material::serialize(std::ostream& os) const
 {
     EachMember(msWrite);
+    if (flags.has_session)
+        write(os, session);
 }
 void Material::deserialize(std::istream& is)
 {
     EachMember(msRead);
+    session = 0;
+    if (flags.has_session)
+        read(is, session);
 }
 
 void Material::clear()
@@ -155,6 +426,7 @@ void Material::clear()
     name.clear();
     flags = { 0 };
     flags.has_color = 1;
+    session = 0;
 
     color = float4::one();
     emission = float4::zero();
@@ -185,6 +457,30 @@ bool Material::operator!=(const Material& v) const
     return !(*this == v);
 }
 
+bool Material::isReference() const
+{
+    return flags.is_reference != 0;
+}
+
+std::shared_ptr<Material> Material::makeReference() const
+{
+    auto ret = create();
+    ret->id = id;
+    ret->name = name;
+    ret->flags = { 0 };
+    ret->flags.is_reference = 1;
+    return ret;
+}
+
+bool Material::usesTexture(int tex_id) const
+{
+    return
+        (flags.has_color_map && color_map == tex_id) ||
+        (flags.has_emission_map && emission_map == tex_id) ||
+        (flags.has_metallic_map && metallic_map == tex_id) ||
+        (flags.has_normal_map && normal_map == tex_id);
+}
+
 void    Material::setColor(float4 v)    { color = v; flags.has_color = 1; }
 float4  Material::getColor() const      { return color; }
 void    Material::setEmission(float4 v) { emission = v; flags.has_emission = 1; }
@@ -40,6 +40,12 @@ enum class TextureFormat
     RGBAi32   = Type_i32 | 4,
 
     RawFile = 0x10 << 4,
+
+    // block compressed. see Texture::compress()
+    BC1 = 0x11 << 4,
+    BC3 = 0x12 << 4,
+    BC5 = 0x13 << 4,
+    BC7 = 0x14 << 4,
 };
 
 enum class TextureType
@@ -50,7 +56,11 @@ enum class TextureType
 
 // in byte
 int GetPixelSize(TextureFormat format);
+size_t GetTextureDataSize(TextureFormat format, int width, int height, bool mipmaps = false);
+bool IsBlockCompressed(TextureFormat format);
 bool FileToByteArray(const char *path, RawVector<char> &out);
+// files larger than this are memory mapped by Texture::readFile() instead of being read into the heap
+const size_t MappedFileThreshold = 4 * 1024 * 1024;
 bool ByteArrayToFile(const char *path, const RawVector<char> &data);
 
 class Texture
@@ -62,7 +72,10 @@ public:
     TextureFormat format = TextureFormat::Unknown;
     int width = 0;
     int height = 0;
-    RawVector<char> data;
+    bool has_mipmaps = false; // data contains the full mip chain, from the largest level
+    uint64_t hash = 0; // content hash of data. 0: not computed
+    RawVector<char> data; // empty if this is a reference to a texture cached on the server
+    std::shared_ptr<MappedFile> mapped_file; // if set, its contents are serialized in place of data. see readFile()
 
 protected:
     Texture();
@@ -77,7 +90,27 @@ public:
 
     void setData(const void *src);
     void getData(void *dst) const;
+    // data or the contents of mapped_file
+    const char* getDataPtr() const;
+    size_t getDataSize() const;
+    // large files are memory mapped and small ones are read into data. the file should not be modified until this is serialized.
+    bool readFile(const char *path);
     bool writeToFile(const char *path);
+
+    int getMipCount() const;
+    // append the rest of the mip chain to data. only uncompressed formats are supported.
+    bool generateMipmaps(MipFilter filter = MipFilter::Box);
+
+    // block compression format for this texture: BC5 for normal maps, BC7 if quality is High,
+    // BC3 if it has alpha and BC1 otherwise. Unknown if the format is not supported (only 8 bit formats are).
+    TextureFormat getCompressedFormat(BCQuality quality) const;
+    // dst receives the compressed copy of this texture
+    bool compress(Texture& dst, TextureFormat dst_format, BCQuality quality) const;
+
+    uint64_t updateHash();
+    bool isReference() const;
+    // same texture without data. the receiver restores data from its cache by hash.
+    std::shared_ptr<Texture> makeReference() const;
 };
 msHasSerializer(Texture);
 using TexturePtr = std::shared_ptr<Texture>;
@@ -93,6 +126,8 @@ struct MaterialDataFlags
     uint32_t has_smoothness : 1;
     uint32_t has_metallic_map : 1;
     uint32_t has_normal_map : 1;
+    uint32_t is_reference : 1; // only id is valid. the receiver uses the one sent before. see MaterialCache
+    uint32_t has_session : 1; // session follows the other members
 };
 
 class Material
@@ -101,6 +136,7 @@ public:
     int id = 0;
     std::string name;
     MaterialDataFlags flags = { 0 };
+    uint64_t session = 0; // MaterialCache that sent this. ids are unique only within a session. 0: none
 
 protected:
     float4 color = float4::one();
@@ -126,6 +162,10 @@ public:
     void clear();
     bool operator==(const Material& v) const;
     bool operator!=(const Material& v) const;
+    bool isReference() const;
+    std::shared_ptr<Material> makeReference() const;
+    // true if any of the texture maps is tex_id
+    bool usesTexture(int tex_id) const;
 
     void    setColor(float4 v);
     float4  getColor() const;
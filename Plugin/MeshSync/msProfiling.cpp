@@ -0,0 +1,242 @@
+#include "pch.h"
+#include "msProfiling.h"
+
+namespace ms {
+
+const char* Profiler::getStageName(ProfileStage v)
+{
+    switch (v) {
+    case ProfileStage::Receive: return "Receive";
+    case ProfileStage::Deserialize: return "Deserialize";
+    case ProfileStage::Refine: return "Refine";
+    case ProfileStage::RefineTransform: return "Refine/Transform";
+    case ProfileStage::RefineNormals: return "Refine/Normals";
+    case ProfileStage::RefineSplit: return "Refine/Split";
+    case ProfileStage::RefineRetopology: return "Refine/Retopology";
+    case ProfileStage::RefineSubmeshes: return "Refine/Submeshes";
+    case ProfileStage::RefineRemap: return "Refine/Remap";
+    case ProfileStage::RefineTangents: return "Refine/Tangents";
+    case ProfileStage::RefineSkinning: return "Refine/Skinning";
+    case ProfileStage::Convert: return "Convert";
+    case ProfileStage::QueueWait: return "QueueWait";
+    case ProfileStage::Handler: return "Handler";
+    default: return "";
+    }
+}
+
+int Profiler::getBucket(nanosec elapsed)
+{
+    uint64_t us = elapsed / 1000;
+    int ret = 0;
+    while (us > 0 && ret < NumBuckets - 1) {
+        us >>= 1;
+        ++ret;
+    }
+    return ret;
+}
+
+Profiler::LocalEntry::LocalEntry()
+{
+    for (auto& h : histogram)
+        h = 0;
+}
+
+void Profiler::record(ProfileStage stage, nanosec elapsed, uint64_t bytes)
+{
+    auto inc = [](std::atomic<uint64_t>& v, uint64_t a) {
+        v.store(v.load(std::memory_order_relaxed) + a, std::memory_order_relaxed);
+    };
+
+    auto& e = m_locals.local().entries[(int)stage];
+    inc(e.count, 1);
+    inc(e.total_ns, elapsed);
+    inc(e.bytes, bytes);
+    inc(e.histogram[getBucket(elapsed)], 1);
+    if (elapsed > e.max_ns.load(std::memory_order_relaxed))
+        e.max_ns.store(elapsed, std::memory_order_relaxed);
+}
+
+Profiler::Stats Profiler::gather()
+{
+    Stats ret;
+    m_locals.each([&ret](Local& local) {
+        for (int si = 0; si < (int)ProfileStage::Count; ++si) {
+            auto& src = local.entries[si];
+            auto& dst = ret.entries[si];
+            dst.count += src.count.load(std::memory_order_relaxed);
+            dst.total_ns += src.total_ns.load(std::memory_order_relaxed);
+            dst.bytes += src.bytes.load(std::memory_order_relaxed);
+            dst.max_ns = std::max(dst.max_ns, src.max_ns.load(std::memory_order_relaxed));
+            for (int bi = 0; bi < NumBuckets; ++bi)
+                dst.histogram[bi] += src.histogram[bi].load(std::memory_order_relaxed);
+        }
+    });
+    return ret;
+}
+
+Profiler::Stats Profiler::getStats()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    auto ret = gather();
+    for (int si = 0; si < (int)ProfileStage::Count; ++si) {
+        auto& dst = ret.entries[si];
+        auto& base = m_base.entries[si];
+        dst.count -= base.count;
+        dst.total_ns -= base.total_ns;
+        dst.bytes -= base.bytes;
+        // max can't be subtracted. it is the max since the beginning if nothing has been recorded after reset.
+        if (dst.count == 0)
+            dst.max_ns = 0;
+        for (int bi = 0; bi < NumBuckets; ++bi)
+            dst.histogram[bi] -= base.histogram[bi];
+    }
+    return ret;
+}
+
+void Profiler::reset()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_base = gather();
+}
+
+std::string Profiler::toString()
+{
+    auto stats = getStats();
+
+    std::string ret;
+    char buf[256];
+    sprintf(buf, "%-20s %10s %12s %10s %10s %14s  histogram (count per 2^n us)\n",
+        "stage", "count", "total ms", "avg ms", "max ms", "bytes");
+    ret += buf;
+    for (int si = 0; si < (int)ProfileStage::Count; ++si) {
+        auto& e = stats.entries[si];
+        sprintf(buf, "%-20s %10llu %12.3f %10.3f %10.3f %14llu ",
+            getStageName((ProfileStage)si),
+            (unsigned long long)e.count,
+            NS2MS(e.total_ns),
+            e.count ? NS2MS(e.total_ns / e.count) : 0.0f,
+            NS2MS(e.max_ns),
+            (unsigned long long)e.bytes);
+        ret += buf;
+        for (int bi = 0; bi < NumBuckets; ++bi) {
+            sprintf(buf, " %llu", (unsigned long long)e.histogram[bi]);
+            ret += buf;
+        }
+        ret += "\n";
+    }
+    return ret;
+}
+
+static tls<Profiler*> g_current_profiler;
+
+Profiler* Profiler::current()
+{
+    return g_current_profiler.local();
+}
+
+Profiler::Scope::Scope(Profiler *v)
+{
+    auto& cur = g_current_profiler.local();
+    m_prev = cur;
+    cur = v;
+}
+
+Profiler::Scope::~Scope()
+{
+    g_current_profiler.local() = m_prev;
+}
+
+
+ProfileTimer::ProfileTimer(ProfileStage stage, uint64_t bytes)
+    : m_profiler(Profiler::current())
+    , m_stage(stage)
+    , m_bytes(bytes)
+    , m_begin(m_profiler ? Now() : 0)
+{
+}
+
+ProfileTimer::~ProfileTimer()
+{
+    if (m_profiler)
+        m_profiler->record(m_stage, Now() - m_begin, m_bytes);
+}
+
+void ProfileTimer::next(ProfileStage stage)
+{
+    if (m_profiler) {
+        auto now = Now();
+        m_profiler->record(m_stage, now - m_begin, m_bytes);
+        m_begin = now;
+    }
+    m_stage = stage;
+    m_bytes = 0;
+}
+
+
+ProfiledIStreamBuf::ProfiledIStreamBuf(std::istream& src, uint64_t size)
+    : m_src(src)
+    , m_remaining(size)
+{
+    setg(m_buf, m_buf, m_buf);
+}
+
+nanosec ProfiledIStreamBuf::getReceiveTime() const
+{
+    return m_receive_time;
+}
+
+uint64_t ProfiledIStreamBuf::getReceivedBytes() const
+{
+    return m_received_bytes;
+}
+
+ProfiledIStreamBuf::int_type ProfiledIStreamBuf::underflow()
+{
+    if (gptr() < egptr())
+        return traits_type::to_int_type(*gptr());
+
+    if (m_remaining == 0)
+        return traits_type::eof();
+
+    auto begin = Now();
+    auto n = m_src.readsome(m_buf, (std::streamsize)std::min<uint64_t>(sizeof(m_buf), m_remaining));
+    if (n == 0) {
+        // readsome() returns 0 if nothing is buffered yet. block for one byte.
+        m_src.read(m_buf, 1);
+        n = m_src.gcount();
+    }
+    m_receive_time += Now() - begin;
+    m_received_bytes += (uint64_t)n;
+    m_remaining -= (uint64_t)n;
+    if (n <= 0)
+        return traits_type::eof();
+    setg(m_buf, m_buf, m_buf + n);
+    return traits_type::to_int_type(*gptr());
+}
+
+std::streamsize ProfiledIStreamBuf::xsgetn(char *s, std::streamsize n)
+{
+    std::streamsize ret = std::min<std::streamsize>(n, egptr() - gptr());
+    if (ret > 0) {
+        memcpy(s, gptr(), (size_t)ret);
+        gbump((int)ret);
+        s += ret;
+        n -= ret;
+    }
+    if (n == 0)
+        return ret;
+    if (n < (std::streamsize)sizeof(m_buf))
+        return ret + std::streambuf::xsgetn(s, n);
+
+    // large blocks are read directly
+    n = (std::streamsize)std::min<uint64_t>(n, m_remaining);
+    auto begin = Now();
+    m_src.read(s, n);
+    auto read = m_src.gcount();
+    m_receive_time += Now() - begin;
+    m_received_bytes += (uint64_t)read;
+    m_remaining -= (uint64_t)read;
+    return ret + read;
+}
+
+} // namespace ms
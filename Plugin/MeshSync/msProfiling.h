@@ -0,0 +1,137 @@
+#pragma once
+
+#include <atomic>
+#include <streambuf>
+#include "MeshUtils/MeshUtils.h"
+#include "msConfig.h"
+
+namespace ms {
+
+enum class ProfileStage
+{
+    Receive,            // time blocked on the transport while reading a message. bytes: message size
+    Deserialize,        // deserialization excluding Receive
+    Refine,             // Mesh::refine() total
+    RefineTransform,    // invert v, local2world, mirror, scale, handedness
+    RefineNormals,
+    RefineSplit,        // MeshRefiner::refine()
+    RefineRetopology,   // MeshRefiner::retopology()
+    RefineSubmeshes,    // MeshRefiner::genSubmeshes()
+    RefineRemap,        // remap attributes, setup splits / submeshes / bounds
+    RefineTangents,
+    RefineSkinning,     // bone weights and blendshapes
+    Convert,            // handedness / scale conversion of non-mesh objects and animations
+    QueueWait,          // from queued to handled by Server::processMessages()
+    Handler,            // message handler of Server::processMessages()
+    Count,
+};
+
+// counters and histograms of time spent in each ProfileStage.
+// counters are per thread and merged only when read, so recording is cheap enough to be always on.
+class Profiler
+{
+public:
+    static const int NumBuckets = 24; // bucket i: [2^(i-1), 2^i) microseconds. the last one is unbounded.
+
+    struct Entry
+    {
+        uint64_t count = 0;
+        uint64_t total_ns = 0;
+        uint64_t max_ns = 0;
+        uint64_t bytes = 0;
+        uint64_t histogram[NumBuckets] = {};
+    };
+    struct Stats
+    {
+        Entry entries[(int)ProfileStage::Count];
+    };
+
+    static const char* getStageName(ProfileStage v);
+    static int getBucket(nanosec elapsed);
+
+    void record(ProfileStage stage, nanosec elapsed, uint64_t bytes = 0);
+    Stats getStats();
+    void reset();
+    std::string toString();
+
+    // profiler of the current thread. lets deep code (Mesh::refine() etc) record without knowing the server.
+    static Profiler* current();
+    struct Scope
+    {
+        Scope(Profiler *v);
+        ~Scope();
+        Profiler *m_prev;
+    };
+
+private:
+    // only the owner thread writes these. relaxed load + store is enough.
+    struct LocalEntry
+    {
+        std::atomic<uint64_t> count{ 0 };
+        std::atomic<uint64_t> total_ns{ 0 };
+        std::atomic<uint64_t> max_ns{ 0 };
+        std::atomic<uint64_t> bytes{ 0 };
+        std::atomic<uint64_t> histogram[NumBuckets];
+        LocalEntry();
+    };
+    struct Local
+    {
+        LocalEntry entries[(int)ProfileStage::Count];
+    };
+
+    Stats gather();
+
+    tls<Local> m_locals;
+    std::mutex m_mutex;
+    Stats m_base; // subtracted from gathered values. reset() just updates this.
+};
+
+class ProfileTimer
+{
+public:
+    ProfileTimer(ProfileStage stage, uint64_t bytes = 0);
+    ~ProfileTimer();
+    // record the current stage and start the next one. splits sequential code without adding scopes.
+    void next(ProfileStage stage);
+
+private:
+    Profiler *m_profiler;
+    ProfileStage m_stage;
+    uint64_t m_bytes;
+    nanosec m_begin;
+};
+
+// wraps a transport stream and measures the time blocked on it. used to split Receive and Deserialize.
+class ProfiledIStreamBuf : public std::streambuf
+{
+public:
+    // size: bytes to read at most. the source stream may contain following messages.
+    ProfiledIStreamBuf(std::istream& src, uint64_t size);
+    nanosec getReceiveTime() const;
+    uint64_t getReceivedBytes() const;
+
+protected:
+    int_type underflow() override;
+    std::streamsize xsgetn(char *s, std::streamsize n) override;
+
+private:
+    std::istream& m_src;
+    uint64_t m_remaining;
+    nanosec m_receive_time = 0;
+    uint64_t m_received_bytes = 0;
+    char m_buf[4096];
+};
+
+#ifdef msEnableProfiling
+    #define msProfileConcat2(A, B) A##B
+    #define msProfileConcat(A, B) msProfileConcat2(A, B)
+    #define msProfileScope(Stage) ::ms::ProfileTimer msProfileConcat(ms_profile_timer_, __LINE__)(::ms::ProfileStage::Stage)
+    #define msProfileSection(Stage) ::ms::ProfileTimer ms_profile_section(::ms::ProfileStage::Stage)
+    #define msProfileNextSection(Stage) ms_profile_section.next(::ms::ProfileStage::Stage)
+#else
+    #define msProfileScope(Stage)
+    #define msProfileSection(Stage)
+    #define msProfileNextSection(Stage)
+#endif
+
+} // namespace ms
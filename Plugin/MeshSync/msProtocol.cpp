@@ -17,13 +17,178 @@ void Message::serialize(std::ostream& os) const
 }
 bool Message::deserialize(std::istream& is)
 {
-    int protocol_version = 0;
+    protocol_version = 0;
     read(is, protocol_version);
-    if (protocol_version != msProtocolVersion)
+    if (protocol_version < msProtocolVersionMin || protocol_version > msProtocolVersion)
         return false;
     return true;
 }
 
+
+// feature bits on the wire, from the lowest bit. new features must be appended.
+#define EachFeature(F)\
+    F(get) F(screenshot) F(query) F(shared_memory) F(mesh_chunk) F(animation_shared_times) F(animation_chunk)\
+    F(texture_cache) F(texture_mipmaps) F(material_reference) F(compact_indices) F(path_references)
+
+static uint32_t PackFeatures(const FeatureFlags& v)
+{
+    uint32_t ret = 0;
+    int bit = 0;
+#define Pack(N) ret |= (uint32_t)v.N << bit++;
+    EachFeature(Pack)
+#undef Pack
+    return ret;
+}
+
+static FeatureFlags UnpackFeatures(uint32_t v)
+{
+    FeatureFlags ret = {0};
+    int bit = 0;
+#define Unpack(N) ret.N = (v >> bit++) & 1;
+    EachFeature(Unpack)
+#undef Unpack
+    return ret;
+}
+
+Capabilities Capabilities::current()
+{
+    Capabilities ret;
+    ret.features.get = 1;
+    ret.features.screenshot = 1;
+    ret.features.query = 1;
+    ret.features.shared_memory = 1;
+    ret.features.mesh_chunk = 1;
+    ret.features.animation_shared_times = 1;
+    ret.features.animation_chunk = 1;
+    ret.features.texture_cache = 1;
+    ret.features.texture_mipmaps = 1;
+    ret.features.material_reference = 1;
+    ret.features.compact_indices = 1;
+    ret.features.path_references = 1;
+    return ret;
+}
+
+static thread_local WireFormatScope *g_wire_format;
+
+WireFormatScope::WireFormatScope(const FeatureFlags& features)
+    : m_prev(g_wire_format), m_features(features)
+{
+    g_wire_format = this;
+}
+
+WireFormatScope::~WireFormatScope()
+{
+    g_wire_format = m_prev;
+}
+
+FeatureFlags WireFormatScope::current()
+{
+    if (g_wire_format)
+        return g_wire_format->m_features;
+    FeatureFlags ret = {0};
+    return ret;
+}
+
+Capabilities Capabilities::legacy()
+{
+    Capabilities ret;
+    ret.protocol_version = ret.protocol_version_min = msProtocolVersionMin;
+    ret.features.get = 1;
+    ret.features.screenshot = 1;
+    ret.features.query = 1;
+    return ret;
+}
+
+Capabilities Capabilities::negotiate(const Capabilities& a, const Capabilities& b)
+{
+    auto min_limit = [](uint64_t x, uint64_t y) {
+        if (x == 0) return y;
+        if (y == 0) return x;
+        return std::min(x, y);
+    };
+
+    Capabilities ret;
+    ret.protocol_version = std::min(a.protocol_version, b.protocol_version);
+    ret.protocol_version_min = std::max(a.protocol_version_min, b.protocol_version_min);
+    ret.features = UnpackFeatures(PackFeatures(a.features) & PackFeatures(b.features));
+    ret.codecs = a.codecs & b.codecs;
+    ret.max_message_size = min_limit(a.max_message_size, b.max_message_size);
+    ret.split_unit = std::min(a.split_unit, b.split_unit);
+    ret.max_threads = (int)min_limit(a.max_threads, b.max_threads);
+    ret.framed_port = a.framed_port != 0 ? a.framed_port : b.framed_port;
+    ret.framed_timeout_ms = (int)min_limit(a.framed_timeout_ms, b.framed_timeout_ms);
+    ret.server_epoch = a.server_epoch != 0 ? a.server_epoch : b.server_epoch;
+    return ret;
+}
+
+bool Capabilities::hasCodec(Codec v) const
+{
+    return (codecs & (1 << (int)v)) != 0;
+}
+
+bool Capabilities::isCompatible() const
+{
+    return protocol_version >= protocol_version_min;
+}
+
+// fields are written one by one in declaration order. the layout doesn't depend on the compiler and has no padding.
+// new fields must be appended.
+#define EachCapability(F)\
+    F(protocol_version) F(protocol_version_min) F(features) F(codecs) F(max_message_size) F(split_unit) F(max_threads) F(framed_port) F(framed_timeout_ms) F(server_epoch)
+
+template<class T> static uint32_t CapabilitySize(const T& v) { return sizeof(v); }
+static uint32_t CapabilitySize(const FeatureFlags&) { return sizeof(uint32_t); }
+
+template<class T> static void WriteCapability(std::ostream& os, const T& v) { write(os, v); }
+static void WriteCapability(std::ostream& os, const FeatureFlags& v) { write(os, PackFeatures(v)); }
+
+// fields the peer didn't send keep their defaults
+template<class T> static void ReadCapability(std::istream& is, T& v, uint32_t& remaining)
+{
+    if (remaining < sizeof(v))
+        return;
+    read(is, v);
+    remaining -= sizeof(v);
+}
+static void ReadCapability(std::istream& is, FeatureFlags& v, uint32_t& remaining)
+{
+    uint32_t bits = 0;
+    ReadCapability(is, bits, remaining);
+    v = UnpackFeatures(bits);
+}
+
+uint32_t Capabilities::getSerializeSize() const
+{
+    uint32_t ret = 4;
+#define Size(N) ret += CapabilitySize(N);
+    EachCapability(Size)
+#undef Size
+    return ret;
+}
+void Capabilities::serialize(std::ostream& os) const
+{
+    uint32_t size = getSerializeSize() - 4;
+    write(os, size);
+#define Write(N) WriteCapability(os, N);
+    EachCapability(Write)
+#undef Write
+}
+void Capabilities::deserialize(std::istream& is)
+{
+    // the peer may be older (fewer fields) or newer (more fields). read what we know and skip the rest.
+    uint32_t size = 0;
+    read(is, size);
+    *this = Capabilities();
+    uint32_t remaining = size;
+#define Read(N) ReadCapability(is, N, remaining);
+    EachCapability(Read)
+#undef Read
+    if (remaining > 0)
+        is.ignore(remaining);
+}
+
+#undef EachCapability
+
 GetMessage::GetMessage()
 {
 }
@@ -57,23 +222,160 @@ SetMessage::SetMessage()
 }
 uint32_t SetMessage::getSerializeSize() const
 {
+    PathReferenceScope scope(WireFormatScope::current().path_references != 0);
     uint32_t ret = super::getSerializeSize();
     ret += scene.getSerializeSize();
     return ret;
 }
 void SetMessage::serialize(std::ostream& os) const
 {
+    PathReferenceScope scope(WireFormatScope::current().path_references != 0);
     super::serialize(os);
     scene.serialize(os);
 }
 bool SetMessage::deserialize(std::istream& is)
 {
     if (!super::deserialize(is)) { return false; }
+    PathReferenceScope scope(false);
     scene.deserialize(is);
     return true;
 }
 
 
+MeshChunkMessage::MeshChunkMessage()
+{
+}
+
+uint32_t MeshChunkMessage::getSerializeSize() const
+{
+    uint32_t ret = super::getSerializeSize();
+    ret += ssize(transfer_id);
+    ret += ssize(attribute);
+    if (attribute == Attribute::Header) {
+        ret += ssize(scene_settings);
+        ret += ssize(flags);
+        ret += source ? source->getHeaderSerializeSize() : mesh->getSerializeSize();
+    }
+    else if (attribute != Attribute::End) {
+        ret += ssize(total_count);
+        ret += ssize(offset);
+        ret += 8 + (uint32_t)data.size();
+    }
+    return ret;
+}
+
+void MeshChunkMessage::serialize(std::ostream& os) const
+{
+    super::serialize(os);
+    write(os, transfer_id);
+    write(os, attribute);
+    if (attribute == Attribute::Header) {
+        write(os, scene_settings);
+        write(os, flags);
+        if (source)
+            source->serializeHeader(os);
+        else
+            mesh->serialize(os);
+    }
+    else if (attribute != Attribute::End) {
+        write(os, total_count);
+        write(os, offset);
+        uint64_t size = data.size();
+        write(os, size);
+        os.write(data.data(), (std::streamsize)size);
+    }
+}
+
+bool MeshChunkMessage::deserialize(std::istream& is)
+{
+    if (!super::deserialize(is)) { return false; }
+    read(is, transfer_id);
+    read(is, attribute);
+    if (attribute == Attribute::Header) {
+        read(is, scene_settings);
+        read(is, flags);
+        mesh = std::dynamic_pointer_cast<Mesh>(Entity::create(is));
+        if (!mesh)
+            return false;
+    }
+    else if (attribute != Attribute::End) {
+        read(is, total_count);
+        read(is, offset);
+        uint64_t size = 0;
+        read(is, size);
+        buffer.resize_discard((size_t)size);
+        is.read(buffer.data(), (std::streamsize)size);
+        data = buffer;
+    }
+    return is.good();
+}
+
+
+AnimationChunkMessage::AnimationChunkMessage()
+{
+}
+
+#define EachMember(F) F(transfer_id) F(clip) F(scene_settings) F(time_begin) F(time_end) F(last) F(animations)
+
+uint32_t AnimationChunkMessage::getSerializeSize() const
+{
+    uint32_t ret = super::getSerializeSize();
+    EachMember(msSize);
+    return ret;
+}
+
+void AnimationChunkMessage::serialize(std::ostream& os) const
+{
+    super::serialize(os);
+    EachMember(msWrite);
+}
+
+bool AnimationChunkMessage::deserialize(std::istream& is)
+{
+    if (!super::deserialize(is)) { return false; }
+    EachMember(msRead);
+    return is.good();
+}
+
+#undef EachMember
+
+#define EachAttribute(Body)\
+    Body(Points, points) Body(Normals, normals) Body(Tangents, tangents) Body(UV0, uv0) Body(UV1, uv1)\
+    Body(Colors, colors) Body(Counts, counts) Body(Indices, indices) Body(MaterialIDs, material_ids)
+
+size_t MeshChunkMessage::getElementSize(Attribute a)
+{
+    switch (a) {
+#define Body(E, A) case Attribute::E: return sizeof(Mesh::A[0]);
+    EachAttribute(Body)
+#undef Body
+    default: return 0;
+    }
+}
+
+IArray<char> MeshChunkMessage::getAttribute(const Mesh& mesh, Attribute a)
+{
+    switch (a) {
+#define Body(E, A) case Attribute::E: return IArray<char>((const char*)mesh.A.data(), mesh.A.size() * sizeof(mesh.A[0]));
+    EachAttribute(Body)
+#undef Body
+    default: return IArray<char>();
+    }
+}
+
+bool MeshChunkMessage::resizeAttribute(Mesh& mesh, Attribute a, uint64_t count)
+{
+    switch (a) {
+#define Body(E, A) case Attribute::E: mesh.A.resize_discard((size_t)count); return true;
+    EachAttribute(Body)
+#undef Body
+    default: return false;
+    }
+}
+
+#undef EachAttribute
+
+
 uint32_t DeleteMessage::Identifier::getSerializeSize() const
 {
     return ssize(path) + ssize(id);
@@ -201,4 +503,53 @@ bool ResponseMessage::deserialize(std::istream & is)
     return true;
 }
 
+
+HandshakeMessage::HandshakeMessage()
+{
+}
+
+uint32_t HandshakeMessage::getSerializeSize() const
+{
+    return super::getSerializeSize()
+        + ssize(caps);
+}
+
+void HandshakeMessage::serialize(std::ostream& os) const
+{
+    super::serialize(os);
+    write(os, caps);
+}
+
+bool HandshakeMessage::deserialize(std::istream& is)
+{
+    // intentionally ignore version mismatch. it is the purpose of handshake to deal with it.
+    super::deserialize(is);
+    read(is, caps);
+    return is.good();
+}
+
+
+TextureQueryMessage::TextureQueryMessage()
+{
+}
+
+uint32_t TextureQueryMessage::getSerializeSize() const
+{
+    return super::getSerializeSize()
+        + ssize(hashes);
+}
+
+void TextureQueryMessage::serialize(std::ostream& os) const
+{
+    super::serialize(os);
+    write(os, hashes);
+}
+
+bool TextureQueryMessage::deserialize(std::istream& is)
+{
+    if (!super::deserialize(is)) { return false; }
+    read(is, hashes);
+    return is.good();
+}
+
 } // namespace ms
@@ -2,6 +2,7 @@
 
 #include <atomic>
 #include "msSceneGraph.h"
+#include "msAnimation.h"
 
 namespace ms {
 
@@ -21,6 +22,11 @@ public:
         Response,
     };
 
+    // non-serializable. version of the sender. valid after deserialize().
+    int protocol_version = msProtocolVersion;
+    // non-serializable. set when Server queues the message.
+    nanosec queued_time = 0;
+
     virtual ~Message();
     virtual uint32_t getSerializeSize() const;
     virtual void serialize(std::ostream& os) const;
@@ -30,6 +36,72 @@ msHasSerializer(Message);
 using MessagePtr = std::shared_ptr<Message>;
 
 
+// new bits must be appended to the end and to EachFeature in msProtocol.cpp
+struct FeatureFlags
+{
+    uint32_t get : 1;
+    uint32_t screenshot : 1;
+    uint32_t query : 1;
+    uint32_t shared_memory : 1;
+    uint32_t mesh_chunk : 1;
+    uint32_t animation_shared_times : 1; // animation tracks can omit times shared with the first track
+    uint32_t animation_chunk : 1;
+    uint32_t texture_cache : 1;
+    uint32_t texture_mipmaps : 1; // textures can carry the whole mip chain. see Texture::has_mipmaps
+    uint32_t material_reference : 1; // the server resolves materials sent as references. see Material::makeReference()
+    uint32_t compact_indices : 1; // meshes can be sent with 16 bit indices. see MeshDataFlags::compact_indices
+    uint32_t path_references : 1; // repeated paths in SetMessage can be sent as references. see PathReferenceScope
+};
+
+// serialization formats added after protocol version 110 are written only while a WireFormatScope that
+// enables them is alive on the thread. outside of a scope, the layout of 110 is written, which any peer can read.
+// readers detect the format from the data, so the scope matters only for writing.
+// Client opens one with the negotiated features around each send.
+class WireFormatScope
+{
+public:
+    WireFormatScope(const FeatureFlags& features);
+    ~WireFormatScope();
+    static FeatureFlags current(); // all zero outside of a scope
+
+private:
+    WireFormatScope *m_prev;
+    FeatureFlags m_features;
+};
+
+enum class Codec
+{
+    Raw,
+};
+
+// exchanged by HandshakeMessage.
+// new fields must be appended to the end and to EachCapability in msProtocol.cpp, so that peers with different versions can read each other.
+struct Capabilities
+{
+    int protocol_version = msProtocolVersion;
+    int protocol_version_min = msProtocolVersionMin;
+    FeatureFlags features = {0};
+    uint32_t codecs = 1 << (int)Codec::Raw;
+    uint64_t max_message_size = 0; // 0: unlimited
+    uint32_t split_unit = 0xffffffff;
+    int max_threads = 0;            // 0: unknown
+    uint16_t framed_port = 0;       // 0: framed transport is not available
+    int framed_timeout_ms = 0;      // framed connections idle for this long are closed by the server. 0: never
+    uint64_t server_epoch = 0;      // changes when the server starts or is cleared. state sent before that is lost. 0: unknown
+
+    static Capabilities current(); // everything this build supports
+    static Capabilities legacy();  // assumed when the peer doesn't respond to handshake
+    static Capabilities negotiate(const Capabilities& a, const Capabilities& b);
+    bool hasCodec(Codec v) const;
+    bool isCompatible() const;
+
+    uint32_t getSerializeSize() const;
+    void serialize(std::ostream& os) const;
+    void deserialize(std::istream& is);
+};
+msHasSerializer(Capabilities);
+
+
 struct GetFlags
 {
     uint32_t get_transform : 1;
@@ -84,6 +156,83 @@ msHasSerializer(SetMessage);
 using SetMessagePtr = std::shared_ptr<SetMessage>;
 
 
+// a part of a mesh that is too large to be sent by one SetMessage.
+// a transfer consists of Header, any number of attribute chunks and End. the server reassembles the mesh
+// and handles it as a SetMessage when End arrives. see Client::send(const SetMessage&).
+class MeshChunkMessage : public Message
+{
+using super = Message;
+public:
+    enum class Attribute : uint32_t
+    {
+        Header,
+        Points,
+        Normals,
+        Tangents,
+        UV0,
+        UV1,
+        Colors,
+        Counts,
+        Indices,
+        MaterialIDs,
+        End,
+    };
+
+    uint64_t transfer_id = 0;
+    Attribute attribute = Attribute::Header;
+
+    // Header
+    SceneSettings scene_settings;
+    MeshDataFlags flags = { 0 }; // flags of the complete mesh
+    const Mesh *source = nullptr; // sending side. non-serializable
+    MeshPtr mesh;                 // receiving side
+
+    // vertex attributes
+    uint64_t total_count = 0; // in elements
+    uint64_t offset = 0;      // in elements
+    IArray<char> data;        // points to the source mesh (sending side) or buffer (receiving side)
+    RawVector<char> buffer;   // non-serializable
+
+public:
+    MeshChunkMessage();
+    uint32_t getSerializeSize() const override;
+    void serialize(std::ostream& os) const override;
+    bool deserialize(std::istream& is) override;
+
+    // helpers for both sides
+    static size_t getElementSize(Attribute a);
+    static IArray<char> getAttribute(const Mesh& mesh, Attribute a);
+    static bool resizeAttribute(Mesh& mesh, Attribute a, uint64_t count);
+};
+msHasSerializer(MeshChunkMessage);
+using MeshChunkMessagePtr = std::shared_ptr<MeshChunkMessage>;
+
+
+// keys of a time range of an animation clip. lets clients send a clip while it is being baked instead of as a whole.
+// the server appends chunks of the same transfer to one clip and hands the clip received so far to the handler
+// as a SetMessage. the last chunk completes the transfer and keyframe reduction is applied to the whole clip.
+class AnimationChunkMessage : public Message
+{
+using super = Message;
+public:
+    uint64_t transfer_id = 0;
+    std::string clip;             // name of the clip
+    SceneSettings scene_settings;
+    float time_begin = 0.0f;      // time range of the keys in this chunk
+    float time_end = 0.0f;
+    bool last = false;
+    std::vector<AnimationPtr> animations; // path identifies the target. animations without keys can be omitted
+
+public:
+    AnimationChunkMessage();
+    uint32_t getSerializeSize() const override;
+    void serialize(std::ostream& os) const override;
+    bool deserialize(std::istream& is) override;
+};
+msHasSerializer(AnimationChunkMessage);
+using AnimationChunkMessagePtr = std::shared_ptr<AnimationChunkMessage>;
+
+
 class DeleteMessage : public Message
 {
 using super = Message;
@@ -214,4 +363,62 @@ public:
 msHasSerializer(ResponseMessage);
 using ResponseMessagePtr = std::shared_ptr<ResponseMessage>;
 
+
+// length-prefixed binary framing used by non-HTTP transports (framed TCP and shared memory).
+enum class FrameType : uint32_t
+{
+    Unknown,
+    Get,
+    Set,
+    Delete,
+    Fence,
+    Query,
+    Handshake,
+    MeshChunk,
+    Ack,   // response. payload depends on the request (scene for Get, ResponseMessage for Query, etc.)
+    Error, // response. request was rejected
+    AnimationChunk,
+    TextureQuery,
+};
+
+struct FrameHeader
+{
+    FrameType type = FrameType::Unknown;
+    uint32_t request_id = 0; // responses have the id of the request
+    uint64_t size = 0;       // payload size
+};
+
+
+// handshake is not rejected by protocol version mismatch. both sides send its capabilities and use the intersection of them.
+class HandshakeMessage : public Message
+{
+using super = Message;
+public:
+    Capabilities caps;
+
+    HandshakeMessage();
+    uint32_t getSerializeSize() const override;
+    void serialize(std::ostream& os) const override;
+    bool deserialize(std::istream& is) override;
+};
+msHasSerializer(HandshakeMessage);
+using HandshakeMessagePtr = std::shared_ptr<HandshakeMessage>;
+
+
+// asks which textures the server has in its cache. like handshake, the server responds immediately
+// with a TextureQueryMessage that has the cached subset of hashes.
+class TextureQueryMessage : public Message
+{
+using super = Message;
+public:
+    std::vector<uint64_t> hashes;
+
+    TextureQueryMessage();
+    uint32_t getSerializeSize() const override;
+    void serialize(std::ostream& os) const override;
+    bool deserialize(std::istream& is) override;
+};
+msHasSerializer(TextureQueryMessage);
+using TextureQueryMessagePtr = std::shared_ptr<TextureQueryMessage>;
+
 } // namespace ms
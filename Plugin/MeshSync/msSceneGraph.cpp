@@ -3,7 +3,9 @@
 #include "msConstraints.h"
 #include "msAnimation.h"
 #include "msMaterial.h"
+#include "msProtocol.h"
 #include "msSceneGraphImpl.h"
+#include "msProfiling.h"
 
 
 namespace ms {
@@ -28,6 +30,96 @@ std::shared_ptr<Entity> Entity::create(std::istream & is)
     return ret;
 }
 
+static thread_local PathReferenceScope *g_path_scope;
+static const uint32_t PathReferenceBit = 0x80000000;
+
+PathReferenceScope::PathReferenceScope(bool enable_references)
+    : m_prev(g_path_scope), m_enabled(enable_references)
+{
+    g_path_scope = this;
+}
+
+PathReferenceScope::~PathReferenceScope()
+{
+    g_path_scope = m_prev;
+}
+
+// getSerializeSize() and serialize() are done in separate scopes with the same order. so sizes match.
+uint32_t ssize_path(const std::string& v)
+{
+    auto *scope = g_path_scope;
+    if (scope && scope->m_enabled) {
+        auto it = scope->m_indices.find(v);
+        if (it != scope->m_indices.end())
+            return 4;
+        scope->m_indices.emplace(v, (uint32_t)scope->m_indices.size());
+    }
+    return ssize(v);
+}
+
+void write_path(std::ostream& os, const std::string& v)
+{
+    auto *scope = g_path_scope;
+    if (scope && scope->m_enabled) {
+        auto it = scope->m_indices.find(v);
+        if (it != scope->m_indices.end()) {
+            uint32_t ref = it->second | PathReferenceBit;
+            write(os, ref);
+            return;
+        }
+        scope->m_indices.emplace(v, (uint32_t)scope->m_indices.size());
+    }
+    write(os, v);
+}
+
+void read_path(std::istream& is, std::string& v)
+{
+    uint32_t size = 0;
+    read(is, size);
+    auto *scope = g_path_scope;
+    if (size & PathReferenceBit) {
+        uint32_t index = size & ~PathReferenceBit;
+        if (scope && index < scope->m_paths.size()) {
+            v = scope->m_paths[index];
+        }
+        else {
+            v.clear();
+            is.setstate(std::ios::failbit);
+        }
+        return;
+    }
+    v.resize(size);
+    is.read(&v[0], size);
+    if (scope)
+        scope->m_paths.push_back(v);
+}
+
+uint32_t ssize_path(const std::vector<std::string>& v)
+{
+    uint32_t ret = 4;
+    for (auto& e : v)
+        ret += ssize_path(e);
+    return ret;
+}
+
+void write_path(std::ostream& os, const std::vector<std::string>& v)
+{
+    auto size = (uint32_t)v.size();
+    write(os, size);
+    for (auto& e : v)
+        write_path(os, e);
+}
+
+void read_path(std::istream& is, std::vector<std::string>& v)
+{
+    uint32_t size = 0;
+    read(is, size);
+    v.resize(size);
+    for (auto& e : v)
+        read_path(is, e);
+}
+
+
 Entity::Entity() {}
 Entity::~Entity() {}
 
@@ -41,7 +133,7 @@ uint32_t Entity::getSerializeSize() const
     uint32_t ret = 0;
     ret += sizeof(int);
     ret += ssize(id);
-    ret += ssize(path);
+    ret += ssize_path(path);
     return ret;
 }
 void Entity::serialize(std::ostream& os) const
@@ -49,13 +141,13 @@ void Entity::serialize(std::ostream& os) const
     int type = (int)getType();
     write(os, type);
     write(os, id);
-    write(os, path);
+    write_path(os, path);
 }
 void Entity::deserialize(std::istream& is)
 {
     // type is consumed by make()
     read(is, id);
-    read(is, path);
+    read_path(is, path);
 }
 
 void Entity::clear()
@@ -388,7 +480,7 @@ BoneData::~BoneData() {}
 uint32_t BoneData::getSerializeSize() const
 {
     uint32_t ret = 0;
-    ret += ssize(path);
+    ret += ssize_path(path);
     ret += ssize(bindpose);
     ret += ssize(weights);
     return ret;
@@ -396,14 +488,14 @@ uint32_t BoneData::getSerializeSize() const
 
 void BoneData::serialize(std::ostream & os) const
 {
-    write(os, path);
+    write_path(os, path);
     write(os, bindpose);
     write(os, weights);
 }
 
 void BoneData::deserialize(std::istream & is)
 {
-    read(is, path);
+    read_path(is, path);
     read(is, bindpose);
     read(is, weights);
 }
@@ -434,7 +526,39 @@ void BoneData::applyScaleFactor(float scale)
 #define EachVertexProperty(Body)\
     Body(points) Body(normals) Body(tangents) Body(uv0) Body(uv1) Body(colors) Body(counts) Body(indices) Body(material_ids)
 
-Mesh::Mesh() {}
+// 16 bit indices are converted from / to int in blocks. the layout is the same as RawVector: count followed by data.
+static const int CompactIndicesBlockSize = 4096;
+
+static void WriteCompactIndices(std::ostream& os, const RawVector<int>& indices)
+{
+    auto size = (uint32_t)indices.size();
+    os.write((const char*)&size, 4);
+
+    uint16_t buf[CompactIndicesBlockSize];
+    for (uint32_t i = 0; i < size; i += CompactIndicesBlockSize) {
+        uint32_t n = std::min<uint32_t>(CompactIndicesBlockSize, size - i);
+        for (uint32_t j = 0; j < n; ++j)
+            buf[j] = (uint16_t)indices[i + j];
+        os.write((const char*)buf, sizeof(uint16_t) * n);
+    }
+}
+
+static void ReadCompactIndices(std::istream& is, RawVector<int>& indices)
+{
+    uint32_t size = 0;
+    is.read((char*)&size, 4);
+    indices.resize_discard(size);
+
+    uint16_t buf[CompactIndicesBlockSize];
+    for (uint32_t i = 0; i < size; i += CompactIndicesBlockSize) {
+        uint32_t n = std::min<uint32_t>(CompactIndicesBlockSize, size - i);
+        is.read((char*)buf, sizeof(uint16_t) * n);
+        for (uint32_t j = 0; j < n; ++j)
+            indices[i + j] = buf[j];
+    }
+}
+
+Mesh::Mesh() { touch(); }
 Mesh::~Mesh() {}
 
 Entity::Type Mesh::getType() const
@@ -442,8 +566,19 @@ Entity::Type Mesh::getType() const
     return Type::Mesh;
 }
 
+// the format of indices is decided on each write rather than stored in the mesh, so that sending doesn't modify the caller's meshes.
+// getSerializeSize() and serialize() are done in the same scope, so they decide the same.
+static MeshDataFlags GetWriteFlags(const Mesh& mesh)
+{
+    auto ret = mesh.flags;
+    if (ret.has_indices && !ret.compact_indices && WireFormatScope::current().compact_indices && mesh.canCompactIndices())
+        ret.compact_indices = 1;
+    return ret;
+}
+
 uint32_t Mesh::getSerializeSize() const
 {
+    auto flags = GetWriteFlags(*this);
     uint32_t ret = super::getSerializeSize();
     ret += ssize(flags);
 
@@ -452,9 +587,11 @@ uint32_t Mesh::getSerializeSize() const
 #define Body(A) if(flags.has_##A) ret += ssize(A);
     EachVertexProperty(Body);
 #undef Body
+    if (flags.has_indices && flags.compact_indices)
+        ret -= (uint32_t)(indices.size() * (sizeof(int) - sizeof(uint16_t)));
 
     if (flags.has_bones) {
-        ret += ssize(root_bone);
+        ret += ssize_path(root_bone);
         ret += ssize(bones);
     }
     if (flags.has_blendshape_weights) {
@@ -465,17 +602,25 @@ uint32_t Mesh::getSerializeSize() const
 
 void Mesh::serialize(std::ostream& os) const
 {
+    auto flags = GetWriteFlags(*this);
     super::serialize(os);
     write(os, flags);
 
     if (flags.has_refine_settings) write(os, refine_settings);
 
 #define Body(A) if(flags.has_##A) write(os, A);
-    EachVertexProperty(Body);
+    Body(points) Body(normals) Body(tangents) Body(uv0) Body(uv1) Body(colors) Body(counts)
+    if (flags.has_indices) {
+        if (flags.compact_indices)
+            WriteCompactIndices(os, indices);
+        else
+            write(os, indices);
+    }
+    Body(material_ids)
 #undef Body
 
     if (flags.has_bones) {
-        write(os, root_bone);
+        write_path(os, root_bone);
         write(os, bones);
     }
     if (flags.has_blendshape_weights) {
@@ -492,11 +637,20 @@ void Mesh::deserialize(std::istream& is)
     if (flags.has_refine_settings) read(is, refine_settings);
 
 #define Body(A) if(flags.has_##A) read(is, A);
-    EachVertexProperty(Body);
+    Body(points) Body(normals) Body(tangents) Body(uv0) Body(uv1) Body(colors) Body(counts)
+    if (flags.has_indices) {
+        if (flags.compact_indices)
+            ReadCompactIndices(is, indices);
+        else
+            read(is, indices);
+    }
+    Body(material_ids)
 #undef Body
+    // indices are int in memory regardless of the format on the wire
+    flags.compact_indices = 0;
 
     if (flags.has_bones) {
-        read(is, root_bone);
+        read_path(is, root_bone);
         read(is, bones);
 
         {
@@ -512,6 +666,65 @@ void Mesh::deserialize(std::istream& is)
     }
 }
 
+static MeshDataFlags StripVertexFlags(MeshDataFlags flags)
+{
+#define Body(A) flags.has_##A = 0;
+    EachVertexProperty(Body);
+#undef Body
+    return flags;
+}
+
+uint32_t Mesh::getHeaderSerializeSize() const
+{
+    auto header_flags = StripVertexFlags(flags);
+    uint32_t ret = super::getSerializeSize();
+    ret += ssize(header_flags);
+    if (header_flags.has_refine_settings) ret += ssize(refine_settings);
+    if (header_flags.has_bones) {
+        ret += ssize_path(root_bone);
+        ret += ssize(bones);
+    }
+    if (header_flags.has_blendshape_weights) {
+        ret += ssize(blendshapes);
+    }
+    return ret;
+}
+
+void Mesh::serializeHeader(std::ostream& os) const
+{
+    auto header_flags = StripVertexFlags(flags);
+    super::serialize(os);
+    write(os, header_flags);
+    if (header_flags.has_refine_settings) write(os, refine_settings);
+    if (header_flags.has_bones) {
+        write_path(os, root_bone);
+        write(os, bones);
+    }
+    if (header_flags.has_blendshape_weights) {
+        write(os, blendshapes);
+    }
+}
+
+uint64_t Mesh::getVertexDataSize() const
+{
+    uint64_t ret = 0;
+#define Body(A) if(flags.has_##A) ret += (uint64_t)A.size() * sizeof(A[0]);
+    EachVertexProperty(Body);
+#undef Body
+    return ret;
+}
+
+bool Mesh::canCompactIndices() const
+{
+    // negative indices set the upper bits too
+    int n = (int)indices.size();
+    const int *src = indices.data();
+    uint32_t bits = 0;
+    for (int i = 0; i < n; ++i)
+        bits |= (uint32_t)src[i];
+    return bits <= 0xffff;
+}
+
 void Mesh::clear()
 {
     super::clear();
@@ -530,8 +743,15 @@ void Mesh::clear()
     submeshes.clear();
     splits.clear();
     weights4.clear();
+    vertex_format = VertexFormat::Unknown;
+    vertices.clear();
+    touch();
+}
 
-    remap_normals.clear(); remap_uv0.clear(); remap_uv1.clear(); remap_colors.clear();
+void Mesh::touch()
+{
+    static std::atomic<uint64_t> s_generation{ 0 };
+    generation = ++s_generation;
 }
 
 #undef EachVertexProperty
@@ -578,7 +798,7 @@ void Mesh::applyScaleFactor(float v)
 }
 
 template<class T>
-inline void Remap(RawVector<T>& dst, const RawVector<T>& src, const RawVector<int>& indices)
+inline void Remap(RawVector<T>& dst, const RawVector<T>& src, const IArray<int>& indices)
 {
     if (indices.empty()) {
         dst.assign(src.begin(), src.end());
@@ -589,8 +809,83 @@ inline void Remap(RawVector<T>& dst, const RawVector<T>& src, const RawVector<in
     }
 }
 
+// scratch buffers of Mesh::refine(). shared by all meshes refined on the same thread,
+// so that meshes don't hold them and allocations are amortized.
+struct RefineWorkspace
+{
+    mu::MeshRefiner refiner;
+    RawVector<float3> tmp_normals;
+    RawVector<float2> tmp_uv0, tmp_uv1;
+    RawVector<float4> tmp_colors;
+    RawVector<int> remap_normals, remap_uv0, remap_uv1, remap_colors;
+    RawVector<Weights4> tmp_weights4;
+    RawVector<float3> tmp_points;
+
+    void clear()
+    {
+        refiner.clear();
+        remap_normals.clear(); remap_uv0.clear(); remap_uv1.clear(); remap_colors.clear();
+    }
+};
+
+// workspaces grow to fit the largest mesh refined on the thread and tls<> never frees them.
+// ones used by meshes with more indices than this are released after refine().
+static const size_t RefineWorkspaceMaxIndices = 256 * 1024;
+
+struct RefineWorkspaceSlot
+{
+    std::unique_ptr<RefineWorkspace> workspace;
+    bool in_use = false;
+};
+static tls<RefineWorkspaceSlot> g_refine_workspaces;
+
+// takes the workspace of the thread. if it is already in use (a nested parallel_for ran another
+// Mesh::refine() on this thread while waiting), a temporary one is used instead.
+class RefineWorkspaceScope
+{
+public:
+    RefineWorkspaceScope()
+    {
+        auto& slot = g_refine_workspaces.local();
+        if (slot.in_use) {
+            m_tmp.reset(new RefineWorkspace());
+            m_workspace = m_tmp.get();
+        }
+        else {
+            if (!slot.workspace)
+                slot.workspace.reset(new RefineWorkspace());
+            slot.in_use = true;
+            m_slot = &slot;
+            m_workspace = slot.workspace.get();
+            m_workspace->clear();
+        }
+    }
+
+    ~RefineWorkspaceScope()
+    {
+        if (m_slot) {
+            if (m_release)
+                m_slot->workspace.reset();
+            m_slot->in_use = false;
+        }
+    }
+
+    RefineWorkspace& get() { return *m_workspace; }
+    // release the workspace at the end of the scope if it is going to grow too large to keep
+    void trim(size_t num_indices) { m_release = num_indices > RefineWorkspaceMaxIndices; }
+
+private:
+    RefineWorkspaceSlot *m_slot = nullptr;
+    RefineWorkspace *m_workspace = nullptr;
+    std::unique_ptr<RefineWorkspace> m_tmp;
+    bool m_release = false;
+};
+
 void Mesh::refine(const MeshRefineSettings& mrs)
 {
+    msProfileScope(Refine);
+    msProfileSection(RefineTransform);
+
     if (mrs.flags.invert_v) {
         mu::InvertV(uv0.data(), uv0.size());
     }
@@ -626,7 +921,19 @@ void Mesh::refine(const MeshRefineSettings& mrs)
         setupBoneData();
     }
 
-    mu::MeshRefiner refiner;
+    RefineWorkspaceScope ws_scope;
+    auto& ws = ws_scope.get();
+    ws_scope.trim(std::max(indices.size(), points.size()));
+    auto& refiner = ws.refiner;
+    auto& tmp_normals = ws.tmp_normals;
+    auto& tmp_uv0 = ws.tmp_uv0;
+    auto& tmp_uv1 = ws.tmp_uv1;
+    auto& tmp_colors = ws.tmp_colors;
+    auto& remap_normals = ws.remap_normals;
+    auto& remap_uv0 = ws.remap_uv0;
+    auto& remap_uv1 = ws.remap_uv1;
+    auto& remap_colors = ws.remap_colors;
+
     refiner.split_unit = mrs.split_unit;
     refiner.points = points;
     refiner.indices = indices;
@@ -640,9 +947,12 @@ void Mesh::refine(const MeshRefineSettings& mrs)
         refiner.addExpandedAttribute<float4>(colors, tmp_colors, remap_colors);
 
     // normals
+    msProfileNextSection(RefineNormals);
     bool flip_normals = mrs.flags.flip_normals ^ mrs.flags.swap_faces;
     if (mrs.flags.gen_normals_with_smooth_angle) {
         if (mrs.smooth_angle < 180.0f) {
+            // refiner.refine() reuses the connection as long as the number of points matches
+            refiner.connection.buildConnection(indices, counts, points);
             GenerateNormalsWithSmoothAngle(normals, refiner.connection, points, counts, indices, mrs.smooth_angle, flip_normals);
             refiner.addExpandedAttribute<float3>(normals, tmp_normals, remap_normals);
         }
@@ -661,27 +971,31 @@ void Mesh::refine(const MeshRefineSettings& mrs)
 
     // refine
     {
+        msProfileNextSection(RefineSplit);
         refiner.refine();
+        msProfileNextSection(RefineRetopology);
         refiner.retopology(mrs.flags.swap_faces);
+        msProfileNextSection(RefineSubmeshes);
         refiner.genSubmeshes(material_ids);
 
+        msProfileNextSection(RefineRemap);
         refiner.new_points.swap(points);
         refiner.new_counts.swap(counts);
         refiner.new_indices_submeshes.swap(indices);
         if (!normals.empty()) {
-            Remap(tmp_normals, normals, !remap_normals.empty() ? remap_normals : refiner.new2old_points);
+            Remap(tmp_normals, normals, !remap_normals.empty() ? IArray<int>(remap_normals) : IArray<int>(refiner.new2old_points));
             tmp_normals.swap(normals);
         }
         if (!uv0.empty()) {
-            Remap(tmp_uv0, uv0, !remap_uv0.empty() ? remap_uv0 : refiner.new2old_points);
+            Remap(tmp_uv0, uv0, !remap_uv0.empty() ? IArray<int>(remap_uv0) : IArray<int>(refiner.new2old_points));
             tmp_uv0.swap(uv0);
         }
         if (!uv1.empty()) {
-            Remap(tmp_uv1, uv1, !remap_uv1.empty() ? remap_uv1 : refiner.new2old_points);
+            Remap(tmp_uv1, uv1, !remap_uv1.empty() ? IArray<int>(remap_uv1) : IArray<int>(refiner.new2old_points));
             tmp_uv1.swap(uv1);
         }
         if (!colors.empty()) {
-            Remap(tmp_colors, colors, !remap_colors.empty() ? remap_colors : refiner.new2old_points);
+            Remap(tmp_colors, colors, !remap_colors.empty() ? IArray<int>(remap_colors) : IArray<int>(refiner.new2old_points));
             tmp_colors.swap(colors);
         }
 
@@ -694,6 +1008,7 @@ void Mesh::refine(const MeshRefineSettings& mrs)
             sp.vertex_offset = offset_vertices;
             sp.index_count = split.index_count;
             sp.vertex_count = split.vertex_count;
+            sp.index_format = split.vertex_count <= 0x10000 ? SplitData::IndexFormat::U16 : SplitData::IndexFormat::U32;
             splits.push_back(sp);
 
             offset_vertices += split.vertex_count;
@@ -735,6 +1050,7 @@ void Mesh::refine(const MeshRefineSettings& mrs)
     }
 
     // tangents
+    msProfileNextSection(RefineTangents);
     if (mrs.flags.gen_tangents && normals.size() == points.size() && uv0.size() == points.size()) {
         tangents.resize(points.size());
         GenerateTangentsTriangleIndexed(tangents.data(),
@@ -742,14 +1058,16 @@ void Mesh::refine(const MeshRefineSettings& mrs)
     }
 
     // weights
+    msProfileNextSection(RefineSkinning);
     if (!weights4.empty()) {
+        auto& tmp_weights4 = ws.tmp_weights4;
         tmp_weights4.resize_discard(points.size());
         CopyWithIndices(tmp_weights4.data(), weights4.data(), refiner.new2old_points);
         weights4.swap(tmp_weights4);
     }
 
     if (!blendshapes.empty()) {
-        RawVector<float3> tmp;
+        auto& tmp = ws.tmp_points;
         for (auto& bs : blendshapes) {
             bs->sort();
             for (auto& fp : bs->frames) {
@@ -773,6 +1091,22 @@ void Mesh::refine(const MeshRefineSettings& mrs)
         }
     }
 
+    // interleaved vertices
+    if (vertex_format != VertexFormat::Unknown) {
+        size_t n = points.size();
+        vertex_format = NegotiateVertexFormat(vertex_format,
+            points.data(),
+            normals.size() == n ? normals.data() : nullptr,
+            colors.size() == n ? colors.data() : nullptr,
+            uv0.size() == n ? uv0.data() : nullptr,
+            tangents.size() == n ? tangents.data() : nullptr);
+        vertices.resize_discard(n * GetVertexSize(vertex_format));
+        Interleave(vertices.data(), vertex_format, n, points.data(), normals.data(), colors.data(), uv0.data(), tangents.data());
+    }
+    else {
+        vertices.clear();
+    }
+
     flags.has_points = !points.empty();
     flags.has_normals = !normals.empty();
     flags.has_tangents = !tangents.empty();
@@ -173,6 +173,7 @@ struct MeshDataFlags
     uint32_t has_blendshape_weights : 1;
     uint32_t has_blendshapes : 1;
     uint32_t apply_trs : 1;
+    uint32_t compact_indices : 1; // indices are serialized in 16 bit. also done without this if the receiver supports it (see WireFormatScope) and all indices fit
 };
 
 struct MeshRefineFlags
@@ -232,11 +233,18 @@ struct SubmeshData
 
 struct SplitData
 {
+    enum class IndexFormat
+    {
+        U16,
+        U32,
+    };
+
     int index_count = 0;
     int index_offset = 0;
     int vertex_count = 0;
     int vertex_offset = 0;
     IArray<SubmeshData> submeshes;
+    IndexFormat index_format = IndexFormat::U32; // U16 if all vertices of the split can be indexed by 16 bit
     float3 bound_center = float3::zero();
     float3 bound_size = float3::zero();
 };
@@ -334,14 +342,14 @@ public:
 
     // non-serialized
     RawVector<Weights4> weights4;
-    RawVector<float3> tmp_normals;
-    RawVector<float2> tmp_uv0, tmp_uv1;
-    RawVector<float4> tmp_colors;
-    RawVector<int> remap_normals, remap_uv0, remap_uv1, remap_colors;
-
-    RawVector<Weights4> tmp_weights4;
     std::vector<SubmeshData> submeshes;
     std::vector<SplitData> splits;
+    // if not Unknown, refine() also builds vertices in the format negotiated with the available attributes.
+    // splits are contiguous in it and start at vertex_offset * GetVertexSize(vertex_format).
+    VertexFormat vertex_format = VertexFormat::Unknown;
+    RawVector<char> vertices;
+    // renewed by touch(). unique in the process, so a mesh pulled from the pool again never has an old one.
+    uint64_t generation = 0;
 
 
 protected:
@@ -364,6 +372,8 @@ public:
 
     void setupBoneData();
     void setupFlags();
+    // call after modifying the mesh. the C API does it on every write. see Server::endServe()
+    void touch();
 
     void convertHandedness_Mesh(bool x, bool yz);
     void convertHandedness_BlendShapes(bool x, bool yz);
@@ -371,6 +381,15 @@ public:
 
     BoneDataPtr addBone(const std::string& path);
     BlendShapeDataPtr addBlendShape(const std::string& name);
+
+    // chunked transfer (see MeshChunkMessage).
+    // header is serialized as a regular mesh without vertex attributes. it can be read by Entity::create().
+    uint32_t getHeaderSerializeSize() const;
+    void serializeHeader(std::ostream& os) const;
+    // total bytes of vertex attributes. 64 bit because it can exceed 4GB.
+    uint64_t getVertexDataSize() const;
+    // true if all indices fit in 16 bit. see MeshDataFlags::compact_indices
+    bool canCompactIndices() const;
 };
 msHasSerializer(Mesh);
 using MeshPtr = std::shared_ptr<Mesh>;
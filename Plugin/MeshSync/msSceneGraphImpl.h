@@ -217,4 +217,34 @@ template<class T> inline void write(std::ostream& os, const T& v) { return write
 template<class T> inline void read(std::istream& is, T& v) { return read_impl<T>()(is, v); }
 template<class T> inline void vclear(T& v) { return clear_impl<T>()(v); }
 
+
+// paths repeat a lot in scenes (bones, animations, constraints). while a PathReferenceScope with references enabled is
+// alive on the thread, a path that has already been written is written as a reference to the first one:
+// the length field has the top bit set and the rest is the index of the first one. reading handles both forms,
+// so only the writer has to know if the reader supports it. see FeatureFlags::path_references.
+// outside of a scope, paths are written and read as plain strings.
+class PathReferenceScope
+{
+public:
+    PathReferenceScope(bool enable_references);
+    ~PathReferenceScope();
+
+private:
+    PathReferenceScope *m_prev;
+    bool m_enabled;
+    std::unordered_map<std::string, uint32_t> m_indices; // writing
+    std::vector<std::string> m_paths; // reading
+
+    friend uint32_t ssize_path(const std::string& v);
+    friend void write_path(std::ostream& os, const std::string& v);
+    friend void read_path(std::istream& is, std::string& v);
+};
+
+uint32_t ssize_path(const std::string& v);
+void write_path(std::ostream& os, const std::string& v);
+void read_path(std::istream& is, std::string& v);
+uint32_t ssize_path(const std::vector<std::string>& v);
+void write_path(std::ostream& os, const std::vector<std::string>& v);
+void read_path(std::istream& is, std::vector<std::string>& v);
+
 } // namespace ms
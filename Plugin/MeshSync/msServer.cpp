@@ -1,6 +1,7 @@
 #include "pch.h"
 #include "msServer.h"
 #include "msAnimation.h"
+#include "msConstraints.h"
 
 
 namespace ms {
@@ -45,6 +46,133 @@ static void RespondTextForm(HTTPServerResponse &response, const std::string& mes
 }
 
 
+// appends everything written to it to a RawVector.
+class VectorOStreamBuf : public std::streambuf
+{
+public:
+    VectorOStreamBuf(RawVector<char>& dst) : m_dst(dst) {}
+
+protected:
+    int_type overflow(int_type c) override
+    {
+        if (c != traits_type::eof())
+            m_dst.push_back((char)c);
+        return c;
+    }
+    std::streamsize xsputn(const char *s, std::streamsize n) override
+    {
+        m_dst.insert(m_dst.end(), s, s + n);
+        return n;
+    }
+
+private:
+    RawVector<char>& m_dst;
+};
+
+static bool FileSeek(FILE *f, uint64_t pos)
+{
+#ifdef _WIN32
+    return _fseeki64(f, (__int64)pos, SEEK_SET) == 0;
+#else
+    return fseeko(f, (off_t)pos, SEEK_SET) == 0;
+#endif
+}
+
+// std::streambuf on a FILE. serializers read and write large blocks, so this is unbuffered and relies on FILE's buffer.
+class FileStreamBuf : public std::streambuf
+{
+public:
+    FileStreamBuf(FILE *f) : m_file(f) {}
+
+protected:
+    int_type overflow(int_type c) override
+    {
+        if (c != traits_type::eof()) {
+            char t = (char)c;
+            if (fwrite(&t, 1, 1, m_file) != 1)
+                return traits_type::eof();
+        }
+        return c;
+    }
+    std::streamsize xsputn(const char *s, std::streamsize n) override
+    {
+        return (std::streamsize)fwrite(s, 1, (size_t)n, m_file);
+    }
+    int_type underflow() override
+    {
+        if (gptr() < egptr())
+            return traits_type::to_int_type(*gptr());
+        if (fread(&m_char, 1, 1, m_file) != 1)
+            return traits_type::eof();
+        setg(&m_char, &m_char, &m_char + 1);
+        return traits_type::to_int_type(m_char);
+    }
+    std::streamsize xsgetn(char *s, std::streamsize n) override
+    {
+        std::streamsize ret = 0;
+        if (gptr() < egptr() && n > 0) {
+            *s++ = *gptr();
+            gbump(1);
+            --n;
+            ++ret;
+        }
+        return ret + (std::streamsize)fread(s, 1, (size_t)n, m_file);
+    }
+
+private:
+    FILE *m_file;
+    char m_char = 0;
+};
+
+template<class T>
+static uint64_t GetVectorSize(const std::vector<std::shared_ptr<T>>& v)
+{
+    uint64_t ret = 4;
+    for (auto& e : v)
+        ret += e->getSerializeSize();
+    return ret;
+}
+
+// serialized size of a received scene. each element fits in 32 bits, but the whole scene may not,
+// so this is summed in 64 bits rather than taken from SetMessage::getSerializeSize().
+static uint64_t GetSetMessageSize(const SetMessage& mes)
+{
+    auto& scene = mes.scene;
+    return mes.Message::getSerializeSize() + scene.settings.getSerializeSize() + GetVectorSize(scene.objects) + GetVectorSize(scene.constraints) +
+        GetVectorSize(scene.animations) + GetVectorSize(scene.textures) + GetVectorSize(scene.materials);
+}
+
+// unique across restarts of the host as well as across Server instances of a process
+static uint64_t NewServerEpoch()
+{
+    static std::atomic<uint64_t> s_count{ 0 };
+    return ((uint64_t)Now() << 8) + (++s_count & 0xff);
+}
+
+// refine() modifies bones and blend shapes in place too. they are copied so that the source is left as the host wrote it.
+static MeshPtr CloneMesh(const Mesh& src)
+{
+    auto ret = Mesh::create();
+    *ret = src;
+    for (auto& bone : ret->bones) {
+        auto dst = BoneData::create();
+        *dst = *bone;
+        bone = dst;
+    }
+    for (auto& bs : ret->blendshapes) {
+        auto dst = BlendShapeData::create();
+        *dst = *bs;
+        for (auto& frame : dst->frames) {
+            auto f = BlendShapeFrameData::create();
+            *f = *frame;
+            frame = f;
+        }
+        bs = dst;
+    }
+    return ret;
+}
+
+
 class RequestHandler : public HTTPRequestHandler
 {
 public:
@@ -91,6 +219,12 @@ void RequestHandler::handleRequest(HTTPServerRequest &request, HTTPServerRespons
     else if (uri == "fence") {
         m_server->recvFence(request, response);
     }
+    else if (uri == "chunk") {
+        m_server->recvMeshChunk(request, response);
+    }
+    else if (uri == "anim_chunk") {
+        m_server->recvAnimationChunk(request, response);
+    }
     else if (uri == "text" || uri.find("/text") != std::string::npos) {
         m_server->recvText(request, response);
     }
@@ -100,6 +234,15 @@ void RequestHandler::handleRequest(HTTPServerRequest &request, HTTPServerRespons
     else if (uri == "query") {
         m_server->recvQuery(request, response);
     }
+    else if (uri == "handshake") {
+        m_server->recvHandshake(request, response);
+    }
+    else if (uri == "texture_query") {
+        m_server->recvTextureQuery(request, response);
+    }
+    else if (uri == "stats" || uri.find("/stats") != std::string::npos) {
+        m_server->recvStats(request, response);
+    }
     else {
         RespondTextForm(response);
     }
@@ -116,16 +259,82 @@ HTTPRequestHandler* RequestHandlerFactory::createRequestHandler(const HTTPServer
 }
 
 
+// a connection of the framed transport. lives as long as the client keeps the socket open
+// and handles any number of requests on it.
+class FramedConnection : public TCPServerConnection
+{
+public:
+    FramedConnection(const StreamSocket& socket, Server *server);
+    void run() override;
+
+private:
+    Server *m_server = nullptr;
+};
+
+class FramedConnectionFactory : public TCPServerConnectionFactory
+{
+public:
+    FramedConnectionFactory(Server *server);
+    TCPServerConnection* createConnection(const StreamSocket& socket) override;
+
+private:
+    Server *m_server = nullptr;
+};
+
+
+FramedConnection::FramedConnection(const StreamSocket& socket, Server *server)
+    : TCPServerConnection(socket)
+    , m_server(server)
+{
+}
+
+void FramedConnection::run()
+{
+    auto& sock = socket();
+    sock.setNoDelay(true);
+    // idle or dead clients must not hold the thread forever. reads fail on timeout and the connection is closed.
+    int timeout_ms = m_server->getSettings().framed_timeout_ms;
+    if (timeout_ms > 0)
+        sock.setReceiveTimeout(Poco::Timespan((Poco::Timespan::TimeDiff)timeout_ms * 1000));
+    try {
+        SocketStream stream(sock);
+        for (;;) {
+            FrameHeader header;
+            if (!stream.read((char*)&header, sizeof(header)))
+                break;
+            if (!m_server->recvFrame(header, stream, stream))
+                break;
+            stream.flush();
+        }
+    }
+    catch (...) {
+    }
+}
+
+FramedConnectionFactory::FramedConnectionFactory(Server *server)
+    : m_server(server)
+{
+}
+
+TCPServerConnection* FramedConnectionFactory::createConnection(const StreamSocket& socket)
+{
+    return new FramedConnection(socket, m_server);
+}
+
+
 
 
 Server::Server(const ServerSettings& settings)
     : m_settings(settings)
+    , m_epoch(NewServerEpoch())
+    , m_texture_cache(settings.texture_cache_size)
 {
 }
 
 Server::~Server()
 {
     stop();
+    stopPrefetch();
     clear();
 }
 
@@ -147,6 +356,8 @@ bool Server::start()
             printf("%s\n", e.what());
             return false;
         }
+        startFramedServer();
+        startSharedMemory();
     }
 
     return true;
@@ -154,15 +365,152 @@ bool Server::start()
 
 void Server::stop()
 {
+    stopSharedMemory();
+    m_framed_server.reset();
+    m_framed_port = 0;
     m_server.reset();
 }
 
+bool Server::startFramedServer()
+{
+    auto* params = new Poco::Net::TCPServerParams;
+    if (m_settings.max_queue > 0)
+        params->setMaxQueued(m_settings.max_queue);
+    if (m_settings.max_threads > 0)
+        params->setMaxThreads(m_settings.max_threads);
+
+    try {
+        // the port is chosen by the OS and told to clients by handshake
+        Poco::Net::ServerSocket svs(Poco::Net::SocketAddress(0));
+        m_framed_port = svs.address().port();
+        m_framed_server.reset(new Poco::Net::TCPServer(new FramedConnectionFactory(this), svs, params));
+        m_framed_server->start();
+    }
+    catch (Poco::Exception &e) {
+        msLogWarning("Server::startFramedServer(): %s. HTTP only.\n", e.what());
+        m_framed_port = 0;
+        return false;
+    }
+    return true;
+}
+
+bool Server::startSharedMemory()
+{
+    if (m_shm || m_settings.shared_memory_size == 0)
+        return false;
+
+    auto shm = std::make_shared<SharedMemoryChannel>();
+    if (!shm->create(SharedMemoryChannel::getName(m_settings.port), m_settings.shared_memory_size)) {
+        msLogWarning("Server::startSharedMemory(): failed to create shared memory. HTTP only.\n");
+        return false;
+    }
+    m_shm = shm;
+    m_shm_stop = false;
+    m_shm_thread = std::thread([this]() { processSharedMemory(); });
+    return true;
+}
+
+void Server::stopSharedMemory()
+{
+    if (!m_shm)
+        return;
+    m_shm_stop = true;
+    m_shm->interrupt();
+    if (m_shm_thread.joinable())
+        m_shm_thread.join();
+    m_shm.reset();
+}
+
+void Server::processSharedMemory()
+{
+    const int wait_ms = 100;
+    const int frame_timeout_ms = 10000;
+
+    auto& shm = *m_shm;
+    while (!m_shm_stop) {
+        if (!shm.waitData(wait_ms))
+            continue;
+
+        // a broken frame is skipped by the channel. just go on to the next one.
+        FrameHeader fh;
+        if (!shm.readFrameHeader(fh, frame_timeout_ms))
+            continue;
+
+        // deserialize directly from the shared memory
+        SharedMemoryIStreamBuf buf(shm, fh.size, frame_timeout_ms);
+        std::istream is(&buf);
+        if (!isServing() || (m_settings.max_message_size != 0 && fh.size > m_settings.max_message_size)) {
+            // just consume
+        }
+        else if (fh.type == FrameType::Set) {
+            RecvSceneScope scope(this);
+            auto mes = SetMessagePtr(new SetMessage());
+            if (deserializeMessage(*mes, is, fh.size))
+                recvSet(mes);
+            else
+                queueVersionNotMatchedMessage();
+        }
+        else if (fh.type == FrameType::Delete) {
+            RecvSceneScope scope(this);
+            auto mes = DeleteMessagePtr(new DeleteMessage());
+            if (deserializeMessage(*mes, is, fh.size))
+                recvDelete(mes);
+            else
+                queueVersionNotMatchedMessage();
+        }
+        else if (fh.type == FrameType::Fence) {
+            auto mes = FenceMessagePtr(new FenceMessage());
+            if (deserializeMessage(*mes, is, fh.size))
+                recvFence(mes);
+            else
+                queueVersionNotMatchedMessage();
+        }
+        else if (fh.type == FrameType::MeshChunk) {
+            RecvSceneScope scope(this);
+            auto mes = MeshChunkMessagePtr(new MeshChunkMessage());
+            if (deserializeMessage(*mes, is, fh.size))
+                recvMeshChunk(mes);
+            else
+                queueVersionNotMatchedMessage();
+        }
+        else if (fh.type == FrameType::AnimationChunk) {
+            RecvSceneScope scope(this);
+            auto mes = AnimationChunkMessagePtr(new AnimationChunkMessage());
+            if (deserializeMessage(*mes, is, fh.size))
+                recvAnimationChunk(mes);
+            else
+                queueVersionNotMatchedMessage();
+        }
+        if (!buf.finish() && !m_shm_stop) {
+            // the writer died or gave up in the middle of the frame
+            msLogWarning("Server::processSharedMemory(): truncated frame\n");
+        }
+    }
+}
+
 void Server::clear()
 {
     lock_t lock(m_mutex);
     m_client_objs.clear();
+    m_materials.clear();
+    m_material_sessions.clear();
     m_recv_history.clear();
+    m_pending_fences.clear();
+    m_history_size = 0;
+    closeSpillFile();
+    {
+        lock_t l2(m_prefetch_mutex);
+        m_prefetch_queue.clear();
+    }
+    m_animation_streams.clear();
+    {
+        lock_t l2(m_chunk_mutex);
+        m_chunked_meshes.clear();
+    }
     m_host_scene.reset();
+    m_served_meshes.clear();
+    // clients that have sent materials as references must send them again
+    m_epoch = NewServerEpoch();
 }
 
 ServerSettings& Server::getSettings()
@@ -170,16 +518,74 @@ ServerSettings& Server::getSettings()
     return m_settings;
 }
 
+Profiler& Server::getProfiler()
+{
+    return m_profiler;
+}
+
+TextureCache& Server::getTextureCache()
+{
+    return m_texture_cache;
+}
+
+bool Server::deserializeMessage(Message& mes, std::istream& is, uint64_t size)
+{
+    auto begin = Now();
+    ProfiledIStreamBuf buf(is, size);
+    std::istream pis(&buf);
+    bool ret = mes.deserialize(pis);
+    auto elapsed = Now() - begin;
+
+    m_profiler.record(ProfileStage::Receive, buf.getReceiveTime(), buf.getReceivedBytes());
+    m_profiler.record(ProfileStage::Deserialize, elapsed - buf.getReceiveTime());
+    return ret;
+}
+
+Capabilities Server::getCapabilities() const
+{
+    auto ret = Capabilities::current();
+    ret.max_message_size = m_settings.max_message_size;
+    ret.split_unit = m_settings.mesh_split_unit;
+    ret.max_threads = m_settings.max_threads;
+    ret.features.shared_memory = m_shm ? 1 : 0;
+    ret.features.texture_cache = m_settings.texture_cache_size > 0 ? 1 : 0;
+    ret.framed_port = m_framed_port;
+    ret.framed_timeout_ms = m_settings.framed_timeout_ms;
+    ret.server_epoch = m_epoch;
+    return ret;
+}
+
 int Server::getNumMessages() const
 {
-    return (int)m_recv_history.size();
+    // pending fences are counted so that the host calls processMessages(), which queues them on timeout
+    return (int)(m_recv_history.size() + m_pending_fences.size());
 }
 
 int Server::processMessages(const MessageHandler& handler)
 {
     lock_t l(m_mutex);
+    // fences whose scenes never completed (e.g. the client died) are not kept forever
+    queuePendingFences(Now());
     for (auto& p : m_recv_history) {
-        if (auto get = std::dynamic_pointer_cast<GetMessage>(p)) {
+        auto begin = Now();
+        if (p->queued_time != 0)
+            m_profiler.record(ProfileStage::QueueWait, begin - p->queued_time);
+
+        if (auto spilled = std::dynamic_pointer_cast<SpilledMessage>(p)) {
+            // restored and converted by the prefetch thread while the messages before it were handled
+            if (auto set = takePrefetched(*spilled)) {
+                // replace the placeholders unless newer objects have been received for the paths
+                auto& objs = set->scene.objects;
+                for (size_t i = 0; i < objs.size() && i < spilled->objects.size(); ++i) {
+                    auto it = m_client_objs.find(objs[i]->path);
+                    if (it != m_client_objs.end() && it->second == spilled->objects[i])
+                        it->second = objs[i];
+                }
+                handler(Message::Type::Set, *set);
+            }
+            spilled->objects.clear();
+        }
+        else if (auto get = std::dynamic_pointer_cast<GetMessage>(p)) {
             m_current_get_request = get;
             handler(Message::Type::Get, *p);
             m_current_get_request = nullptr;
@@ -206,10 +612,13 @@ int Server::processMessages(const MessageHandler& handler)
         else if (auto q = std::dynamic_pointer_cast<QueryMessage>(p)) {
             handler(Message::Type::Query, *p);
         }
+        m_profiler.record(ProfileStage::Handler, Now() - begin);
     }
 
     int ret = (int)m_recv_history.size();
     m_recv_history.clear();
+    m_history_size = 0;
+    closeSpillFile();
     return ret;
 }
 
@@ -253,19 +662,51 @@ void Server::endServe()
         return;
     }
 
+    // the handler serves the whole scene on every request. a host that keeps its meshes across requests
+    // gets the refined results of the last request for the ones it has not touched since then.
     auto& request = *m_current_get_request;
-    parallel_for_each(m_host_scene->objects.begin(), m_host_scene->objects.end(), [&request](TransformPtr& p) {
-        auto pmesh = dynamic_cast<Mesh*>(p.get());
-        if (!pmesh)
-            return;
+    auto& objects = m_host_scene->objects;
+    std::vector<int> meshes, to_refine;
+    std::vector<MeshPtr> sources(objects.size());
+    for (int i = 0; i < (int)objects.size(); ++i) {
+        if (objects[i]->getType() != Entity::Type::Mesh)
+            continue;
+        meshes.push_back(i);
+
+        auto src = std::static_pointer_cast<Mesh>(objects[i]);
+        auto& mrs = src->refine_settings;
+        if (!src->flags.has_refine_settings || memcmp(&mrs.flags, &request.refine_settings.flags, sizeof(mrs.flags)) != 0 ||
+            mrs.scale_factor != request.refine_settings.scale_factor || mrs.smooth_angle != 180.0f)
+        {
+            src->flags.has_refine_settings = 1;
+            mrs.flags = request.refine_settings.flags;
+            mrs.scale_factor = request.refine_settings.scale_factor;
+            mrs.smooth_angle = 180.0f;
+            src->touch();
+        }
 
-        auto& mesh = *pmesh;
-        mesh.flags.has_refine_settings = 1;
-        mesh.refine_settings.flags = request.refine_settings.flags;
-        mesh.refine_settings.scale_factor = request.refine_settings.scale_factor;
-        mesh.refine_settings.smooth_angle = 180.0f;
-        mesh.refine(mesh.refine_settings);
+        auto it = m_served_meshes.find(src->path);
+        if (it != m_served_meshes.end() && it->second.source == src && it->second.generation == src->generation)
+            objects[i] = it->second.mesh;
+        else
+            to_refine.push_back(i);
+        sources[i] = src;
+    }
+    parallel_for_each(to_refine.begin(), to_refine.end(), [&](int i) {
+        // a mesh nobody else holds can't be served again, so it is refined in place.
+        auto& src = sources[i];
+        auto mesh = src.use_count() > 2 ? CloneMesh(*src) : src;
+        mesh->refine(mesh->refine_settings);
+        objects[i] = mesh;
     });
+
+    // only the meshes of this request are kept. ones that are no longer served are released.
+    ServedMeshes served;
+    served.reserve(meshes.size());
+    for (int i : meshes)
+        served[sources[i]->path] = { sources[i], sources[i]->generation, std::static_pointer_cast<Mesh>(objects[i]) };
+    m_served_meshes.swap(served);
+
     if (request.wait_flag) {
         *request.wait_flag = 0;
     }
@@ -285,6 +726,7 @@ void Server::queueVersionNotMatchedMessage()
 {
     lock_t l(m_mutex);
     auto txt = new TextMessage();
+    txt->queued_time = Now();
     txt->type = TextMessage::Type::Error;
     txt->text = "protocol version not matched";
     m_recv_history.emplace_back(txt);
@@ -297,6 +739,7 @@ Scene* Server::getHostScene()
 
 void Server::queueMessage(const MessagePtr& v)
 {
+    v->queued_time = Now();
     lock_t l(m_mutex);
     m_recv_history.push_back(v);
 }
@@ -306,57 +749,359 @@ void Server::recvSet(HTTPServerRequest &request, HTTPServerResponse &response)
 {
     RecvSceneScope scope(this);
 
+    if (m_settings.max_message_size != 0 && (uint64_t)request.getContentLength() > m_settings.max_message_size) {
+        msLogWarning("Server::recvSet(): message size exceeds limit (%llu bytes)\n", (unsigned long long)request.getContentLength());
+        RespondText(response, "");
+        return;
+    }
+
     auto mes = std::shared_ptr<SetMessage>(new SetMessage());
-    if (!mes->deserialize(request.stream())) {
+    if (!deserializeMessage(*mes, request.stream(), (uint64_t)request.getContentLength())) {
         queueVersionNotMatchedMessage();
         RespondText(response, "");
         return;
     }
+    recvSet(mes);
+    RespondText(response, "ok");
+}
+
+void Server::recvSet(const SetMessagePtr& mes)
+{
+    resolveTextures(mes->scene.textures);
+
+    uint64_t size = GetSetMessageSize(*mes);
+    if (m_settings.max_history_size != 0) {
+        bool spill = false;
+        {
+            lock_t l(m_mutex);
+            if (m_history_size + size > m_settings.max_history_size) {
+                // materials and textures are resolved now as they depend on what was received before.
+                // refinement and conversions are done when the message is read back.
+                resolveMaterials(mes->scene.materials);
+                spill = true;
+            }
+        }
+        if (spill && spillMessage(*mes))
+            return;
+    }
+
+    convertSet(*mes);
+    {
+        lock_t l(m_mutex);
+        for (auto& obj : mes->scene.objects) {
+            m_client_objs[obj->path] = obj;
+        }
+        resolveMaterials(mes->scene.materials);
+        mes->queued_time = Now();
+        m_recv_history.emplace_back(mes);
+        m_history_size += size;
+    }
+}
 
-    bool swap_x = mes->scene.settings.handedness == Handedness::Right || mes->scene.settings.handedness == Handedness::RightZUp;
-    bool swap_yz = mes->scene.settings.handedness == Handedness::LeftZUp || mes->scene.settings.handedness == Handedness::RightZUp;
-    parallel_for_each(mes->scene.objects.begin(), mes->scene.objects.end(), [this, &mes, swap_x, swap_yz](TransformPtr& obj) {
+void Server::convertSet(SetMessage& mes)
+{
+    bool swap_x = mes.scene.settings.handedness == Handedness::Right || mes.scene.settings.handedness == Handedness::RightZUp;
+    bool swap_yz = mes.scene.settings.handedness == Handedness::LeftZUp || mes.scene.settings.handedness == Handedness::RightZUp;
+    parallel_for_each(mes.scene.objects.begin(), mes.scene.objects.end(), [this, &mes, swap_x, swap_yz](TransformPtr& obj) {
+        Profiler::Scope pscope(&m_profiler);
         if(obj->getType() == Entity::Type::Mesh) {
             auto& mesh = (Mesh&)*obj;
-            mesh.refine_settings.scale_factor = 1.0f / mes->scene.settings.scale_factor;
+            mesh.refine_settings.scale_factor = 1.0f / mes.scene.settings.scale_factor;
             mesh.refine_settings.flags.swap_handedness = swap_x;
             mesh.refine_settings.flags.swap_yz = swap_yz;
             mesh.refine_settings.flags.triangulate = 1;
             mesh.refine_settings.flags.split = 1;
             mesh.refine_settings.flags.optimize_topology = 1;
             mesh.refine_settings.split_unit = m_settings.mesh_split_unit;
+            mesh.vertex_format = m_settings.vertex_format;
             mesh.refine(mesh.refine_settings);
         }
         else {
+            msProfileScope(Convert);
             if (swap_x || swap_yz) {
                 obj->convertHandedness(swap_x, swap_yz);
             }
-            if (mes->scene.settings.scale_factor != 1.0f) {
-                float scale = 1.0f / mes->scene.settings.scale_factor;
+            if (mes.scene.settings.scale_factor != 1.0f) {
+                float scale = 1.0f / mes.scene.settings.scale_factor;
                 obj->applyScaleFactor(scale);
             }
         }
     });
-    for (auto& clip : mes->scene.animations) {
-        parallel_for_each(clip->animations.begin(), clip->animations.end(), [this, &mes, swap_x, swap_yz](AnimationPtr& anim) {
-            if (swap_x || swap_yz) {
-                anim->convertHandedness(swap_x, swap_yz);
-            }
-            if (mes->scene.settings.scale_factor != 1.0f) {
-                float scale = 1.0f / mes->scene.settings.scale_factor;
-                anim->applyScaleFactor(scale);
+    for (auto& clip : mes.scene.animations)
+        convertAnimations(clip->animations, mes.scene.settings);
+}
+
+bool Server::spillMessage(const SetMessage& mes)
+{
+    {
+        lock_t l(m_spill_mutex);
+        if (m_spill_failed)
+            return false;
+    }
+
+    // serialized without locks. the spilled message is read back by this server. keep everything this build supports.
+    RawVector<char> data;
+    {
+        WireFormatScope scope(Capabilities::current().features);
+        data.reserve((size_t)GetSetMessageSize(mes));
+        VectorOStreamBuf buf(data);
+        std::ostream os(&buf);
+        mes.serialize(os);
+    }
+
+    // messages are located by offset, so the order in the file doesn't have to match m_recv_history
+    auto spilled = std::make_shared<SpilledMessage>();
+    uint64_t generation;
+    {
+        lock_t l(m_spill_mutex);
+        if (m_spill_failed)
+            return false;
+        if (!m_spill_file) {
+            m_spill_file = tmpfile();
+            m_spill_size = 0;
+            if (!m_spill_file) {
+                msLogWarning("Server::spillMessage(): failed to create temporary file\n");
+                m_spill_failed = true;
+                return false;
             }
-        });
+        }
+        if (!FileSeek(m_spill_file, m_spill_size) ||
+            fwrite(data.data(), 1, data.size(), m_spill_file) != data.size() || fflush(m_spill_file) != 0) {
+            // the messages spilled so far are still readable. the rest are kept in memory until the history is processed.
+            msLogWarning("Server::spillMessage(): failed to write (disk full?)\n");
+            m_spill_failed = true;
+            return false;
+        }
+        spilled->offset = m_spill_size;
+        m_spill_size += data.size();
+        generation = m_spill_generation;
     }
 
+    spilled->protocol_version = mes.protocol_version;
+    spilled->queued_time = Now();
+    spilled->generation = generation;
+    // meshes are registered as placeholders without data, so that the spilled data is not kept in memory
+    spilled->objects.reserve(mes.scene.objects.size());
+    for (auto& obj : mes.scene.objects) {
+        if (obj->getType() == Entity::Type::Mesh) {
+            auto placeholder = Mesh::create();
+            placeholder->id = obj->id;
+            placeholder->path = obj->path;
+            spilled->objects.push_back(placeholder);
+        }
+        else {
+            spilled->objects.push_back(obj);
+        }
+    }
     {
         lock_t l(m_mutex);
-        for (auto& obj : mes->scene.objects) {
+        // the history may have been processed and the file closed in the meantime
+        if (generation != m_spill_generation)
+            return false;
+        for (auto& obj : spilled->objects) {
             m_client_objs[obj->path] = obj;
         }
-        m_recv_history.emplace_back(mes);
+        m_recv_history.push_back(spilled);
+
+        lock_t l2(m_prefetch_mutex);
+        if (!m_prefetch_thread.joinable()) {
+            m_prefetch_stop = false;
+            m_prefetch_thread = std::thread([this]() { prefetchSpilledMessages(); });
+        }
+        m_prefetch_queue.push_back(spilled);
+        m_prefetch_cond.notify_all();
     }
-    RespondText(response, "ok");
+    ++m_num_spilled;
+    return true;
+}
+
+SetMessagePtr Server::restoreMessage(const SpilledMessage& spilled)
+{
+    auto ret = SetMessagePtr(new SetMessage());
+    {
+        lock_t l(m_spill_mutex);
+        // the file may have been closed by clear() and reopened since
+        if (!m_spill_file || spilled.generation != m_spill_generation)
+            return nullptr;
+        FileStreamBuf buf(m_spill_file);
+        std::istream is(&buf);
+        if (!FileSeek(m_spill_file, spilled.offset) || !ret->deserialize(is) || !is) {
+            msLogWarning("Server::restoreMessage(): failed to read\n");
+            return nullptr;
+        }
+    }
+    ret->protocol_version = spilled.protocol_version;
+    ret->queued_time = spilled.queued_time;
+    convertSet(*ret);
+    return ret;
+}
+
+void Server::prefetchSpilledMessages()
+{
+    lock_t l(m_prefetch_mutex);
+    for (;;) {
+        SpilledMessagePtr target;
+        m_prefetch_cond.wait(l, [this, &target]() {
+            if (m_prefetch_stop)
+                return true;
+            int n = 0;
+            for (auto& spilled : m_prefetch_queue) {
+                if (n++ == SpillPrefetchWindow)
+                    break;
+                if (!spilled->prefetching) {
+                    target = spilled;
+                    return true;
+                }
+            }
+            return false;
+        });
+        if (m_prefetch_stop)
+            break;
+
+        target->prefetching = true;
+        l.unlock();
+        auto set = restoreMessage(*target);
+        l.lock();
+        target->restored = set;
+        target->prefetched = true;
+        m_prefetch_cond.notify_all();
+    }
+}
+
+SetMessagePtr Server::takePrefetched(SpilledMessage& spilled)
+{
+    lock_t l(m_prefetch_mutex);
+    if (m_prefetch_queue.empty() || m_prefetch_queue.front().get() != &spilled)
+        return nullptr;
+    m_prefetch_cond.wait(l, [&spilled]() { return spilled.prefetched; });
+    auto ret = std::move(spilled.restored);
+    m_prefetch_queue.pop_front();
+    // let the prefetch thread go on to the next one in the window
+    m_prefetch_cond.notify_all();
+    return ret;
+}
+
+void Server::stopPrefetch()
+{
+    {
+        lock_t l(m_prefetch_mutex);
+        m_prefetch_stop = true;
+        m_prefetch_cond.notify_all();
+    }
+    if (m_prefetch_thread.joinable())
+        m_prefetch_thread.join();
+}
+
+void Server::closeSpillFile()
+{
+    // the temporary file is deleted on close
+    lock_t l(m_spill_mutex);
+    if (m_spill_file) {
+        fclose(m_spill_file);
+        m_spill_file = nullptr;
+    }
+    m_spill_size = 0;
+    m_spill_failed = false;
+    ++m_spill_generation;
+}
+
+int Server::getNumSpilledMessages() const
+{
+    return m_num_spilled;
+}
+
+void Server::resolveMaterials(std::vector<MaterialPtr>& materials)
+{
+    expireMaterials(Now());
+    if (materials.empty())
+        return;
+
+    // the handler receives complete material lists as before. ids are per client, so materials are looked up
+    // by (session, id). materials without a session come from clients that never send references and are not kept.
+    uint64_t session = materials.front()->session;
+    size_t n = 0;
+    for (auto& mat : materials) {
+        if (mat->isReference()) {
+            auto it = m_materials.find({ mat->session, mat->id });
+            if (it == m_materials.end()) {
+                msLogWarning("Server::resolveMaterials(): %s is not received yet\n", mat->name.c_str());
+                continue;
+            }
+            mat = it->second;
+        }
+        materials[n++] = mat;
+    }
+    materials.resize(n);
+    if (session == 0)
+        return;
+
+    // lists are complete. materials the client no longer has are dropped.
+    m_materials.erase(m_materials.lower_bound({ session, std::numeric_limits<int>::min() }),
+        m_materials.upper_bound({ session, std::numeric_limits<int>::max() }));
+    for (auto& mat : materials) {
+        if (mat->session == session)
+            m_materials[{ session, mat->id }] = mat;
+    }
+    m_material_sessions[session] = Now();
+}
+
+void Server::expireMaterials(nanosec now)
+{
+    if (m_settings.material_timeout_ms <= 0)
+        return;
+    auto timeout = (nanosec)m_settings.material_timeout_ms * 1000000;
+    for (auto it = m_material_sessions.begin(); it != m_material_sessions.end(); ) {
+        if (now - it->second > timeout) {
+            m_materials.erase(m_materials.lower_bound({ it->first, std::numeric_limits<int>::min() }),
+                m_materials.upper_bound({ it->first, std::numeric_limits<int>::max() }));
+            it = m_material_sessions.erase(it);
+        }
+        else
+            ++it;
+    }
+}
+
+void Server::resolveTextures(std::vector<TexturePtr>& textures)
+{
+    if (textures.empty())
+        return;
+
+    std::vector<TexturePtr> received;
+    for (auto& tex : textures) {
+        if (!tex->data.empty())
+            received.push_back(tex);
+    }
+
+    // resolve references before adding received textures. adding may evict referenced ones.
+    parallel_for_each(textures.begin(), textures.end(), [this](TexturePtr& tex) {
+        if (tex->isReference() && !m_texture_cache.resolve(*tex))
+            msLogWarning("Server::resolveTextures(): %s is not in the cache\n", tex->name.c_str());
+    });
+    if (m_settings.texture_cache_size > 0) {
+        parallel_for_each(received.begin(), received.end(), [](TexturePtr& tex) {
+            if (tex->hash == 0)
+                tex->updateHash();
+        });
+        for (auto& tex : received)
+            m_texture_cache.add(tex);
+    }
+}
+
+void Server::convertAnimations(std::vector<AnimationPtr>& animations, const SceneSettings& settings)
+{
+    bool swap_x = settings.handedness == Handedness::Right || settings.handedness == Handedness::RightZUp;
+    bool swap_yz = settings.handedness == Handedness::LeftZUp || settings.handedness == Handedness::RightZUp;
+    parallel_for_each(animations.begin(), animations.end(), [this, &settings, swap_x, swap_yz](AnimationPtr& anim) {
+        Profiler::Scope pscope(&m_profiler);
+        msProfileScope(Convert);
+        if (swap_x || swap_yz) {
+            anim->convertHandedness(swap_x, swap_yz);
+        }
+        if (settings.scale_factor != 1.0f) {
+            float scale = 1.0f / settings.scale_factor;
+            anim->applyScaleFactor(scale);
+        }
+    });
 }
 
 void Server::recvDelete(HTTPServerRequest &request, HTTPServerResponse &response)
@@ -364,40 +1109,254 @@ void Server::recvDelete(HTTPServerRequest &request, HTTPServerResponse &response
     RecvSceneScope scope(this);
 
     auto mes = std::shared_ptr<DeleteMessage>(new DeleteMessage());
-    if (!mes->deserialize(request.stream())) {
+    if (!deserializeMessage(*mes, request.stream(), (uint64_t)request.getContentLength())) {
         queueVersionNotMatchedMessage();
         RespondText(response, "");
         return;
     }
-    queueMessage(mes);
+    recvDelete(mes);
     RespondText(response, "ok");
 }
 
+void Server::recvDelete(const DeleteMessagePtr& mes)
+{
+    queueMessage(mes);
+}
+
+void Server::recvMeshChunk(HTTPServerRequest &request, HTTPServerResponse &response)
+{
+    RecvSceneScope scope(this);
+
+    auto mes = MeshChunkMessagePtr(new MeshChunkMessage());
+    if (!deserializeMessage(*mes, request.stream(), (uint64_t)request.getContentLength())) {
+        queueVersionNotMatchedMessage();
+        RespondText(response, "");
+        return;
+    }
+    RespondText(response, recvMeshChunk(mes) ? "ok" : "");
+}
+
+bool Server::recvMeshChunk(const MeshChunkMessagePtr& mes)
+{
+    using Attribute = MeshChunkMessage::Attribute;
+
+    auto now = Now();
+    if (mes->attribute == Attribute::Header) {
+        lock_t l(m_chunk_mutex);
+        expireChunkedMeshes(now);
+        auto& dst = m_chunked_meshes[mes->transfer_id];
+        dst.scene_settings = mes->scene_settings;
+        dst.flags = mes->flags;
+        dst.mesh = mes->mesh;
+        dst.last_update = now;
+        return true;
+    }
+    else if (mes->attribute == Attribute::End) {
+        ChunkedMesh cm;
+        {
+            lock_t l(m_chunk_mutex);
+            auto it = m_chunked_meshes.find(mes->transfer_id);
+            if (it == m_chunked_meshes.end())
+                return false;
+            cm = std::move(it->second);
+            m_chunked_meshes.erase(it);
+        }
+
+        // handle the complete mesh as if it is sent by SetMessage
+        cm.mesh->flags = cm.flags;
+        cm.mesh->flags.compact_indices = 0; // indices have been received in 32 bit
+        auto set = SetMessagePtr(new SetMessage());
+        set->protocol_version = mes->protocol_version;
+        set->scene.settings = cm.scene_settings;
+        set->scene.objects.push_back(cm.mesh);
+        recvSet(set);
+        return true;
+    }
+    else {
+        // copy the chunk into place. memory usage of a transfer is the mesh itself + one chunk.
+        lock_t l(m_chunk_mutex);
+        auto it = m_chunked_meshes.find(mes->transfer_id);
+        if (it == m_chunked_meshes.end())
+            return false;
+
+        it->second.last_update = now;
+        auto& mesh = *it->second.mesh;
+        auto elem_size = MeshChunkMessage::getElementSize(mes->attribute);
+        // the counts come from the wire. none of the products below may overflow.
+        if (elem_size == 0 || mes->total_count > SIZE_MAX / elem_size || mes->offset > mes->total_count) {
+            msLogWarning("Server::recvMeshChunk(): chunk out of range\n");
+            return false;
+        }
+        auto dst = MeshChunkMessage::getAttribute(mesh, mes->attribute);
+        if (dst.size() != mes->total_count * elem_size) {
+            MeshChunkMessage::resizeAttribute(mesh, mes->attribute, mes->total_count);
+            dst = MeshChunkMessage::getAttribute(mesh, mes->attribute);
+        }
+        uint64_t begin = mes->offset * elem_size;
+        if (begin > dst.size() || mes->data.size() > dst.size() - begin) {
+            msLogWarning("Server::recvMeshChunk(): chunk out of range\n");
+            return false;
+        }
+        memcpy(dst.data() + begin, mes->data.data(), mes->data.size());
+        return true;
+    }
+}
+
+void Server::expireChunkedMeshes(nanosec now)
+{
+    if (m_settings.transfer_timeout_ms <= 0)
+        return;
+    auto timeout = (nanosec)m_settings.transfer_timeout_ms * 1000000;
+    for (auto it = m_chunked_meshes.begin(); it != m_chunked_meshes.end(); ) {
+        if (now - it->second.last_update > timeout) {
+            msLogWarning("Server::recvMeshChunk(): transfer %llu timed out\n", (unsigned long long)it->first);
+            it = m_chunked_meshes.erase(it);
+        }
+        else
+            ++it;
+    }
+}
+
+void Server::expireAnimationStreams(nanosec now)
+{
+    if (m_settings.transfer_timeout_ms <= 0)
+        return;
+    auto timeout = (nanosec)m_settings.transfer_timeout_ms * 1000000;
+    for (auto it = m_animation_streams.begin(); it != m_animation_streams.end(); ) {
+        if (it->second.clip && now - it->second.last_update > timeout) {
+            msLogWarning("Server::recvAnimationChunk(): transfer %llu timed out\n", (unsigned long long)it->first);
+            it = m_animation_streams.erase(it);
+        }
+        else
+            ++it;
+    }
+}
+
+void Server::recvAnimationChunk(HTTPServerRequest &request, HTTPServerResponse &response)
+{
+    RecvSceneScope scope(this);
+
+    auto mes = AnimationChunkMessagePtr(new AnimationChunkMessage());
+    if (!deserializeMessage(*mes, request.stream(), (uint64_t)request.getContentLength())) {
+        queueVersionNotMatchedMessage();
+        RespondText(response, "");
+        return;
+    }
+    RespondText(response, recvAnimationChunk(mes) ? "ok" : "");
+}
+
+bool Server::recvAnimationChunk(const AnimationChunkMessagePtr& mes)
+{
+    convertAnimations(mes->animations, mes->scene_settings);
+
+    auto now = Now();
+    lock_t l(m_mutex);
+    auto& stream = m_animation_streams[mes->transfer_id];
+    if (!stream.clip) {
+        expireAnimationStreams(now);
+        stream.clip = AnimationClip::create();
+        stream.clip->name = mes->clip;
+    }
+    stream.last_update = now;
+    ++stream.num_chunks;
+
+    // the first chunk of each path becomes the destination. following chunks are appended to it.
+    bool ret = true;
+    for (auto& anim : mes->animations) {
+        auto& dst = stream.animations[anim->path];
+        if (!dst) {
+            dst = anim;
+            stream.clip->animations.push_back(anim);
+        }
+        else if (dst->getType() == anim->getType()) {
+            dst->append(*anim);
+        }
+        else {
+            msLogWarning("Server::recvAnimationChunk(): type mismatch (%s)\n", anim->path.c_str());
+            ret = false;
+        }
+    }
+    if (mes->last)
+        stream.clip->reduction();
+
+    // the handler always sees the whole clip received so far. chunks that arrive before it runs
+    // are merged into the already queued message instead of queuing the clip again.
+    // once it has been handled, the clip is queued again only when it has doubled (or is complete).
+    // the handler imports the whole clip each time, so queuing on every chunk would be quadratic.
+    bool pending = stream.queued && std::find(m_recv_history.begin(), m_recv_history.end(), stream.queued) != m_recv_history.end();
+    if (!pending && (mes->last || stream.num_chunks >= stream.num_queued_chunks * 2)) {
+        auto set = SetMessagePtr(new SetMessage());
+        set->protocol_version = mes->protocol_version;
+        set->queued_time = Now();
+        set->scene.settings = mes->scene_settings;
+        set->scene.animations.push_back(stream.clip);
+        m_recv_history.push_back(set);
+        stream.queued = set;
+        stream.num_queued_chunks = stream.num_chunks;
+    }
+    if (mes->last)
+        m_animation_streams.erase(mes->transfer_id);
+    return ret;
+}
+
 void Server::recvFence(HTTPServerRequest &request, HTTPServerResponse &response)
 {
     auto mes = std::shared_ptr<FenceMessage>(new FenceMessage());
-    if (!mes->deserialize(request.stream())) {
+    if (!deserializeMessage(*mes, request.stream(), (uint64_t)request.getContentLength())) {
         queueVersionNotMatchedMessage();
         RespondText(response, "");
         return;
     }
+    recvFence(mes);
+    RespondText(response, "ok");
+}
 
+void Server::recvFence(const FenceMessagePtr& mes)
+{
     if (mes->type == FenceMessage::FenceType::SceneBegin) {
         ++m_request_count;
     }
     else if (mes->type == FenceMessage::FenceType::SceneEnd) {
-        --m_request_count;
-
-        // wait for complete (or timeout) queuing set and delete messages
-        for (int i = 0; i < 500; ++i) {
-            if (m_request_count.load() == 0) {
-                break;
-            }
-            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        // the fence must be queued after the set and delete messages being received.
+        // the receiving thread doesn't wait for them (the shared memory thread serves all clients).
+        // the last RecvSceneScope queues it instead.
+        auto now = Now();
+        lock_t l(m_mutex);
+        if (--m_request_count > 0) {
+            m_pending_fences.push_back({ mes, now + (nanosec)FenceTimeoutMS * 1000000 });
+            return;
         }
+        queuePendingFences(0);
+        mes->queued_time = now;
+        m_recv_history.push_back(mes);
+        return;
     }
     queueMessage(mes);
-    RespondText(response, "ok");
+}
+
+void Server::endRecvScene()
+{
+    if (--m_request_count > 0)
+        return;
+    lock_t l(m_mutex);
+    // checked again under the lock. recvFence() decides whether to keep a fence pending under it.
+    if (m_request_count.load() <= 0)
+        queuePendingFences(0);
+}
+
+void Server::queuePendingFences(nanosec now)
+{
+    auto queued_time = Now();
+    for (auto it = m_pending_fences.begin(); it != m_pending_fences.end(); ) {
+        if (now == 0 || it->deadline <= now) {
+            it->mes->queued_time = queued_time;
+            m_recv_history.push_back(it->mes);
+            it = m_pending_fences.erase(it);
+        }
+        else {
+            ++it;
+        }
+    }
 }
 
 void Server::recvText(HTTPServerRequest &request, HTTPServerResponse &response)
@@ -406,7 +1365,7 @@ void Server::recvText(HTTPServerRequest &request, HTTPServerResponse &response)
 
     auto mes = std::shared_ptr<TextMessage>(new TextMessage());
     if (request.getURI() == "text") {
-        mes->deserialize(request.stream());
+        deserializeMessage(*mes, request.stream(), (uint64_t)request.getContentLength());
     }
     else if (request.getMethod() == HTTPServerRequest::HTTP_GET) {
         auto& uri = request.getURI();
@@ -445,23 +1404,12 @@ void Server::recvText(HTTPServerRequest &request, HTTPServerResponse &response)
 void Server::recvGet(HTTPServerRequest &request, HTTPServerResponse &response)
 {
     auto mes = std::shared_ptr<GetMessage>(new GetMessage());
-    if (!mes->deserialize(request.stream())) {
+    if (!deserializeMessage(*mes, request.stream(), (uint64_t)request.getContentLength())) {
         queueVersionNotMatchedMessage();
         RespondText(response, "");
         return;
     }
-    mes->wait_flag.reset(new std::atomic_int(1));
-
-    // queue request
-    queueMessage(mes);
-
-    // wait for data arrive (or timeout)
-    for (int i = 0; i < 300; ++i) {
-        if (*mes->wait_flag == 0) {
-            break;
-        }
-        std::this_thread::sleep_for(std::chrono::milliseconds(10));
-    }
+    recvGet(mes);
 
     // serve data
     {
@@ -481,10 +1429,8 @@ void Server::recvGet(HTTPServerRequest &request, HTTPServerResponse &response)
     }
 }
 
-void Server::recvScreenshot(HTTPServerRequest &request, HTTPServerResponse &response)
+void Server::recvGet(const GetMessagePtr& mes)
 {
-    auto mes = std::shared_ptr<ScreenshotMessage>(new ScreenshotMessage());
-    mes->deserialize(request.stream());
     mes->wait_flag.reset(new std::atomic_int(1));
 
     // queue request
@@ -497,18 +1443,13 @@ void Server::recvScreenshot(HTTPServerRequest &request, HTTPServerResponse &resp
         }
         std::this_thread::sleep_for(std::chrono::milliseconds(10));
     }
-
-    // serve data
-    response.set("Cache-Control", "no-store, must-revalidate");
-    response.sendFile(m_screenshot_file_path, "image/png");
 }
 
-void Server::recvQuery(Poco::Net::HTTPServerRequest & request, Poco::Net::HTTPServerResponse & response)
+void Server::recvScreenshot(HTTPServerRequest &request, HTTPServerResponse &response)
 {
-    auto mes = QueryMessagePtr(new QueryMessage());
-    mes->deserialize(request.stream());
+    auto mes = std::shared_ptr<ScreenshotMessage>(new ScreenshotMessage());
+    deserializeMessage(*mes, request.stream(), (uint64_t)request.getContentLength());
     mes->wait_flag.reset(new std::atomic_int(1));
-    mes->response = ResponseMessagePtr(new ResponseMessage());
 
     // queue request
     queueMessage(mes);
@@ -521,6 +1462,17 @@ void Server::recvQuery(Poco::Net::HTTPServerRequest & request, Poco::Net::HTTPSe
         std::this_thread::sleep_for(std::chrono::milliseconds(10));
     }
 
+    // serve data
+    response.set("Cache-Control", "no-store, must-revalidate");
+    response.sendFile(m_screenshot_file_path, "image/png");
+}
+
+void Server::recvQuery(Poco::Net::HTTPServerRequest & request, Poco::Net::HTTPServerResponse & response)
+{
+    auto mes = QueryMessagePtr(new QueryMessage());
+    deserializeMessage(*mes, request.stream(), (uint64_t)request.getContentLength());
+    recvQuery(mes);
+
     // serve data
     if (mes->response) {
         response.setContentType("application/octet-stream");
@@ -541,5 +1493,203 @@ void Server::recvQuery(Poco::Net::HTTPServerRequest & request, Poco::Net::HTTPSe
     }
 }
 
+void Server::recvQuery(const QueryMessagePtr& mes)
+{
+    mes->wait_flag.reset(new std::atomic_int(1));
+    mes->response = ResponseMessagePtr(new ResponseMessage());
+
+    // queue request
+    queueMessage(mes);
+
+    // wait for data arrive (or timeout)
+    for (int i = 0; i < 300; ++i) {
+        if (*mes->wait_flag == 0) {
+            break;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+}
+
+void Server::recvHandshake(HTTPServerRequest &request, HTTPServerResponse &response)
+{
+    // respond immediately. unlike other requests, this doesn't involve the main thread.
+    HandshakeMessage mes;
+    if (!deserializeMessage(mes, request.stream(), (uint64_t)request.getContentLength())) {
+        RespondText(response, "");
+        return;
+    }
+
+    HandshakeMessage ret;
+    ret.caps = getCapabilities();
+    if (!Capabilities::negotiate(mes.caps, ret.caps).isCompatible()) {
+        queueVersionNotMatchedMessage();
+    }
+
+    response.setContentType("application/octet-stream");
+    response.setContentLength(ret.getSerializeSize());
+    auto& os = response.send();
+    ret.serialize(os);
+    os.flush();
+}
+
+void Server::recvTextureQuery(HTTPServerRequest &request, HTTPServerResponse &response)
+{
+    // respond immediately like handshake
+    TextureQueryMessage mes;
+    if (!deserializeMessage(mes, request.stream(), (uint64_t)request.getContentLength())) {
+        RespondText(response, "");
+        return;
+    }
+
+    TextureQueryMessage ret;
+    recvTextureQuery(mes, ret);
+    response.setContentType("application/octet-stream");
+    response.setContentLength(ret.getSerializeSize());
+    auto& os = response.send();
+    ret.serialize(os);
+    os.flush();
+}
+
+void Server::recvTextureQuery(const TextureQueryMessage& mes, TextureQueryMessage& ret)
+{
+    if (m_settings.texture_cache_size > 0)
+        m_texture_cache.query(mes.hashes, ret.hashes);
+}
+
+void Server::recvStats(HTTPServerRequest &request, HTTPServerResponse &response)
+{
+    // "/stats?reset" resets counters after responding
+    RespondText(response, m_profiler.toString());
+    if (request.getURI().find("reset") != std::string::npos)
+        m_profiler.reset();
+}
+
+bool Server::recvFrame(const FrameHeader& header, std::istream& is, std::ostream& os)
+{
+    auto respond = [&](FrameType type, const Message *body) {
+        FrameHeader ret;
+        ret.type = type;
+        ret.request_id = header.request_id;
+        ret.size = body ? body->getSerializeSize() : 0;
+        os.write((const char*)&ret, sizeof(ret));
+        if (body)
+            body->serialize(os);
+    };
+    auto reject = [&]() {
+        // the payload can't be skipped reliably once deserialize() failed. close the connection.
+        queueVersionNotMatchedMessage();
+        respond(FrameType::Error, nullptr);
+        return false;
+    };
+
+    if (!isServing() || (m_settings.max_message_size != 0 && header.size > m_settings.max_message_size)) {
+        is.ignore((std::streamsize)header.size);
+        respond(FrameType::Error, nullptr);
+        return is.good();
+    }
+
+    switch (header.type) {
+    case FrameType::Set:
+    {
+        RecvSceneScope scope(this);
+        auto mes = SetMessagePtr(new SetMessage());
+        if (!deserializeMessage(*mes, is, header.size))
+            return reject();
+        recvSet(mes);
+        respond(FrameType::Ack, nullptr);
+        break;
+    }
+    case FrameType::Delete:
+    {
+        RecvSceneScope scope(this);
+        auto mes = DeleteMessagePtr(new DeleteMessage());
+        if (!deserializeMessage(*mes, is, header.size))
+            return reject();
+        recvDelete(mes);
+        respond(FrameType::Ack, nullptr);
+        break;
+    }
+    case FrameType::Fence:
+    {
+        auto mes = FenceMessagePtr(new FenceMessage());
+        if (!deserializeMessage(*mes, is, header.size))
+            return reject();
+        recvFence(mes);
+        respond(FrameType::Ack, nullptr);
+        break;
+    }
+    case FrameType::MeshChunk:
+    {
+        RecvSceneScope scope(this);
+        auto mes = MeshChunkMessagePtr(new MeshChunkMessage());
+        if (!deserializeMessage(*mes, is, header.size))
+            return reject();
+        respond(recvMeshChunk(mes) ? FrameType::Ack : FrameType::Error, nullptr);
+        break;
+    }
+    case FrameType::AnimationChunk:
+    {
+        RecvSceneScope scope(this);
+        auto mes = AnimationChunkMessagePtr(new AnimationChunkMessage());
+        if (!deserializeMessage(*mes, is, header.size))
+            return reject();
+        respond(recvAnimationChunk(mes) ? FrameType::Ack : FrameType::Error, nullptr);
+        break;
+    }
+    case FrameType::Get:
+    {
+        auto mes = GetMessagePtr(new GetMessage());
+        if (!deserializeMessage(*mes, is, header.size))
+            return reject();
+        recvGet(mes);
+
+        lock_t l(m_mutex);
+        FrameHeader ret;
+        ret.type = FrameType::Ack;
+        ret.request_id = header.request_id;
+        ret.size = m_host_scene ? m_host_scene->getSerializeSize() : 0;
+        os.write((const char*)&ret, sizeof(ret));
+        if (m_host_scene)
+            m_host_scene->serialize(os);
+        break;
+    }
+    case FrameType::Query:
+    {
+        auto mes = QueryMessagePtr(new QueryMessage());
+        if (!deserializeMessage(*mes, is, header.size))
+            return reject();
+        recvQuery(mes);
+        respond(FrameType::Ack, mes->response.get());
+        mes->response.reset();
+        break;
+    }
+    case FrameType::Handshake:
+    {
+        HandshakeMessage mes;
+        if (!mes.deserialize(is))
+            return false;
+        HandshakeMessage ret;
+        ret.caps = getCapabilities();
+        respond(FrameType::Ack, &ret);
+        break;
+    }
+    case FrameType::TextureQuery:
+    {
+        TextureQueryMessage mes;
+        if (!deserializeMessage(mes, is, header.size))
+            return reject();
+        TextureQueryMessage ret;
+        recvTextureQuery(mes, ret);
+        respond(FrameType::Ack, &ret);
+        break;
+    }
+    default:
+        is.ignore((std::streamsize)header.size);
+        respond(FrameType::Error, nullptr);
+        break;
+    }
+    return is.good() && os.good();
+}
+
 } // namespace ms
 
@@ -3,12 +3,16 @@
 #include <map>
 #include <mutex>
 #include "msProtocol.h"
+#include "msSharedMemory.h"
+#include "msProfiling.h"
+#include "msTextureCache.h"
 
 namespace Poco {
     namespace Net {
         class HTTPServer;
         class HTTPServerRequest;
         class HTTPServerResponse;
+        class TCPServer;
     }
 }
 
@@ -21,6 +25,14 @@ struct ServerSettings
     int max_threads = 8;
     uint16_t port = 8080;
     uint32_t mesh_split_unit = 0xffffffff;
+    uint64_t max_message_size = 0; // 0: unlimited
+    uint32_t shared_memory_size = 64 * 1024 * 1024; // 0: disable shared memory transport
+    uint64_t texture_cache_size = 512 * 1024 * 1024; // 0: disable texture cache
+    uint64_t max_history_size = 1024 * 1024 * 1024; // bytes of received scenes kept in memory until processMessages(). the rest are spilled to a temporary file. 0: unlimited
+    VertexFormat vertex_format = VertexFormat::Unknown; // if set, received meshes also have interleaved vertices. see Mesh::vertices
+    int transfer_timeout_ms = 60000; // chunked transfers that receive nothing for this long are dropped. 0: never
+    int material_timeout_ms = 10 * 60 * 1000; // materials of sessions that send none for this long are dropped. must be longer than MaterialCache::SessionLifetimeMS. 0: never
+    int framed_timeout_ms = 60000; // framed connections that send nothing for this long are closed. they occupy threads of max_threads. 0: never
 };
 
 class Server
@@ -33,11 +45,17 @@ public:
     void stop();
     void clear();
     ServerSettings& getSettings();
+    Capabilities getCapabilities() const;
+    Profiler& getProfiler();
+    TextureCache& getTextureCache();
 
     using MessageHandler = std::function<void(Message::Type type, Message& data)>;
     int getNumMessages() const;
     int processMessages(const MessageHandler& handler);
 
+    // number of messages that have been spilled to disk since the server started
+    int getNumSpilledMessages() const;
+
     void setServe(bool v);
     bool isServing() const;
 
@@ -53,41 +71,177 @@ public:
     void recvSet(Poco::Net::HTTPServerRequest &request, Poco::Net::HTTPServerResponse &response);
     void recvDelete(Poco::Net::HTTPServerRequest &request, Poco::Net::HTTPServerResponse &response);
     void recvFence(Poco::Net::HTTPServerRequest &request, Poco::Net::HTTPServerResponse &response);
+    void recvMeshChunk(Poco::Net::HTTPServerRequest &request, Poco::Net::HTTPServerResponse &response);
+    void recvAnimationChunk(Poco::Net::HTTPServerRequest &request, Poco::Net::HTTPServerResponse &response);
+    // transport independent part. called after the message is deserialized.
+    void recvSet(const SetMessagePtr& mes);
+    void recvDelete(const DeleteMessagePtr& mes);
+    void recvFence(const FenceMessagePtr& mes);
+    bool recvMeshChunk(const MeshChunkMessagePtr& mes);
+    bool recvAnimationChunk(const AnimationChunkMessagePtr& mes);
+    void recvGet(const GetMessagePtr& mes);
+    void recvQuery(const QueryMessagePtr& mes);
+    void recvTextureQuery(const TextureQueryMessage& mes, TextureQueryMessage& ret);
+    // handle a request of the framed transport. returns false if the connection should be closed.
+    bool recvFrame(const FrameHeader& header, std::istream& is, std::ostream& os);
     void recvText(Poco::Net::HTTPServerRequest &request, Poco::Net::HTTPServerResponse &response);
     void recvGet(Poco::Net::HTTPServerRequest &request, Poco::Net::HTTPServerResponse &response);
     void recvScreenshot(Poco::Net::HTTPServerRequest &request, Poco::Net::HTTPServerResponse &response);
     void recvQuery(Poco::Net::HTTPServerRequest &request, Poco::Net::HTTPServerResponse &response);
+    void recvHandshake(Poco::Net::HTTPServerRequest &request, Poco::Net::HTTPServerResponse &response);
+    void recvTextureQuery(Poco::Net::HTTPServerRequest &request, Poco::Net::HTTPServerResponse &response);
+    void recvStats(Poco::Net::HTTPServerRequest &request, Poco::Net::HTTPServerResponse &response);
 
     struct RecvSceneScope
     {
         RecvSceneScope(Server *v) : m_server(v) { ++m_server->m_request_count; }
-        ~RecvSceneScope() { --m_server->m_request_count; }
+        ~RecvSceneScope() { m_server->endRecvScene(); }
         Server *m_server = nullptr;
     };
 
 private:
+    // deserialize and record Receive / Deserialize time
+    bool deserializeMessage(Message& mes, std::istream& is, uint64_t size);
+    // restore referenced textures from the cache and cache textures that have data
+    void resolveTextures(std::vector<TexturePtr>& textures);
+    // replace material references with the ones received before in the same session, and record the list
+    // as the materials of the session. m_mutex must be locked.
+    void resolveMaterials(std::vector<MaterialPtr>& materials);
+    // drop the materials of sessions that have ended. m_mutex must be locked.
+    void expireMaterials(nanosec now);
+    // called when a RecvSceneScope ends. queues the pending fences if nothing is being received anymore.
+    void endRecvScene();
+    // queue pending fences whose deadline is before now. all of them if now is 0. m_mutex must be locked.
+    void queuePendingFences(nanosec now);
+    // placeholder of a SetMessage in the spill file
+    class SpilledMessage : public Message
+    {
+    public:
+        uint64_t offset = 0; // in the spill file
+        uint64_t generation = 0; // m_spill_generation when written
+        std::vector<EntityPtr> objects; // registered in m_client_objs on behalf of the spilled ones
+
+        // set by the prefetch thread. guarded by m_prefetch_mutex
+        bool prefetching = false;
+        bool prefetched = false;
+        SetMessagePtr restored; // null if reading failed
+    };
+    using SpilledMessagePtr = std::shared_ptr<SpilledMessage>;
+
+    // refinement, handedness and scale conversion of received scenes
+    void convertSet(SetMessage& mes);
+    // write a not yet converted message to the spill file and queue a placeholder. m_mutex must not be locked.
+    bool spillMessage(const SetMessage& mes);
+    // read a message from the spill file and convert it. called by the prefetch thread without m_mutex.
+    SetMessagePtr restoreMessage(const SpilledMessage& spilled);
+    // body of m_prefetch_thread. restores spilled messages ahead of processMessages()
+    void prefetchSpilledMessages();
+    // wait until the prefetch thread has restored spilled, and take the result. spilled must be the first in m_prefetch_queue.
+    SetMessagePtr takePrefetched(SpilledMessage& spilled);
+    void stopPrefetch();
+    // m_mutex must be locked.
+    void closeSpillFile();
+    // handedness and scale conversion of animations received by SetMessage or AnimationChunkMessage
+    void convertAnimations(std::vector<AnimationPtr>& animations, const SceneSettings& settings);
+    bool startFramedServer();
+    bool startSharedMemory();
+    void stopSharedMemory();
+    void processSharedMemory();
+    // drop chunked transfers the client gave up on. m_chunk_mutex must be locked.
+    void expireChunkedMeshes(nanosec now);
+    // same for animation streams. m_mutex must be locked.
+    void expireAnimationStreams(nanosec now);
+
     using GetPtr    = std::shared_ptr<GetMessage>;
     using DeletePtr = std::shared_ptr<DeleteMessage>;
-    using ClientObjects = std::map<std::string, EntityPtr>;
+    using ClientObjects = mu::FlatHashMap<std::string, EntityPtr>; // by path
     using HTTPServerPtr = std::shared_ptr<Poco::Net::HTTPServer>;
+    using TCPServerPtr = std::shared_ptr<Poco::Net::TCPServer>;
     using lock_t = std::unique_lock<std::mutex>;
     using History = std::vector<MessagePtr>;
+    struct ChunkedMesh
+    {
+        SceneSettings scene_settings;
+        MeshDataFlags flags;
+        MeshPtr mesh;
+        nanosec last_update = 0;
+    };
+    using ChunkedMeshes = std::map<uint64_t, ChunkedMesh>;
+    using MaterialKey = std::pair<uint64_t, int>; // session, id
+    using Materials = std::map<MaterialKey, MaterialPtr>;
+    struct AnimationStream
+    {
+        AnimationClipPtr clip;
+        mu::FlatHashMap<std::string, AnimationPtr> animations; // by path
+        SetMessagePtr queued; // the clip is not queued again while this is in m_recv_history
+        int num_chunks = 0;
+        int num_queued_chunks = 0; // num_chunks when the clip was queued last time
+        nanosec last_update = 0;
+    };
+    using AnimationStreams = std::map<uint64_t, AnimationStream>;
+    struct PendingFence
+    {
+        FenceMessagePtr mes;
+        nanosec deadline;
+    };
+    struct ServedMesh
+    {
+        MeshPtr source;      // as served by the handler
+        uint64_t generation; // of source when it was refined
+        MeshPtr mesh;        // refined. source itself if nobody else held it
+    };
+    using ServedMeshes = mu::FlatHashMap<std::string, ServedMesh>; // by path
 
     bool m_serving = true;
     ServerSettings m_settings;
     HTTPServerPtr m_server;
+    TCPServerPtr m_framed_server;
+    uint16_t m_framed_port = 0;
+    std::atomic<uint64_t> m_epoch{0}; // renewed by clear(). see Capabilities::server_epoch
     std::mutex m_mutex;
     std::atomic_int m_request_count{0};
 
     ClientObjects m_client_objs;
+    Materials m_materials; // received materials of the sessions. guarded by m_mutex
+    std::map<uint64_t, nanosec> m_material_sessions; // last time materials were received. guarded by m_mutex
     History m_recv_history;
+    // SceneEnd fences received while Set or Delete messages were still being received. they are queued after them,
+    // or after FenceTimeoutMS. guarded by m_mutex
+    std::vector<PendingFence> m_pending_fences;
+    static const int FenceTimeoutMS = 5000;
+    uint64_t m_history_size = 0; // serialized size of the SetMessages in m_recv_history. guarded by m_mutex
+    // the spill file is guarded by m_spill_mutex. when both are locked, m_mutex is locked first.
+    std::mutex m_spill_mutex;
+    FILE *m_spill_file = nullptr;
+    uint64_t m_spill_size = 0;
+    uint64_t m_spill_generation = 0; // incremented when the file is closed. changed with both mutexes locked
+    bool m_spill_failed = false;
+    std::atomic_int m_num_spilled{0};
+    // spilled messages are read back and converted by m_prefetch_thread while the handler processes the ones before them.
+    // at most SpillPrefetchWindow from the front of m_prefetch_queue are restored at a time.
+    static const int SpillPrefetchWindow = 2;
+    std::mutex m_prefetch_mutex;
+    std::condition_variable m_prefetch_cond;
+    std::deque<SpilledMessagePtr> m_prefetch_queue; // the spilled ones in m_recv_history, in order. guarded by m_prefetch_mutex
+    std::thread m_prefetch_thread;
+    bool m_prefetch_stop = false;
+    ChunkedMeshes m_chunked_meshes;
+    std::mutex m_chunk_mutex;
+    AnimationStreams m_animation_streams; // guarded by m_mutex. the handler reads the clips while chunks are appended
 
     ScenePtr m_host_scene;
+    ServedMeshes m_served_meshes; // refined meshes of the last GET by path. reused while the served ones are unchanged
     GetMessagePtr m_current_get_request;
     ScreenshotMessagePtr m_current_screenshot_request;
     std::string m_screenshot_file_path;
 
     QueryMessagePtr m_current_query;
+    Profiler m_profiler;
+    TextureCache m_texture_cache;
+
+    SharedMemoryChannelPtr m_shm;
+    std::thread m_shm_thread;
+    std::atomic_bool m_shm_stop{ false };
 };
 
 } // namespace ms
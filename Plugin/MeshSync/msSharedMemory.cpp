@@ -0,0 +1,675 @@
+#include "pch.h"
+#include "msSharedMemory.h"
+
+#ifndef _WIN32
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <fcntl.h>
+    #include <unistd.h>
+    #include <signal.h>
+    #include <errno.h>
+    #ifdef __linux__
+        #include <linux/futex.h>
+        #include <sys/syscall.h>
+        #include <climits>
+        #include <ctime>
+    #endif
+#endif
+
+namespace ms {
+
+static const uint32_t kSharedMemoryMagic = 0x4d53534d; // "MSSM"
+
+// frame_state: state of the frame being written in the low 2 bits, frame sequence number in the rest.
+// a frame that is not completed (the writer timed out or crashed, or the reader gave up on it) goes
+// Writing -> Aborted -> Discard -> Idle. the writer (or whoever takes the lock over) publishes where
+// the broken frame ends and sets Discard, the reader skips to there and sets Idle.
+// writers don't start a new frame until the state is Idle, so bytes of the next frame are never
+// read as the rest of a broken one.
+enum FrameState : uint32_t
+{
+    FrameIdle,
+    FrameWriting,
+    FrameAborted,
+    FrameDiscard,
+    FrameStateMask = 3,
+    FrameSeqOne = 4,
+};
+
+struct SharedMemoryChannel::Header
+{
+    uint32_t magic;
+    int protocol_version;
+    uint64_t capacity;
+    int server_pid;
+    std::atomic<uint32_t> server_alive;
+    std::atomic<uint32_t> writer_lock; // pid of the process that holds the lock. 0 if free.
+    std::atomic<uint32_t> frame_state;
+    std::atomic<uint32_t> data_seq;  // incremented when data is written. futex word.
+    std::atomic<uint32_t> space_seq; // incremented when data is consumed. futex word.
+    std::atomic<uint64_t> frame_begin; // position of the frame being written
+    std::atomic<uint64_t> discard_pos; // end of the broken frame. valid when frame_state is Discard.
+    alignas(64) std::atomic<uint64_t> write_pos;
+    alignas(64) std::atomic<uint64_t> read_pos;
+};
+
+
+static uint32_t GetPID()
+{
+#ifdef _WIN32
+    return (uint32_t)::GetCurrentProcessId();
+#else
+    return (uint32_t)::getpid();
+#endif
+}
+
+// false only if the process is known to be gone
+static bool IsProcessAlive(uint32_t pid)
+{
+#ifdef _WIN32
+    HANDLE proc = ::OpenProcess(SYNCHRONIZE, FALSE, (DWORD)pid);
+    if (!proc)
+        return ::GetLastError() == ERROR_ACCESS_DENIED;
+    bool ret = ::WaitForSingleObject(proc, 0) == WAIT_TIMEOUT;
+    ::CloseHandle(proc);
+    return ret;
+#else
+    return ::kill((pid_t)pid, 0) == 0 || errno == EPERM;
+#endif
+}
+
+static int RemainingMS(nanosec deadline)
+{
+    auto now = Now();
+    return now < deadline ? (int)((deadline - now) / 1000000) : 0;
+}
+
+
+static void WaitSeq(std::atomic<uint32_t>& seq, uint32_t value, nanosec timeout)
+{
+#ifdef __linux__
+    // cap the wait so that callers can check the peer is still alive
+    timeout = std::min<nanosec>(timeout, 100 * 1000000);
+    timespec ts;
+    ts.tv_sec = (time_t)(timeout / 1000000000);
+    ts.tv_nsec = (long)(timeout % 1000000000);
+    // not FUTEX_PRIVATE_FLAG. the word is shared between processes.
+    syscall(SYS_futex, (int*)&seq, FUTEX_WAIT, (int)value, &ts, nullptr, 0);
+#else
+    (void)seq; (void)value; (void)timeout;
+    std::this_thread::sleep_for(std::chrono::microseconds(100));
+#endif
+}
+
+static void WakeSeq(std::atomic<uint32_t>& seq)
+{
+    seq.fetch_add(1, std::memory_order_release);
+#ifdef __linux__
+    syscall(SYS_futex, (int*)&seq, FUTEX_WAKE, INT_MAX, nullptr, nullptr, 0);
+#endif
+}
+
+template<class Cond>
+static bool WaitFor(std::atomic<uint32_t>& seq, int timeout_ms, const Cond& cond)
+{
+    auto deadline = Now() + (nanosec)timeout_ms * 1000000;
+    for (;;) {
+        uint32_t v = seq.load(std::memory_order_acquire);
+        if (cond())
+            return true;
+        auto now = Now();
+        if (now >= deadline)
+            return false;
+        WaitSeq(seq, v, deadline - now);
+    }
+}
+
+
+std::string SharedMemoryChannel::getName(uint16_t port)
+{
+    char buf[64];
+    sprintf(buf, "MeshSync_%d", (int)port);
+    return buf;
+}
+
+SharedMemoryChannel::SharedMemoryChannel()
+{
+}
+
+SharedMemoryChannel::~SharedMemoryChannel()
+{
+    close();
+}
+
+bool SharedMemoryChannel::create(const std::string& name, uint64_t capacity)
+{
+    close();
+
+    uint64_t map_size = sizeof(Header) + capacity;
+#ifdef _WIN32
+    m_handle = ::CreateFileMappingA(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE,
+        (DWORD)(map_size >> 32), (DWORD)map_size, name.c_str());
+    if (!m_handle)
+        return false;
+    void *addr = ::MapViewOfFile(m_handle, FILE_MAP_ALL_ACCESS, 0, 0, (SIZE_T)map_size);
+    if (!addr) {
+        close();
+        return false;
+    }
+#else
+    auto path = "/" + name;
+    m_fd = ::shm_open(path.c_str(), O_CREAT | O_RDWR, 0600);
+    if (m_fd == -1)
+        return false;
+    if (::ftruncate(m_fd, (off_t)map_size) != 0) {
+        ::close(m_fd);
+        m_fd = -1;
+        ::shm_unlink(path.c_str());
+        return false;
+    }
+    void *addr = ::mmap(nullptr, (size_t)map_size, PROT_READ | PROT_WRITE, MAP_SHARED, m_fd, 0);
+    if (addr == MAP_FAILED) {
+        ::close(m_fd);
+        m_fd = -1;
+        ::shm_unlink(path.c_str());
+        return false;
+    }
+#endif
+    m_name = name;
+    m_owner = true;
+    m_map_size = map_size;
+    m_header = new (addr) Header();
+    m_data = (char*)addr + sizeof(Header);
+
+    auto& h = *m_header;
+    h.magic = kSharedMemoryMagic;
+    h.protocol_version = msProtocolVersion;
+    h.capacity = capacity;
+    h.server_pid = (int)GetPID();
+    h.writer_lock = 0;
+    h.frame_state = FrameIdle;
+    h.frame_begin = 0;
+    h.discard_pos = 0;
+    h.data_seq = 0;
+    h.space_seq = 0;
+    h.write_pos = 0;
+    h.read_pos = 0;
+    h.server_alive = 1;
+    return true;
+}
+
+bool SharedMemoryChannel::open(const std::string& name)
+{
+    close();
+
+    void *addr = nullptr;
+    uint64_t map_size = 0;
+#ifdef _WIN32
+    m_handle = ::OpenFileMappingA(FILE_MAP_ALL_ACCESS, FALSE, name.c_str());
+    if (!m_handle)
+        return false;
+    addr = ::MapViewOfFile(m_handle, FILE_MAP_ALL_ACCESS, 0, 0, 0);
+    if (!addr) {
+        close();
+        return false;
+    }
+    MEMORY_BASIC_INFORMATION info;
+    ::VirtualQuery(addr, &info, sizeof(info));
+    map_size = info.RegionSize;
+#else
+    auto path = "/" + name;
+    m_fd = ::shm_open(path.c_str(), O_RDWR, 0600);
+    if (m_fd == -1)
+        return false;
+    struct stat st;
+    if (::fstat(m_fd, &st) != 0 || (uint64_t)st.st_size < sizeof(Header)) {
+        close();
+        return false;
+    }
+    map_size = (uint64_t)st.st_size;
+    addr = ::mmap(nullptr, (size_t)map_size, PROT_READ | PROT_WRITE, MAP_SHARED, m_fd, 0);
+    if (addr == MAP_FAILED) {
+        close();
+        return false;
+    }
+#endif
+    m_name = name;
+    m_owner = false;
+    m_map_size = map_size;
+    m_header = (Header*)addr;
+    m_data = (char*)addr + sizeof(Header);
+
+    if (m_header->magic != kSharedMemoryMagic ||
+        m_header->protocol_version != msProtocolVersion ||
+        sizeof(Header) + m_header->capacity > map_size)
+    {
+        close();
+        return false;
+    }
+    return true;
+}
+
+void SharedMemoryChannel::close()
+{
+    if (m_header) {
+        if (m_owner) {
+            m_header->server_alive = 0;
+            WakeSeq(m_header->space_seq);
+        }
+#ifdef _WIN32
+        ::UnmapViewOfFile(m_header);
+#else
+        ::munmap(m_header, (size_t)m_map_size);
+#endif
+        m_header = nullptr;
+        m_data = nullptr;
+    }
+#ifdef _WIN32
+    if (m_handle) {
+        ::CloseHandle(m_handle);
+        m_handle = nullptr;
+    }
+#else
+    if (m_fd != -1) {
+        ::close(m_fd);
+        m_fd = -1;
+        if (m_owner)
+            ::shm_unlink(("/" + m_name).c_str());
+    }
+#endif
+    m_owner = false;
+    m_map_size = 0;
+    m_name.clear();
+}
+
+bool SharedMemoryChannel::valid() const
+{
+    return m_header != nullptr;
+}
+
+bool SharedMemoryChannel::isServerAlive() const
+{
+    if (!m_header || m_header->server_alive.load() == 0)
+        return false;
+    // the object outlives a crashed server. check the process actually exists.
+    if (!m_owner && !IsProcessAlive((uint32_t)m_header->server_pid))
+        return false;
+    return true;
+}
+
+uint64_t SharedMemoryChannel::getCapacity() const
+{
+    return m_header ? m_header->capacity : 0;
+}
+
+bool SharedMemoryChannel::lockWriter(int timeout_ms)
+{
+    if (!m_header)
+        return false;
+
+    auto& h = *m_header;
+    auto deadline = Now() + (nanosec)timeout_ms * 1000000;
+    auto next_check = Now();
+    const uint32_t pid = GetPID();
+    bool taken_over = false;
+    for (;;) {
+        uint32_t owner = 0;
+        if (h.writer_lock.compare_exchange_weak(owner, pid, std::memory_order_acquire))
+            break;
+        auto now = Now();
+        if (now >= deadline || !isServerAlive())
+            return false;
+        if (owner != 0 && now >= next_check) {
+            // the owner crashed while holding the lock. nobody else would ever release it.
+            if (!IsProcessAlive(owner) && h.writer_lock.compare_exchange_strong(owner, pid, std::memory_order_acquire)) {
+                taken_over = true;
+                break;
+            }
+            next_check = now + 100 * 1000000;
+        }
+        std::this_thread::yield();
+    }
+
+    if (taken_over) {
+        // the frame the dead owner was writing will never be completed
+        uint32_t state = h.frame_state.load(std::memory_order_acquire);
+        uint32_t st = state & FrameStateMask;
+        if (st == FrameWriting || st == FrameAborted)
+            discardFrame(state);
+    }
+
+    // wait for the reader to skip a broken frame
+    bool ok = WaitFor(h.space_seq, RemainingMS(deadline), [&]() {
+        return (h.frame_state.load(std::memory_order_acquire) & FrameStateMask) == FrameIdle || !isServerAlive();
+    });
+    if (!ok || !isServerAlive()) {
+        unlockWriter();
+        return false;
+    }
+    return true;
+}
+
+void SharedMemoryChannel::unlockWriter()
+{
+    if (m_header)
+        m_header->writer_lock.store(0, std::memory_order_release);
+}
+
+bool SharedMemoryChannel::frameAborted() const
+{
+    return m_frame_state != 0 && m_header->frame_state.load(std::memory_order_acquire) != m_frame_state;
+}
+
+void SharedMemoryChannel::beginFrame()
+{
+    auto& h = *m_header;
+    uint32_t state = h.frame_state.load(std::memory_order_relaxed);
+    m_frame_state = ((state & ~FrameStateMask) + FrameSeqOne) | FrameWriting;
+    h.frame_begin.store(h.write_pos.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    h.frame_state.store(m_frame_state, std::memory_order_release);
+}
+
+bool SharedMemoryChannel::endFrame(bool ok)
+{
+    auto& h = *m_header;
+    uint32_t state = m_frame_state;
+    m_frame_state = 0;
+    // fails if the reader gave up on the frame in the meantime
+    if (ok && h.frame_state.compare_exchange_strong(state, (state & ~FrameStateMask) | FrameIdle, std::memory_order_release))
+        return true;
+    discardFrame(h.frame_state.load(std::memory_order_acquire));
+    return false;
+}
+
+void SharedMemoryChannel::discardFrame(uint32_t state)
+{
+    // called by the lock holder. nothing is written after this until the reader sets Idle.
+    auto& h = *m_header;
+    h.discard_pos.store(h.write_pos.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    h.frame_state.store((state & ~FrameStateMask) | FrameDiscard, std::memory_order_release);
+    WakeSeq(h.data_seq);
+}
+
+bool SharedMemoryChannel::write(const void *src_, uint64_t size, int timeout_ms)
+{
+    if (!m_header)
+        return false;
+
+    auto& h = *m_header;
+    auto *src = (const char*)src_;
+    const uint64_t capacity = h.capacity;
+    while (size > 0) {
+        uint64_t wpos = h.write_pos.load(std::memory_order_relaxed);
+        uint64_t space = 0;
+        bool ok = WaitFor(h.space_seq, timeout_ms, [&]() {
+            space = capacity - (wpos - h.read_pos.load(std::memory_order_acquire));
+            return space > 0 || !isServerAlive() || frameAborted();
+        });
+        if (!ok || space == 0 || frameAborted())
+            return false;
+
+        uint64_t n = std::min(size, space);
+        uint64_t offset = wpos % capacity;
+        uint64_t n1 = std::min(n, capacity - offset);
+        memcpy(m_data + offset, src, (size_t)n1);
+        if (n1 < n)
+            memcpy(m_data, src + n1, (size_t)(n - n1));
+
+        h.write_pos.store(wpos + n, std::memory_order_release);
+        WakeSeq(h.data_seq);
+        src += n;
+        size -= n;
+    }
+    return true;
+}
+
+bool SharedMemoryChannel::writeMessage(FrameType type, const Message& mes, int timeout_ms)
+{
+    if (!lockWriter(timeout_ms))
+        return false;
+
+    beginFrame();
+    FrameHeader fh;
+    fh.type = type;
+    fh.size = mes.getSerializeSize();
+    bool ret = write(&fh, sizeof(fh), timeout_ms);
+    if (ret) {
+        SharedMemoryOStreamBuf buf(*this, timeout_ms);
+        std::ostream os(&buf);
+        mes.serialize(os);
+        os.flush();
+        ret = os.good();
+    }
+    ret = endFrame(ret);
+    unlockWriter();
+    return ret;
+}
+
+void SharedMemoryChannel::interrupt()
+{
+    m_interrupted = true;
+    if (m_header) {
+        WakeSeq(m_header->data_seq);
+        WakeSeq(m_header->space_seq);
+    }
+}
+
+uint64_t SharedMemoryChannel::getReadable(uint64_t rpos, bool& discard) const
+{
+    auto& h = *m_header;
+    uint32_t state = h.frame_state.load(std::memory_order_acquire);
+    uint64_t end = h.write_pos.load(std::memory_order_acquire);
+    switch (state & FrameStateMask) {
+    case FrameAborted:
+        // the reader is in the broken frame. nothing is readable until the writer publishes its end.
+        end = std::min(end, h.frame_begin.load(std::memory_order_relaxed));
+        break;
+    case FrameDiscard:
+        // frames before the broken one are intact
+        end = h.frame_begin.load(std::memory_order_relaxed);
+        if (rpos >= end)
+            discard = true;
+        break;
+    }
+    return end > rpos ? end - rpos : 0;
+}
+
+void SharedMemoryChannel::skipDiscarded()
+{
+    auto& h = *m_header;
+    uint32_t state = h.frame_state.load(std::memory_order_acquire);
+    h.read_pos.store(h.discard_pos.load(std::memory_order_relaxed), std::memory_order_release);
+    h.frame_state.store((state & ~FrameStateMask) | FrameIdle, std::memory_order_release);
+    WakeSeq(h.space_seq);
+}
+
+void SharedMemoryChannel::abortFrame(uint64_t rpos)
+{
+    // the writer stalls in the middle of the frame. let it know so that it stops and publishes the end.
+    auto& h = *m_header;
+    uint32_t state = h.frame_state.load(std::memory_order_acquire);
+    if ((state & FrameStateMask) == FrameWriting && rpos >= h.frame_begin.load(std::memory_order_relaxed))
+        h.frame_state.compare_exchange_strong(state, (state & ~FrameStateMask) | FrameAborted);
+    WakeSeq(h.space_seq);
+}
+
+bool SharedMemoryChannel::waitData(int timeout_ms)
+{
+    if (!m_header)
+        return false;
+    auto& h = *m_header;
+    return WaitFor(h.data_seq, timeout_ms, [&]() {
+        bool discard = false;
+        return m_interrupted || getReadable(h.read_pos.load(std::memory_order_relaxed), discard) > 0 || discard;
+    }) && !m_interrupted;
+}
+
+bool SharedMemoryChannel::read(void *dst_, uint64_t size, int timeout_ms)
+{
+    if (!m_header)
+        return false;
+
+    auto& h = *m_header;
+    auto *dst = (char*)dst_;
+    const uint64_t capacity = h.capacity;
+    while (size > 0) {
+        uint64_t rpos = h.read_pos.load(std::memory_order_relaxed);
+        uint64_t available = 0;
+        bool discard = false;
+        bool ok = WaitFor(h.data_seq, timeout_ms, [&]() {
+            available = getReadable(rpos, discard);
+            return available > 0 || discard || m_interrupted;
+        });
+        if (m_interrupted)
+            return false;
+        if (discard) {
+            skipDiscarded();
+            return false;
+        }
+        if (!ok) {
+            abortFrame(rpos);
+            return false;
+        }
+
+        uint64_t n = std::min(size, available);
+        if (dst) {
+            uint64_t offset = rpos % capacity;
+            uint64_t n1 = std::min(n, capacity - offset);
+            memcpy(dst, m_data + offset, (size_t)n1);
+            if (n1 < n)
+                memcpy(dst + n1, m_data, (size_t)(n - n1));
+            dst += n;
+        }
+
+        h.read_pos.store(rpos + n, std::memory_order_release);
+        WakeSeq(h.space_seq);
+        size -= n;
+    }
+    return true;
+}
+
+bool SharedMemoryChannel::skip(uint64_t size, int timeout_ms)
+{
+    return read(nullptr, size, timeout_ms);
+}
+
+bool SharedMemoryChannel::readFrameHeader(FrameHeader& dst, int timeout_ms)
+{
+    return read(&dst, sizeof(dst), timeout_ms);
+}
+
+
+SharedMemoryOStreamBuf::SharedMemoryOStreamBuf(SharedMemoryChannel& channel, int timeout_ms)
+    : m_channel(channel)
+    , m_timeout_ms(timeout_ms)
+{
+    setp(m_buf, m_buf + sizeof(m_buf));
+}
+
+SharedMemoryOStreamBuf::~SharedMemoryOStreamBuf()
+{
+    flushBuffer();
+}
+
+bool SharedMemoryOStreamBuf::flushBuffer()
+{
+    auto n = pptr() - pbase();
+    if (n == 0)
+        return true;
+    bool ret = m_channel.write(pbase(), (uint64_t)n, m_timeout_ms);
+    setp(m_buf, m_buf + sizeof(m_buf));
+    return ret;
+}
+
+SharedMemoryOStreamBuf::int_type SharedMemoryOStreamBuf::overflow(int_type c)
+{
+    if (!flushBuffer())
+        return traits_type::eof();
+    if (!traits_type::eq_int_type(c, traits_type::eof())) {
+        *pptr() = traits_type::to_char_type(c);
+        pbump(1);
+    }
+    return traits_type::not_eof(c);
+}
+
+std::streamsize SharedMemoryOStreamBuf::xsputn(const char *s, std::streamsize n)
+{
+    if (n < (std::streamsize)sizeof(m_buf) / 4)
+        return std::streambuf::xsputn(s, n);
+
+    // write directly into the ring
+    if (!flushBuffer() || !m_channel.write(s, (uint64_t)n, m_timeout_ms))
+        return 0;
+    return n;
+}
+
+int SharedMemoryOStreamBuf::sync()
+{
+    return flushBuffer() ? 0 : -1;
+}
+
+
+SharedMemoryIStreamBuf::SharedMemoryIStreamBuf(SharedMemoryChannel& channel, uint64_t size, int timeout_ms)
+    : m_channel(channel)
+    , m_remaining(size)
+    , m_timeout_ms(timeout_ms)
+{
+    setg(m_buf, m_buf, m_buf);
+}
+
+bool SharedMemoryIStreamBuf::finish()
+{
+    setg(m_buf, m_buf, m_buf);
+    if (m_failed)
+        return false;
+    bool ret = m_channel.skip(m_remaining, m_timeout_ms);
+    m_remaining = 0;
+    return ret;
+}
+
+SharedMemoryIStreamBuf::int_type SharedMemoryIStreamBuf::underflow()
+{
+    if (gptr() < egptr())
+        return traits_type::to_int_type(*gptr());
+    if (m_remaining == 0 || m_failed)
+        return traits_type::eof();
+
+    auto n = std::min<uint64_t>(m_remaining, sizeof(m_buf));
+    if (!m_channel.read(m_buf, n, m_timeout_ms)) {
+        m_failed = true;
+        return traits_type::eof();
+    }
+    m_remaining -= n;
+    setg(m_buf, m_buf, m_buf + n);
+    return traits_type::to_int_type(*gptr());
+}
+
+std::streamsize SharedMemoryIStreamBuf::xsgetn(char *s, std::streamsize n)
+{
+    // drain the buffer first
+    std::streamsize ret = std::min<std::streamsize>(n, egptr() - gptr());
+    if (ret > 0) {
+        memcpy(s, gptr(), (size_t)ret);
+        gbump((int)ret);
+        s += ret;
+        n -= ret;
+    }
+    if (n == 0)
+        return ret;
+
+    if (n < (std::streamsize)sizeof(m_buf) / 4)
+        return ret + std::streambuf::xsgetn(s, n);
+
+    // read directly from the ring
+    if (m_failed)
+        return ret;
+    auto len = std::min<uint64_t>(m_remaining, (uint64_t)n);
+    if (!m_channel.read(s, len, m_timeout_ms)) {
+        m_failed = true;
+        return ret;
+    }
+    m_remaining -= len;
+    return ret + (std::streamsize)len;
+}
+
+} // namespace ms
@@ -0,0 +1,115 @@
+#pragma once
+
+#include <atomic>
+#include <streambuf>
+#include "msProtocol.h"
+
+namespace ms {
+
+// byte ring buffer placed in a named shared memory object. transport for the same host that bypasses HTTP.
+// the server creates it and clients open it. writers are serialized by a lock in the shared header
+// (a frame is never interleaved with another one) and the server is the only reader.
+// frames larger than the ring are streamed: the reader consumes while the writer is still writing.
+// the lock holds the pid of the writer and is taken over if that process is gone. a frame that is never
+// completed is marked in the header and skipped by the reader as a whole. see FrameState.
+class SharedMemoryChannel
+{
+public:
+    static std::string getName(uint16_t port);
+
+    SharedMemoryChannel();
+    ~SharedMemoryChannel();
+    SharedMemoryChannel(const SharedMemoryChannel&) = delete;
+    SharedMemoryChannel& operator=(const SharedMemoryChannel&) = delete;
+
+    bool create(const std::string& name, uint64_t capacity); // server
+    bool open(const std::string& name);                      // client
+    void close();
+    bool valid() const;
+    bool isServerAlive() const;
+    uint64_t getCapacity() const;
+
+    // writer side
+    bool lockWriter(int timeout_ms);
+    void unlockWriter();
+    bool write(const void *src, uint64_t size, int timeout_ms);
+    bool writeMessage(FrameType type, const Message& mes, int timeout_ms);
+
+    // reader side
+    bool waitData(int timeout_ms);
+    bool read(void *dst, uint64_t size, int timeout_ms);
+    bool skip(uint64_t size, int timeout_ms);
+    bool readFrameHeader(FrameHeader& dst, int timeout_ms);
+    // make waiting reads return false immediately. used to stop the reader thread.
+    void interrupt();
+
+private:
+    struct Header;
+
+    bool frameAborted() const;
+    void beginFrame();
+    bool endFrame(bool ok);
+    void discardFrame(uint32_t state);
+    uint64_t getReadable(uint64_t rpos, bool& discard) const;
+    void skipDiscarded();
+    void abortFrame(uint64_t rpos);
+
+    Header *m_header = nullptr;
+    char *m_data = nullptr;
+    uint64_t m_map_size = 0;
+    bool m_owner = false;
+    uint32_t m_frame_state = 0; // writer side. state word of the frame being written.
+    std::atomic_bool m_interrupted{ false };
+    std::string m_name;
+#ifdef _WIN32
+    void *m_handle = nullptr;
+#else
+    int m_fd = -1;
+#endif
+};
+using SharedMemoryChannelPtr = std::shared_ptr<SharedMemoryChannel>;
+
+
+// std::streambuf on SharedMemoryChannel.
+// Message::serialize() / deserialize() read and write the shared memory directly through these.
+// large blocks (vertex arrays etc) bypass the intermediate buffer.
+class SharedMemoryOStreamBuf : public std::streambuf
+{
+public:
+    SharedMemoryOStreamBuf(SharedMemoryChannel& channel, int timeout_ms);
+    ~SharedMemoryOStreamBuf() override;
+
+protected:
+    int_type overflow(int_type c) override;
+    std::streamsize xsputn(const char *s, std::streamsize n) override;
+    int sync() override;
+
+private:
+    bool flushBuffer();
+
+    SharedMemoryChannel& m_channel;
+    int m_timeout_ms;
+    char m_buf[4096];
+};
+
+class SharedMemoryIStreamBuf : public std::streambuf
+{
+public:
+    // size: length of the frame. reading beyond it results eof.
+    SharedMemoryIStreamBuf(SharedMemoryChannel& channel, uint64_t size, int timeout_ms);
+    // skip unread part of the frame. returns false if the channel timed out.
+    bool finish();
+
+protected:
+    int_type underflow() override;
+    std::streamsize xsgetn(char *s, std::streamsize n) override;
+
+private:
+    SharedMemoryChannel& m_channel;
+    uint64_t m_remaining;
+    int m_timeout_ms;
+    bool m_failed = false;
+    char m_buf[4096];
+};
+
+} // namespace ms
@@ -0,0 +1,112 @@
+#include "pch.h"
+#include "msTextureCache.h"
+
+namespace ms {
+
+// the client sends the Set right after the query. this only matters if it never does.
+static const nanosec kPinDuration = 60ull * 1000000000;
+
+TextureCache::TextureCache(uint64_t capacity)
+    : m_capacity(capacity)
+{
+}
+
+void TextureCache::setCapacity(uint64_t v)
+{
+    lock_t l(m_mutex);
+    m_capacity = v;
+    evict();
+}
+
+uint64_t TextureCache::getCapacity() const
+{
+    lock_t l(m_mutex);
+    return m_capacity;
+}
+
+void TextureCache::add(const TexturePtr& tex)
+{
+    if (!tex || tex->data.empty() || tex->hash == 0)
+        return;
+
+    lock_t l(m_mutex);
+    if (tex->data.size() > m_capacity)
+        return;
+    auto it = m_table.find(tex->hash);
+    if (it != m_table.end()) {
+        m_list.splice(m_list.begin(), m_list, it->second);
+        return;
+    }
+    m_list.push_front(tex);
+    m_table[tex->hash] = m_list.begin();
+    m_stats.size += tex->data.size();
+    ++m_stats.num_textures;
+    evict();
+}
+
+bool TextureCache::resolve(Texture& tex)
+{
+    lock_t l(m_mutex);
+    m_pins.erase(tex.hash);
+    auto it = m_table.find(tex.hash);
+    if (it == m_table.end()) {
+        ++m_stats.misses;
+        return false;
+    }
+    m_list.splice(m_list.begin(), m_list, it->second);
+    tex.data = (*it->second)->data;
+    ++m_stats.hits;
+    return true;
+}
+
+void TextureCache::query(const std::vector<uint64_t>& hashes, std::vector<uint64_t>& cached)
+{
+    lock_t l(m_mutex);
+    auto expire = Now() + kPinDuration;
+    for (auto hash : hashes) {
+        auto it = m_table.find(hash);
+        if (it != m_table.end()) {
+            m_list.splice(m_list.begin(), m_list, it->second);
+            m_pins[hash] = expire;
+            cached.push_back(hash);
+        }
+    }
+}
+
+void TextureCache::clear()
+{
+    lock_t l(m_mutex);
+    m_list.clear();
+    m_table.clear();
+    m_pins.clear();
+    m_stats.num_textures = m_stats.size = 0;
+}
+
+TextureCache::Stats TextureCache::getStats()
+{
+    lock_t l(m_mutex);
+    return m_stats;
+}
+
+void TextureCache::evict()
+{
+    auto now = Now();
+    auto it = m_list.end();
+    while (m_stats.size > m_capacity && it != m_list.begin()) {
+        --it;
+        auto hash = (*it)->hash;
+        auto pin = m_pins.find(hash);
+        if (pin != m_pins.end()) {
+            if (pin->second > now)
+                continue; // queried. the Set that references it has not arrived yet.
+            m_pins.erase(pin);
+        }
+        m_stats.size -= (*it)->data.size();
+        --m_stats.num_textures;
+        ++m_stats.evictions;
+        m_table.erase(hash);
+        it = m_list.erase(it);
+    }
+}
+
+} // namespace ms
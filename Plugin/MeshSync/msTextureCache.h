@@ -0,0 +1,51 @@
+#pragma once
+
+#include <list>
+#include <unordered_map>
+#include "msMaterial.h"
+
+namespace ms {
+
+// textures received by the server, keyed by content hash. clients send references instead of pixels
+// for textures that are cached. least recently used textures are evicted when the total size exceeds capacity.
+// textures reported by query() are pinned until they are resolved (or for a while), so that another client can't
+// evict them between the query and the Set that references them. the size may exceed capacity meanwhile.
+class TextureCache
+{
+public:
+    struct Stats
+    {
+        uint64_t hits = 0;
+        uint64_t misses = 0;
+        uint64_t evictions = 0;
+        uint64_t num_textures = 0;
+        uint64_t size = 0; // in byte
+    };
+
+    TextureCache(uint64_t capacity);
+    void setCapacity(uint64_t v);
+    uint64_t getCapacity() const;
+
+    // tex must have data and hash
+    void add(const TexturePtr& tex);
+    // restores data of a reference texture. returns false if it is not cached.
+    bool resolve(Texture& tex);
+    // hashes that are cached. also pins them, so that they survive until the following Set.
+    void query(const std::vector<uint64_t>& hashes, std::vector<uint64_t>& cached);
+    void clear();
+    Stats getStats();
+
+private:
+    using lock_t = std::unique_lock<std::mutex>;
+    using List = std::list<TexturePtr>;
+    void evict();
+
+    mutable std::mutex m_mutex;
+    uint64_t m_capacity = 0;
+    List m_list; // front is the most recently used
+    std::unordered_map<uint64_t, List::iterator> m_table;
+    std::unordered_map<uint64_t, nanosec> m_pins; // hash -> time the pin expires
+    Stats m_stats;
+};
+
+} // namespace ms
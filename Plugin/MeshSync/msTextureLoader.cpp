@@ -0,0 +1,73 @@
+#include "pch.h"
+#include "msTextureLoader.h"
+
+namespace ms {
+
+TextureLoader::TextureLoader(int num_threads)
+    : m_max_threads(std::max(num_threads, 1))
+{
+}
+
+TextureLoader::~TextureLoader()
+{
+    {
+        lock_t l(m_mutex);
+        m_stop = true;
+    }
+    m_cond_task.notify_all();
+    for (auto& t : m_threads)
+        t.join();
+}
+
+bool TextureLoader::load(TexturePtr dst, const std::string& path)
+{
+    if (!dst || GetFileSizeInByte(path.c_str()) <= 0)
+        return false;
+
+    {
+        lock_t l(m_mutex);
+        m_tasks.push_back({ dst, path });
+        ++m_num_pending;
+        // threads are started on demand
+        if ((int)m_threads.size() < m_max_threads && (int)m_threads.size() < m_num_pending)
+            m_threads.emplace_back([this]() { process(); });
+    }
+    m_cond_task.notify_one();
+    return true;
+}
+
+int TextureLoader::wait()
+{
+    lock_t l(m_mutex);
+    m_cond_done.wait(l, [this]() { return m_num_pending == 0; });
+    int ret = m_num_failed;
+    m_num_failed = 0;
+    return ret;
+}
+
+void TextureLoader::process()
+{
+    for (;;) {
+        Task task;
+        {
+            lock_t l(m_mutex);
+            m_cond_task.wait(l, [this]() { return m_stop || !m_tasks.empty(); });
+            if (m_tasks.empty())
+                return;
+            task = std::move(m_tasks.front());
+            m_tasks.pop_front();
+        }
+
+        bool ok = task.dst->readFile(task.path.c_str());
+
+        {
+            lock_t l(m_mutex);
+            if (!ok)
+                ++m_num_failed;
+            if (--m_num_pending == 0)
+                m_cond_done.notify_all();
+        }
+    }
+}
+
+} // namespace ms
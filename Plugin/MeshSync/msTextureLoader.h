@@ -0,0 +1,44 @@
+#pragma once
+
+#include <deque>
+#include <thread>
+#include <condition_variable>
+#include "msMaterial.h"
+
+namespace ms {
+
+// reads texture files on worker threads, so that exporting materials doesn't wait for the disk.
+// large files are memory mapped. see Texture::readFile().
+class TextureLoader
+{
+public:
+    TextureLoader(int num_threads = 4);
+    ~TextureLoader();
+
+    // queue reading path into dst->data. returns false if the file doesn't exist.
+    // dst must not be touched until wait() returns.
+    bool load(TexturePtr dst, const std::string& path);
+    // wait for all queued files. returns the number of files that could not be read.
+    int wait();
+
+private:
+    using lock_t = std::unique_lock<std::mutex>;
+    struct Task
+    {
+        TexturePtr dst;
+        std::string path;
+    };
+    void process();
+
+    int m_max_threads = 0;
+    std::vector<std::thread> m_threads;
+    std::mutex m_mutex;
+    std::condition_variable m_cond_task;
+    std::condition_variable m_cond_done;
+    std::deque<Task> m_tasks;
+    int m_num_pending = 0;
+    int m_num_failed = 0;
+    bool m_stop = false;
+};
+
+} // namespace ms
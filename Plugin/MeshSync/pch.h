@@ -25,6 +25,7 @@
 #include <string>
 #include <vector>
 #include <map>
+#include <unordered_map>
 #include <functional>
 #include <memory>
 #include <iostream>
@@ -34,7 +35,10 @@
 #include <mutex>
 #include <atomic>
 #include <algorithm>
+#include <limits>
 #include <thread>
+#include <condition_variable>
+#include <deque>
 
 #define POCO_STATIC
 #include "Poco/Path.h"
@@ -46,6 +50,8 @@
 #include "Poco/StreamCopier.h"
 #include "Poco/Net/TCPServer.h"
 #include "Poco/Net/TCPServerParams.h"
+#include "Poco/Net/TCPServerConnection.h"
+#include "Poco/Net/TCPServerConnectionFactory.h"
 #include "Poco/Net/HTTPServer.h"
 #include "Poco/Net/HTTPRequestHandler.h"
 #include "Poco/Net/HTTPRequestHandlerFactory.h"
@@ -1004,8 +1004,8 @@ void MeshSyncClient3dsMax::extractCameraAnimation(ms::Animation& dst_, INode *sr
     float t = m_current_time_sec * m_settings.animation_time_scale;
     auto& dst = (ms::CameraAnimation&)dst_;
     {
-        auto& last = dst.rotation.back();
-        last.value *= mu::rotateX(-90.0f * mu::Deg2Rad);
+        auto& last = dst.rotation.values.back();
+        last *= mu::rotateX(-90.0f * mu::Deg2Rad);
     }
 
     bool ortho;
@@ -1024,8 +1024,8 @@ void MeshSyncClient3dsMax::extractLightAnimation(ms::Animation& dst_, INode *src
     float t = m_current_time_sec * m_settings.animation_time_scale;
     auto& dst = (ms::LightAnimation&)dst_;
     {
-        auto& last = dst.rotation.back();
-        last.value *= mu::rotateX(-90.0f * mu::Deg2Rad);
+        auto& last = dst.rotation.values.back();
+        last *= mu::rotateX(-90.0f * mu::Deg2Rad);
     }
     ms::Light::LightType type;
     mu::float4 color;
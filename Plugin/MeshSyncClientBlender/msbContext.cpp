@@ -556,8 +556,9 @@ ms::TransformPtr msbContext::exportObject(Object * obj, bool force)
         return ret;
 
     auto& rec = touchRecord(obj);
-    if (rec.exported)
+    if (rec.exported == m_generation)
         return ret; // already exported
+    auto path = rec.path; // copied as exporting parents may move the record
 
     switch (obj->type) {
     case OB_ARMATURE:
@@ -572,7 +573,7 @@ ms::TransformPtr msbContext::exportObject(Object * obj, bool force)
     {
         exportObject(obj->parent, true);
         if (m_settings.sync_meshes) {
-            auto dst = addMesh(get_path(obj));
+            auto dst = addMesh(path);
             extractMeshData(*dst, obj);
             ret = dst;
         }
@@ -582,7 +583,7 @@ ms::TransformPtr msbContext::exportObject(Object * obj, bool force)
     {
         exportObject(obj->parent, true);
         if (m_settings.sync_cameras) {
-            auto dst = addCamera(get_path(obj));
+            auto dst = addCamera(path);
             extractCameraData(*dst, obj);
             ret = dst;
         }
@@ -592,7 +593,7 @@ ms::TransformPtr msbContext::exportObject(Object * obj, bool force)
     {
         exportObject(obj->parent, true);
         if (m_settings.sync_lights) {
-            auto dst = addLight(get_path(obj));
+            auto dst = addLight(path);
             extractLightData(*dst, obj);
             ret = dst;
         }
@@ -602,7 +603,7 @@ ms::TransformPtr msbContext::exportObject(Object * obj, bool force)
     {
         if (obj->dup_group || force) {
             exportObject(obj->parent, true);
-            ret = addTransform(get_path(obj));
+            ret = addTransform(path);
             extractTransformData(*ret, obj);
         }
         break;
@@ -611,7 +612,8 @@ ms::TransformPtr msbContext::exportObject(Object * obj, bool force)
 
     if (ret) {
         exportDupliGroup(obj, ret->path);
-        rec.exported = true;
+        // exporting parents adds records and may move this one. look it up again.
+        m_obj_records[obj].exported = m_generation;
     }
 
     return ret;
@@ -658,39 +660,65 @@ ms::TransformPtr msbContext::exportDupliGroup(Object *obj, const std::string & b
 
 msbContext::ObjectRecord& msbContext::touchRecord(Object * obj)
 {
-    auto& rec = m_obj_records[obj];
-    if (rec.alive)
-        return rec; // already touched
-
-    auto path = get_path(obj);
-    if (rec.path != path) {
-        if (!rec.path.empty()) {
-            // in this case, obj is renamed
-            m_deleted.push_back(rec.path);
+    auto *rec = &m_obj_records[obj];
+    if (rec->touched == m_generation)
+        return *rec; // already touched
+
+    // every sync touches every object. rebuilding the path is avoided unless the name or the parent changed,
+    // or the path of the parent changed in this sync. bone names are not tracked, so paths under bones are always rebuilt.
+    bool path_valid = !rec->path.empty() && rec->parent == obj->parent && rec->partype == obj->partype &&
+        rec->name == obj->id.name + 2;
+    if (path_valid && obj->parent) {
+        if (obj->partype == PARBONE)
+            path_valid = false;
+        else {
+            path_valid = touchRecord(obj->parent).path_changed != m_generation;
+            rec = &m_obj_records[obj]; // touching the parent may have moved it
+        }
+    }
+    if (!path_valid) {
+        auto path = get_path(obj);
+        if (rec->path != path) {
+            if (!rec->path.empty()) {
+                // in this case, obj is renamed
+                m_deleted.push_back(rec->path);
+            }
+            rec->name = get_name(obj);
+            rec->path = path;
+            rec->path_changed = m_generation;
         }
-        rec.name = get_name(obj);
-        rec.path = path;
+        rec->parent = obj->parent;
+        rec->partype = obj->partype;
     }
 
-    rec.alive = true;
+    rec->touched = m_generation;
+    ++m_num_touched;
     if (obj->type == OB_ARMATURE) {
         auto poses = bl::list_range((bPoseChannel*)obj->pose->chanbase.first);
         for (auto pose : poses) {
-            m_obj_records[pose->bone].alive = true;
+            auto& bone_rec = m_obj_records[pose->bone];
+            if (bone_rec.touched != m_generation) {
+                bone_rec.touched = m_generation;
+                ++m_num_touched;
+            }
         }
+        rec = &m_obj_records[obj]; // adding bone records may have moved it
     }
-    return rec;
+    return *rec;
 }
 
 void msbContext::eraseStaleObjects()
 {
-    for (auto i = m_obj_records.begin(); i != m_obj_records.end(); /**/) {
-        if (!i->second.alive) {
-            m_deleted.push_back(i->second.path);
-            m_obj_records.erase(i++);
-        }
-        else {
-            ++i;
+    // if all records are touched in this generation, nothing is stale and the records don't need to be walked.
+    if (m_num_touched < m_obj_records.size()) {
+        for (auto i = m_obj_records.begin(); i != m_obj_records.end(); /**/) {
+            if (i->second.touched != m_generation) {
+                m_deleted.push_back(i->second.path);
+                m_obj_records.erase(i++);
+            }
+            else {
+                ++i;
+            }
         }
     }
 
@@ -698,14 +726,13 @@ void msbContext::eraseStaleObjects()
         // blender re-creates all objects when undo / redo.
         // in that case, m_deleted includes all previous objects.
         // to avoid unneeded delete, erase re-created objects from m_deleted.
+        mu::FlatHashMap<std::string, bool> alive_paths;
+        alive_paths.reserve(m_obj_records.size());
+        for (auto& kvp : m_obj_records)
+            alive_paths[kvp.second.path] = true;
         m_deleted.erase(std::remove_if(m_deleted.begin(), m_deleted.end(),
-            [this](const std::string& v) {
-            for (auto& kvp : m_obj_records) {
-                if (kvp.second.path == v)
-                    return true;
-            }
-            return false;
-        }), m_deleted.end());
+            [&alive_paths](const std::string& v) { return alive_paths.count(v) != 0; }),
+            m_deleted.end());
     }
 }
 
@@ -732,34 +759,32 @@ void msbContext::sendAnimations(SendScope scope)
         }
     }
 
-    // advance frame and record animations
+    // advance frame and record animations.
+    // scene.frame_set() is the only serial part. merging and keyframe reduction run on worker threads.
     {
         int frame_current = scene.frame_current();
-        int frame_start = scene.frame_start();
-        int frame_end = scene.frame_end();
-        int interval = std::max(m_settings.animation_frame_interval, 1);
         float frame_to_seconds = 1.0f / scene.fps();
-        int reserve_size = (frame_end - frame_start) / interval + 1;
 
-        for(auto& kvp : m_anim_records) {
-            kvp.second.dst->reserve(reserve_size);
-        };
-        for (int f = frame_start; f <= frame_end; f += interval) {
-            scene.frame_set(f);
+        ms::AnimationBaker baker;
+        for (auto& kvp : m_anim_records) {
+            auto *rec = &kvp.second;
+            baker.addTarget(rec->dst, [this, rec](ms::Animation& dst) { (this->*rec->extractor)(dst, rec->obj); });
+        }
 
+        ms::AnimationBaker::Settings settings;
+        settings.frame_start = scene.frame_start();
+        settings.frame_end = scene.frame_end();
+        settings.frame_interval = m_settings.animation_frame_interval;
+        settings.chunk_frames = 64; // reduce while frame_set() is running
+        baker.bake(settings, [this, &scene, frame_to_seconds](int f) {
+            scene.frame_set(f);
             m_current_time = frame_to_seconds * f;
-            mu::parallel_for_each(m_anim_records.begin(), m_anim_records.end(), [this](AnimationRecords::value_type& kvp) {
-                kvp.second(this);
-            });
-        }
+        }, m_animations.front().get());
+
         m_anim_records.clear();
         scene.frame_set(frame_current);
     }
 
-    // keyframe reduction
-    for (auto& clip : m_animations) {
-        clip->reduction();
-    }
     // erase empty clip
     m_animations.erase(
         std::remove_if(m_animations.begin(), m_animations.end(), [](ms::AnimationClipPtr& p) { return p->empty(); }),
@@ -791,7 +816,7 @@ void msbContext::exportAnimation(Object *obj, bool force, const std::string base
         auto& rec = m_anim_records[path];
         rec.extractor = extractor;
         rec.obj = obj;
-        rec.dst = dst.get();
+        rec.dst = dst;
         clip->animations.push_back(dst);
     };
 
@@ -888,8 +913,8 @@ void msbContext::extractCameraAnimationData(ms::Animation& dst_, void *obj)
 
     auto& dst = (ms::CameraAnimation&)dst_;
     {
-        auto& last = dst.rotation.back();
-        last.value *= rotateX(90.0f * Deg2Rad);
+        auto& last = dst.rotation.values.back();
+        last *= rotateX(90.0f * Deg2Rad);
     }
 
     bool ortho;
@@ -908,8 +933,8 @@ void msbContext::extractLightAnimationData(ms::Animation& dst_, void *obj)
 
     auto& dst = (ms::LightAnimation&)dst_;
     {
-        auto& last = dst.rotation.back();
-        last.value *= rotateX(90.0f * Deg2Rad);
+        auto& last = dst.rotation.values.back();
+        last *= rotateX(90.0f * Deg2Rad);
     }
 
     ms::Light::LightType type;
@@ -987,11 +1012,12 @@ void msbContext::sendScene(SendScope scope)
                 touchRecord(obj);
         }
     }
-    if (scope == SendScope::Selected) {
+    else if (scope == SendScope::Selected) {
         // todo
     }
     else {
-        // all
+        // all. materials and textures are sent again even if they are unchanged
+        m_material_cache.clear();
         exportMaterials();
         auto scene = bl::BScene(bl::BContext::get().scene());
         for (auto *base : scene.objects()) {
@@ -1022,9 +1048,9 @@ void msbContext::kickAsyncSend()
     });
     m_extract_tasks.clear();
 
-    for (auto& kvp : m_obj_records) {
-        kvp.second.clear();
-    }
+    // records touched so far become stale. no need to walk them
+    ++m_generation;
+    m_num_touched = 0;
 
     m_bones.clear();
     m_added.clear();
@@ -1032,6 +1058,7 @@ void msbContext::kickAsyncSend()
     // kick async send
     m_send_future = std::async(std::launch::async, [this]() {
         ms::Client client(m_settings.client_settings);
+        client.setMaterialCache(&m_material_cache);
 
         // notify scene begin
         {
@@ -55,14 +55,14 @@ private:
     {
         std::string name;
         std::string path;
-        bool alive = false;
-        bool exported = false;
-
-        void clear()
-        {
-            alive = false;
-            exported = false;
-        }
+        // path is rebuilt only when these or the parent's path change
+        const Object *parent = nullptr;
+        short partype = 0;
+        // generations (see m_generation) of the last sync that touched / exported this / changed path.
+        // the record is alive if touched is the current one.
+        uint32_t touched = 0;
+        uint32_t exported = 0;
+        uint32_t path_changed = 0;
     };
 
     struct AnimationRecord : public mu::noncopyable
@@ -70,7 +70,7 @@ private:
         using extractor_t = void (msbContext::*)(ms::Animation& dst, void *obj);
 
         void *obj = nullptr;
-        ms::Animation *dst = nullptr;
+        ms::AnimationPtr dst;
         extractor_t extractor = nullptr;
 
         void operator()(msbContext *_this)
@@ -119,21 +119,24 @@ private:
     msbSettings m_settings;
     std::set<Object*> m_added;
     std::set<Object*> m_pending, m_pending_tmp;
-    std::map<const Bone*, ms::TransformPtr> m_bones;
+    mu::FlatHashMap<const Bone*, ms::TransformPtr> m_bones;
     std::vector<ms::TransformPtr> m_objects;
     std::vector<ms::MeshPtr> m_meshes;
     std::vector<ms::AnimationClipPtr> m_animations;
     std::vector<ms::MaterialPtr> m_materials;
     std::vector<std::string> m_deleted;
-    std::map<void*, ObjectRecord> m_obj_records;
+    mu::FlatHashMap<void*, ObjectRecord> m_obj_records;
+    uint32_t m_generation = 1; // advanced by each send. records are not cleared one by one
+    size_t m_num_touched = 0; // records touched in the current generation
 
     std::future<void> m_send_future;
+    ms::MaterialCache m_material_cache;
 
     using task_t = std::function<void()>;
     std::vector<task_t> m_extract_tasks;
 
     // animation export
-    using AnimationRecords = std::map<std::string, AnimationRecord>;
+    using AnimationRecords = mu::FlatHashMap<std::string, AnimationRecord>;
     AnimationRecords m_anim_records;
     float m_current_time = 0.0f;
     bool m_ignore_update = false;
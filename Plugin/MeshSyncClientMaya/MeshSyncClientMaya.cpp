@@ -489,6 +489,9 @@ bool MeshSyncClientMaya::sendScene(SendScope scope)
     };
 
     if (scope == SendScope::All) {
+        // send all materials and textures again
+        m_material_cache.clear();
+
         //EnumerateAllNode([](MObject& obj) { PrintNodeInfo(obj); });
 
         auto handler = [&](MObject& node) {
@@ -598,6 +601,7 @@ void MeshSyncClientMaya::kickAsyncSend()
     // begin async send
     m_future_send = std::async(std::launch::async, [this, to_meter]() {
         ms::Client client(m_settings.client_settings);
+        client.setMaterialCache(&m_material_cache);
 
         ms::SceneSettings scene_settings;
         scene_settings.handedness = ms::Handedness::Right;
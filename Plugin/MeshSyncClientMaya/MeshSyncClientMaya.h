@@ -190,6 +190,7 @@ private:
     std::vector<ms::ConstraintPtr>      m_constraints;
     std::vector<std::string>            m_deleted;
     std::future<void>                   m_future_send;
+    ms::MaterialCache                   m_material_cache;
 
     SendScope m_pending_scope = SendScope::None;
     bool      m_scene_updated = true;
@@ -772,8 +772,8 @@ void MeshSyncClientMaya::extractCameraAnimationData(ms::Animation& dst_, TreeNod
 
     auto& dst = (ms::CameraAnimation&)dst_;
     {
-        auto& last = dst.rotation.back();
-        last.value = mu::flipY(last.value);
+        auto& last = dst.rotation.values.back();
+        last = mu::flipY(last);
     }
 
     bool ortho;
@@ -800,8 +800,8 @@ void MeshSyncClientMaya::extractLightAnimationData(ms::Animation& dst_, TreeNode
 
     auto& dst = (ms::LightAnimation&)dst_;
     {
-        auto& last = dst.rotation.back();
-        last.value = mu::flipY(last.value);
+        auto& last = dst.rotation.values.back();
+        last = mu::flipY(last);
     }
 
     ms::Light::LightType type;
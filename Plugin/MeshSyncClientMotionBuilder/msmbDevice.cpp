@@ -158,6 +158,10 @@ void msmbDevice::kickAsyncSend()
 
         // send scene data
         {
+            // texture files are read and failed ones are re-exported by sendScene(). drop ones that have nothing to send.
+            m_textures.erase(std::remove_if(m_textures.begin(), m_textures.end(),
+                [](const ms::TexturePtr& tex) { return tex->getDataSize() == 0; }), m_textures.end());
+
             ms::SetMessage set;
             set.scene.settings = scene_settings;
             set.scene.objects = m_objects;
@@ -222,6 +226,19 @@ bool msmbDevice::sendScene(bool force_all)
             ++num_exported;
     });
 
+    // texture files have been read while the nodes were exported. ones that failed fall back to
+    // the pixels of the video clip, which can only be read on this thread.
+    if (m_texture_loader.wait() > 0) {
+        for (auto& kvp : m_texture_records) {
+            auto *dst = kvp.second.dst;
+            auto *video = FBCast<FBVideoClip>(kvp.first->Video);
+            if (dst && video && dst->format == ms::TextureFormat::RawFile && dst->getDataSize() == 0)
+                ExtractVideoPixels(*dst, video);
+        }
+    }
+    for (auto& kvp : m_texture_records)
+        kvp.second.dst = nullptr;
+
     // check deleted objects
     for (auto it = m_node_records.begin(); it != m_node_records.end(); /**/) {
         if (!it->second.exist) {
@@ -658,14 +675,61 @@ bool msmbDevice::exportMaterials()
             ++num_exported;
     }
 
-    for (auto& kvp : m_texture_records)
-        kvp.second.dst = nullptr;
+    // texture records are reset by sendScene() after the texture files are read
     for (auto& kvp : m_material_records)
         kvp.second.dst = nullptr;
 
     return num_exported > 0;
 }
 
+// pixels of the image that MotionBuilder has loaded. must be called on the main thread.
+static bool ExtractVideoPixels(ms::Texture& dst, FBVideoClip *video)
+{
+    auto& data = dst.data;
+    dst.name = mu::GetFilename_NoExtension(video->Filename);
+    dst.width = video->Width;
+    dst.height = video->Height;
+
+    int num_pixels = dst.width * dst.height;
+    auto image = (const char*)video->GetImage();
+    if (num_pixels > 0 && image) {
+        switch (video->Format) {
+        case kFBVideoFormat_RGBA_32:
+            dst.format = ms::TextureFormat::RGBAu8;
+            data.assign(image, image + (num_pixels * 4));
+            break;
+        case kFBVideoFormat_ABGR_32:
+            dst.format = ms::TextureFormat::RGBAu8;
+            data.resize_discard(num_pixels * 4);
+            mu::ABGR2RGBA((mu::unorm8x4*)data.data(), (mu::unorm8x4*)image, num_pixels);
+            break;
+        case kFBVideoFormat_ARGB_32:
+            dst.format = ms::TextureFormat::RGBAu8;
+            data.resize_discard(num_pixels * 4);
+            mu::ARGB2RGBA((mu::unorm8x4*)data.data(), (mu::unorm8x4*)image, num_pixels);
+            break;
+        case kFBVideoFormat_BGRA_32:
+            dst.format = ms::TextureFormat::RGBAu8;
+            data.resize_discard(num_pixels * 4);
+            mu::BGRA2RGBA((mu::unorm8x4*)data.data(), (mu::unorm8x4*)image, num_pixels);
+            break;
+        case kFBVideoFormat_RGB_24:
+            dst.format = ms::TextureFormat::RGBu8;
+            data.assign(image, image + (num_pixels * 3));
+            break;
+        case kFBVideoFormat_BGR_24:
+            dst.format = ms::TextureFormat::RGBu8;
+            data.resize_discard(num_pixels * 3);
+            mu::BGR2RGB((mu::unorm8x3*)data.data(), (mu::unorm8x3*)image, num_pixels);
+            break;
+        default:
+            // not supported
+            break;
+        }
+    }
+    return !data.empty();
+}
+
 int msmbDevice::exportTexture(FBTexture* src, FBMaterialTextureType type)
 {
     if (!src)
@@ -680,60 +744,19 @@ int msmbDevice::exportTexture(FBTexture* src, FBMaterialTextureType type)
         return rec.id; // already exported
 
     auto dst = ms::Texture::create();
-    auto& data = dst->data;
-    if (ms::FileToByteArray(video->Filename, data)) {
-        // send raw file contents
+    bool raw_file = m_texture_loader.load(dst, (const char*)video->Filename);
+    if (raw_file) {
+        // send raw file contents. the file is read in background and waited before sending.
 
         dst->name = mu::GetFilename(video->Filename);
         dst->format = ms::TextureFormat::RawFile;
     }
     else {
         // send texture data in FBVideoClip
-
-        dst->name = mu::GetFilename_NoExtension(video->Filename);
-        dst->width = video->Width;
-        dst->height = video->Height;
-
-        int num_pixels = dst->width * dst->height;
-        auto image = (const char*)video->GetImage();
-        if (num_pixels > 0 && image) {
-            switch (video->Format) {
-            case kFBVideoFormat_RGBA_32:
-                dst->format = ms::TextureFormat::RGBAu8;
-                data.assign(image, image + (num_pixels * 4));
-                break;
-            case kFBVideoFormat_ABGR_32:
-                dst->format = ms::TextureFormat::RGBAu8;
-                data.resize_discard(num_pixels * 4);
-                mu::ABGR2RGBA((mu::unorm8x4*)data.data(), (mu::unorm8x4*)image, num_pixels);
-                break;
-            case kFBVideoFormat_ARGB_32:
-                dst->format = ms::TextureFormat::RGBAu8;
-                data.resize_discard(num_pixels * 4);
-                mu::ARGB2RGBA((mu::unorm8x4*)data.data(), (mu::unorm8x4*)image, num_pixels);
-                break;
-            case kFBVideoFormat_BGRA_32:
-                dst->format = ms::TextureFormat::RGBAu8;
-                data.resize_discard(num_pixels * 4);
-                mu::BGRA2RGBA((mu::unorm8x4*)data.data(), (mu::unorm8x4*)image, num_pixels);
-                break;
-            case kFBVideoFormat_RGB_24:
-                dst->format = ms::TextureFormat::RGBu8;
-                data.assign(image, image + (num_pixels * 3));
-                break;
-            case kFBVideoFormat_BGR_24:
-                dst->format = ms::TextureFormat::RGBu8;
-                data.resize_discard(num_pixels * 3);
-                mu::BGR2RGB((mu::unorm8x3*)data.data(), (mu::unorm8x3*)image, num_pixels);
-                break;
-            default:
-                // not supported
-                break;
-            }
-        }
+        ExtractVideoPixels(*dst, video);
     }
 
-    if (!data.empty()) {
+    if (raw_file || !dst->data.empty()) {
         m_textures.push_back(dst);
         rec.dst = dst.get();
         if (rec.id == -1)
@@ -821,25 +844,84 @@ bool msmbDevice::exportAnimations()
     std::tie(time_begin, time_end) = GetTimeRange(system.CurrentTake);
     double interval = 1.0 / std::max(samples_per_second, 1.0f);
 
-    int reserve_size = int((time_end - time_begin) / interval) + 1;
-    for (auto& kvp : m_anim_records) {
-        kvp.second.dst->reserve(reserve_size);
+    // stream keys in chunks if the server can append them. memory usage doesn't grow with the length of the take
+    // and the first frames are visible on the Unity side immediately.
+    std::unique_ptr<ms::Client> stream_client;
+    ms::AnimationChunkMessage chunk;
+    if (animation_chunk_frames > 0) {
+        stream_client.reset(new ms::Client(client_settings));
+        if (stream_client->handshake() && stream_client->getCapabilities().features.animation_chunk) {
+            chunk.transfer_id = (uint64_t)mu::Now();
+            chunk.clip = m_animations.front()->name;
+            chunk.scene_settings.handedness = ms::Handedness::Right;
+            chunk.scene_settings.scale_factor = scale_factor;
+        }
+        else {
+            stream_client.reset();
+        }
     }
+    auto& animations = m_animations.front()->animations;
+    auto send_chunk = [&](bool last) {
+        chunk.time_end = m_anim_time * time_scale;
+        chunk.last = last;
+        // extractors set the path every frame. animations cleared by the previous chunk and not extracted since
+        // have no path and no keys. if no frame is left for the last chunk, it only tells the server the clip is complete.
+        chunk.animations.clear();
+        for (auto& anim : animations) {
+            if (!anim->path.empty())
+                chunk.animations.push_back(anim);
+        }
+        bool ret = stream_client->send(chunk);
+        for (auto& anim : animations)
+            anim->clear();
+        chunk.time_begin = chunk.time_end;
+        return ret;
+    };
+
+    // advance frame and record. returns false if a chunk failed to be sent.
+    auto bake = [&]() {
+        int reserve_size = int((time_end - time_begin) / interval) + 1;
+        if (stream_client)
+            reserve_size = std::min(reserve_size, animation_chunk_frames);
+        for (auto& kvp : m_anim_records) {
+            kvp.second.dst->reserve(reserve_size);
+        }
 
-    // advance frame and record
-    for (double t = time_begin; t < time_end; t += interval) {
-        FBTime fbt;
-        fbt.SetSecondDouble(t);
-        control.Goto(fbt);
-        m_anim_time = (float)t;
-        for (auto& kvp : m_anim_records)
-            kvp.second(this);
+        chunk.time_begin = (float)time_begin * time_scale;
+        int num_frames = 0;
+        for (double t = time_begin; t < time_end; t += interval) {
+            FBTime fbt;
+            fbt.SetSecondDouble(t);
+            control.Goto(fbt);
+            m_anim_time = (float)t;
+            for (auto& kvp : m_anim_records)
+                kvp.second(this);
+
+            if (stream_client && ++num_frames % animation_chunk_frames == 0 && !send_chunk(false))
+                return false;
+        }
+        // the server reduces keyframes of the whole clip when the last chunk arrives
+        return !stream_client || send_chunk(true);
+    };
+
+    if (!bake()) {
+        // the server stopped accepting chunks. keys already sent are gone on this side,
+        // so bake again from the beginning and send the clip as a whole.
+        stream_client.reset();
+        for (auto& anim : animations)
+            anim->clear();
+        bake();
     }
 
     // cleanup
     m_anim_records.clear();
     control.Goto(time_current);
 
+    if (stream_client) {
+        m_animations.clear();
+        return true;
+    }
+
     // keyframe reduction
     for (auto& clip : m_animations)
         clip->reduction();
@@ -921,8 +1003,8 @@ void msmbDevice::extractCameraAnimation(ms::Animation& dst_, FBModel* src)
 
     auto& dst = static_cast<ms::CameraAnimation&>(dst_);
     {
-        auto& last = dst.rotation.back();
-        last.value *= mu::rotateY(90.0f * mu::Deg2Rad);
+        auto& last = dst.rotation.values.back();
+        last *= mu::rotateY(90.0f * mu::Deg2Rad);
     }
 
     bool ortho;
@@ -941,8 +1023,8 @@ void msmbDevice::extractLightAnimation(ms::Animation& dst_, FBModel* src)
 
     auto& dst = static_cast<ms::LightAnimation&>(dst_);
     {
-        auto& last = dst.rotation.back();
-        last.value *= mu::rotateX(90.0f * mu::Deg2Rad);
+        auto& last = dst.rotation.values.back();
+        last *= mu::rotateX(90.0f * mu::Deg2Rad);
     }
 
     ms::Light::LightType type;
@@ -106,6 +106,7 @@ private:
     std::vector<ms::ConstraintPtr>      m_constraints;
     std::vector<std::string>            m_deleted;
     std::future<void>                   m_future_send;
+    ms::TextureLoader                   m_texture_loader;
 
 public:
     ms::ClientSettings client_settings;
@@ -113,6 +114,7 @@ public:
     float scale_factor = 100.0f;
     float time_scale = 1.0f;
     float samples_per_second = 3.0f;
+    int animation_chunk_frames = 256; // stream animations in chunks of this many frames if the server supports it. 0: send as a whole
 
     bool auto_sync = false;
     bool sync_cameras = true;
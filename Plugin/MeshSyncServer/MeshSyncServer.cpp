@@ -98,6 +98,53 @@ msAPI void msServerSetScreenshotFilePath(ms::Server *server, const char *path)
     server->setScrrenshotFilePath(path);
 }
 
+// stats: ms::Profiler::Stats is an array of ProfileStage::Count entries.
+// each entry is { count, total_ns, max_ns, bytes, histogram[NumBuckets] } of uint64.
+msAPI int msServerGetNumStatsStages() { return (int)ms::ProfileStage::Count; }
+msAPI int msServerGetNumStatsBuckets() { return ms::Profiler::NumBuckets; }
+msAPI const char* msServerGetStatsStageName(int i)
+{
+    if (i < 0 || i >= (int)ms::ProfileStage::Count) { return ""; }
+    return ms::Profiler::getStageName((ms::ProfileStage)i);
+}
+msAPI void msServerGetStats(ms::Server *server, ms::Profiler::Stats *dst)
+{
+    if (!server || !dst) { return; }
+    *dst = server->getProfiler().getStats();
+}
+msAPI void msServerResetStats(ms::Server *server)
+{
+    if (!server) { return; }
+    server->getProfiler().reset();
+}
+
+// object pools. ms::PoolStats is { capacity, in_use, hits, misses } of uint64.
+// pools are shared by all servers and are listed in the order they are first used.
+msAPI int msPoolGetCount()
+{
+    std::unique_lock<std::mutex> lock(ms::GetPoolsMutex());
+    return (int)ms::GetPools().size();
+}
+msAPI const char* msPoolGetName(int i)
+{
+    std::unique_lock<std::mutex> lock(ms::GetPoolsMutex());
+    auto& pools = ms::GetPools();
+    if (i < 0 || i >= (int)pools.size()) { return ""; }
+    return pools[i]->getName();
+}
+msAPI void msPoolGetStats(int i, ms::PoolStats *dst)
+{
+    std::unique_lock<std::mutex> lock(ms::GetPoolsMutex());
+    auto& pools = ms::GetPools();
+    if (i < 0 || i >= (int)pools.size() || !dst) { return; }
+    *dst = pools[i]->getStats();
+}
+// delete retained objects. useful after a huge scene is cleared.
+msAPI void msPoolTrimAll()
+{
+    ms::TrimPools();
+}
+
 msAPI int msGetGetBakeSkin(ms::GetMessage *_this)
 {
     return _this->refine_settings.flags.bake_skin;
@@ -150,6 +197,8 @@ msAPI int               msTextureGetWidth(ms::Texture *_this) { return _this->wi
 msAPI void              msTextureSetWidth(ms::Texture *_this, int v) { _this->width = v; }
 msAPI int               msTextureGetHeight(ms::Texture *_this) { return _this->height; }
 msAPI void              msTextureSetHeight(ms::Texture *_this, int v) { _this->height = v; }
+msAPI bool              msTextureGetHasMipmaps(ms::Texture *_this) { return _this->has_mipmaps; }
+msAPI void              msTextureSetHasMipmaps(ms::Texture *_this, bool v) { _this->has_mipmaps = v; }
 msAPI void              msTextureGetData(ms::Texture *_this, void *v) { _this->getData(v); }
 msAPI void              msTextureSetData(ms::Texture *_this, const void *v) { _this->setData(v); }
 msAPI void*             msTextureGetDataPtr(ms::Texture *_this) { return _this->data.data(); }
@@ -282,6 +331,12 @@ msAPI void msQueryAddResponseText(ms::QueryMessage *_this, const char *text)
 }
 
 
+// served meshes are refined again only when they are touched. see ms::Server::endServe()
+static inline void TouchMesh(ms::Transform *v)
+{
+    if (v->getType() == ms::Entity::Type::Mesh)
+        static_cast<ms::Mesh*>(v)->touch();
+}
 
 msAPI ms::Transform* msTransformCreate()
 {
@@ -298,6 +353,7 @@ msAPI int msTransformGetID(ms::Transform *_this)
 msAPI void msTransformSetID(ms::Transform *_this, int v)
 {
     _this->id = v;
+    TouchMesh(_this);
 }
 msAPI int msTransformGetIndex(ms::Transform *_this)
 {
@@ -306,6 +362,7 @@ msAPI int msTransformGetIndex(ms::Transform *_this)
 msAPI void msTransformSetIndex(ms::Transform *_this, int v)
 {
     _this->index = v;
+    TouchMesh(_this);
 }
 msAPI const char* msTransformGetPath(ms::Transform *_this)
 {
@@ -314,6 +371,7 @@ msAPI const char* msTransformGetPath(ms::Transform *_this)
 msAPI void msTransformSetPath(ms::Transform *_this, const char *v)
 {
     _this->path = v;
+    TouchMesh(_this);
 }
 msAPI mu::float3 msTransformGetPosition(ms::Transform *_this)
 {
@@ -322,6 +380,7 @@ msAPI mu::float3 msTransformGetPosition(ms::Transform *_this)
 msAPI void msTransformSetPosition(ms::Transform *_this, mu::float3 v)
 {
     _this->position = v;
+    TouchMesh(_this);
 }
 msAPI mu::quatf msTransformGetRotation(ms::Transform *_this)
 {
@@ -330,6 +389,7 @@ msAPI mu::quatf msTransformGetRotation(ms::Transform *_this)
 msAPI void msTransformSetRotation(ms::Transform *_this, mu::quatf v)
 {
     _this->rotation = v;
+    TouchMesh(_this);
 }
 msAPI mu::float3 msTransformGetScale(ms::Transform *_this)
 {
@@ -338,6 +398,7 @@ msAPI mu::float3 msTransformGetScale(ms::Transform *_this)
 msAPI void msTransformSetScale(ms::Transform *_this, mu::float3 v)
 {
     _this->scale = v;
+    TouchMesh(_this);
 }
 msAPI bool msTransformGetVisible(ms::Transform *_this)
 {
@@ -346,6 +407,7 @@ msAPI bool msTransformGetVisible(ms::Transform *_this)
 msAPI void msTransformSetVisible(ms::Transform *_this, bool v)
 {
     _this->visible = v;
+    TouchMesh(_this);
 }
 msAPI bool msTransformGetVisibleHierarchy(ms::Transform *_this)
 {
@@ -354,6 +416,7 @@ msAPI bool msTransformGetVisibleHierarchy(ms::Transform *_this)
 msAPI void msTransformSetVisibleHierarchy(ms::Transform *_this, bool v)
 {
     _this->visible_hierarchy = v;
+    TouchMesh(_this);
 }
 msAPI const char* msTransformGetReference(ms::Transform *_this)
 {
@@ -362,6 +425,7 @@ msAPI const char* msTransformGetReference(ms::Transform *_this)
 msAPI void msTransformSetReference(ms::Transform *_this, const char *v)
 {
     _this->reference = v;
+    TouchMesh(_this);
 }
 
 msAPI ms::Camera* msCameraCreate()
@@ -490,6 +554,7 @@ msAPI ms::MeshDataFlags msMeshGetFlags(ms::Mesh *_this)
 msAPI void msMeshSetFlags(ms::Mesh *_this, ms::MeshDataFlags v)
 {
     _this->flags = v;
+    _this->touch();
 }
 msAPI int msMeshGetNumPoints(ms::Mesh *_this)
 {
@@ -516,6 +581,7 @@ msAPI void msMeshWritePoints(ms::Mesh *_this, const float3 *v, int size)
         _this->points.assign(v, v + size);
         _this->flags.has_points = 1;
     }
+    _this->touch();
 }
 msAPI void msMeshReadNormals(ms::Mesh *_this, float3 *dst, ms::SplitData *split)
 {
@@ -530,6 +596,7 @@ msAPI void msMeshWriteNormals(ms::Mesh *_this, const float3 *v, int size)
         _this->normals.assign(v, v + size);
         _this->flags.has_normals = 1;
     }
+    _this->touch();
 }
 msAPI void msMeshReadTangents(ms::Mesh *_this, float4 *dst, ms::SplitData *split)
 {
@@ -544,6 +611,7 @@ msAPI void msMeshWriteTangents(ms::Mesh *_this, const float4 *v, int size)
         _this->tangents.assign(v, v + size);
         _this->flags.has_tangents = 1;
     }
+    _this->touch();
 }
 msAPI void msMeshReadUV0(ms::Mesh *_this, float2 *dst, ms::SplitData *split)
 {
@@ -565,6 +633,7 @@ msAPI void msMeshWriteUV0(ms::Mesh *_this, const float2 *v, int size)
         _this->uv0.assign(v, v + size);
         _this->flags.has_uv0 = 1;
     }
+    _this->touch();
 }
 msAPI void msMeshWriteUV1(ms::Mesh *_this, const float2 *v, int size)
 {
@@ -572,6 +641,7 @@ msAPI void msMeshWriteUV1(ms::Mesh *_this, const float2 *v, int size)
         _this->uv1.assign(v, v + size);
         _this->flags.has_uv1 = 1;
     }
+    _this->touch();
 }
 msAPI void msMeshReadColors(ms::Mesh *_this, float4 *dst, ms::SplitData *split)
 {
@@ -586,6 +656,7 @@ msAPI void msMeshWriteColors(ms::Mesh *_this, const float4 *v, int size)
         _this->colors.assign(v, v + size);
         _this->flags.has_colors = 1;
     }
+    _this->touch();
 }
 msAPI void msMeshReadIndices(ms::Mesh *_this, int *dst, ms::SplitData *split)
 {
@@ -602,6 +673,7 @@ msAPI void msMeshWriteIndices(ms::Mesh *_this, const int *v, int size)
         _this->counts.resize(size / 3, 3);
         _this->flags.has_indices = 1;
     }
+    _this->touch();
 }
 msAPI void msMeshWriteSubmeshTriangles(ms::Mesh *_this, const int *v, int size, int materialID)
 {
@@ -612,6 +684,7 @@ msAPI void msMeshWriteSubmeshTriangles(ms::Mesh *_this, const int *v, int size,
         _this->flags.has_indices = 1;
         _this->flags.has_material_ids = 1;
     }
+    _this->touch();
 }
 msAPI ms::SplitData* msMeshGetSplit(ms::Mesh *_this, int i)
 {
@@ -627,6 +700,24 @@ msAPI ms::SubmeshData* msMeshGetSubmesh(ms::Mesh *_this, int i)
     return &_this->submeshes[i];
 }
 
+msAPI mu::VertexFormat msMeshGetVertexFormat(ms::Mesh *_this)
+{
+    return _this->vertices.empty() ? mu::VertexFormat::Unknown : _this->vertex_format;
+}
+msAPI int msMeshGetVertexSize(ms::Mesh *_this)
+{
+    return (int)mu::GetVertexSize(msMeshGetVertexFormat(_this));
+}
+// copy interleaved vertices as they are. dst must have vertex_count * msMeshGetVertexSize() bytes.
+msAPI void msMeshReadVertices(ms::Mesh *_this, void *dst, ms::SplitData *split)
+{
+    size_t stride = mu::GetVertexSize(msMeshGetVertexFormat(_this));
+    if (split)
+        memcpy(dst, _this->vertices.data() + stride * split->vertex_offset, stride * split->vertex_count);
+    else
+        memcpy(dst, _this->vertices.data(), _this->vertices.size());
+}
+
 msAPI void msMeshReadWeights4(ms::Mesh *_this, ms::Weights4 *dst, ms::SplitData *split)
 {
     if (split)
@@ -637,6 +728,7 @@ msAPI void msMeshReadWeights4(ms::Mesh *_this, ms::Weights4 *dst, ms::SplitData
 msAPI void msMeshWriteWeights4(ms::Mesh *_this, const ms::Weights4 *v, int size)
 {
     _this->weights4.assign(v, v + size);
+    _this->touch();
 }
 msAPI int msMeshGetNumBones(ms::Mesh *_this)
 {
@@ -649,6 +741,7 @@ msAPI const char* msMeshGetRootBonePath(ms::Mesh *_this)
 msAPI void msMeshSetRootBonePath(ms::Mesh *_this, const char *v)
 {
     _this->root_bone = v;
+    _this->touch();
 }
 msAPI const char* msMeshGetBonePath(ms::Mesh *_this, int i)
 {
@@ -660,6 +753,7 @@ msAPI void msMeshSetBonePath(ms::Mesh *_this, const char *v, int i)
         _this->bones.push_back(ms::BoneData::create());
     }
     _this->bones[i]->path = v;
+    _this->touch();
 }
 msAPI void msMeshReadBindPoses(ms::Mesh *_this, float4x4 *v)
 {
@@ -674,6 +768,7 @@ msAPI void msMeshWriteBindPoses(ms::Mesh *_this, const float4x4 *v, int size)
     for (int bi = 0; bi < num_bones; ++bi) {
         _this->bones[bi]->bindpose = v[bi];
     }
+    _this->touch();
 }
 
 msAPI int msMeshGetNumBlendShapes(ms::Mesh *_this)
@@ -689,16 +784,19 @@ msAPI ms::BlendShapeData* msMeshAddBlendShape(ms::Mesh *_this, const char *name)
     auto ret = ms::BlendShapeData::create();
     ret->name = name;
     _this->blendshapes.push_back(ret);
+    _this->touch();
     return ret.get();
 }
 
 msAPI void msMeshSetLocal2World(ms::Mesh *_this, const float4x4 *v)
 {
     _this->refine_settings.local2world = *v;
+    _this->touch();
 }
 msAPI void msMeshSetWorld2Local(ms::Mesh *_this, const float4x4 *v)
 {
     _this->refine_settings.world2local = *v;
+    _this->touch();
 }
 
 
@@ -718,6 +816,10 @@ msAPI float3 msSplitGetBoundsSize(ms::SplitData *_this)
 {
     return _this->bound_size;
 }
+msAPI ms::SplitData::IndexFormat msSplitGetIndexFormat(ms::SplitData *_this)
+{
+    return _this->index_format;
+}
 msAPI int msSplitGetNumSubmeshes(ms::SplitData *_this)
 {
     return (int)_this->submeshes.size();
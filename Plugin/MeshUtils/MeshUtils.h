@@ -3,12 +3,15 @@
 #include <vector>
 #include <memory>
 #include "muRawVector.h"
+#include "muHashMap.h"
 #include "muIntrusiveArray.h"
 #include "muMath.h"
 #include "muHalf.h"
 #include "muSIMD.h"
 #include "muVertex.h"
 #include "muColor.h"
+#include "muTextureCompression.h"
+#include "muMipmap.h"
 #include "muTLS.h"
 #include "muMisc.h"
 #include "muConcurrency.h"
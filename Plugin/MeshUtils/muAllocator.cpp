@@ -1,17 +1,59 @@
 #include "pch.h"
 #include "muAllocator.h"
+#include <atomic>
+#ifdef __linux__
+    #include <sys/mman.h>
+#endif
+
+static const size_t HugePageSize = 2 * 1024 * 1024;
+
+static std::atomic<size_t> g_huge_page_threshold{ 8 * 1024 * 1024 };
+static std::atomic<bool> g_first_touch{ false };
+
+void   SetHugePageThreshold(size_t size) { g_huge_page_threshold = size; }
+size_t GetHugePageThreshold() { return g_huge_page_threshold; }
+void   SetFirstTouch(bool v) { g_first_touch = v; }
+bool   GetFirstTouch() { return g_first_touch; }
+
+// touched on the calling thread. allocations must not schedule tasks: they happen everywhere,
+// including inside tasks of parallel_for() and while locks are held.
+static void FirstTouch(void *addr, size_t size)
+{
+    const size_t page_size = 4096;
+    char *data = (char*)addr;
+    for (size_t i = 0; i < size; i += page_size)
+        data[i] = 0;
+}
 
 void* AlignedMalloc(size_t size, size_t alignment)
 {
+    size_t threshold = g_huge_page_threshold;
+    bool large = threshold != 0 && size >= threshold;
+#ifdef __linux__
+    if (large) {
+        alignment = std::max(alignment, HugePageSize);
+        size_t mask = HugePageSize - 1;
+        size = (size + mask) & (~mask);
+    }
+#endif
+
     size_t mask = alignment - 1;
     size = (size + mask) & (~mask);
 #ifdef _WIN32
-    return _mm_malloc(size, alignment);
+    void *ret = _mm_malloc(size, alignment);
 #else
     void *ret = nullptr;
     posix_memalign(&ret, alignment, size);
-    return ret;
 #endif
+
+    if (ret && large) {
+#ifdef __linux__
+        madvise(ret, size, MADV_HUGEPAGE);
+#endif
+        if (g_first_touch)
+            FirstTouch(ret, size);
+    }
+    return ret;
 }
 
 void AlignedFree(void *addr)
@@ -22,3 +64,97 @@ void AlignedFree(void *addr)
     free(addr);
 #endif
 }
+
+Arena::Arena(size_t block_size)
+    : m_block_size(block_size)
+{
+}
+
+Arena::~Arena()
+{
+    for (auto& b : m_blocks)
+        AlignedFree(b.data);
+}
+
+void Arena::addBlock(size_t min_size)
+{
+    Block b;
+    b.size = std::max(m_block_size, min_size);
+    b.data = (char*)AlignedMalloc(b.size, 0x40);
+    m_blocks.push_back(b);
+}
+
+void* Arena::allocate(size_t size, size_t alignment)
+{
+    if (size == 0)
+        return nullptr;
+
+    size_t mask = alignment - 1;
+    if (m_blocks.empty())
+        addBlock(size);
+
+    auto *b = &m_blocks.back();
+    size_t pos = (b->pos + mask) & ~mask;
+    if (pos + size > b->size) {
+        addBlock(size);
+        b = &m_blocks.back();
+        pos = 0;
+    }
+    b->pos = pos + size;
+    m_last = b->data + pos;
+    return m_last;
+}
+
+void Arena::deallocate(void *addr, size_t /*size*/)
+{
+    if (addr && addr == m_last) {
+        auto& b = m_blocks.back();
+        b.pos = (size_t)(m_last - b.data);
+        m_last = nullptr;
+    }
+}
+
+bool Arena::expand(void *addr, size_t /*size*/, size_t new_size)
+{
+    if (!addr || addr != m_last)
+        return false;
+    auto& b = m_blocks.back();
+    size_t pos = (size_t)(m_last - b.data);
+    if (pos + new_size > b.size)
+        return false;
+    b.pos = pos + new_size;
+    return true;
+}
+
+void Arena::reset()
+{
+    m_last = nullptr;
+    if (m_blocks.size() > 1) {
+        size_t total = 0;
+        for (auto& b : m_blocks) {
+            total += b.size;
+            AlignedFree(b.data);
+        }
+        m_blocks.clear();
+        addBlock(total);
+    }
+    else if (!m_blocks.empty()) {
+        m_blocks.back().pos = 0;
+    }
+}
+
+size_t Arena::getUsedSize() const
+{
+    size_t ret = 0;
+    for (auto& b : m_blocks)
+        ret += b.pos;
+    return ret;
+}
+
+size_t Arena::getReservedSize() const
+{
+    size_t ret = 0;
+    for (auto& b : m_blocks)
+        ret += b.size;
+    return ret;
+}
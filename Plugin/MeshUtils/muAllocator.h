@@ -1,4 +1,76 @@
 #pragma once
 
+#include <cstddef>
+#include <vector>
+
 void* AlignedMalloc(size_t size, size_t alignment);
 void  AlignedFree(void *addr);
+
+// settings of large allocations by AlignedMalloc(). these are global and not meant to be changed while allocating.
+// allocations of this size or larger are aligned to 2MB and advised to be backed by transparent huge pages,
+// which reduces TLB misses of gather-heavy loops over huge meshes. Linux only. 0: disabled
+void   SetHugePageThreshold(size_t size);
+size_t GetHugePageThreshold();
+// touch pages of allocations larger than the threshold above right after allocation, on the allocating thread.
+// page faults are taken up front instead of in the loops that fill the buffer, and on NUMA systems the pages are placed
+// on the node of the allocating thread. meshes are refined by worker threads, so that is the node of the worker that
+// processes them. disabled by default.
+void   SetFirstTouch(bool v);
+bool   GetFirstTouch();
+
+
+// allocator policies of RawVector.
+// allocate() / deallocate() get sizes in byte. expand() grows an allocation in place if possible.
+
+struct AlignedAllocator
+{
+    void* allocate(size_t size, size_t alignment) { return AlignedMalloc(size, alignment); }
+    void deallocate(void *addr, size_t /*size*/) { AlignedFree(addr); }
+    bool expand(void * /*addr*/, size_t /*size*/, size_t /*new_size*/) { return false; }
+};
+
+// bump allocator. memory is released all at once by reset() or the destructor.
+// deallocate() and expand() work only for the last allocation, which is the common case of a growing vector.
+// not thread safe. use one arena per thread or per task.
+class Arena
+{
+public:
+    explicit Arena(size_t block_size = 1024 * 1024);
+    ~Arena();
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+
+    void* allocate(size_t size, size_t alignment);
+    void deallocate(void *addr, size_t size);
+    bool expand(void *addr, size_t size, size_t new_size);
+
+    // invalidate all allocations. if the previous round used multiple blocks, they are merged into one
+    // so that the next round of the same workload fits in a single block.
+    void reset();
+
+    size_t getUsedSize() const;     // in byte
+    size_t getReservedSize() const; // in byte
+
+private:
+    struct Block
+    {
+        char *data = nullptr;
+        size_t size = 0;
+        size_t pos = 0;
+    };
+    void addBlock(size_t min_size);
+
+    size_t m_block_size;
+    std::vector<Block> m_blocks;
+    char *m_last = nullptr; // the last allocation
+};
+
+struct ArenaAllocator
+{
+    Arena *arena = nullptr;
+
+    ArenaAllocator(Arena *a = nullptr) : arena(a) {}
+    void* allocate(size_t size, size_t alignment) { return arena->allocate(size, alignment); }
+    void deallocate(void *addr, size_t size) { arena->deallocate(addr, size); }
+    bool expand(void *addr, size_t size, size_t new_size) { return arena->expand(addr, size, new_size); }
+};
@@ -1,2 +1,386 @@
 #include "pch.h"
 #include "muColor.h"
+#include "muSIMDConfig.h"
+#include "muConcurrency.h"
+
+namespace mu {
+
+static inline float LinearToSRGBImpl(float v)
+{
+    return v <= 0.0031308f ? v * 12.92f : 1.055f * std::pow(v, 1.0f / 2.4f) - 0.055f;
+}
+static inline float SRGBToLinearImpl(float v)
+{
+    return v <= 0.04045f ? v * (1.0f / 12.92f) : std::pow((v + 0.055f) * (1.0f / 1.055f), 2.4f);
+}
+static inline float RoundSigned(float v)
+{
+    return v + (v < 0.0f ? -0.5f : 0.5f);
+}
+
+void Swizzle_Generic(unorm8x4 *dst, const unorm8x4 *src, size_t num, int r, int g, int b, int a)
+{
+    // treat pixels as uint32 so that this is vectorized
+    auto *d = (uint32_t*)dst;
+    auto *s = (const uint32_t*)src;
+    uint32_t sr = r * 8, sg = g * 8, sb = b * 8, sa = a * 8;
+    for (size_t i = 0; i < num; ++i) {
+        uint32_t v = s[i];
+        d[i] = ((v >> sr) & 0xff) | (((v >> sg) & 0xff) << 8) | (((v >> sb) & 0xff) << 16) | (((v >> sa) & 0xff) << 24);
+    }
+}
+
+void U8ToF32_Generic(float *dst, const unorm8 *src, size_t num)
+{
+    auto *s = (const uint8_t*)src;
+    for (size_t i = 0; i < num; ++i)
+        dst[i] = (float)s[i] * (1.0f / 255.0f);
+}
+void F32ToU8_Generic(unorm8 *dst, const float *src, size_t num)
+{
+    auto *d = (uint8_t*)dst;
+    for (size_t i = 0; i < num; ++i)
+        d[i] = (uint8_t)(clamp01(src[i]) * 255.0f + 0.5f);
+}
+void U16ToF32_Generic(float *dst, const unorm16 *src, size_t num)
+{
+    auto *s = (const uint16_t*)src;
+    for (size_t i = 0; i < num; ++i)
+        dst[i] = (float)s[i] * (1.0f / 65535.0f);
+}
+void F32ToU16_Generic(unorm16 *dst, const float *src, size_t num)
+{
+    auto *d = (uint16_t*)dst;
+    for (size_t i = 0; i < num; ++i)
+        d[i] = (uint16_t)(clamp01(src[i]) * 65535.0f + 0.5f);
+}
+void I16ToF32_Generic(float *dst, const snorm16 *src, size_t num)
+{
+    auto *s = (const int16_t*)src;
+    for (size_t i = 0; i < num; ++i)
+        dst[i] = std::max((float)s[i] * (1.0f / 32767.0f), -1.0f);
+}
+void F32ToI16_Generic(snorm16 *dst, const float *src, size_t num)
+{
+    auto *d = (int16_t*)dst;
+    for (size_t i = 0; i < num; ++i)
+        d[i] = (int16_t)RoundSigned(saturate(src[i]) * 32767.0f);
+}
+
+void LinearToSRGB_Generic(float4 *dst, size_t num)
+{
+    for (size_t i = 0; i < num; ++i) {
+        auto& c = dst[i];
+        c.x = LinearToSRGBImpl(c.x);
+        c.y = LinearToSRGBImpl(c.y);
+        c.z = LinearToSRGBImpl(c.z);
+    }
+}
+void SRGBToLinear_Generic(float4 *dst, size_t num)
+{
+    for (size_t i = 0; i < num; ++i) {
+        auto& c = dst[i];
+        c.x = SRGBToLinearImpl(c.x);
+        c.y = SRGBToLinearImpl(c.y);
+        c.z = SRGBToLinearImpl(c.z);
+    }
+}
+
+void Premultiply_Generic(float4 *dst, size_t num)
+{
+    for (size_t i = 0; i < num; ++i) {
+        auto& c = dst[i];
+        c.x *= c.w;
+        c.y *= c.w;
+        c.z *= c.w;
+    }
+}
+
+
+#ifdef muEnableISPC
+#include "MeshUtilsCore.h"
+
+#ifdef muSIMD_Swizzle
+void Swizzle_ISPC(unorm8x4 *dst, const unorm8x4 *src, size_t num, int r, int g, int b, int a)
+{
+    ispc::Swizzle4u8((uint32_t*)dst, (const uint32_t*)src, (int)num, r, g, b, a);
+}
+#endif
+
+#ifdef muSIMD_PixelConversion
+void U8ToF32_ISPC(float *dst, const unorm8 *src, size_t num)
+{
+    ispc::U8ToF32(dst, (const uint8_t*)src, (int)num);
+}
+void F32ToU8_ISPC(unorm8 *dst, const float *src, size_t num)
+{
+    ispc::F32ToU8((uint8_t*)dst, src, (int)num);
+}
+void U16ToF32_ISPC(float *dst, const unorm16 *src, size_t num)
+{
+    ispc::U16ToF32(dst, (const uint16_t*)src, (int)num);
+}
+void F32ToU16_ISPC(unorm16 *dst, const float *src, size_t num)
+{
+    ispc::F32ToU16((uint16_t*)dst, src, (int)num);
+}
+void I16ToF32_ISPC(float *dst, const snorm16 *src, size_t num)
+{
+    ispc::I16ToF32(dst, (const int16_t*)src, (int)num);
+}
+void F32ToI16_ISPC(snorm16 *dst, const float *src, size_t num)
+{
+    ispc::F32ToI16((int16_t*)dst, src, (int)num);
+}
+#endif
+
+#ifdef muSIMD_ColorSpace
+void LinearToSRGB_ISPC(float4 *dst, size_t num)
+{
+    ispc::LinearToSRGB4((float*)dst, (int)num);
+}
+void SRGBToLinear_ISPC(float4 *dst, size_t num)
+{
+    ispc::SRGBToLinear4((float*)dst, (int)num);
+}
+#endif
+
+#ifdef muSIMD_Premultiply4
+void Premultiply_ISPC(float4 *dst, size_t num)
+{
+    ispc::Premultiply4((float*)dst, (int)num);
+}
+#endif
+
+#endif // muEnableISPC
+
+
+// process [begin, end) in parallel if num is large enough to be worth it
+template<class Body>
+static inline void EachBlock(size_t num, const Body& body)
+{
+    const size_t block_size = 64 * 1024;
+    if (num <= block_size) {
+        body(size_t(0), num);
+        return;
+    }
+    int num_blocks = (int)((num + block_size - 1) / block_size);
+    parallel_for(0, num_blocks, [&](int bi) {
+        size_t begin = block_size * bi;
+        body(begin, std::min(begin + block_size, num));
+    });
+}
+
+#if defined(muEnableISPC) && defined(muSIMD_Swizzle)
+    #define SwizzleImpl Swizzle_ISPC
+#else
+    #define SwizzleImpl Swizzle_Generic
+#endif
+#if defined(muEnableISPC) && defined(muSIMD_PixelConversion)
+    #define ConvertImpl(Name) Name##_ISPC
+#else
+    #define ConvertImpl(Name) Name##_Generic
+#endif
+#if defined(muEnableISPC) && defined(muSIMD_ColorSpace)
+    #define ColorSpaceImpl(Name) Name##_ISPC
+#else
+    #define ColorSpaceImpl(Name) Name##_Generic
+#endif
+#if defined(muEnableISPC) && defined(muSIMD_Premultiply4)
+    #define PremultiplyImpl Premultiply_ISPC
+#else
+    #define PremultiplyImpl Premultiply_Generic
+#endif
+
+void Swizzle(unorm8x4 *dst, const unorm8x4 *src, size_t num, int r, int g, int b, int a)
+{
+    EachBlock(num, [&](size_t begin, size_t end) {
+        SwizzleImpl(dst + begin, src + begin, end - begin, r, g, b, a);
+    });
+}
+
+void ABGR2RGBA(unorm8x4 *dst, const unorm8x4 *src, int num)
+{
+    Swizzle(dst, src, num, 3, 2, 1, 0);
+}
+void ARGB2RGBA(unorm8x4 *dst, const unorm8x4 *src, int num)
+{
+    Swizzle(dst, src, num, 1, 2, 3, 0);
+}
+void BGRA2RGBA(unorm8x4 *dst, const unorm8x4 *src, int num)
+{
+    Swizzle(dst, src, num, 2, 1, 0, 3);
+}
+void BGR2RGB(unorm8x3 *dst, const unorm8x3 *src, int num)
+{
+    EachBlock(num, [&](size_t begin, size_t end) {
+        auto *d = (uint8_t*)(dst + begin);
+        auto *s = (const uint8_t*)(src + begin);
+        for (size_t i = 0; i < end - begin; ++i, d += 3, s += 3) {
+            uint8_t t0 = s[0], t1 = s[1], t2 = s[2];
+            d[0] = t2; d[1] = t1; d[2] = t0;
+        }
+    });
+}
+
+
+int GetPixelTypeSize(PixelType type)
+{
+    switch (type) {
+    case PixelType::U8: return 1;
+    case PixelType::U16: return 2;
+    case PixelType::I16: return 2;
+    case PixelType::F16: return 2;
+    case PixelType::F32: return 4;
+    }
+    return 0;
+}
+
+static void ToF32(float *dst, const void *src, PixelType src_type, size_t num)
+{
+    switch (src_type) {
+    case PixelType::U8: ConvertImpl(U8ToF32)(dst, (const unorm8*)src, num); break;
+    case PixelType::U16: ConvertImpl(U16ToF32)(dst, (const unorm16*)src, num); break;
+    case PixelType::I16: ConvertImpl(I16ToF32)(dst, (const snorm16*)src, num); break;
+    case PixelType::F16: {
+        auto *s = (const half*)src;
+        for (size_t i = 0; i < num; ++i)
+            dst[i] = s[i];
+        break;
+    }
+    case PixelType::F32: memcpy(dst, src, sizeof(float) * num); break;
+    }
+}
+
+static void FromF32(void *dst, PixelType dst_type, const float *src, size_t num)
+{
+    switch (dst_type) {
+    case PixelType::U8: ConvertImpl(F32ToU8)((unorm8*)dst, src, num); break;
+    case PixelType::U16: ConvertImpl(F32ToU16)((unorm16*)dst, src, num); break;
+    case PixelType::I16: ConvertImpl(F32ToI16)((snorm16*)dst, src, num); break;
+    case PixelType::F16: {
+        auto *d = (half*)dst;
+        for (size_t i = 0; i < num; ++i)
+            d[i] = src[i];
+        break;
+    }
+    case PixelType::F32: memcpy(dst, src, sizeof(float) * num); break;
+    }
+}
+
+void ConvertPixels(void *dst, PixelType dst_type, const void *src, PixelType src_type, size_t num)
+{
+    int dst_size = GetPixelTypeSize(dst_type);
+    int src_size = GetPixelTypeSize(src_type);
+    EachBlock(num, [&](size_t begin, size_t end) {
+        auto *d = (char*)dst + dst_size * begin;
+        auto *s = (const char*)src + src_size * begin;
+        size_t n = end - begin;
+        if (dst_type == src_type) {
+            memcpy(d, s, dst_size * n);
+        }
+        else if (dst_type == PixelType::F32) {
+            ToF32((float*)d, s, src_type, n);
+        }
+        else if (src_type == PixelType::F32) {
+            FromF32(d, dst_type, (const float*)s, n);
+        }
+        else {
+            // via float in chunks that fit in the cache
+            const size_t chunk_size = 4096;
+            float tmp[chunk_size];
+            for (size_t i = 0; i < n; i += chunk_size) {
+                size_t c = std::min(chunk_size, n - i);
+                ToF32(tmp, s + src_size * i, src_type, c);
+                FromF32(d + dst_size * i, dst_type, tmp, c);
+            }
+        }
+    });
+}
+
+
+void LinearToSRGB(float4 *dst, size_t num)
+{
+    EachBlock(num, [&](size_t begin, size_t end) {
+        ColorSpaceImpl(LinearToSRGB)(dst + begin, end - begin);
+    });
+}
+void SRGBToLinear(float4 *dst, size_t num)
+{
+    EachBlock(num, [&](size_t begin, size_t end) {
+        ColorSpaceImpl(SRGBToLinear)(dst + begin, end - begin);
+    });
+}
+
+// 8 bit values have only 256 possible inputs. use lookup tables.
+static void ConvertRGB(unorm8x4 *dst, size_t num, float (*f)(float))
+{
+    uint8_t table[256];
+    for (int i = 0; i < 256; ++i)
+        table[i] = (uint8_t)(clamp01(f((float)i / 255.0f)) * 255.0f + 0.5f);
+
+    EachBlock(num, [&](size_t begin, size_t end) {
+        auto *d = (uint8_t*)(dst + begin);
+        for (size_t i = 0; i < end - begin; ++i, d += 4) {
+            d[0] = table[d[0]];
+            d[1] = table[d[1]];
+            d[2] = table[d[2]];
+        }
+    });
+}
+void LinearToSRGB(unorm8x4 *dst, size_t num)
+{
+    ConvertRGB(dst, num, LinearToSRGBImpl);
+}
+void SRGBToLinear(unorm8x4 *dst, size_t num)
+{
+    ConvertRGB(dst, num, SRGBToLinearImpl);
+}
+
+void Premultiply(float4 *dst, size_t num)
+{
+    EachBlock(num, [&](size_t begin, size_t end) {
+        PremultiplyImpl(dst + begin, end - begin);
+    });
+}
+void Premultiply(unorm8x4 *dst, size_t num)
+{
+    EachBlock(num, [&](size_t begin, size_t end) {
+        auto *d = (uint8_t*)(dst + begin);
+        for (size_t i = 0; i < end - begin; ++i, d += 4) {
+            uint32_t a = d[3];
+            // x * a / 255 with rounding
+            for (int c = 0; c < 3; ++c) {
+                uint32_t t = d[c] * a + 128;
+                d[c] = (uint8_t)((t + (t >> 8)) >> 8);
+            }
+        }
+    });
+}
+
+void FlipY(void *dst, const void *src, size_t pitch, int height)
+{
+    auto *d = (char*)dst;
+    auto *s = (const char*)src;
+    if (dst == src) {
+        // swap rows in place
+        parallel_for(0, height / 2, [&](int y) {
+            char *a = d + pitch * y;
+            char *b = d + pitch * (height - 1 - y);
+            for (size_t i = 0; i < pitch; ++i)
+                std::swap(a[i], b[i]);
+        });
+    }
+    else {
+        parallel_for(0, height, [&](int y) {
+            memcpy(d + pitch * y, s + pitch * (height - 1 - y), pitch);
+        });
+    }
+}
+
+#undef SwizzleImpl
+#undef ConvertImpl
+#undef ColorSpaceImpl
+#undef PremultiplyImpl
+
+} // namespace mu
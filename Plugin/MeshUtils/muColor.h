@@ -40,4 +40,69 @@ inline void BGR2RGB(T *dst, const T *src, int num)
     }
 }
 
+// 8 bit overloads of above. vectorized and processed in parallel on large images.
+void ABGR2RGBA(unorm8x4 *dst, const unorm8x4 *src, int num);
+void ARGB2RGBA(unorm8x4 *dst, const unorm8x4 *src, int num);
+void BGRA2RGBA(unorm8x4 *dst, const unorm8x4 *src, int num);
+void BGR2RGB(unorm8x3 *dst, const unorm8x3 *src, int num);
+
+// dst[i] = { src[i][r], src[i][g], src[i][b], src[i][a] }. dst and src can be the same.
+void Swizzle(unorm8x4 *dst, const unorm8x4 *src, size_t num, int r, int g, int b, int a);
+
+
+// channel types of pixel data. integer types are normalized: [0, 1] for unsigned and [-1, 1] for signed.
+enum class PixelType
+{
+    U8,  // unorm8
+    U16, // unorm16
+    I16, // snorm16
+    F16, // half
+    F32, // float
+};
+int GetPixelTypeSize(PixelType type);
+
+// convert num channel values (not pixels). values out of range of dst are clamped.
+void ConvertPixels(void *dst, PixelType dst_type, const void *src, PixelType src_type, size_t num);
+
+// color space conversion of RGB. alpha is left as is.
+void LinearToSRGB(float4 *dst, size_t num);
+void SRGBToLinear(float4 *dst, size_t num);
+void LinearToSRGB(unorm8x4 *dst, size_t num);
+void SRGBToLinear(unorm8x4 *dst, size_t num);
+
+// multiply RGB by alpha
+void Premultiply(float4 *dst, size_t num);
+void Premultiply(unorm8x4 *dst, size_t num);
+
+// flip rows. pitch is the size of a row in byte. dst and src can be the same.
+void FlipY(void *dst, const void *src, size_t pitch, int height);
+
+
+// ------------------------------------------------------------
+// internal (for test)
+// ------------------------------------------------------------
+void Swizzle_Generic(unorm8x4 *dst, const unorm8x4 *src, size_t num, int r, int g, int b, int a);
+void Swizzle_ISPC(unorm8x4 *dst, const unorm8x4 *src, size_t num, int r, int g, int b, int a);
+
+void U8ToF32_Generic(float *dst, const unorm8 *src, size_t num);
+void U8ToF32_ISPC(float *dst, const unorm8 *src, size_t num);
+void F32ToU8_Generic(unorm8 *dst, const float *src, size_t num);
+void F32ToU8_ISPC(unorm8 *dst, const float *src, size_t num);
+void U16ToF32_Generic(float *dst, const unorm16 *src, size_t num);
+void U16ToF32_ISPC(float *dst, const unorm16 *src, size_t num);
+void F32ToU16_Generic(unorm16 *dst, const float *src, size_t num);
+void F32ToU16_ISPC(unorm16 *dst, const float *src, size_t num);
+void I16ToF32_Generic(float *dst, const snorm16 *src, size_t num);
+void I16ToF32_ISPC(float *dst, const snorm16 *src, size_t num);
+void F32ToI16_Generic(snorm16 *dst, const float *src, size_t num);
+void F32ToI16_ISPC(snorm16 *dst, const float *src, size_t num);
+
+void LinearToSRGB_Generic(float4 *dst, size_t num);
+void LinearToSRGB_ISPC(float4 *dst, size_t num);
+void SRGBToLinear_Generic(float4 *dst, size_t num);
+void SRGBToLinear_ISPC(float4 *dst, size_t num);
+
+void Premultiply_Generic(float4 *dst, size_t num);
+void Premultiply_ISPC(float4 *dst, size_t num);
+
 } // namespace mu
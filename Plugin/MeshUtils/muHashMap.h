@@ -0,0 +1,236 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <utility>
+#include <functional>
+#include <type_traits>
+#include <new>
+
+namespace mu {
+
+// open addressing hash map with linear probing.
+// entries live in one flat array, so lookups don't chase nodes like std::map / std::unordered_map do.
+// erased slots become tombstones. erase() never moves other entries, so erasing while iterating is safe
+// (same as std::map: m.erase(it++)). inserting may rehash and invalidates iterators and references.
+// values only have to be move constructible.
+template<class K, class V, class Hash = std::hash<K>, class Eq = std::equal_to<K>>
+class FlatHashMap
+{
+public:
+    using key_type = K;
+    using mapped_type = V;
+    using value_type = std::pair<const K, V>;
+    using size_type = size_t;
+
+    template<class Map, class T>
+    class iterator_t
+    {
+    public:
+        iterator_t() {}
+        iterator_t(Map *m, size_t i) : m_map(m), m_index(i) { skip(); }
+        template<class M2, class T2>
+        iterator_t(const iterator_t<M2, T2>& v) : m_map(v.m_map), m_index(v.m_index) {}
+
+        T& operator*() const { return m_map->slot(m_index); }
+        T* operator->() const { return &m_map->slot(m_index); }
+        iterator_t& operator++() { ++m_index; skip(); return *this; }
+        iterator_t operator++(int) { auto ret = *this; ++*this; return ret; }
+        bool operator==(const iterator_t& v) const { return m_index == v.m_index; }
+        bool operator!=(const iterator_t& v) const { return m_index != v.m_index; }
+
+    private:
+        template<class, class> friend class iterator_t;
+        friend class FlatHashMap;
+
+        void skip()
+        {
+            while (m_index < m_map->m_capacity && m_map->m_states[m_index] != Used)
+                ++m_index;
+        }
+
+        Map *m_map = nullptr;
+        size_t m_index = 0;
+    };
+    using iterator = iterator_t<FlatHashMap, value_type>;
+    using const_iterator = iterator_t<const FlatHashMap, const value_type>;
+
+    FlatHashMap() {}
+    FlatHashMap(FlatHashMap&& v) { swap(v); }
+    FlatHashMap& operator=(FlatHashMap&& v) { swap(v); return *this; }
+    FlatHashMap(const FlatHashMap&) = delete;
+    FlatHashMap& operator=(const FlatHashMap&) = delete;
+    ~FlatHashMap() { destroy(); }
+
+    void swap(FlatHashMap& v)
+    {
+        std::swap(m_slots, v.m_slots);
+        std::swap(m_states, v.m_states);
+        std::swap(m_capacity, v.m_capacity);
+        std::swap(m_size, v.m_size);
+        std::swap(m_tombstones, v.m_tombstones);
+    }
+
+    size_t size() const { return m_size; }
+    bool empty() const { return m_size == 0; }
+    size_t capacity() const { return m_capacity; }
+
+    iterator begin() { return iterator(this, 0); }
+    iterator end() { return iterator(this, m_capacity); }
+    const_iterator begin() const { return const_iterator(this, 0); }
+    const_iterator end() const { return const_iterator(this, m_capacity); }
+
+    iterator find(const K& key)
+    {
+        size_t i = findIndex(key);
+        return i != npos ? iterator(this, i) : end();
+    }
+    const_iterator find(const K& key) const
+    {
+        size_t i = findIndex(key);
+        return i != npos ? const_iterator(this, i) : end();
+    }
+    size_t count(const K& key) const { return findIndex(key) != npos ? 1 : 0; }
+
+    V& operator[](const K& key) { return emplace(key).first->second; }
+
+    // same as std::unordered_map::try_emplace(). V is default constructed if the key is new.
+    std::pair<iterator, bool> emplace(const K& key)
+    {
+        size_t i = findIndex(key);
+        if (i != npos)
+            return { iterator(this, i), false };
+
+        if ((m_size + m_tombstones + 1) * 4 > m_capacity * 3)
+            rehash(m_size + 1);
+        i = insertIndex(key);
+        if (m_states[i] == Deleted)
+            --m_tombstones;
+        new (&slot(i)) value_type(key, V());
+        m_states[i] = Used;
+        ++m_size;
+        return { iterator(this, i), true };
+    }
+
+    size_t erase(const K& key)
+    {
+        size_t i = findIndex(key);
+        if (i == npos)
+            return 0;
+        eraseIndex(i);
+        return 1;
+    }
+    iterator erase(const_iterator it)
+    {
+        eraseIndex(it.m_index);
+        return iterator(this, it.m_index);
+    }
+
+    // keeps the capacity
+    void clear()
+    {
+        if (m_size == 0 && m_tombstones == 0)
+            return;
+        for (size_t i = 0; i < m_capacity; ++i) {
+            if (m_states[i] == Used)
+                slot(i).~value_type();
+            m_states[i] = Empty;
+        }
+        m_size = m_tombstones = 0;
+    }
+
+    void reserve(size_t n)
+    {
+        if (n * 4 > m_capacity * 3)
+            rehash(n);
+    }
+
+private:
+    enum State : uint8_t { Empty, Used, Deleted };
+    struct Slot { typename std::aligned_storage<sizeof(value_type), alignof(value_type)>::type data; };
+    static const size_t npos = ~(size_t)0;
+
+    value_type& slot(size_t i) { return reinterpret_cast<value_type&>(m_slots[i]); }
+    const value_type& slot(size_t i) const { return reinterpret_cast<const value_type&>(m_slots[i]); }
+
+    // std::hash of pointers and integers is the identity on some platforms. mix the bits so that
+    // aligned pointers don't pile up in the same slots.
+    size_t home(const K& key) const
+    {
+        uint64_t h = (uint64_t)Hash()(key) * 0x9E3779B97F4A7C15ull;
+        return (size_t)(h ^ (h >> 32)) & (m_capacity - 1);
+    }
+
+    size_t findIndex(const K& key) const
+    {
+        if (m_size == 0)
+            return npos;
+        size_t mask = m_capacity - 1;
+        for (size_t i = home(key); ; i = (i + 1) & mask) {
+            if (m_states[i] == Empty)
+                return npos;
+            if (m_states[i] == Used && Eq()(slot(i).first, key))
+                return i;
+        }
+    }
+
+    // the key must not be in the map. reuses the first tombstone on the probe sequence.
+    size_t insertIndex(const K& key) const
+    {
+        size_t mask = m_capacity - 1;
+        for (size_t i = home(key); ; i = (i + 1) & mask) {
+            if (m_states[i] != Used)
+                return i;
+        }
+    }
+
+    void eraseIndex(size_t i)
+    {
+        slot(i).~value_type();
+        m_states[i] = Deleted;
+        --m_size;
+        ++m_tombstones;
+    }
+
+    // rebuilds the table with enough slots for n entries. tombstones are dropped.
+    void rehash(size_t n)
+    {
+        size_t capacity = 16;
+        while (capacity < n * 2)
+            capacity *= 2;
+
+        FlatHashMap tmp;
+        tmp.m_slots.reset(new Slot[capacity]);
+        tmp.m_states.reset(new uint8_t[capacity]());
+        tmp.m_capacity = capacity;
+        for (size_t i = 0; i < m_capacity; ++i) {
+            if (m_states[i] != Used)
+                continue;
+            auto& src = slot(i);
+            size_t di = tmp.insertIndex(src.first);
+            new (&tmp.slot(di)) value_type(std::move(src));
+            tmp.m_states[di] = Used;
+            ++tmp.m_size;
+        }
+        swap(tmp);
+    }
+
+    void destroy()
+    {
+        for (size_t i = 0; i < m_capacity; ++i) {
+            if (m_states[i] == Used)
+                slot(i).~value_type();
+        }
+        m_slots.reset();
+        m_states.reset();
+        m_capacity = m_size = m_tombstones = 0;
+    }
+
+    std::unique_ptr<Slot[]> m_slots;
+    std::unique_ptr<uint8_t[]> m_states;
+    size_t m_capacity = 0;
+    size_t m_size = 0;
+    size_t m_tombstones = 0;
+};
+
+} // namespace mu
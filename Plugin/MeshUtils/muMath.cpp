@@ -56,6 +56,31 @@ void Scale_Generic(float3 *dst, float s, size_t num)
         dst[i] *= s;
     }
 }
+void Scale_Generic(float3 *dst, const float3& s, size_t num)
+{
+    for (size_t i = 0; i < num; ++i) {
+        dst[i] *= s;
+    }
+}
+void Scale_Generic(float4 *dst, const float4& s, size_t num)
+{
+    for (size_t i = 0; i < num; ++i) {
+        dst[i] *= s;
+    }
+}
+
+void SwapYZ_Generic(float3 *dst, size_t num)
+{
+    for (size_t i = 0; i < num; ++i) {
+        std::swap(dst[i].y, dst[i].z);
+    }
+}
+void SwapYZ_Generic(float4 *dst, size_t num)
+{
+    for (size_t i = 0; i < num; ++i) {
+        std::swap(dst[i].y, dst[i].z);
+    }
+}
 
 void Normalize_Generic(float3 *dst, size_t num)
 {
@@ -154,7 +154,7 @@ void MeshRefiner::genSubmeshes(IArray<int> material_ids)
 
     int num_splits = (int)splits.size();
     int offset_faces = 0;
-    RawVector<Submesh> tmp_submeshes;
+    TempVector<Submesh> tmp_submeshes{ ArenaAllocator(&arena) };
 
     for (int spi = 0; spi < num_splits; ++spi) {
         auto& split = splits[spi];
@@ -303,6 +303,18 @@ void MeshRefiner::setupSubmeshes()
 }
 
 
+MeshRefiner::MeshRefiner()
+    : old2new_indices(ArenaAllocator(&arena))
+    , new2old_points(ArenaAllocator(&arena))
+    , new_indices(ArenaAllocator(&arena))
+    , new_indices_tri(ArenaAllocator(&arena))
+    , new_indices_lines(ArenaAllocator(&arena))
+    , new_indices_points(ArenaAllocator(&arena))
+    , splits(ArenaAllocator(&arena))
+    , submeshes(ArenaAllocator(&arena))
+{
+}
+
 void MeshRefiner::clear()
 {
     split_unit = 0;
@@ -330,6 +342,17 @@ void MeshRefiner::clear()
     splits.clear();
     submeshes.clear();
     connection.clear();
+
+    // drop pointers to the arena before resetting it
+    old2new_indices.shrink_to_fit();
+    new2old_points.shrink_to_fit();
+    new_indices.shrink_to_fit();
+    new_indices_tri.shrink_to_fit();
+    new_indices_lines.shrink_to_fit();
+    new_indices_points.shrink_to_fit();
+    splits.shrink_to_fit();
+    submeshes.shrink_to_fit();
+    arena.reset();
 }
 
 void MeshRefiner::refine()
@@ -99,18 +99,23 @@ struct MeshRefiner
     IArray<int> indices;
     IArray<float3> points;
 
+    // intermediate data are allocated from this and released at once when the refiner is destroyed or cleared.
+    // outputs that are likely to be taken by swap() are ordinary RawVectors.
+    Arena arena;
+    template<class T> using TempVector = RawVector<T, 0x20, ArenaAllocator>;
+
     // outputs
-    RawVector<int> old2new_indices; // old index to new index
-    RawVector<int> new2old_points;  // new index to old vertex
+    TempVector<int> old2new_indices; // old index to new index
+    TempVector<int> new2old_points;  // new index to old vertex
     RawVector<int> new_counts;
-    RawVector<int> new_indices;     // non-triangulated new indices
-    RawVector<int> new_indices_tri;
-    RawVector<int> new_indices_lines;
-    RawVector<int> new_indices_points;
+    TempVector<int> new_indices;     // non-triangulated new indices
+    TempVector<int> new_indices_tri;
+    TempVector<int> new_indices_lines;
+    TempVector<int> new_indices_points;
     RawVector<int> new_indices_submeshes;
     RawVector<float3> new_points;
-    RawVector<Split> splits;
-    RawVector<Submesh> submeshes;
+    TempVector<Split> splits;
+    TempVector<Submesh> submeshes;
     MeshConnectionInfo connection;
 
     // attributes
@@ -133,6 +138,7 @@ struct MeshRefiner
         attr->new2old = &new2old;
     }
 
+    MeshRefiner();
     void refine();
     void retopology(bool swap_faces);
     void genSubmeshes(IArray<int> material_ids);
@@ -0,0 +1,172 @@
+#include "pch.h"
+#include "muMipmap.h"
+#include "muRawVector.h"
+#include "muConcurrency.h"
+
+namespace mu {
+
+namespace {
+
+const float KaiserWidth = 3.0f; // half width in destination pixels
+const float KaiserAlpha = 4.0f;
+
+float Sinc(float x)
+{
+    x *= PI;
+    return std::abs(x) < 1e-4f ? 1.0f : std::sin(x) / x;
+}
+
+// modified Bessel function of the first kind, order 0
+float BesselI0(float x)
+{
+    float sum = 1.0f, term = 1.0f, hx = x * 0.5f;
+    for (int k = 1; k < 32; ++k) {
+        term *= hx / k;
+        float t = term * term;
+        sum += t;
+        if (t < sum * 1e-8f)
+            break;
+    }
+    return sum;
+}
+
+// x: distance in destination pixels
+float KaiserSinc(float x)
+{
+    float t = x / KaiserWidth;
+    t = 1.0f - t * t;
+    if (t <= 0.0f)
+        return 0.0f;
+    return Sinc(x) * BesselI0(KaiserAlpha * std::sqrt(t)) / BesselI0(KaiserAlpha);
+}
+
+// taps of a separable filter for each destination coordinate. source indices are clamped.
+struct FilterTable
+{
+    int taps = 0;
+    RawVector<int> indices;
+    RawVector<float> weights;
+
+    void build(int src_size, int dst_size, MipFilter filter)
+    {
+        float scale = (float)src_size / (float)dst_size; // source pixels per destination pixel
+        float support = (filter == MipFilter::Box ? 0.5f : KaiserWidth) * scale;
+        taps = (int)std::ceil(support * 2.0f) + 1;
+        indices.resize_discard(dst_size * taps);
+        weights.resize_discard(dst_size * taps);
+
+        for (int x = 0; x < dst_size; ++x) {
+            float center = ((float)x + 0.5f) * scale; // in source pixels, edge aligned
+            int first = (int)std::floor(center - support);
+            int *idx = &indices[x * taps];
+            float *w = &weights[x * taps];
+            float total = 0.0f;
+            for (int t = 0; t < taps; ++t) {
+                int s = first + t;
+                if (filter == MipFilter::Box) {
+                    // coverage of the source pixel by the destination pixel
+                    float lo = std::max((float)s, center - support);
+                    float hi = std::min((float)s + 1.0f, center + support);
+                    w[t] = std::max(hi - lo, 0.0f);
+                }
+                else {
+                    w[t] = KaiserSinc(((float)s + 0.5f - center) / scale);
+                }
+                idx[t] = s < 0 ? 0 : (s >= src_size ? src_size - 1 : s);
+                total += w[t];
+            }
+            if (total != 0.0f) {
+                float rcp = 1.0f / total;
+                for (int t = 0; t < taps; ++t)
+                    w[t] *= rcp;
+            }
+            else {
+                w[0] = 1.0f;
+            }
+        }
+    }
+};
+
+template<class T> inline float ToFloat(T v) { return (float)v; }
+
+template<class T> inline T FromFloat(float v);
+template<> inline uint8_t FromFloat(float v) { return (uint8_t)clamp(v + 0.5f, 0.0f, 255.0f); }
+template<> inline int16_t FromFloat(float v) { return (int16_t)clamp(std::round(v), -32768.0f, 32767.0f); }
+template<> inline int32_t FromFloat(float v) { return (int32_t)std::min(std::max((double)std::round(v), -2147483648.0), 2147483647.0); }
+template<> inline half FromFloat(float v) { return half(v); }
+template<> inline float FromFloat(float v) { return v; }
+
+} // namespace
+
+int GetMipCount(int width, int height)
+{
+    int n = std::max(width, height);
+    int ret = 1;
+    while (n > 1) {
+        n >>= 1;
+        ++ret;
+    }
+    return ret;
+}
+
+void GetMipSize(int width, int height, int level, int& dst_width, int& dst_height)
+{
+    dst_width = std::max(width >> level, 1);
+    dst_height = std::max(height >> level, 1);
+}
+
+template<class T>
+void Downsample(T *dst, const T *src, int src_width, int src_height, int num_channels, MipFilter filter)
+{
+    int dst_width, dst_height;
+    GetMipSize(src_width, src_height, 1, dst_width, dst_height);
+
+    FilterTable fx, fy;
+    fx.build(src_width, dst_width, filter);
+    fy.build(src_height, dst_height, filter);
+
+    size_t src_pitch = size_t(src_width) * num_channels;
+    size_t dst_pitch = size_t(dst_width) * num_channels;
+    const int rows_per_block = std::max(1, (int)(16384 / src_pitch));
+    int num_blocks = ceildiv(dst_height, rows_per_block);
+
+    parallel_for(0, num_blocks, [&](int bi) {
+        // vertical pass into a float row, then horizontal pass into the destination.
+        // the vertical pass is a plain multiply-add over the whole row so that it is vectorized.
+        RawVector<float> row;
+        row.resize_discard(src_pitch);
+        int y_end = std::min((bi + 1) * rows_per_block, dst_height);
+        for (int y = bi * rows_per_block; y < y_end; ++y) {
+            row.zeroclear();
+            float *r = row.data();
+            for (int t = 0; t < fy.taps; ++t) {
+                float w = fy.weights[y * fy.taps + t];
+                if (w == 0.0f)
+                    continue;
+                const T *s = src + src_pitch * fy.indices[y * fy.taps + t];
+                for (size_t i = 0; i < src_pitch; ++i)
+                    r[i] += w * ToFloat(s[i]);
+            }
+
+            T *d = dst + dst_pitch * y;
+            for (int x = 0; x < dst_width; ++x) {
+                const int *idx = &fx.indices[x * fx.taps];
+                const float *w = &fx.weights[x * fx.taps];
+                for (int c = 0; c < num_channels; ++c) {
+                    float acc = 0.0f;
+                    for (int t = 0; t < fx.taps; ++t)
+                        acc += w[t] * r[idx[t] * num_channels + c];
+                    d[x * num_channels + c] = FromFloat<T>(acc);
+                }
+            }
+        }
+    });
+}
+
+template void Downsample(uint8_t *dst, const uint8_t *src, int src_width, int src_height, int num_channels, MipFilter filter);
+template void Downsample(int16_t *dst, const int16_t *src, int src_width, int src_height, int num_channels, MipFilter filter);
+template void Downsample(int32_t *dst, const int32_t *src, int src_width, int src_height, int num_channels, MipFilter filter);
+template void Downsample(half *dst, const half *src, int src_width, int src_height, int num_channels, MipFilter filter);
+template void Downsample(float *dst, const float *src, int src_width, int src_height, int num_channels, MipFilter filter);
+
+} // namespace mu
@@ -0,0 +1,24 @@
+#pragma once
+#include "muMath.h"
+#include "muHalf.h"
+
+namespace mu {
+
+enum class MipFilter
+{
+    Box,    // average of 2x2 pixels. fast
+    Kaiser, // Kaiser windowed sinc. sharper, may ring slightly
+};
+
+// number of levels of the full chain, down to 1x1
+int GetMipCount(int width, int height);
+// size of the given level. never smaller than 1.
+void GetMipSize(int width, int height, int level, int& dst_width, int& dst_height);
+
+// downsample an image with interleaved channels to the next mip level.
+// T: uint8_t (unorm), int16_t, int32_t, half, float. edges are clamped.
+// filtering is separable and done in float. rows of the destination are processed in parallel.
+template<class T>
+void Downsample(T *dst, const T *src, int src_width, int src_height, int num_channels, MipFilter filter);
+
+} // namespace mu
@@ -6,7 +6,9 @@
     #pragma comment(lib, "dbghelp.lib")
 #else
     #include <unistd.h>
+    #include <fcntl.h>
     #include <sys/mman.h>
+    #include <sys/stat.h>
 #endif
 
 namespace mu {
@@ -45,6 +47,79 @@ void Print(const wchar_t *fmt, ...)
     va_end(args);
 }
 
+static const uint64_t HashPrime1 = 11400714785074694791ULL;
+static const uint64_t HashPrime2 = 14029467366897019727ULL;
+static const uint64_t HashPrime3 = 1609587929392839161ULL;
+static const uint64_t HashPrime4 = 9650029242287828579ULL;
+static const uint64_t HashPrime5 = 2870177450012600261ULL;
+
+static inline uint64_t HashRotl(uint64_t v, int r) { return (v << r) | (v >> (64 - r)); }
+static inline uint64_t HashRead64(const uint8_t *p) { uint64_t r; memcpy(&r, p, 8); return r; }
+static inline uint32_t HashRead32(const uint8_t *p) { uint32_t r; memcpy(&r, p, 4); return r; }
+static inline uint64_t HashRound(uint64_t acc, uint64_t input)
+{
+    acc += input * HashPrime2;
+    acc = HashRotl(acc, 31);
+    return acc * HashPrime1;
+}
+static inline uint64_t HashMerge(uint64_t acc, uint64_t v)
+{
+    acc ^= HashRound(0, v);
+    return acc * HashPrime1 + HashPrime4;
+}
+
+uint64_t Hash64(const void *data, size_t size, uint64_t seed)
+{
+    auto *p = (const uint8_t*)data;
+    auto *end = p + size;
+    uint64_t h;
+
+    if (size >= 32) {
+        uint64_t v1 = seed + HashPrime1 + HashPrime2;
+        uint64_t v2 = seed + HashPrime2;
+        uint64_t v3 = seed;
+        uint64_t v4 = seed - HashPrime1;
+        auto *limit = end - 32;
+        do {
+            v1 = HashRound(v1, HashRead64(p)); p += 8;
+            v2 = HashRound(v2, HashRead64(p)); p += 8;
+            v3 = HashRound(v3, HashRead64(p)); p += 8;
+            v4 = HashRound(v4, HashRead64(p)); p += 8;
+        } while (p <= limit);
+
+        h = HashRotl(v1, 1) + HashRotl(v2, 7) + HashRotl(v3, 12) + HashRotl(v4, 18);
+        h = HashMerge(h, v1);
+        h = HashMerge(h, v2);
+        h = HashMerge(h, v3);
+        h = HashMerge(h, v4);
+    }
+    else {
+        h = seed + HashPrime5;
+    }
+    h += (uint64_t)size;
+
+    for (; p + 8 <= end; p += 8) {
+        h ^= HashRound(0, HashRead64(p));
+        h = HashRotl(h, 27) * HashPrime1 + HashPrime4;
+    }
+    if (p + 4 <= end) {
+        h ^= (uint64_t)HashRead32(p) * HashPrime1;
+        h = HashRotl(h, 23) * HashPrime2 + HashPrime3;
+        p += 4;
+    }
+    for (; p < end; ++p) {
+        h ^= (*p) * HashPrime5;
+        h = HashRotl(h, 11) * HashPrime1;
+    }
+
+    h ^= h >> 33;
+    h *= HashPrime2;
+    h ^= h >> 29;
+    h *= HashPrime3;
+    h ^= h >> 32;
+    return h;
+}
+
 std::string ToUTF8(const char *src)
 {
 #ifdef _WIN32
@@ -372,4 +447,82 @@ void SetMemoryProtection(void *addr, size_t size, MemoryFlags flags)
 }
 
 
+MappedFile::MappedFile() {}
+MappedFile::~MappedFile() { close(); }
+
+bool MappedFile::open(const char *path)
+{
+    close();
+#ifdef _WIN32
+    m_file = ::CreateFileW(ToWCS(path).c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (m_file == INVALID_HANDLE_VALUE)
+        return false;
+    LARGE_INTEGER size;
+    if (::GetFileSizeEx(m_file, &size) && size.QuadPart > 0) {
+        m_mapping = ::CreateFileMappingW(m_file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (m_mapping) {
+            m_data = (const char*)::MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0);
+            m_size = (size_t)size.QuadPart;
+        }
+    }
+#else
+    int fd = ::open(path, O_RDONLY);
+    if (fd == -1)
+        return false;
+    struct stat st;
+    if (::fstat(fd, &st) == 0 && st.st_size > 0) {
+        void *p = ::mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (p != MAP_FAILED) {
+            ::madvise(p, (size_t)st.st_size, MADV_SEQUENTIAL);
+            m_data = (const char*)p;
+            m_size = (size_t)st.st_size;
+        }
+    }
+    ::close(fd); // the mapping stays valid
+#endif
+    if (!m_data) {
+        close();
+        return false;
+    }
+    return true;
+}
+
+void MappedFile::close()
+{
+#ifdef _WIN32
+    if (m_data)
+        ::UnmapViewOfFile(m_data);
+    if (m_mapping)
+        ::CloseHandle(m_mapping);
+    if (m_file != INVALID_HANDLE_VALUE)
+        ::CloseHandle(m_file);
+    m_mapping = nullptr;
+    m_file = INVALID_HANDLE_VALUE;
+#else
+    if (m_data)
+        ::munmap((void*)m_data, m_size);
+#endif
+    m_data = nullptr;
+    m_size = 0;
+}
+
+const char* MappedFile::data() const { return m_data; }
+size_t MappedFile::size() const { return m_size; }
+
+int64_t GetFileSizeInByte(const char *path)
+{
+#ifdef _WIN32
+    WIN32_FILE_ATTRIBUTE_DATA attr;
+    if (!::GetFileAttributesExW(ToWCS(path).c_str(), GetFileExInfoStandard, &attr))
+        return -1;
+    return ((int64_t)attr.nFileSizeHigh << 32) | attr.nFileSizeLow;
+#else
+    struct stat st;
+    if (::stat(path, &st) != 0)
+        return -1;
+    return (int64_t)st.st_size;
+#endif
+}
+
+
 } // namespace mu
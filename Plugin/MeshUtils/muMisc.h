@@ -12,6 +12,9 @@ inline float NS2MS(nanosec ns) { return (float)((double)ns / 1000000.0); }
 void Print(const char *fmt, ...);
 void Print(const wchar_t *fmt, ...);
 
+// 64 bit content hash (xxHash64). not cryptographic.
+uint64_t Hash64(const void *data, size_t size, uint64_t seed = 0);
+
 std::string ToUTF8(const char *src);
 std::string ToUTF8(const std::string& src);
 std::string ToANSI(const char *src);
@@ -54,6 +57,30 @@ enum class MemoryFlags
 };
 void SetMemoryProtection(void *addr, size_t size, MemoryFlags flags);
 
+
+// read-only memory mapped file
+class MappedFile : public noncopyable
+{
+public:
+    MappedFile();
+    ~MappedFile();
+    bool open(const char *path);
+    void close();
+    const char* data() const;
+    size_t size() const;
+
+private:
+    const char *m_data = nullptr;
+    size_t m_size = 0;
+#ifdef _WIN32
+    HANDLE m_file = INVALID_HANDLE_VALUE;
+    HANDLE m_mapping = nullptr;
+#endif
+};
+
+// -1 if the file does not exist
+int64_t GetFileSizeInByte(const char *path);
+
 template<class T>
 inline void ForceWrite(void *dst, const T &src)
 {
@@ -6,8 +6,9 @@
 #include <initializer_list>
 #include "muAllocator.h"
 
-template<class T, int Align = 0x20>
-class RawVector
+// Allocator: allocator policy. see muAllocator.h. empty policies don't increase the size of RawVector.
+template<class T, int Align = 0x20, class Allocator = AlignedAllocator>
+class RawVector : private Allocator
 {
 public:
     using value_type      = T;
@@ -17,10 +18,13 @@ public:
     using const_pointer   = const T*;
     using iterator        = pointer;
     using const_iterator  = const_pointer;
+    using allocator_type  = Allocator;
     static const int alignment = Align;
 
     RawVector() {}
+    explicit RawVector(const Allocator& a) : Allocator(a) {}
     RawVector(const RawVector& v)
+        : Allocator(v.get_allocator())
     {
         operator=(v);
     }
@@ -32,7 +36,11 @@ public:
     {
         operator=(v);
     }
-    explicit RawVector(size_t initial_size) { resize(initial_size); }
+    explicit RawVector(size_t initial_size, const Allocator& a = Allocator())
+        : Allocator(a)
+    {
+        resize(initial_size);
+    }
     RawVector& operator=(const RawVector& v)
     {
         assign(v.begin(), v.end());
@@ -78,20 +86,23 @@ public:
     iterator end() { return m_data + m_size; }
     const_iterator end() const { return m_data + m_size; }
 
-    static void* allocate(size_t size) { return AlignedMalloc(size, alignment); }
-    static void deallocate(void *addr, size_t /*size*/) { AlignedFree(addr); }
+    const Allocator& get_allocator() const { return *this; }
+    void* allocate(size_t size) { return Allocator::allocate(size, alignment); }
+    void deallocate(void *addr, size_t size) { if (addr) Allocator::deallocate(addr, size); }
 
     void reserve(size_t s)
     {
         if (s > m_capacity) {
             s = std::max<size_t>(s, m_size * 2);
             size_t newsize = sizeof(T) * s;
-            size_t oldsize = sizeof(T) * m_size;
+            size_t oldsize = sizeof(T) * m_capacity;
 
-            T *newdata = (T*)allocate(newsize);
-            memcpy(newdata, m_data, oldsize);
-            deallocate(m_data, oldsize);
-            m_data = newdata;
+            if (!m_data || !Allocator::expand(m_data, oldsize, newsize)) {
+                T *newdata = (T*)allocate(newsize);
+                memcpy(newdata, m_data, sizeof(T) * m_size);
+                deallocate(m_data, oldsize);
+                m_data = newdata;
+            }
             m_capacity = s;
         }
     }
@@ -101,10 +112,12 @@ public:
         if (s > m_capacity) {
             s = std::max<size_t>(s, m_size * 2);
             size_t newsize = sizeof(T) * s;
-            size_t oldsize = sizeof(T) * m_size;
+            size_t oldsize = sizeof(T) * m_capacity;
 
-            deallocate(m_data, oldsize);
-            m_data = (T*)allocate(newsize);
+            if (!m_data || !Allocator::expand(m_data, oldsize, newsize)) {
+                deallocate(m_data, oldsize);
+                m_data = (T*)allocate(newsize);
+            }
             m_capacity = s;
         }
     }
@@ -112,7 +125,8 @@ public:
     void shrink_to_fit()
     {
         if (m_size == 0) {
-            deallocate(m_data, m_size);
+            deallocate(m_data, sizeof(T) * m_capacity);
+            m_data = nullptr;
             m_size = m_capacity = 0;
         }
         else if (m_size == m_capacity) {
@@ -165,6 +179,7 @@ public:
 
     void swap(RawVector &other)
     {
+        std::swap(static_cast<Allocator&>(*this), static_cast<Allocator&>(other));
         std::swap(m_data, other.m_data);
         std::swap(m_size, other.m_size);
         std::swap(m_capacity, other.m_capacity);
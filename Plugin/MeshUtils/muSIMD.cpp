@@ -50,6 +50,32 @@ void Scale_ISPC(float3 *dst, float s, size_t num)
 }
 #endif
 
+#ifdef muSIMD_Scale3
+void Scale_ISPC(float3 *dst, const float3& s, size_t num)
+{
+    ispc::Scale3((ispc::float3*)dst, (ispc::float3&)s, (int)num);
+}
+#endif
+#ifdef muSIMD_Scale4
+void Scale_ISPC(float4 *dst, const float4& s, size_t num)
+{
+    ispc::Scale4((ispc::float4*)dst, (ispc::float4&)s, (int)num);
+}
+#endif
+
+#ifdef muSIMD_SwapYZ3
+void SwapYZ_ISPC(float3 *dst, size_t num)
+{
+    ispc::SwapYZ3((ispc::float3*)dst, (int)num);
+}
+#endif
+#ifdef muSIMD_SwapYZ4
+void SwapYZ_ISPC(float4 *dst, size_t num)
+{
+    ispc::SwapYZ4((ispc::float4*)dst, (int)num);
+}
+#endif
+
 #ifdef muSIMD_Normalize
 void Normalize_ISPC(float3 *dst, size_t num)
 {
@@ -290,6 +316,32 @@ void Scale(float3 *dst, float s, size_t num)
 }
 #endif
 
+#if defined(muSIMD_Scale3) || !defined(muEnableISPC)
+void Scale(float3 *dst, const float3& s, size_t num)
+{
+    Forward(Scale, dst, s, num);
+}
+#endif
+#if defined(muSIMD_Scale4) || !defined(muEnableISPC)
+void Scale(float4 *dst, const float4& s, size_t num)
+{
+    Forward(Scale, dst, s, num);
+}
+#endif
+
+#if defined(muSIMD_SwapYZ3) || !defined(muEnableISPC)
+void SwapYZ(float3 *dst, size_t num)
+{
+    Forward(SwapYZ, dst, num);
+}
+#endif
+#if defined(muSIMD_SwapYZ4) || !defined(muEnableISPC)
+void SwapYZ(float4 *dst, size_t num)
+{
+    Forward(SwapYZ, dst, num);
+}
+#endif
+
 #if defined(muSIMD_Normalize) || !defined(muEnableISPC)
 void Normalize(float3 *dst, size_t num)
 {
@@ -13,6 +13,10 @@ void InvertX(float4 *dst, size_t num);
 void InvertV(float2 *dst, size_t num);
 void Scale(float *dst, float s, size_t num);
 void Scale(float3 *dst, float s, size_t num);
+void Scale(float3 *dst, const float3& s, size_t num); // component-wise
+void Scale(float4 *dst, const float4& s, size_t num); // component-wise
+void SwapYZ(float3 *dst, size_t num);
+void SwapYZ(float4 *dst, size_t num);
 void Normalize(float3 *dst, size_t num);
 void Lerp(float *dst, const float *src1, const float *src2, size_t num, float w);
 void Lerp(float2 *dst, const float2 *src1, const float2 *src2, size_t num, float w);
@@ -93,6 +97,15 @@ void Scale_Generic(float *dst, float s, size_t num);
 void Scale_Generic(float3 *dst, float s, size_t num);
 void Scale_ISPC(float *dst, float s, size_t num);
 void Scale_ISPC(float3 *dst, float s, size_t num);
+void Scale_Generic(float3 *dst, const float3& s, size_t num);
+void Scale_ISPC(float3 *dst, const float3& s, size_t num);
+void Scale_Generic(float4 *dst, const float4& s, size_t num);
+void Scale_ISPC(float4 *dst, const float4& s, size_t num);
+
+void SwapYZ_Generic(float3 *dst, size_t num);
+void SwapYZ_ISPC(float3 *dst, size_t num);
+void SwapYZ_Generic(float4 *dst, size_t num);
+void SwapYZ_ISPC(float4 *dst, size_t num);
 
 void Normalize_Generic(float3 *dst, size_t num);
 void Normalize_ISPC(float3 *dst, size_t num);
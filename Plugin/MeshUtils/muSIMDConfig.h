@@ -6,6 +6,10 @@
 #define muSIMD_InvertX3
 #define muSIMD_InvertX4
 #define muSIMD_Scale
+#define muSIMD_Scale3
+#define muSIMD_Scale4
+#define muSIMD_SwapYZ3
+#define muSIMD_SwapYZ4
 #define muSIMD_Normalize
 #define muSIMD_Lerp
 #define muSIMD_NearEqual
@@ -13,6 +17,11 @@
 #define muSIMD_MinMax2
 #define muSIMD_MinMax3
 
+#define muSIMD_Swizzle
+#define muSIMD_PixelConversion
+#define muSIMD_ColorSpace
+#define muSIMD_Premultiply4
+
 //#define muSIMD_MulVectors3
 #define muSIMD_MulPoints3
 
@@ -0,0 +1,464 @@
+#include "pch.h"
+#include "muTextureCompression.h"
+#include "muConcurrency.h"
+
+namespace mu {
+
+namespace {
+
+struct Block
+{
+    float px[16][4]; // RGBA in [0, 255]
+};
+
+// positions of palette entries between endpoint 0 and 1
+const float BC1Weights[4] = { 0.0f, 1.0f, 1.0f / 3.0f, 2.0f / 3.0f };
+const float BC4Weights[8] = { 0.0f, 1.0f, 1.0f / 7.0f, 2.0f / 7.0f, 3.0f / 7.0f, 4.0f / 7.0f, 5.0f / 7.0f, 6.0f / 7.0f };
+const int BC7Weights4[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+inline int Round(float v) { return (int)(v + 0.5f); }
+inline int Clamp(int v, int lo, int hi) { return v < lo ? lo : (v > hi ? hi : v); }
+inline float Clamp255(float v) { return v < 0.0f ? 0.0f : (v > 255.0f ? 255.0f : v); }
+
+void LoadBlock(Block& dst, const uint8_t *src, int width, int height, int bx, int by)
+{
+    for (int y = 0; y < 4; ++y) {
+        int sy = std::min(by * 4 + y, height - 1);
+        for (int x = 0; x < 4; ++x) {
+            int sx = std::min(bx * 4 + x, width - 1);
+            auto *p = src + (size_t(sy) * width + sx) * 4;
+            auto *d = dst.px[y * 4 + x];
+            d[0] = p[0]; d[1] = p[1]; d[2] = p[2]; d[3] = p[3];
+        }
+    }
+}
+
+// endpoints that span the distribution of channels [ch, ch + N) along its principal axis.
+template<int N>
+void FitEndpoints(const Block& b, int ch, BCQuality quality, float (&e0)[N], float (&e1)[N])
+{
+    float mean[N], mn[N], mx[N];
+    for (int c = 0; c < N; ++c) {
+        mean[c] = 0.0f;
+        mn[c] = 255.0f;
+        mx[c] = 0.0f;
+    }
+    for (int i = 0; i < 16; ++i) {
+        for (int c = 0; c < N; ++c) {
+            float v = b.px[i][ch + c];
+            mean[c] += v;
+            mn[c] = std::min(mn[c], v);
+            mx[c] = std::max(mx[c], v);
+        }
+    }
+    for (int c = 0; c < N; ++c)
+        mean[c] /= 16.0f;
+
+    bool use_bbox = quality == BCQuality::Fast || N == 1;
+    float axis[N];
+    if (!use_bbox) {
+        float cov[N][N] = {};
+        for (int i = 0; i < 16; ++i) {
+            float d[N];
+            for (int c = 0; c < N; ++c)
+                d[c] = b.px[i][ch + c] - mean[c];
+            for (int r = 0; r < N; ++r)
+                for (int c = 0; c < N; ++c)
+                    cov[r][c] += d[r] * d[c];
+        }
+
+        // power iteration
+        for (int c = 0; c < N; ++c)
+            axis[c] = mx[c] - mn[c];
+        for (int it = 0; it < 8; ++it) {
+            float tmp[N], len = 0.0f;
+            for (int r = 0; r < N; ++r) {
+                tmp[r] = 0.0f;
+                for (int c = 0; c < N; ++c)
+                    tmp[r] += cov[r][c] * axis[c];
+                len += tmp[r] * tmp[r];
+            }
+            if (len < 1e-8f) {
+                use_bbox = true;
+                break;
+            }
+            len = 1.0f / std::sqrt(len);
+            for (int c = 0; c < N; ++c)
+                axis[c] = tmp[c] * len;
+        }
+    }
+
+    if (use_bbox) {
+        for (int c = 0; c < N; ++c) {
+            e0[c] = mn[c];
+            e1[c] = mx[c];
+        }
+    }
+    else {
+        float tmin = FLT_MAX, tmax = -FLT_MAX;
+        for (int i = 0; i < 16; ++i) {
+            float t = 0.0f;
+            for (int c = 0; c < N; ++c)
+                t += (b.px[i][ch + c] - mean[c]) * axis[c];
+            tmin = std::min(tmin, t);
+            tmax = std::max(tmax, t);
+        }
+        for (int c = 0; c < N; ++c) {
+            e0[c] = Clamp255(mean[c] + axis[c] * tmin);
+            e1[c] = Clamp255(mean[c] + axis[c] * tmax);
+        }
+    }
+
+    // inset a bit. extremes are usually outliers that are better represented by palette entries next to them.
+    for (int c = 0; c < N; ++c) {
+        float inset = (e1[c] - e0[c]) / 32.0f;
+        e0[c] += inset;
+        e1[c] -= inset;
+    }
+}
+
+// least squares endpoints for the given palette assignment
+template<int N>
+bool RefineEndpoints(const Block& b, int ch, const int *indices, const float *weights, float (&e0)[N], float (&e1)[N])
+{
+    float a = 0.0f, m = 0.0f, c2 = 0.0f;
+    float d0[N] = {}, d1[N] = {};
+    for (int i = 0; i < 16; ++i) {
+        float t = weights[indices[i]];
+        float s = 1.0f - t;
+        a += s * s;
+        m += s * t;
+        c2 += t * t;
+        for (int c = 0; c < N; ++c) {
+            float v = b.px[i][ch + c];
+            d0[c] += s * v;
+            d1[c] += t * v;
+        }
+    }
+    float det = a * c2 - m * m;
+    if (std::abs(det) < 1e-6f)
+        return false;
+    float rdet = 1.0f / det;
+    for (int c = 0; c < N; ++c) {
+        e0[c] = Clamp255((c2 * d0[c] - m * d1[c]) * rdet);
+        e1[c] = Clamp255((a * d1[c] - m * d0[c]) * rdet);
+    }
+    return true;
+}
+
+// nearest palette entry of each pixel. returns the total squared error.
+template<int N, int K>
+float SelectIndices(const Block& b, int ch, const float (&palette)[K][N], int *indices, int num_entries = K)
+{
+    float total = 0.0f;
+    for (int i = 0; i < 16; ++i) {
+        float best = FLT_MAX;
+        int best_index = 0;
+        for (int k = 0; k < num_entries; ++k) {
+            float e = 0.0f;
+            for (int c = 0; c < N; ++c) {
+                float d = b.px[i][ch + c] - palette[k][c];
+                e += d * d;
+            }
+            if (e < best) {
+                best = e;
+                best_index = k;
+            }
+        }
+        indices[i] = best_index;
+        total += best;
+    }
+    return total;
+}
+
+int NumRefinements(BCQuality quality)
+{
+    switch (quality) {
+    case BCQuality::Fast: return 0;
+    case BCQuality::Normal: return 1;
+    default: return 4;
+    }
+}
+
+
+// BC1 color block (also the color part of BC3)
+struct BC1Block
+{
+    uint16_t c0, c1;
+    uint32_t indices;
+};
+
+struct BC1Candidate
+{
+    uint16_t c0, c1;
+    int indices[16];
+    float error;
+};
+
+inline uint16_t QuantizeRGB565(const float (&v)[3])
+{
+    int r = Clamp(Round(v[0] * (31.0f / 255.0f)), 0, 31);
+    int g = Clamp(Round(v[1] * (63.0f / 255.0f)), 0, 63);
+    int b = Clamp(Round(v[2] * (31.0f / 255.0f)), 0, 31);
+    return uint16_t((r << 11) | (g << 5) | b);
+}
+
+inline void DecodeRGB565(uint16_t v, int (&dst)[3])
+{
+    int r = (v >> 11) & 31, g = (v >> 5) & 63, b = v & 31;
+    dst[0] = (r << 3) | (r >> 2);
+    dst[1] = (g << 2) | (g >> 4);
+    dst[2] = (b << 3) | (b >> 2);
+}
+
+void EvaluateBC1(const Block& b, BC1Candidate& dst, const float (&e0)[3], const float (&e1)[3])
+{
+    uint16_t c0 = QuantizeRGB565(e0), c1 = QuantizeRGB565(e1);
+    // 4 color mode requires c0 > c1
+    if (c0 < c1)
+        std::swap(c0, c1);
+    dst.c0 = c0;
+    dst.c1 = c1;
+
+    int p0[3], p1[3];
+    DecodeRGB565(c0, p0);
+    DecodeRGB565(c1, p1);
+    float palette[4][3];
+    for (int c = 0; c < 3; ++c) {
+        palette[0][c] = (float)p0[c];
+        palette[1][c] = (float)p1[c];
+        palette[2][c] = (float)((2 * p0[c] + p1[c]) / 3);
+        palette[3][c] = (float)((p0[c] + 2 * p1[c]) / 3);
+    }
+    // c0 == c1 is interpreted as 3 color mode. only the first entry is safe.
+    dst.error = SelectIndices<3, 4>(b, 0, palette, dst.indices, c0 == c1 ? 1 : 4);
+}
+
+void EncodeBC1(const Block& b, BCQuality quality, void *dst)
+{
+    float e0[3], e1[3];
+    FitEndpoints<3>(b, 0, quality, e0, e1);
+
+    BC1Candidate best, tmp;
+    EvaluateBC1(b, best, e0, e1);
+    int n = NumRefinements(quality);
+    for (int it = 0; it < n && best.error > 0.0f; ++it) {
+        if (!RefineEndpoints<3>(b, 0, best.indices, BC1Weights, e0, e1))
+            break;
+        EvaluateBC1(b, tmp, e0, e1);
+        if (tmp.error >= best.error)
+            break;
+        best = tmp;
+    }
+
+    BC1Block ret;
+    ret.c0 = best.c0;
+    ret.c1 = best.c1;
+    ret.indices = 0;
+    for (int i = 0; i < 16; ++i)
+        ret.indices |= uint32_t(best.indices[i]) << (i * 2);
+    memcpy(dst, &ret, sizeof(ret));
+}
+
+
+// BC4 single channel block (alpha of BC3, R and G of BC5)
+struct BC4Candidate
+{
+    int a0, a1;
+    int indices[16];
+    float error;
+};
+
+void EvaluateBC4(const Block& b, int ch, BC4Candidate& dst, float e0, float e1)
+{
+    int a0 = Clamp(Round(e0), 0, 255), a1 = Clamp(Round(e1), 0, 255);
+    // 8 value mode requires a0 > a1
+    if (a0 < a1)
+        std::swap(a0, a1);
+    dst.a0 = a0;
+    dst.a1 = a1;
+
+    float palette[8][1];
+    palette[0][0] = (float)a0;
+    palette[1][0] = (float)a1;
+    for (int i = 2; i < 8; ++i)
+        palette[i][0] = (float)(((8 - i) * a0 + (i - 1) * a1) / 7);
+    dst.error = SelectIndices<1, 8>(b, ch, palette, dst.indices, a0 == a1 ? 1 : 8);
+}
+
+void EncodeBC4(const Block& b, int ch, BCQuality quality, void *dst)
+{
+    float e0[1], e1[1];
+    FitEndpoints<1>(b, ch, quality, e0, e1);
+
+    BC4Candidate best, tmp;
+    // endpoints are ordered a0 > a1. fit them in that order so that refined indices keep their meaning.
+    EvaluateBC4(b, ch, best, e1[0], e0[0]);
+    int n = NumRefinements(quality);
+    for (int it = 0; it < n && best.error > 0.0f; ++it) {
+        float r0[1], r1[1];
+        if (!RefineEndpoints<1>(b, ch, best.indices, BC4Weights, r0, r1))
+            break;
+        EvaluateBC4(b, ch, tmp, r0[0], r1[0]);
+        if (tmp.error >= best.error)
+            break;
+        best = tmp;
+    }
+
+    uint64_t bits = uint64_t(best.a0) | (uint64_t(best.a1) << 8);
+    for (int i = 0; i < 16; ++i)
+        bits |= uint64_t(best.indices[i]) << (16 + i * 3);
+    memcpy(dst, &bits, sizeof(bits));
+}
+
+
+// BC7 mode 6: one subset, RGBA 7 bits + unique p-bit per endpoint, 4 bit indices
+struct BC7Candidate
+{
+    int q0[4], q1[4]; // 7 bit
+    int p0, p1;
+    int indices[16];
+    float error;
+};
+
+// the p-bit is shared by all channels of an endpoint. pick the one that reconstructs better.
+void QuantizeBC7Endpoint(const float (&e)[4], int (&q)[4], int& p)
+{
+    float best = FLT_MAX;
+    for (int pb = 0; pb < 2; ++pb) {
+        int tq[4];
+        float err = 0.0f;
+        for (int c = 0; c < 4; ++c) {
+            tq[c] = Clamp(Round((e[c] - pb) * 0.5f), 0, 127);
+            float d = (float)((tq[c] << 1) | pb) - e[c];
+            err += d * d;
+        }
+        if (err < best) {
+            best = err;
+            p = pb;
+            for (int c = 0; c < 4; ++c)
+                q[c] = tq[c];
+        }
+    }
+}
+
+void EvaluateBC7(const Block& b, BC7Candidate& dst, const float (&e0)[4], const float (&e1)[4])
+{
+    QuantizeBC7Endpoint(e0, dst.q0, dst.p0);
+    QuantizeBC7Endpoint(e1, dst.q1, dst.p1);
+
+    float palette[16][4];
+    for (int c = 0; c < 4; ++c) {
+        int v0 = (dst.q0[c] << 1) | dst.p0;
+        int v1 = (dst.q1[c] << 1) | dst.p1;
+        for (int k = 0; k < 16; ++k)
+            palette[k][c] = (float)(((64 - BC7Weights4[k]) * v0 + BC7Weights4[k] * v1 + 32) >> 6);
+    }
+    dst.error = SelectIndices<4, 16>(b, 0, palette, dst.indices);
+}
+
+struct BitWriter
+{
+    uint64_t bits[2] = { 0, 0 };
+    int pos = 0;
+
+    void write(uint32_t v, int n)
+    {
+        for (int i = 0; i < n; ++i, ++pos) {
+            if ((v >> i) & 1)
+                bits[pos >> 6] |= uint64_t(1) << (pos & 63);
+        }
+    }
+};
+
+void EncodeBC7(const Block& b, BCQuality quality, void *dst)
+{
+    float w[16];
+    for (int k = 0; k < 16; ++k)
+        w[k] = (float)BC7Weights4[k] / 64.0f;
+
+    float e0[4], e1[4];
+    FitEndpoints<4>(b, 0, quality, e0, e1);
+
+    BC7Candidate best, tmp;
+    EvaluateBC7(b, best, e0, e1);
+    int n = NumRefinements(quality);
+    for (int it = 0; it < n && best.error > 0.0f; ++it) {
+        if (!RefineEndpoints<4>(b, 0, best.indices, w, e0, e1))
+            break;
+        EvaluateBC7(b, tmp, e0, e1);
+        if (tmp.error >= best.error)
+            break;
+        best = tmp;
+    }
+
+    // the MSB of the first index is implicitly 0. swap endpoints if it is 1.
+    if (best.indices[0] >= 8) {
+        for (int c = 0; c < 4; ++c)
+            std::swap(best.q0[c], best.q1[c]);
+        std::swap(best.p0, best.p1);
+        for (int i = 0; i < 16; ++i)
+            best.indices[i] = 15 - best.indices[i];
+    }
+
+    BitWriter bw;
+    bw.write(1 << 6, 7); // mode 6
+    for (int c = 0; c < 4; ++c) {
+        bw.write(best.q0[c], 7);
+        bw.write(best.q1[c], 7);
+    }
+    bw.write(best.p0, 1);
+    bw.write(best.p1, 1);
+    bw.write(best.indices[0], 3);
+    for (int i = 1; i < 16; ++i)
+        bw.write(best.indices[i], 4);
+    memcpy(dst, bw.bits, sizeof(bw.bits));
+}
+
+} // namespace
+
+
+int GetBCBlockSize(BCFormat format)
+{
+    return format == BCFormat::BC1 ? 8 : 16;
+}
+
+size_t GetBCDataSize(BCFormat format, int width, int height)
+{
+    return size_t(ceildiv(width, 4)) * size_t(ceildiv(height, 4)) * GetBCBlockSize(format);
+}
+
+void CompressBC(BCFormat format, void *dst_, const unorm8x4 *src_, int width, int height, BCQuality quality)
+{
+    auto *dst = (uint8_t*)dst_;
+    auto *src = (const uint8_t*)src_;
+    int bw = ceildiv(width, 4);
+    int bh = ceildiv(height, 4);
+    int block_size = GetBCBlockSize(format);
+
+    parallel_for(0, bh, [&](int by) {
+        Block block;
+        auto *d = dst + size_t(by) * bw * block_size;
+        for (int bx = 0; bx < bw; ++bx, d += block_size) {
+            LoadBlock(block, src, width, height, bx, by);
+            switch (format) {
+            case BCFormat::BC1:
+                EncodeBC1(block, quality, d);
+                break;
+            case BCFormat::BC3:
+                EncodeBC4(block, 3, quality, d);
+                EncodeBC1(block, quality, d + 8);
+                break;
+            case BCFormat::BC5:
+                EncodeBC4(block, 0, quality, d);
+                EncodeBC4(block, 1, quality, d + 8);
+                break;
+            case BCFormat::BC7:
+                EncodeBC7(block, quality, d);
+                break;
+            }
+        }
+    });
+}
+
+} // namespace mu
@@ -0,0 +1,29 @@
+#pragma once
+#include "muMath.h"
+#include "muHalf.h"
+
+namespace mu {
+
+enum class BCFormat
+{
+    BC1, // RGB. 4 bits per pixel
+    BC3, // RGBA. 8 bits per pixel
+    BC5, // RG (normal maps). 8 bits per pixel
+    BC7, // RGBA. 8 bits per pixel. mode 6 only
+};
+
+enum class BCQuality
+{
+    Fast,   // bounding box endpoints
+    Normal, // principal axis endpoints + one least squares refinement
+    High,   // principal axis endpoints + iterative refinement
+};
+
+int GetBCBlockSize(BCFormat format); // in byte
+size_t GetBCDataSize(BCFormat format, int width, int height);
+
+// compress an RGBA8 image. blocks on the right / bottom edges are padded by repeating edge pixels.
+// blocks are independent, so rows of blocks are processed in parallel.
+void CompressBC(BCFormat format, void *dst, const unorm8x4 *src, int width, int height, BCQuality quality = BCQuality::Normal);
+
+} // namespace mu
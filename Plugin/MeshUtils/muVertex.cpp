@@ -1,6 +1,7 @@
 #include "pch.h"
 #include "muMath.h"
 #include "muVertex.h"
+#include "muConcurrency.h"
 
 namespace mu {
 
@@ -47,13 +48,36 @@ template<> inline void InterleaveImpl(vertex_v3n3c4u2t4 *dst, const vertex_v3n3c
 }
 
 template<class VertexT>
-void TInterleave(VertexT *dst, const typename VertexT::arrays_t& src, size_t num)
+static inline void InterleaveRange(VertexT *dst, const typename VertexT::arrays_t& src, size_t begin, size_t end)
 {
-    for (size_t i = 0; i < num; ++i) {
+    for (size_t i = begin; i < end; ++i) {
         InterleaveImpl(dst, src, i);
     }
 }
 
+template<class VertexT>
+void Interleave_Generic(VertexT *dst, const typename VertexT::arrays_t& src, size_t num)
+{
+    InterleaveRange(dst, src, 0, num);
+}
+
+// the loops are plain copies with constant strides that compilers vectorize well.
+// large buffers are split into blocks that are processed in parallel.
+template<class VertexT>
+static void TInterleave(VertexT *dst, const typename VertexT::arrays_t& src, size_t num)
+{
+    const size_t block_size = 16 * 1024;
+    if (num <= block_size) {
+        InterleaveRange(dst, src, 0, num);
+        return;
+    }
+    int num_blocks = (int)((num + block_size - 1) / block_size);
+    parallel_for(0, num_blocks, [&](int bi) {
+        size_t begin = block_size * bi;
+        InterleaveRange(dst, src, begin, std::min(begin + block_size, num));
+    });
+}
+
 VertexFormat GuessVertexFormat(
     const float3 *points,
     const float3 *normals,
@@ -73,6 +97,27 @@ VertexFormat GuessVertexFormat(
     return VertexFormat::Unknown;
 }
 
+VertexFormat NegotiateVertexFormat(VertexFormat format,
+    const float3 *points,
+    const float3 *normals,
+    const float4 *colors,
+    const float2 *uvs,
+    const float4 *tangents
+)
+{
+    bool c = false, u = false, t = false;
+    switch (format) {
+    case VertexFormat::V3N3: break;
+    case VertexFormat::V3N3C4: c = true; break;
+    case VertexFormat::V3N3U2: u = true; break;
+    case VertexFormat::V3N3C4U2: c = u = true; break;
+    case VertexFormat::V3N3U2T4: u = t = true; break;
+    case VertexFormat::V3N3C4U2T4: c = u = t = true; break;
+    default: return VertexFormat::Unknown;
+    }
+    return GuessVertexFormat(points, normals, c ? colors : nullptr, u ? uvs : nullptr, t ? tangents : nullptr);
+}
+
 size_t GetVertexSize(VertexFormat format)
 {
     switch (format) {
@@ -138,7 +138,7 @@ struct vertex_v3n3u2t4
 
 struct vertex_v3n3c4u2t4_arrays
 {
-    DefTraits(vertex_v3n3u2t4, V3N3C4U2T4)
+    DefTraits(vertex_v3n3c4u2t4, V3N3C4U2T4)
     const float3 *points;
     const float3 *normals;
     const float4 *colors;
@@ -164,8 +164,19 @@ VertexFormat GuessVertexFormat(
     const float4 *tangents
 );
 
+// the largest format that has only components of format and whose sources are not null.
+// e.g. V3N3C4U2T4 without colors is V3N3U2T4. Unknown if points or normals are null.
+VertexFormat NegotiateVertexFormat(VertexFormat format,
+    const float3 *points,
+    const float3 *normals,
+    const float4 *colors,
+    const float2 *uvs,
+    const float4 *tangents
+);
+
 size_t GetVertexSize(VertexFormat format);
 
+// sources that are not in format are ignored. processed in parallel if num is large.
 void Interleave(void *dst, VertexFormat format, size_t num,
     const float3 *points,
     const float3 *normals,
@@ -174,6 +185,6 @@ void Interleave(void *dst, VertexFormat format, size_t num,
     const float4 *tangents
 );
 
-template<class VertexT> void Interleave_Generic(VertexT *dst, const typename VertexT::source_t& src, size_t num);
+template<class VertexT> void Interleave_Generic(VertexT *dst, const typename VertexT::arrays_t& src, size_t num);
 
 } // namespace mu
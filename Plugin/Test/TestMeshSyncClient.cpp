@@ -102,6 +102,283 @@ TestCase(Test_Animation)
     Send(scene);
 }
 
+// value of reduced track at time t, interpolated the same way keyframe reduction assumes
+template<class T, class Lerp>
+static T SampleTrack(const ms::AnimationTrack<T>& track, float t, const Lerp& lerp_)
+{
+    auto& times = track.times;
+    auto& values = track.values;
+    if (t <= times.front())
+        return values.front();
+    if (t >= times.back())
+        return values.back();
+    int i = (int)(std::upper_bound(times.begin(), times.end(), t) - times.begin());
+    return lerp_(values[i - 1], values[i], (t - times[i - 1]) / (times[i] - times[i - 1]));
+}
+
+TestCase(Test_KeyframeReduction)
+{
+    // baked samples as clients produce: 30 fps, smooth motion mixed with holds and linear moves
+    const int num_animations = 256;
+    const int num_frames = 30 * 60;
+    const float frame_to_seconds = 1.0f / 30.0f;
+
+    auto clip = ms::AnimationClip::create();
+    for (int ai = 0; ai < num_animations; ++ai) {
+        auto anim = ms::TransformAnimation::create();
+        anim->path = "/Test/Reduction" + std::to_string(ai);
+        for (int f = 0; f < num_frames; ++f) {
+            float t = frame_to_seconds * f;
+            float phase = (float)ai * 0.1f;
+            float hold = (f / 120) % 2 == 0 ? t : (float)(f / 120 * 120) * frame_to_seconds;
+            anim->translation.push_back({ t, { std::sin(t + phase), hold, t * 0.5f } });
+            anim->rotation.push_back({ t, rotateY(std::sin(t * 0.7f + phase) * mu::PI) });
+            anim->scale.push_back({ t, { 1.0f, 1.0f, 1.0f } });
+            anim->visible.push_back({ t, (f / 300) % 2 == 0 });
+        }
+        clip->animations.push_back(anim);
+    }
+
+    std::vector<std::shared_ptr<ms::TransformAnimation>> original;
+    for (auto& a : clip->animations) {
+        auto dst = ms::TransformAnimation::create();
+        *dst = static_cast<ms::TransformAnimation&>(*a);
+        original.push_back(dst);
+    }
+
+    auto count_keys = [](ms::AnimationClip& c) {
+        size_t ret = 0;
+        for (auto& a : c.animations) {
+            auto& t = static_cast<ms::TransformAnimation&>(*a);
+            ret += t.translation.size() + t.rotation.size() + t.scale.size() + t.visible.size();
+        }
+        return ret;
+    };
+    size_t keys_before = count_keys(*clip);
+
+    ms::KeyframeReductionSettings settings;
+    auto begin = Now();
+    clip->reduction(settings);
+    auto elapsed = Now() - begin;
+    size_t keys_after = count_keys(*clip);
+
+    float max_translation_error = 0.0f;
+    float max_rotation_error = 0.0f;
+    int visibility_mismatches = 0;
+    for (size_t ai = 0; ai < clip->animations.size(); ++ai) {
+        auto& src = *original[ai];
+        auto& dst = static_cast<ms::TransformAnimation&>(*clip->animations[ai]);
+        for (int f = 0; f < num_frames; ++f) {
+            float t = frame_to_seconds * f;
+            auto pos = SampleTrack(dst.translation, t, [](const float3& a, const float3& b, float r) { return lerp(a, b, r); });
+            max_translation_error = std::max(max_translation_error, length(pos - src.translation[f].value));
+
+            auto rot = SampleTrack(dst.rotation, t, [](const quatf& a, const quatf& b, float r) {
+                auto v = normalize(lerp((const float4&)a, (const float4&)b, r));
+                return (const quatf&)v;
+            });
+            auto a4 = (const float4&)rot;
+            auto b4 = normalize((const float4&)src.rotation[f].value);
+            if (dot(a4, b4) < 0.0f)
+                b4 = -b4;
+            float angle = 4.0f * std::atan2(length(a4 - b4), length(a4 + b4));
+            max_rotation_error = std::max(max_rotation_error, angle * mu::Rad2Deg);
+
+            if (!dst.visible.empty()) {
+                auto vis = SampleTrack(dst.visible, t, [](bool a, bool, float) { return a; });
+                if (vis != src.visible[f].value)
+                    ++visibility_mismatches;
+            }
+        }
+    }
+
+    Print("    keys: %d -> %d (%.2f%%), %.2fms\n", (int)keys_before, (int)keys_after,
+        (double)keys_after / (double)keys_before * 100.0, NS2MS(elapsed));
+    Print("    max error: translation %f (threshold %f), rotation %f deg (threshold %f), visibility mismatches %d\n",
+        max_translation_error, settings.threshold, max_rotation_error, settings.rotation_threshold, visibility_mismatches);
+}
+
+
+TestCase(Test_AnimationTrackSoA)
+{
+    const int num_frames = 30 * 60;
+    const float frame_to_seconds = 1.0f / 30.0f;
+
+    auto anim = ms::CameraAnimation::create();
+    anim->path = "/Test/Camera";
+    for (int f = 0; f < num_frames; ++f) {
+        float t = frame_to_seconds * f;
+        anim->translation.push_back({ t, { std::sin(t), std::cos(t), t } });
+        anim->rotation.push_back({ t, rotateXYZ(float3{ t, t * 0.5f, t * 0.25f }) });
+        anim->scale.push_back({ t, { 1.0f, 2.0f, 3.0f } });
+        anim->fov.push_back({ t, 60.0f + std::sin(t) });
+        anim->near_plane.push_back({ t, 0.3f });
+        anim->far_plane.push_back({ t, 1000.0f });
+    }
+
+    // size of the former interleaved layout: { time, value } per key
+    size_t interleaved_size = num_frames * (sizeof(float) + sizeof(float3)) * 2 + num_frames * (sizeof(float) + sizeof(quatf))
+        + num_frames * (sizeof(float) + sizeof(float)) * 3;
+
+    // the 110 layout is written unless the receiver supports shared times
+    auto round_trip = [&](bool share_times, size_t& size) {
+        ms::FeatureFlags features = {0};
+        features.animation_shared_times = share_times;
+        ms::WireFormatScope scope(features);
+
+        std::stringstream ss;
+        anim->serialize(ss);
+        size = anim->getSerializeSize();
+        auto restored = std::static_pointer_cast<ms::CameraAnimation>(ms::Animation::create(ss));
+        return ss.str().size() == size && restored && restored->translation.size() == num_frames && restored->fov.size() == num_frames &&
+            memcmp(restored->far_plane.times.data(), anim->translation.times.data(), sizeof(float) * num_frames) == 0 &&
+            memcmp(restored->rotation.values.data(), anim->rotation.values.data(), sizeof(quatf) * num_frames) == 0;
+    };
+    size_t legacy_size, serialized_size;
+    bool legacy_ok = round_trip(false, legacy_size) && legacy_size > interleaved_size;
+    bool restore_ok = round_trip(true, serialized_size) && serialized_size < legacy_size;
+
+    Print("    serialized %d bytes (interleaved layout: %d bytes, %.1f%%) 110 layout %s, shared times %s\n",
+        (int)serialized_size, (int)interleaved_size, (double)serialized_size / (double)interleaved_size * 100.0,
+        legacy_ok ? "ok" : "*** failed ***", restore_ok ? "ok" : "*** failed ***");
+
+    // SIMD conversion must match per-key swap_handedness() / swap_yz()
+    auto expected = ms::CameraAnimation::create();
+    *expected = *anim;
+    for (auto& v : expected->translation.values) v = swap_yz(swap_handedness(v));
+    for (auto& v : expected->rotation.values) v = swap_yz(swap_handedness(v));
+    for (auto& v : expected->scale.values) v = swap_yz(v);
+    for (auto& v : expected->near_plane.values) v *= 0.01f;
+    for (auto& v : expected->far_plane.values) v *= 0.01f;
+    for (auto& v : expected->translation.values) v *= 0.01f;
+
+    auto begin = Now();
+    anim->convertHandedness(true, true);
+    anim->applyScaleFactor(0.01f);
+    auto elapsed = Now() - begin;
+
+    bool convert_ok = true;
+    for (int i = 0; i < num_frames; ++i) {
+        convert_ok = convert_ok &&
+            near_equal(anim->translation.values[i], expected->translation.values[i]) &&
+            near_equal(anim->rotation.values[i], expected->rotation.values[i]) &&
+            near_equal(anim->scale.values[i], expected->scale.values[i]) &&
+            near_equal(anim->near_plane.values[i], expected->near_plane.values[i]) &&
+            near_equal(anim->far_plane.values[i], expected->far_plane.values[i]);
+    }
+    Print("    convertHandedness + applyScaleFactor: %.3fms, %s\n", NS2MS(elapsed), convert_ok ? "ok" : "*** mismatch ***");
+}
+
+TestCase(Test_AnimationBaker)
+{
+    const int num_targets = 64;
+    const int num_frames = 120;
+    const float frame_to_seconds = 1.0f / 30.0f;
+
+    // emulates a DCC: evaluating a frame is slow and serial, reading evaluated values is cheap.
+    float current_time = 0.0f;
+    auto set_frame = [&](int f) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        current_time = frame_to_seconds * f;
+    };
+    auto capture = [&](ms::Animation& dst_, int ti) {
+        auto& dst = static_cast<ms::TransformAnimation&>(dst_);
+        float t = current_time;
+        float v = t * (float)(ti + 1);
+        dst.translation.push_back({ t, { std::sin(v), 0.0f, std::cos(v) } });
+        dst.rotation.push_back({ t, rotateY(v) });
+        dst.scale.push_back({ t, { 1.0f, 1.0f, 1.0f } });
+        dst.visible.push_back({ t, true });
+    };
+
+    // reference: capture each frame directly into the targets
+    std::vector<std::shared_ptr<ms::TransformAnimation>> expected(num_targets);
+    auto begin = Now();
+    for (auto& e : expected)
+        e = ms::TransformAnimation::create();
+    for (int f = 0; f < num_frames; ++f) {
+        set_frame(f);
+        for (int ti = 0; ti < num_targets; ++ti)
+            capture(*expected[ti], ti);
+    }
+    for (auto& e : expected)
+        e->reduction();
+    auto elapsed_serial = Now() - begin;
+
+    std::vector<std::shared_ptr<ms::TransformAnimation>> baked(num_targets);
+    begin = Now();
+    ms::AnimationBaker baker;
+    for (int ti = 0; ti < num_targets; ++ti) {
+        baked[ti] = ms::TransformAnimation::create();
+        baker.addTarget(baked[ti], [&capture, ti](ms::Animation& dst) { capture(dst, ti); });
+    }
+    ms::AnimationBaker::Settings settings;
+    settings.frame_start = 0;
+    settings.frame_end = num_frames - 1;
+    baker.bake(settings, set_frame);
+    auto elapsed_baker = Now() - begin;
+
+    bool ok = true;
+    for (int ti = 0; ti < num_targets; ++ti) {
+        auto& e = *expected[ti];
+        auto& b = *baked[ti];
+        ok = ok &&
+            e.translation.size() == b.translation.size() &&
+            e.rotation.size() == b.rotation.size() &&
+            e.scale.size() == b.scale.size() &&
+            e.visible.size() == b.visible.size() &&
+            memcmp(e.translation.times.data(), b.translation.times.data(), sizeof(float) * e.translation.size()) == 0 &&
+            memcmp(e.rotation.values.data(), b.rotation.values.data(), sizeof(quatf) * e.rotation.size()) == 0;
+    }
+    Print("    %d targets x %d frames: serial %.2fms, baker %.2fms, %s\n",
+        num_targets, num_frames, NS2MS(elapsed_serial), NS2MS(elapsed_baker), ok ? "ok" : "*** mismatch ***");
+
+    // chunked: reduced on the worker. the result must stay within the error bound of the original samples.
+    const int chunk_frames = 32;
+    std::vector<std::shared_ptr<ms::TransformAnimation>> chunked(num_targets);
+    baker.clear();
+    for (int ti = 0; ti < num_targets; ++ti) {
+        chunked[ti] = ms::TransformAnimation::create();
+        baker.addTarget(chunked[ti], [&capture, ti](ms::Animation& dst) { capture(dst, ti); });
+    }
+    int num_chunks = 0, last_frame = -1;
+    bool chunks_ok = true;
+    settings.chunk_frames = chunk_frames;
+    begin = Now();
+    baker.bake(settings, set_frame, nullptr, [&](int frame_begin, int frame_end, bool last) {
+        chunks_ok = chunks_ok && frame_begin == last_frame + 1 && last == (frame_end == num_frames - 1);
+        last_frame = frame_end;
+        ++num_chunks;
+    });
+    auto elapsed_chunked = Now() - begin;
+    chunks_ok = chunks_ok && num_chunks == (num_frames + chunk_frames - 1) / chunk_frames;
+
+    float max_error = 0.0f;
+    size_t num_keys = 0;
+    for (int ti = 0; ti < num_targets; ++ti) {
+        auto& track = chunked[ti]->translation;
+        num_keys += track.size();
+        chunks_ok = chunks_ok && chunked[ti]->scale.empty() && chunked[ti]->visible.empty() &&
+            track.size() >= expected[ti]->translation.size();
+        for (int f = 0; f < num_frames && chunks_ok; ++f) {
+            float t = frame_to_seconds * f;
+            size_t i = std::lower_bound(track.times.begin(), track.times.end(), t) - track.times.begin();
+            float3 v;
+            if (i == 0)
+                v = track.values[0];
+            else if (i == track.size())
+                v = track.values[i - 1];
+            else
+                v = lerp(track.values[i - 1], track.values[i], (t - track.times[i - 1]) / (track.times[i] - track.times[i - 1]));
+            float a = t * (float)(ti + 1);
+            max_error = std::max(max_error, length(v - float3{ std::sin(a), 0.0f, std::cos(a) }));
+        }
+    }
+    chunks_ok = chunks_ok && num_keys < (size_t)(num_targets * num_frames) && max_error <= settings.reduction_settings.threshold * 1.01f;
+    Print("    chunked (%d frames): %.2fms, %d chunks, max error %f, %s\n",
+        chunk_frames, NS2MS(elapsed_chunked), num_chunks, max_error, chunks_ok ? "ok" : "*** validation failed ***");
+}
+
 
 template<class color_t>
 void CreateCheckerImage(RawVector<char>& dst, color_t black, color_t white, int width, int height)
@@ -253,3 +530,1228 @@ TestCase(Test_Query)
     send_query(ms::QueryMessage::QueryType::RootNodes);
     send_query(ms::QueryMessage::QueryType::AllNodes);
 }
+
+
+TestCase(Test_Handshake)
+{
+    // capabilities survive serialization
+    auto caps = ms::Capabilities::current();
+    caps.max_message_size = 1024 * 1024;
+    caps.max_threads = 8;
+    caps.framed_port = 8081;
+    caps.framed_timeout_ms = 60000;
+    caps.server_epoch = 12345;
+    std::stringstream ss;
+    caps.serialize(ss);
+    ms::Capabilities restored;
+    restored.deserialize(ss);
+    bool ok = ss.str().size() == caps.getSerializeSize() && memcmp(&restored.features, &caps.features, sizeof(caps.features)) == 0 &&
+        restored.max_message_size == caps.max_message_size && restored.max_threads == 8 && restored.framed_port == 8081 &&
+        restored.framed_timeout_ms == 60000 && restored.server_epoch == 12345;
+
+    // negotiation keeps only the common features. a legacy peer gets none of the newer ones.
+    auto legacy = ms::Capabilities::negotiate(caps, ms::Capabilities::legacy());
+    ok = ok && legacy.isCompatible() && legacy.features.get && legacy.features.query &&
+        !legacy.features.texture_cache && !legacy.features.path_references && !legacy.features.animation_shared_times;
+    auto peer = ms::Capabilities::current();
+    peer.features.compact_indices = 0;
+    auto common = ms::Capabilities::negotiate(caps, peer);
+    ok = ok && common.isCompatible() && !common.features.compact_indices && common.features.path_references && common.max_threads == 8 &&
+        common.server_epoch == 12345;
+    Print("    capabilities: %s\n", ok ? "OK" : "*** validation failed ***");
+
+    // with a running server
+    ms::ClientSettings settings;
+    ms::Client client(settings);
+    if (client.handshake()) {
+        auto& negotiated = client.getCapabilities();
+        bool server_ok = negotiated.isCompatible() && negotiated.features.get && negotiated.features.path_references;
+        Print("    handshake with server: %s\n", server_ok ? "OK" : "*** validation failed ***");
+    }
+    else {
+        Print("    handshake with server: no server\n");
+    }
+}
+
+
+TestCase(Test_SharedMemoryTransport)
+{
+    // server-less loopback: a reader thread deserializes SetMessage directly from the ring
+    const int num_frames = 8;
+    const int timeout_ms = 10000;
+
+    ms::SharedMemoryChannel server_side, client_side;
+    if (!server_side.create("MeshSync_Test", 64 * 1024 * 1024) || !client_side.open("MeshSync_Test")) {
+        Print("    failed to create shared memory\n");
+        return;
+    }
+
+    ms::SetMessage mes;
+    {
+        auto mesh = ms::Mesh::create();
+        mesh->path = "/Test/LargeWave";
+        GenerateWaveMesh(mesh->counts, mesh->indices, mesh->points, mesh->uv0, 2.0f, 1.0f, 1024, 0.0f);
+        mesh->material_ids.resize(mesh->counts.size(), 0);
+        mesh->normals.resize(mesh->points.size(), float3::zero());
+        mesh->setupFlags();
+        mes.scene.objects.push_back(mesh);
+    }
+    const uint64_t frame_size = mes.getSerializeSize();
+
+    int num_received = 0;
+    std::thread reader([&]() {
+        for (int i = 0; i < num_frames; ++i) {
+            ms::FrameHeader fh;
+            if (!server_side.readFrameHeader(fh, timeout_ms))
+                break;
+            ms::SharedMemoryIStreamBuf buf(server_side, fh.size, timeout_ms);
+            std::istream is(&buf);
+            ms::SetMessage recv;
+            if (recv.deserialize(is) && buf.finish())
+                ++num_received;
+        }
+    });
+
+    auto begin = Now();
+    for (int i = 0; i < num_frames; ++i)
+        client_side.writeMessage(ms::FrameType::Set, mes, timeout_ms);
+    reader.join();
+    auto elapsed = Now() - begin;
+
+    double bytes = (double)frame_size * num_frames;
+    Print("    shared memory: %d/%d frames, %.2fMB each, %.2fms, %.2fGB/s\n",
+        num_received, num_frames, (double)frame_size / (1024.0 * 1024.0),
+        NS2MS(elapsed), bytes / ((double)elapsed / 1e9) / (1024.0 * 1024.0 * 1024.0));
+
+    // for comparison: serialize + deserialize via std::stringstream (lower bound of what HTTP has to do)
+    begin = Now();
+    for (int i = 0; i < num_frames; ++i) {
+        std::stringstream ss;
+        mes.serialize(ss);
+        ms::SetMessage recv;
+        recv.deserialize(ss);
+    }
+    elapsed = Now() - begin;
+    Print("    stringstream:  %.2fms, %.2fGB/s\n",
+        NS2MS(elapsed), bytes / ((double)elapsed / 1e9) / (1024.0 * 1024.0 * 1024.0));
+}
+
+
+TestCase(Test_SharedMemoryResync)
+{
+    // a frame the writer gives up on must be skipped as a whole, and the next frame must be intact
+    ms::SharedMemoryChannel server_side, client_side;
+    if (!server_side.create("MeshSync_TestResync", 64 * 1024) || !client_side.open("MeshSync_TestResync")) {
+        Print("    failed to create shared memory\n");
+        return;
+    }
+
+    ms::SetMessage large;
+    {
+        auto mesh = ms::Mesh::create();
+        mesh->path = "/Test/LargeWave";
+        GenerateWaveMesh(mesh->counts, mesh->indices, mesh->points, mesh->uv0, 2.0f, 1.0f, 128, 0.0f);
+        mesh->setupFlags();
+        large.scene.objects.push_back(mesh);
+    }
+    ms::FenceMessage fence;
+    fence.type = ms::FenceMessage::FenceType::SceneEnd;
+
+    // nobody reads. the writer times out with the header and a part of the payload in the ring.
+    bool aborted = !client_side.writeMessage(ms::FrameType::Set, large, 100);
+
+    // the reader skips the broken frame
+    ms::FrameHeader fh;
+    bool skipped = server_side.waitData(100) && !server_side.readFrameHeader(fh, 100);
+
+    bool sent = client_side.writeMessage(ms::FrameType::Fence, fence, 1000);
+    bool received = false;
+    if (server_side.readFrameHeader(fh, 1000) && fh.type == ms::FrameType::Fence) {
+        ms::SharedMemoryIStreamBuf buf(server_side, fh.size, 1000);
+        std::istream is(&buf);
+        ms::FenceMessage recv;
+        received = recv.deserialize(is) && buf.finish() && recv.type == fence.type;
+    }
+
+    bool ok = aborted && skipped && sent && received;
+    Print("    ... %s\n", ok ? "OK" : "*** validation failed ***");
+}
+
+TestCase(Test_FenceLatency)
+{
+    // requires a running server. compares HTTP and the framed transport on small messages.
+    const int num_try = 100;
+    auto measure = [num_try](const char *name, bool framed) {
+        ms::ClientSettings settings;
+        settings.use_shared_memory = false;
+        settings.use_framed_transport = framed;
+        ms::Client client(settings);
+
+        ms::FenceMessage begin, end;
+        begin.type = ms::FenceMessage::FenceType::SceneBegin;
+        end.type = ms::FenceMessage::FenceType::SceneEnd;
+        if (!client.send(begin) || !client.send(end)) {
+            Print("    %s: server not responding\n", name);
+            return;
+        }
+        TestScope(name, [&]() {
+            client.send(begin);
+            client.send(end);
+        }, num_try);
+    };
+    measure("fence (HTTP)", false);
+    measure("fence (framed)", true);
+}
+
+TestCase(Test_PendingFence)
+{
+    // a SceneEnd fence that arrives while a Set is still being received must not block the receiving thread,
+    // and must be queued after the Set (no network involved)
+    ms::ServerSettings settings;
+    ms::Server server(settings);
+    auto make_fence = [](ms::FenceMessage::FenceType type) {
+        auto ret = std::make_shared<ms::FenceMessage>();
+        ret->type = type;
+        return ret;
+    };
+
+    server.recvFence(make_fence(ms::FenceMessage::FenceType::SceneBegin));
+    nanosec elapsed;
+    {
+        ms::Server::RecvSceneScope receiving(&server); // a Set being received on another thread
+        auto begin = mu::Now();
+        server.recvFence(make_fence(ms::FenceMessage::FenceType::SceneEnd));
+        elapsed = mu::Now() - begin;
+
+        auto set = std::make_shared<ms::SetMessage>();
+        auto obj = ms::Transform::create();
+        obj->path = "/Fenced";
+        set->scene.objects.push_back(obj);
+        server.recvSet(set);
+    }
+
+    std::vector<ms::Message::Type> order;
+    server.processMessages([&](ms::Message::Type type, ms::Message&) { order.push_back(type); });
+    bool ok = elapsed < 100000000 && order.size() == 3 && order[0] == ms::Message::Type::Fence &&
+        order[1] == ms::Message::Type::Set && order[2] == ms::Message::Type::Fence;
+    Print("    fence returned in %.2fms, queued after the set: %s\n", NS2MS(elapsed), ok ? "OK" : "*** validation failed ***");
+}
+
+
+TestCase(Test_MeshChunk)
+{
+    // split a mesh into chunks as Client does, and let Server reassemble it (no network involved)
+    using Attribute = ms::MeshChunkMessage::Attribute;
+    const uint64_t chunk_size = 1024 * 1024;
+
+    auto mesh = ms::Mesh::create();
+    mesh->path = "/Test/ChunkedWave";
+    GenerateWaveMesh(mesh->counts, mesh->indices, mesh->points, mesh->uv0, 2.0f, 1.0f, 512, 0.0f);
+    mesh->material_ids.resize(mesh->counts.size(), 0);
+    mesh->setupFlags();
+
+    ms::ServerSettings settings;
+    ms::Server server(settings);
+
+    int num_chunks = 0;
+    auto send = [&](const ms::MeshChunkMessage& chunk) {
+        std::stringstream ss;
+        chunk.serialize(ss);
+        auto recv = std::make_shared<ms::MeshChunkMessage>();
+        recv->deserialize(ss);
+        ++num_chunks;
+        return server.recvMeshChunk(recv);
+    };
+
+    ms::MeshChunkMessage chunk;
+    chunk.transfer_id = 1;
+    chunk.attribute = Attribute::Header;
+    chunk.flags = mesh->flags;
+    chunk.source = mesh.get();
+    send(chunk);
+    chunk.source = nullptr;
+    for (int a = (int)Attribute::Points; a < (int)Attribute::End; ++a) {
+        chunk.attribute = (Attribute)a;
+        auto elem_size = ms::MeshChunkMessage::getElementSize(chunk.attribute);
+        auto src = ms::MeshChunkMessage::getAttribute(*mesh, chunk.attribute);
+        uint64_t count = src.size() / elem_size;
+        uint64_t step = chunk_size / elem_size;
+        chunk.total_count = count;
+        for (uint64_t offset = 0; offset < count; offset += step) {
+            chunk.offset = offset;
+            chunk.data = IArray<char>(src.data() + offset * elem_size, (size_t)(std::min(step, count - offset) * elem_size));
+            send(chunk);
+        }
+    }
+
+    // chunks out of range are rejected. offsets and counts come from the wire and must not overflow the bounds check.
+    bool rejected = true;
+    {
+        float3 garbage[2] = {};
+        chunk.attribute = Attribute::Points;
+        chunk.total_count = mesh->points.size();
+        chunk.data = IArray<char>((char*)garbage, sizeof(garbage));
+        chunk.offset = chunk.total_count - 1;
+        rejected = rejected && !send(chunk);
+        chunk.offset = ~0ull / sizeof(float3) + 1;
+        rejected = rejected && !send(chunk);
+    }
+    chunk.attribute = Attribute::End;
+    send(chunk);
+
+    bool ok = rejected;
+    server.processMessages([&](ms::Message::Type type, ms::Message& data) {
+        if (type != ms::Message::Type::Set)
+            return;
+        auto& set = static_cast<ms::SetMessage&>(data);
+        for (auto& obj : set.scene.objects) {
+            auto *dst = dynamic_cast<ms::Mesh*>(obj.get());
+            ok = ok && dst && dst->path == mesh->path && !dst->splits.empty() && dst->points.size() >= mesh->points.size();
+        }
+    });
+    Print("    %d chunks (%.2fMB vertex data): %s\n", num_chunks,
+        (double)mesh->getVertexDataSize() / (1024.0 * 1024.0), ok ? "reassembled" : "*** validation failed ***");
+    Print("%s", server.getProfiler().toString().c_str());
+}
+
+TestCase(Test_AnimationChunk)
+{
+    // stream a clip in chunks as a DCC does while baking, and let Server append them (no network involved)
+    const int num_frames = 1000;
+    const int chunk_frames = 64;
+    const float frame_to_seconds = 1.0f / 30.0f;
+
+    ms::ServerSettings settings;
+    ms::Server server(settings);
+
+    int num_chunks = 0, num_sets = 0;
+    size_t max_chunk_size = 0;
+    auto send = [&](const ms::AnimationChunkMessage& chunk) {
+        std::stringstream ss;
+        chunk.serialize(ss);
+        max_chunk_size = std::max(max_chunk_size, ss.str().size());
+        auto recv = std::make_shared<ms::AnimationChunkMessage>();
+        recv->deserialize(ss);
+        server.recvAnimationChunk(recv);
+        ++num_chunks;
+    };
+    ms::AnimationClipPtr received;
+    auto process = [&]() {
+        server.processMessages([&](ms::Message::Type type, ms::Message& data) {
+            if (type != ms::Message::Type::Set)
+                return;
+            auto& set = static_cast<ms::SetMessage&>(data);
+            if (!set.scene.animations.empty()) {
+                received = set.scene.animations.front();
+                ++num_sets;
+            }
+        });
+    };
+
+    auto anim = ms::TransformAnimation::create();
+    ms::AnimationChunkMessage chunk;
+    chunk.transfer_id = 1;
+    chunk.clip = "Take001";
+    chunk.animations = { anim };
+    for (int f = 0; f < num_frames; ++f) {
+        float t = frame_to_seconds * f;
+        anim->path = "/Test/Streamed";
+        anim->translation.push_back({ t, { std::sin(t), 0.0f, std::cos(t) } });
+        anim->rotation.push_back({ t, rotateY(t) });
+        if ((f + 1) % chunk_frames == 0 || f + 1 == num_frames) {
+            chunk.time_end = t;
+            chunk.last = f + 1 == num_frames;
+            send(chunk);
+            anim->clear();
+            chunk.time_begin = t;
+            // the handler runs while the clip is being streamed. the clip is not re-imported on every chunk.
+            process();
+        }
+    }
+
+    bool ok = num_sets <= 2 + (int)std::log2((double)num_chunks);
+    if (received && received->name == chunk.clip && received->animations.size() == 1) {
+        auto& dst = static_cast<ms::TransformAnimation&>(*received->animations.front());
+        ok = ok && dst.path == "/Test/Streamed" && !dst.translation.empty() && dst.translation.size() < num_frames &&
+            dst.translation.times.front() == 0.0f && near_equal(dst.translation.times.back(), frame_to_seconds * (num_frames - 1));
+    }
+    Print("    %d chunks (max %d bytes), handled %d times: %s\n", num_chunks, (int)max_chunk_size, num_sets,
+        ok ? "appended and reduced" : "*** validation failed ***");
+}
+
+TestCase(Test_TextureCache)
+{
+    // send textures, then send them again as references as Client does after querying the cache (no network involved)
+    const int width = 1024, height = 1024;
+    const uint64_t texture_size = width * height * sizeof(unorm8x4);
+
+    ms::ServerSettings settings;
+    settings.texture_cache_size = texture_size * 3;
+    ms::Server server(settings);
+
+    auto send = [&](const std::vector<ms::TexturePtr>& textures) {
+        ms::WireFormatScope scope(ms::Capabilities::current().features);
+        ms::SetMessage set;
+        set.scene.textures = textures;
+        std::stringstream ss;
+        set.serialize(ss);
+        auto size = ss.str().size();
+        auto recv = std::make_shared<ms::SetMessage>();
+        recv->deserialize(ss);
+        server.recvSet(recv);
+        return size;
+    };
+    std::vector<ms::TexturePtr> received;
+    auto process = [&]() {
+        received.clear();
+        server.processMessages([&](ms::Message::Type type, ms::Message& data) {
+            if (type == ms::Message::Type::Set)
+                received = static_cast<ms::SetMessage&>(data).scene.textures;
+        });
+    };
+
+    std::vector<ms::TexturePtr> textures;
+    for (int i = 0; i < 4; ++i) {
+        auto tex = ms::Texture::create();
+        tex->name = "checker" + std::to_string(i);
+        tex->format = ms::TextureFormat::RGBAu8;
+        tex->width = width;
+        tex->height = height;
+        unorm8x4 black{ 0.0f, 0.0f, 0.0f, 1.0f };
+        unorm8x4 color{ 0.25f * i, 1.0f, 1.0f, 1.0f };
+        CreateCheckerImage(tex->data, black, color, width, height);
+        tex->updateHash();
+        textures.push_back(tex);
+    }
+
+    // the first send caches all of them. the capacity holds 3, so the first one is evicted.
+    auto full_size = send(textures);
+    process();
+
+    ms::TextureQueryMessage query, cached;
+    for (auto& tex : textures)
+        query.hashes.push_back(tex->hash);
+    server.recvTextureQuery(query, cached);
+
+    // another client sends a texture between the query and the Set. the queried ones must not be evicted by it.
+    {
+        auto other = ms::Texture::create();
+        other->name = "other";
+        other->format = ms::TextureFormat::RGBAu8;
+        other->width = width;
+        other->height = height;
+        CreateCheckerImage(other->data, unorm8x4{ 0.0f, 0.0f, 0.0f, 1.0f }, unorm8x4{ 1.0f, 0.0f, 0.0f, 1.0f }, width, height);
+        other->updateHash();
+        send({ other });
+        process();
+    }
+
+    std::vector<ms::TexturePtr> refs;
+    for (auto& tex : textures) {
+        bool hit = std::find(cached.hashes.begin(), cached.hashes.end(), tex->hash) != cached.hashes.end();
+        refs.push_back(hit ? tex->makeReference() : tex);
+    }
+    auto ref_size = send(refs);
+    process();
+
+    bool ok = cached.hashes.size() == 3 && received.size() == textures.size();
+    for (size_t i = 0; ok && i < received.size(); ++i) {
+        ok = received[i]->data.size() == textures[i]->data.size() &&
+            memcmp(received[i]->data.cdata(), textures[i]->data.cdata(), textures[i]->data.size()) == 0;
+    }
+    auto stats = server.getTextureCache().getStats();
+    Print("    %d cached of %d. sent %.2fMB -> %.2fMB. hits %d, evictions %d: %s\n",
+        (int)cached.hashes.size(), (int)textures.size(), (double)full_size / (1024.0 * 1024.0), (double)ref_size / (1024.0 * 1024.0),
+        (int)stats.hits, (int)stats.evictions, ok ? "restored" : "*** validation failed ***");
+}
+
+// reference decoders to validate the encoders. see the BC format specifications.
+static void DecodeBC1(unorm8x4 *dst, const uint8_t *src, bool four_colors)
+{
+    uint16_t c[2] = { uint16_t(src[0] | (src[1] << 8)), uint16_t(src[2] | (src[3] << 8)) };
+    int rgb[4][3];
+    for (int i = 0; i < 2; ++i) {
+        rgb[i][0] = ((c[i] >> 11) & 31) * 255 / 31;
+        rgb[i][1] = ((c[i] >> 5) & 63) * 255 / 63;
+        rgb[i][2] = (c[i] & 31) * 255 / 31;
+    }
+    bool opaque = four_colors || c[0] > c[1];
+    for (int k = 0; k < 3; ++k) {
+        if (opaque) {
+            rgb[2][k] = (rgb[0][k] * 2 + rgb[1][k]) / 3;
+            rgb[3][k] = (rgb[0][k] + rgb[1][k] * 2) / 3;
+        }
+        else {
+            rgb[2][k] = (rgb[0][k] + rgb[1][k]) / 2;
+            rgb[3][k] = 0;
+        }
+    }
+    uint32_t indices = src[4] | (src[5] << 8) | (src[6] << 16) | (src[7] << 24);
+    for (int i = 0; i < 16; ++i) {
+        int *v = rgb[(indices >> (i * 2)) & 3];
+        dst[i].x.value = (uint8_t)v[0];
+        dst[i].y.value = (uint8_t)v[1];
+        dst[i].z.value = (uint8_t)v[2];
+    }
+}
+
+static void DecodeBC4(uint8_t *dst, int stride, const uint8_t *src)
+{
+    int v[8] = { src[0], src[1] };
+    if (v[0] > v[1]) {
+        for (int i = 2; i < 8; ++i)
+            v[i] = ((8 - i) * v[0] + (i - 1) * v[1]) / 7;
+    }
+    else {
+        for (int i = 2; i < 6; ++i)
+            v[i] = ((6 - i) * v[0] + (i - 1) * v[1]) / 5;
+        v[6] = 0;
+        v[7] = 255;
+    }
+    uint64_t indices = 0;
+    for (int i = 0; i < 6; ++i)
+        indices |= uint64_t(src[2 + i]) << (i * 8);
+    for (int i = 0; i < 16; ++i)
+        dst[i * stride] = (uint8_t)v[(indices >> (i * 3)) & 7];
+}
+
+static void DecodeBC7Mode6(unorm8x4 *dst, const uint8_t *src)
+{
+    int pos = 0;
+    auto read = [&](int bits) {
+        int r = 0;
+        for (int i = 0; i < bits; ++i, ++pos)
+            r |= ((src[pos >> 3] >> (pos & 7)) & 1) << i;
+        return r;
+    };
+    static const int weights[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+    if (read(7) != 0x40) {
+        // unorm8's default constructor leaves it uninitialized. zero explicitly rather than memset a class type.
+        std::fill(dst, dst + 16, unorm8x4{ 0.0f, 0.0f, 0.0f, 0.0f });
+        return;
+    }
+    int e[2][4];
+    for (int c = 0; c < 4; ++c) {
+        e[0][c] = read(7);
+        e[1][c] = read(7);
+    }
+    for (int i = 0; i < 2; ++i) {
+        int p = read(1);
+        for (int c = 0; c < 4; ++c)
+            e[i][c] = (e[i][c] << 1) | p;
+    }
+    for (int i = 0; i < 16; ++i) {
+        int w = weights[read(i == 0 ? 3 : 4)];
+        uint8_t *d = (uint8_t*)&dst[i];
+        for (int c = 0; c < 4; ++c)
+            d[c] = (uint8_t)(((64 - w) * e[0][c] + w * e[1][c] + 32) >> 6);
+    }
+}
+
+static void DecodeBC(ms::TextureFormat format, unorm8x4 *dst, const char *src, int width, int height)
+{
+    int block_size = format == ms::TextureFormat::BC1 ? 8 : 16;
+    for (int by = 0; by < height / 4; ++by) {
+        for (int bx = 0; bx < width / 4; ++bx) {
+            auto *b = (const uint8_t*)src + (by * (width / 4) + bx) * block_size;
+            unorm8x4 block[16] = {};
+            switch (format) {
+            case ms::TextureFormat::BC1: DecodeBC1(block, b, false); break;
+            case ms::TextureFormat::BC3: DecodeBC4(&block[0].w.value, 4, b); DecodeBC1(block, b + 8, true); break;
+            case ms::TextureFormat::BC5: DecodeBC4(&block[0].x.value, 4, b); DecodeBC4(&block[0].y.value, 4, b + 8); break;
+            case ms::TextureFormat::BC7: DecodeBC7Mode6(block, b); break;
+            default: break;
+            }
+            for (int i = 0; i < 16; ++i)
+                dst[(by * 4 + i / 4) * width + bx * 4 + i % 4] = block[i];
+        }
+    }
+}
+
+TestCase(Test_TextureCompression)
+{
+    const int width = 1024, height = 1024;
+
+    // smooth gradients with some noise, roughly like painted textures
+    auto tex = ms::Texture::create();
+    tex->format = ms::TextureFormat::RGBAu8;
+    tex->width = width;
+    tex->height = height;
+    tex->data.resize(width * height * sizeof(unorm8x4));
+    {
+        auto *pixels = (unorm8x4*)tex->data.data();
+        uint32_t seed = 1;
+        for (int y = 0; y < height; ++y) {
+            for (int x = 0; x < width; ++x) {
+                seed = seed * 1103515245 + 12345;
+                float noise = float((seed >> 16) & 0xff) / 255.0f * 0.05f;
+                float u = float(x) / width, v = float(y) / height;
+                unorm8x4 pixel{
+                    clamp01(u + noise), clamp01(v + noise),
+                    clamp01(0.5f + 0.5f * std::sin(u * 12.0f) * std::cos(v * 7.0f)),
+                    clamp01(1.0f - u * v) };
+                pixels[y * width + x] = pixel;
+            }
+        }
+    }
+
+    auto psnr = [&](ms::TextureFormat format, const RawVector<unorm8x4>& decoded) {
+        // compare channels that the format stores
+        int channels = format == ms::TextureFormat::BC1 ? 3 : format == ms::TextureFormat::BC5 ? 2 : 4;
+        auto *src = (const unorm8x4*)tex->data.cdata();
+        double se = 0.0;
+        for (size_t i = 0; i < decoded.size(); ++i) {
+            auto *a = (const uint8_t*)&src[i];
+            auto *b = (const uint8_t*)&decoded[i];
+            for (int c = 0; c < channels; ++c) {
+                double d = double(a[c]) - double(b[c]);
+                se += d * d;
+            }
+        }
+        double mse = se / double(decoded.size() * channels);
+        return mse == 0.0 ? 99.0 : 10.0 * std::log10(255.0 * 255.0 / mse);
+    };
+
+    const ms::TextureFormat formats[] = { ms::TextureFormat::BC1, ms::TextureFormat::BC3, ms::TextureFormat::BC5, ms::TextureFormat::BC7 };
+    const char *format_names[] = { "BC1", "BC3", "BC5", "BC7" };
+    // lower bounds of PSNR on this image. each is a few dB below what the encoders achieve at Fast.
+    const double min_psnr[] = { 38.0, 40.0, 48.0, 45.0 };
+    const BCQuality qualities[] = { BCQuality::Fast, BCQuality::Normal, BCQuality::High };
+    const char *quality_names[] = { "Fast", "Normal", "High" };
+    RawVector<unorm8x4> decoded;
+    decoded.resize(width * height);
+    bool ok = true;
+    for (int fi = 0; fi < 4; ++fi) {
+        for (int qi = 0; qi < 3; ++qi) {
+            auto dst = ms::Texture::create();
+            auto begin = Now();
+            tex->compress(*dst, formats[fi], qualities[qi]);
+            auto elapsed = Now() - begin;
+            DecodeBC(formats[fi], decoded.data(), dst->data.cdata(), width, height);
+            double db = psnr(formats[fi], decoded);
+            ok = ok && db >= min_psnr[fi];
+            Print("    %s %-6s: %.2fMB -> %.2fMB, PSNR %.2fdB, %.2fms%s\n",
+                format_names[fi], quality_names[qi], (double)tex->data.size() / (1024.0 * 1024.0), (double)dst->data.size() / (1024.0 * 1024.0),
+                db, NS2MS(elapsed), db >= min_psnr[fi] ? "" : " *** below bound ***");
+        }
+    }
+    Print("    ... %s\n", ok ? "OK" : "*** validation failed ***");
+
+    // format selection by texture type
+    tex->type = ms::TextureType::NormalMap;
+    auto normal_format = tex->getCompressedFormat(BCQuality::Normal);
+    tex->type = ms::TextureType::Default;
+    auto default_format = tex->getCompressedFormat(BCQuality::Normal);
+    auto high_format = tex->getCompressedFormat(BCQuality::High);
+    Print("    normal map: %s, default: %s, high quality: %s\n",
+        normal_format == ms::TextureFormat::BC5 ? "BC5" : "*** wrong format ***",
+        default_format == ms::TextureFormat::BC3 ? "BC3" : "*** wrong format ***",
+        high_format == ms::TextureFormat::BC7 ? "BC7" : "*** wrong format ***");
+}
+
+TestCase(Test_Mipmap)
+{
+    const int width = 2048, height = 1024;
+
+    auto make_texture = [&](ms::TextureFormat format) {
+        auto tex = ms::Texture::create();
+        tex->format = format;
+        tex->width = width;
+        tex->height = height;
+        tex->data.resize(ms::GetTextureDataSize(format, width, height));
+        for (int y = 0; y < height; ++y) {
+            for (int x = 0; x < width; ++x) {
+                float4 c{ float(x) / width, float(y) / height, (x / 8 + y / 8) % 2 ? 1.0f : 0.0f, 1.0f };
+                if (format == ms::TextureFormat::RGBAu8)
+                    ((unorm8x4*)tex->data.data())[y * width + x] = unorm8x4{ c.x, c.y, c.z, c.w };
+                else
+                    ((half4*)tex->data.data())[y * width + x] = half4{ c.x, c.y, c.z, c.w };
+            }
+        }
+        return tex;
+    };
+
+    const ms::TextureFormat formats[] = { ms::TextureFormat::RGBAu8, ms::TextureFormat::RGBAf16 };
+    const char *format_names[] = { "RGBAu8", "RGBAf16" };
+    const MipFilter filters[] = { MipFilter::Box, MipFilter::Kaiser };
+    const char *filter_names[] = { "Box", "Kaiser" };
+    for (int fi = 0; fi < 2; ++fi) {
+        for (int ki = 0; ki < 2; ++ki) {
+            auto tex = make_texture(formats[fi]);
+            auto base = tex->data;
+            auto begin = Now();
+            tex->generateMipmaps(filters[ki]);
+            auto elapsed = Now() - begin;
+
+            // the base level must be intact and 8x8 checker cells must average to gray at level 4 (16x16 pixels per texel)
+            bool ok = tex->has_mipmaps && tex->getMipCount() == 12 &&
+                tex->data.size() == ms::GetTextureDataSize(formats[fi], width, height, true) &&
+                memcmp(tex->data.cdata(), base.cdata(), base.size()) == 0;
+            size_t offset = 0;
+            for (int level = 0; level < 4; ++level) {
+                int w, h;
+                GetMipSize(width, height, level, w, h);
+                offset += ms::GetTextureDataSize(formats[fi], w, h);
+            }
+            float checker = formats[fi] == ms::TextureFormat::RGBAu8 ?
+                float(((const unorm8x4*)&tex->data[offset])[64].z) : float(((const half4*)&tex->data[offset])[64].z);
+            ok = ok && std::abs(checker - 0.5f) < 0.02f;
+
+            Print("    %s %-6s: %.2fMB -> %.2fMB, %.2fms: %s\n",
+                format_names[fi], filter_names[ki], (double)base.size() / (1024.0 * 1024.0), (double)tex->data.size() / (1024.0 * 1024.0),
+                NS2MS(elapsed), ok ? "ok" : "*** validation failed ***");
+        }
+    }
+
+    // compressed mip chains. small levels are padded to 4x4 blocks.
+    auto tex = make_texture(ms::TextureFormat::RGBAu8);
+    tex->generateMipmaps();
+    auto compressed = ms::Texture::create();
+    tex->compress(*compressed, ms::TextureFormat::BC1, BCQuality::Fast);
+    Print("    BC1 with mipmaps: %.2fMB (%s)\n", (double)compressed->data.size() / (1024.0 * 1024.0),
+        compressed->has_mipmaps && compressed->data.size() == ms::GetTextureDataSize(ms::TextureFormat::BC1, width, height, true) ? "ok" : "*** validation failed ***");
+}
+
+TestCase(Test_TextureLoader)
+{
+    // many small files are read by worker threads and large ones are memory mapped
+    const int num_small = 32;
+    const size_t small_size = 256 * 1024, large_size = 32 * 1024 * 1024;
+
+    std::vector<std::string> paths;
+    std::vector<size_t> sizes;
+    for (int i = 0; i < num_small + 1; ++i) {
+        size_t size = i < num_small ? small_size : large_size;
+        RawVector<char> data;
+        data.resize_discard(size);
+        for (size_t j = 0; j < size; ++j)
+            data[j] = char(j * 31 + i);
+        auto path = "TextureLoaderTest" + std::to_string(i) + ".bin";
+        ms::ByteArrayToFile(path.c_str(), data);
+        paths.push_back(path);
+        sizes.push_back(size);
+    }
+
+    std::vector<ms::TexturePtr> textures;
+    auto begin = Now();
+    int num_failed;
+    {
+        ms::TextureLoader loader;
+        for (auto& path : paths) {
+            auto tex = ms::Texture::create();
+            tex->name = path;
+            tex->format = ms::TextureFormat::RawFile;
+            loader.load(tex, path);
+            textures.push_back(tex);
+        }
+        num_failed = loader.wait();
+    }
+    auto elapsed = Now() - begin;
+
+    // mapped contents are serialized as if they were data
+    bool ok = num_failed == 0 && textures.back()->mapped_file && textures.back()->data.empty();
+    for (size_t i = 0; ok && i < textures.size(); ++i) {
+        std::stringstream ss;
+        textures[i]->serialize(ss);
+        auto tex = ms::Texture::create(ss);
+        RawVector<char> expected;
+        ms::FileToByteArray(paths[i].c_str(), expected);
+        ok = tex->data.size() == sizes[i] && tex->data == expected;
+    }
+    textures.clear();
+    for (auto& path : paths)
+        std::remove(path.c_str());
+
+    Print("    %d files (%.2fMB) loaded in %.2fms: %s\n",
+        (int)paths.size(), (double)(small_size * num_small + large_size) / (1024.0 * 1024.0),
+        NS2MS(elapsed), ok ? "ok" : "*** validation failed ***");
+}
+
+TestCase(Test_MaterialDiff)
+{
+    // send the same materials repeatedly through MaterialCache as Client does (no network involved)
+    ms::ServerSettings settings;
+    ms::Server server(settings);
+    ms::MaterialCache cache, other_cache;
+
+    std::vector<ms::MaterialPtr> sent;
+    auto send = [&](std::vector<ms::MaterialPtr> materials, std::vector<ms::TexturePtr> textures, ms::MaterialCache *c = nullptr) {
+        (c ? c : &cache)->filter(materials, textures, true, server.getCapabilities().server_epoch);
+        sent = materials;
+        ms::SetMessage set;
+        set.scene.materials = materials;
+        set.scene.textures = textures;
+        std::stringstream ss;
+        set.serialize(ss);
+        auto size = ss.str().size();
+        auto recv = std::make_shared<ms::SetMessage>();
+        recv->deserialize(ss);
+        server.recvSet(recv);
+        return size;
+    };
+    std::vector<ms::MaterialPtr> received;
+    size_t num_textures = 0;
+    auto process = [&]() {
+        received.clear();
+        num_textures = 0;
+        server.processMessages([&](ms::Message::Type type, ms::Message& data) {
+            if (type == ms::Message::Type::Set) {
+                received = static_cast<ms::SetMessage&>(data).scene.materials;
+                num_textures = static_cast<ms::SetMessage&>(data).scene.textures.size();
+            }
+        });
+    };
+
+    auto tex = ms::Texture::create();
+    tex->id = 0;
+    tex->name = "checker";
+    tex->format = ms::TextureFormat::RGBAu8;
+    tex->width = tex->height = 256;
+    CreateCheckerImage(tex->data, unorm8x4{ 0.0f, 0.0f, 0.0f, 1.0f }, unorm8x4{ 1.0f, 1.0f, 1.0f, 1.0f }, 256, 256);
+
+    const int num_materials = 32;
+    std::vector<ms::MaterialPtr> materials;
+    for (int i = 0; i < num_materials; ++i) {
+        auto mat = ms::Material::create();
+        mat->id = i;
+        mat->name = "material" + std::to_string(i);
+        mat->setColor({ 1.0f / (i + 1), 1.0f, 1.0f, 1.0f });
+        mat->setColorMap(i == 0 ? 0 : -1);
+        materials.push_back(mat);
+    }
+    auto validate = [&]() {
+        if (received.size() != materials.size())
+            return false;
+        for (size_t i = 0; i < materials.size(); ++i) {
+            if (received[i]->isReference() || *received[i] != *materials[i])
+                return false;
+        }
+        return true;
+    };
+
+    // first: everything is sent
+    auto size1 = send(materials, { tex });
+    process();
+    bool ok1 = validate() && num_textures == 1;
+
+    // nothing changed: neither materials nor textures are sent
+    auto size2 = send(materials, { tex });
+    process();
+    bool ok2 = received.empty() && num_textures == 0;
+
+    // one material changed: others are sent as references and restored by the server
+    materials[5]->setMetallic(1.0f);
+    auto size3 = send(materials, { tex });
+    process();
+    bool ok3 = validate() && num_textures == 0;
+
+    // the texture changed: it is sent again and the material that uses it is regarded as changed
+    tex->data[0] = tex->data[0] + 1;
+    send(materials, { tex });
+    process();
+    bool ok4 = validate() && num_textures == 1 && sent.size() == materials.size() &&
+        !sent[0]->isReference() && sent[1]->isReference() && sent[5]->isReference();
+
+    // another client uses the same ids for its own materials. references of each client resolve to its own ones.
+    std::vector<ms::MaterialPtr> other_materials;
+    for (int i = 0; i < 4; ++i) {
+        auto mat = ms::Material::create();
+        mat->id = i;
+        mat->name = "other" + std::to_string(i);
+        other_materials.push_back(mat);
+    }
+    send(other_materials, {}, &other_cache);
+    process();
+    other_materials[1]->setSmoothness(1.0f);
+    send(other_materials, {}, &other_cache);
+    process();
+    bool ok6 = received.size() == other_materials.size() && received[0]->name == "other0" && *received[1] == *other_materials[1];
+    materials[6]->setMetallic(1.0f);
+    send(materials, {});
+    process();
+    ok6 = ok6 && validate();
+
+    // the server lost the materials. its epoch changes, so they are sent in full instead of as references.
+    server.clear();
+    materials[7]->setMetallic(1.0f);
+    send(materials, {});
+    process();
+    bool ok7 = validate();
+    for (auto& mat : sent)
+        ok7 = ok7 && !mat->isReference();
+
+    // forgetting the state makes everything sent again
+    cache.clear();
+    auto size5 = send(materials, { tex });
+    process();
+    bool ok5 = validate() && num_textures == 1 && size5 == size1;
+
+    Print("    sent %d bytes, unchanged %d bytes, one changed %d bytes: %s\n", (int)size1, (int)size2, (int)size3,
+        ok1 && ok2 && ok3 && ok4 && ok5 && ok6 && ok7 && size2 < size3 && size3 < size1 ? "OK" : "*** validation failed ***");
+}
+
+TestCase(Test_Pool)
+{
+    // create and release objects from many threads at once as deserialization of recvSet does
+    auto& pool = ms::Pool<ms::BoneData>::instance();
+    pool.trim();
+    auto before = pool.getStats();
+
+    const int num_threads = 8, num_iterations = 2000, num_objects = 64;
+    auto begin = mu::Now();
+    std::vector<std::thread> threads;
+    for (int ti = 0; ti < num_threads; ++ti) {
+        threads.emplace_back([&]() {
+            std::vector<std::shared_ptr<ms::BoneData>> objs;
+            for (int i = 0; i < num_iterations; ++i) {
+                for (int j = 0; j < num_objects; ++j)
+                    objs.push_back(ms::BoneData::create());
+                objs.clear();
+            }
+        });
+    }
+    for (auto& t : threads)
+        t.join();
+    auto elapsed = mu::NS2MS(mu::Now() - begin);
+
+    // objects cached by the exited threads are back in the depot
+    auto stats = pool.getStats();
+    uint64_t pulls = (stats.hits + stats.misses) - (before.hits + before.misses);
+    bool ok1 = stats.in_use == before.in_use && pulls == (uint64_t)num_threads * num_iterations * num_objects;
+
+    pool.trim();
+    auto trimmed = pool.getStats();
+    bool ok2 = trimmed.capacity == trimmed.in_use;
+
+    bool registered = false;
+    for (auto *p : ms::GetPools())
+        registered = registered || strcmp(p->getName(), "BoneData") == 0;
+
+    Print("    %d pulls in %.2fms. hit rate %.2f%%, capacity %d -> %d after trim: %s\n",
+        (int)pulls, elapsed, 100.0 * (double)(stats.hits - before.hits) / (double)pulls,
+        (int)stats.capacity, (int)trimmed.capacity, ok1 && ok2 && registered ? "OK" : "*** validation failed ***");
+}
+
+TestCase(Test_RefineWorkspace)
+{
+    // meshes refined one after another on the same thread share the scratch buffers.
+    // results must not depend on what was refined before.
+    auto make_mesh = [](int resolution, float angle) {
+        auto mesh = ms::Mesh::create();
+        GenerateWaveMesh(mesh->counts, mesh->indices, mesh->points, mesh->uv0, 2.0f, 1.0f, resolution, angle);
+        mesh->material_ids.resize(mesh->counts.size(), 0);
+        mesh->refine_settings.flags.gen_normals_with_smooth_angle = 1;
+        mesh->refine_settings.smooth_angle = 40.0f;
+        mesh->refine_settings.flags.gen_tangents = 1;
+        mesh->refine_settings.flags.triangulate = 1;
+        mesh->refine_settings.flags.split = 1;
+        mesh->refine_settings.split_unit = 65000;
+        return mesh;
+    };
+
+    auto a1 = make_mesh(64, 0.0f);
+    a1->refine(a1->refine_settings);
+    auto b = make_mesh(256, 1.0f);
+    b->refine(b->refine_settings);
+    auto a2 = make_mesh(64, 0.0f);
+    a2->refine(a2->refine_settings);
+    bool ok = a1->points == a2->points && a1->indices == a2->indices && a1->normals == a2->normals &&
+        a1->tangents == a2->tangents && a1->uv0 == a2->uv0 && a1->splits.size() == a2->splits.size();
+
+    // many small meshes, as scenes with thousands of objects
+    const int num_meshes = 2000;
+    std::vector<ms::MeshPtr> meshes;
+    for (int i = 0; i < num_meshes; ++i)
+        meshes.push_back(make_mesh(8, 0.1f * i));
+    TestScope("refine 2000 meshes", [&]() {
+        for (auto& mesh : meshes)
+            mesh->refine(mesh->refine_settings);
+    });
+    Print("    sizeof(Mesh) %d: %s\n", (int)sizeof(ms::Mesh), ok ? "OK" : "*** validation failed ***");
+}
+
+TestCase(Test_ServeMesh)
+{
+    // serve the same meshes repeatedly as the Unity side does on every GET (no network involved).
+    // meshes kept by the host and not touched since the last request must share its refined results.
+    ms::ServerSettings settings;
+    ms::Server server(settings);
+
+    const int num_meshes = 16;
+    std::vector<ms::MeshPtr> meshes;
+    for (int i = 0; i < num_meshes; ++i) {
+        auto mesh = ms::Mesh::create();
+        char path[64];
+        sprintf(path, "/Mesh%d", i);
+        mesh->path = path;
+        mesh->flags.has_points = mesh->flags.has_uv0 = mesh->flags.has_counts = mesh->flags.has_indices = 1;
+        GenerateWaveMesh(mesh->counts, mesh->indices, mesh->points, mesh->uv0, 2.0f, 1.0f, 128, 0.0f);
+        meshes.push_back(mesh);
+    }
+
+    auto serve = [&](int count) {
+        auto get = std::make_shared<ms::GetMessage>();
+        get->wait_flag.reset(new std::atomic_int(1));
+        server.queueMessage(get);
+
+        std::vector<ms::TransformPtr> ret;
+        server.processMessages([&](ms::Message::Type type, ms::Message& data) {
+            if (type != ms::Message::Type::Get)
+                return;
+            server.beginServe();
+            for (int i = 0; i < count; ++i)
+                server.getHostScene()->objects.push_back(meshes[i]);
+            server.endServe();
+            ret = server.getHostScene()->objects;
+        });
+        return ret;
+    };
+
+    std::vector<ms::TransformPtr> r1, r2, r3;
+    TestScope("serve (initial)", [&]() { r1 = serve(num_meshes); });
+    TestScope("serve (unchanged)", [&]() { r2 = serve(num_meshes); });
+    auto& changed = *meshes[0];
+    GenerateWaveMesh(changed.counts, changed.indices, changed.points, changed.uv0, 2.0f, 1.0f, 128, 1.0f);
+    changed.touch();
+    TestScope("serve (one changed)", [&]() { r3 = serve(num_meshes); });
+
+    bool ok = r1.size() == num_meshes && r2.size() == num_meshes && r3.size() == num_meshes;
+    for (int i = 0; ok && i < num_meshes; ++i) {
+        ok = r1[i] != meshes[i] && r2[i] == r1[i] && (i == 0 ? r3[i] != r1[i] : r3[i] == r1[i]);
+    }
+    if (ok) {
+        // the host's meshes are left as it wrote them
+        auto& a = static_cast<ms::Mesh&>(*r1[0]);
+        auto& b = static_cast<ms::Mesh&>(*r3[0]);
+        ok = a.points != b.points && !a.splits.empty() && meshes[0]->splits.empty();
+    }
+
+    // meshes created for a request and not kept by anyone are refined in place
+    if (ok) {
+        auto get = std::make_shared<ms::GetMessage>();
+        get->wait_flag.reset(new std::atomic_int(1));
+        server.queueMessage(get);
+        ms::Mesh *raw = nullptr;
+        server.processMessages([&](ms::Message::Type type, ms::Message& data) {
+            if (type != ms::Message::Type::Get)
+                return;
+            server.beginServe();
+            auto mesh = ms::Mesh::create();
+            mesh->path = "/Temporary";
+            mesh->flags.has_points = mesh->flags.has_counts = mesh->flags.has_indices = 1;
+            GenerateWaveMesh(mesh->counts, mesh->indices, mesh->points, mesh->uv0, 2.0f, 1.0f, 16, 0.0f);
+            raw = mesh.get();
+            server.getHostScene()->objects.push_back(mesh);
+            mesh.reset();
+            server.endServe();
+            ok = server.getHostScene()->objects[0].get() == raw && !raw->splits.empty();
+        });
+    }
+
+    // meshes that are no longer served are released
+    if (ok) {
+        std::weak_ptr<ms::Transform> removed = r3.back();
+        serve(num_meshes / 2);
+        r1.clear(); r2.clear(); r3.clear();
+        ok = removed.expired();
+    }
+    Print("    %d meshes: %s\n", num_meshes, ok ? "shared" : "*** validation failed ***");
+}
+
+TestCase(Test_HistorySpill)
+{
+    // queue scenes while the handler is not called (play mode, domain reload, etc.).
+    // the same scenes go to a server with the default budget for comparison.
+    ms::ServerSettings settings;
+    ms::Server server_ref(settings);
+    settings.max_history_size = 4 * 1024 * 1024;
+    ms::Server server(settings);
+
+    const int num_messages = 32;
+    auto make_set = [](int i) {
+        auto mesh = ms::Mesh::create();
+        char path[64];
+        sprintf(path, "/Wave%d", i);
+        mesh->path = path;
+        mesh->flags.has_points = mesh->flags.has_uv0 = mesh->flags.has_counts = mesh->flags.has_indices = 1;
+        GenerateWaveMesh(mesh->counts, mesh->indices, mesh->points, mesh->uv0, 2.0f, 1.0f, 128, 0.1f * i);
+        auto set = std::make_shared<ms::SetMessage>();
+        set->scene.settings.scale_factor = 100.0f;
+        set->scene.objects.push_back(mesh);
+        return set;
+    };
+    // spilled messages dropped by clear() must not be read back, even though the next ones go to a new spill file
+    for (int i = 0; i < num_messages / 2; ++i)
+        server.recvSet(make_set(num_messages + i));
+    server.clear();
+    int num_dropped = server.getNumSpilledMessages();
+    for (int i = 0; i < num_messages; ++i) {
+        server_ref.recvSet(make_set(i));
+        server.recvSet(make_set(i));
+    }
+
+    auto collect = [](ms::Server& s) {
+        std::vector<ms::MeshPtr> ret;
+        s.processMessages([&](ms::Message::Type type, ms::Message& data) {
+            if (type == ms::Message::Type::Set) {
+                for (auto& obj : static_cast<ms::SetMessage&>(data).scene.objects)
+                    ret.push_back(std::static_pointer_cast<ms::Mesh>(obj));
+            }
+        });
+        return ret;
+    };
+    auto expected = collect(server_ref);
+    std::vector<ms::MeshPtr> received;
+    TestScope("process", [&]() { received = collect(server); });
+
+    int num_spilled = server.getNumSpilledMessages() - num_dropped;
+    bool ok = num_dropped > 0 && num_spilled > 0 && received.size() == expected.size();
+    for (size_t i = 0; ok && i < received.size(); ++i) {
+        auto& a = *received[i];
+        auto& b = *expected[i];
+        ok = a.path == b.path && a.points == b.points && a.indices == b.indices && a.splits.size() == b.splits.size();
+    }
+    Print("    %d of %d messages spilled: %s\n", num_spilled, num_messages, ok ? "OK" : "*** validation failed ***");
+}
+
+TestCase(Test_CompactIndices)
+{
+    auto mesh = ms::Mesh::create();
+    GenerateWaveMesh(mesh->counts, mesh->indices, mesh->points, mesh->uv0, 2.0f, 1.0f, 128, 0.0f);
+    mesh->setupFlags();
+
+    auto send = [&](bool compact, ms::MeshPtr& dst) {
+        // the format is decided on write by the receiver's features as Client does. the mesh is not modified.
+        ms::FeatureFlags features = {0};
+        features.compact_indices = compact;
+        ms::WireFormatScope scope(features);
+        std::stringstream ss;
+        mesh->serialize(ss);
+        auto size = ss.str().size();
+        bool ok = size == mesh->getSerializeSize();
+        dst = std::static_pointer_cast<ms::Mesh>(ms::Entity::create(ss));
+        return ok ? size : 0;
+    };
+    ms::MeshPtr m32, m16;
+    auto size32 = send(false, m32);
+    auto size16 = send(true, m16);
+    bool ok = size32 != 0 && size16 != 0 && size16 < size32 && m32->indices == mesh->indices && m16->indices == mesh->indices && !m16->flags.compact_indices &&
+        !mesh->flags.compact_indices;
+
+    // a mesh larger than split_unit is split into ones that can be indexed by 16 bit
+    auto large = ms::Mesh::create();
+    GenerateWaveMesh(large->counts, large->indices, large->points, large->uv0, 2.0f, 1.0f, 512, 0.0f);
+    ok = ok && !large->canCompactIndices();
+    large->refine_settings.flags.triangulate = 1;
+    large->refine_settings.flags.split = 1;
+    large->refine_settings.split_unit = 65000;
+    large->refine(large->refine_settings);
+    ok = ok && large->splits.size() > 1;
+    for (auto& split : large->splits)
+        ok = ok && split.index_format == ms::SplitData::IndexFormat::U16;
+
+    Print("    %d -> %d bytes, %d splits: %s\n", (int)size32, (int)size16, (int)large->splits.size(), ok ? "OK" : "*** validation failed ***");
+}
+
+TestCase(Test_InterleavedVertices)
+{
+    // request all components. the mesh has no colors, so they are dropped from the format.
+    auto mesh = ms::Mesh::create();
+    GenerateWaveMesh(mesh->counts, mesh->indices, mesh->points, mesh->uv0, 2.0f, 1.0f, 512, 0.0f);
+    mesh->refine_settings.flags.triangulate = 1;
+    mesh->refine_settings.flags.split = 1;
+    mesh->refine_settings.flags.gen_normals = 1;
+    mesh->refine_settings.flags.gen_tangents = 1;
+    mesh->refine_settings.split_unit = 65000;
+    mesh->vertex_format = mu::VertexFormat::V3N3C4U2T4;
+    TestScope("refine", [&]() { mesh->refine(mesh->refine_settings); });
+
+    bool ok = mesh->vertex_format == mu::VertexFormat::V3N3U2T4 &&
+        mesh->vertices.size() == mesh->points.size() * sizeof(mu::vertex_v3n3u2t4);
+    for (auto& split : mesh->splits) {
+        auto *v = (const mu::vertex_v3n3u2t4*)mesh->vertices.data() + split.vertex_offset;
+        for (int i = 0; ok && i < split.vertex_count; ++i) {
+            int vi = split.vertex_offset + i;
+            ok = v[i].p == mesh->points[vi] && v[i].n == mesh->normals[vi] && v[i].u == mesh->uv0[vi] && v[i].t == mesh->tangents[vi];
+        }
+    }
+    Print("    %d splits, %d vertices: %s\n", (int)mesh->splits.size(), (int)mesh->points.size(), ok ? "OK" : "*** validation failed ***");
+}
+
+TestCase(Test_PathReferences)
+{
+    // skinned meshes share the bone paths, and the animations target the same bones
+    const char *bone_paths[] = { "/Character/Armature/Hips", "/Character/Armature/Hips/Spine", "/Character/Armature/Hips/Spine/Head" };
+    ms::SetMessage mes;
+    auto clip = ms::AnimationClip::create();
+    mes.scene.animations.push_back(clip);
+    for (auto *bone_path : bone_paths) {
+        auto anim = ms::TransformAnimation::create();
+        anim->path = bone_path;
+        anim->translation.push_back({ 0.0f, {0.0f, 0.0f, 0.0f} });
+        clip->animations.push_back(anim);
+    }
+    for (int i = 0; i < 8; ++i) {
+        auto mesh = ms::Mesh::create();
+        mesh->path = "/Character/Mesh" + std::to_string(i);
+        mesh->root_bone = bone_paths[0];
+        for (auto *bone_path : bone_paths)
+            mesh->addBone(bone_path);
+        mesh->setupFlags();
+        mes.scene.objects.push_back(mesh);
+    }
+
+    auto get_paths = [](const ms::Scene& scene) {
+        std::vector<std::string> ret;
+        for (auto& obj : scene.objects) {
+            auto& mesh = static_cast<ms::Mesh&>(*obj);
+            ret.push_back(mesh.path);
+            ret.push_back(mesh.root_bone);
+            for (auto& bone : mesh.bones)
+                ret.push_back(bone->path);
+        }
+        for (auto& anim : scene.animations[0]->animations)
+            ret.push_back(anim->path);
+        return ret;
+    };
+    auto send = [&](bool references) {
+        ms::FeatureFlags features = {0};
+        features.path_references = references;
+        ms::WireFormatScope scope(features);
+        std::stringstream ss;
+        mes.serialize(ss);
+        auto size = ss.str().size();
+        ms::SetMessage dst;
+        bool ok = size == mes.getSerializeSize() && dst.deserialize(ss) && get_paths(dst.scene) == get_paths(mes.scene);
+        return ok ? size : 0;
+    };
+    auto size_plain = send(false);
+    auto size_ref = send(true);
+    bool ok = size_plain != 0 && size_ref != 0 && size_ref < size_plain;
+    Print("    %d -> %d bytes: %s\n", (int)size_plain, (int)size_ref, ok ? "OK" : "*** validation failed ***");
+}
+
+TestCase(Test_Profiler)
+{
+    ms::Profiler profiler;
+    {
+        ms::Profiler::Scope scope(&profiler);
+        std::vector<int> work(64);
+        parallel_for_each(work.begin(), work.end(), [&profiler](int&) {
+            ms::Profiler::Scope scope(&profiler);
+            ms::ProfileTimer timer(ms::ProfileStage::Refine, 1000);
+            std::this_thread::sleep_for(std::chrono::microseconds(100));
+        });
+    }
+    auto stats = profiler.getStats();
+    auto& refine = stats.entries[(int)ms::ProfileStage::Refine];
+    uint64_t hist_total = 0;
+    for (auto h : refine.histogram)
+        hist_total += h;
+    Print("    count %d, bytes %d, avg %.3fms, histogram total %d\n",
+        (int)refine.count, (int)refine.bytes, NS2MS(refine.total_ns / std::max<uint64_t>(refine.count, 1)), (int)hist_total);
+
+    profiler.reset();
+    stats = profiler.getStats();
+    Print("    after reset: count %d\n", (int)stats.entries[(int)ms::ProfileStage::Refine].count);
+}
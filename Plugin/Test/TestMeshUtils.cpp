@@ -104,6 +104,104 @@ TestCase(TestMeshRefiner)
 }
 
 
+TestCase(TestArenaAllocator)
+{
+    // many small vectors growing by push_back, as intermediate data of refine
+    const int num_vectors = 64, num_elements = 10000, num_try = 20;
+    TestScope("push_back (AlignedAllocator)", [&]() {
+        for (int vi = 0; vi < num_vectors; ++vi) {
+            RawVector<int> v;
+            for (int i = 0; i < num_elements; ++i)
+                v.push_back(i);
+        }
+    }, num_try);
+
+    Arena arena;
+    TestScope("push_back (Arena)", [&]() {
+        for (int vi = 0; vi < num_vectors; ++vi) {
+            RawVector<int, 0x20, ArenaAllocator> v{ ArenaAllocator(&arena) };
+            for (int i = 0; i < num_elements; ++i)
+                v.push_back(i);
+        }
+        arena.reset();
+    }, num_try);
+    Print("    arena reserved %uKB\n", (uint32_t)(arena.getReservedSize() / 1024));
+
+    // refine a large mesh. intermediate data of MeshRefiner are allocated from its arena.
+    RawVector<int> counts, indices;
+    RawVector<float3> points;
+    RawVector<float2> uv;
+    GenerateWaveMesh(counts, indices, points, uv, 10.0f, 1.0f, 512, 0.0f);
+    RawVector<float2> uv_flattened(indices.size()), uv_refined;
+    for (size_t i = 0; i < indices.size(); ++i)
+        uv_flattened[i] = uv[indices[i]];
+    RawVector<int> remap_uv;
+
+    size_t used = 0;
+    TestScope("MeshRefiner::refine()", [&]() {
+        mu::MeshRefiner refiner;
+        refiner.split_unit = 65000;
+        refiner.counts = counts;
+        refiner.indices = indices;
+        refiner.points = points;
+        refiner.addExpandedAttribute<float2>(uv_flattened, uv_refined, remap_uv);
+        refiner.refine();
+        refiner.retopology(false);
+        refiner.genSubmeshes();
+        used = refiner.arena.getReservedSize();
+    }, 5);
+    Print("    %d faces. arena reserved %uKB\n", (int)counts.size(), (uint32_t)(used / 1024));
+}
+
+TestCase(TestHugePages)
+{
+    // gather and refine over huge buffers, with and without huge pages.
+    // buffers are allocated inside each scope so that the current setting applies.
+    const size_t num_points = 16 * 1024 * 1024;
+    RawVector<int> shuffle(num_points);
+    {
+        uint32_t r = 12345;
+        for (size_t i = 0; i < num_points; ++i) {
+            r = r * 1103515245 + 12345;
+            shuffle[i] = (int)((r >> 4) % num_points);
+        }
+    }
+
+    RawVector<int> counts, indices;
+    RawVector<float3> points;
+    RawVector<float2> uv;
+    GenerateWaveMesh(counts, indices, points, uv, 10.0f, 1.0f, 1024, 0.0f);
+
+    auto default_threshold = GetHugePageThreshold();
+    for (int hp = 0; hp < 2; ++hp) {
+        SetHugePageThreshold(hp ? default_threshold : 0);
+        Print("    huge pages %s\n", hp ? "enabled" : "disabled");
+
+        TestScope("gather", [&]() {
+            RawVector<float4> src(num_points), dst(num_points);
+            src.zeroclear();
+            CopyWithIndices(dst.data(), src.data(), shuffle);
+        });
+
+        TestScope("refine", [&]() {
+            RawVector<float2> uv_flattened(indices.size()), uv_refined;
+            RawVector<int> remap_uv;
+            for (size_t i = 0; i < indices.size(); ++i)
+                uv_flattened[i] = uv[indices[i]];
+            mu::MeshRefiner refiner;
+            refiner.split_unit = 65000;
+            refiner.counts = counts;
+            refiner.indices = indices;
+            refiner.points = points;
+            refiner.addExpandedAttribute<float2>(uv_flattened, uv_refined, remap_uv);
+            refiner.refine();
+            refiner.retopology(false);
+            refiner.genSubmeshes();
+        });
+    }
+    SetHugePageThreshold(default_threshold);
+}
+
 TestCase(TestNormalsAndTangents)
 {
     RawVector<int> indices, counts;
@@ -368,6 +466,153 @@ TestCase(TestMulPoints)
 }
 
 
+TestCase(TestPixelConversion)
+{
+    // same layout as Texture_RGBA_u8.png and Texture_RGBA_f16.exr, scaled up so that blocks are processed in parallel
+    const int width = 320 * 4, height = 240 * 4;
+    const int num_pixels = width * height;
+    const int num_try = 8;
+
+    RawVector<unorm8x4> rgba_u8, tmp_u8[2];
+    RawVector<half4> rgba_f16;
+    rgba_u8.resize(num_pixels);
+    rgba_f16.resize(num_pixels);
+    for (int y = 0; y < height; ++y) {
+        for (int x = 0; x < width; ++x) {
+            float u = float(x) / width, v = float(y) / height;
+            unorm8x4 c{ u, v, 1.0f - u, (x / 16 + y / 16) % 2 ? 1.0f : 0.5f };
+            rgba_u8[y * width + x] = c;
+            rgba_f16[y * width + x] = half4{ u * 4.0f, v, 1.0f - u, 1.0f };
+        }
+    }
+    tmp_u8[0].resize(num_pixels);
+    tmp_u8[1].resize(num_pixels);
+
+    auto check = [](bool ok) {
+        if (!ok)
+            Print("    *** validation failed ***\n");
+    };
+
+    Print(
+        "    pixels: %dx%d\n"
+        "    num_try: %d\n",
+        width, height, num_try);
+
+    // swizzle
+    TestScope("Swizzle C++", [&]() {
+        Swizzle_Generic(tmp_u8[0].data(), rgba_u8.data(), num_pixels, 2, 1, 0, 3);
+    }, num_try);
+#ifdef muSIMD_Swizzle
+    TestScope("Swizzle ISPC", [&]() {
+        Swizzle_ISPC(tmp_u8[1].data(), rgba_u8.data(), num_pixels, 2, 1, 0, 3);
+    }, num_try);
+    check(tmp_u8[0] == tmp_u8[1]);
+#endif
+    BGRA2RGBA(tmp_u8[1].data(), tmp_u8[0].data(), num_pixels);
+    check(tmp_u8[1] == rgba_u8);
+
+    // u8 <-> f32, u8 <-> f16: 8 bit values must survive round trips
+    RawVector<float4> f32[2];
+    f32[0].resize(num_pixels);
+    f32[1].resize(num_pixels);
+    TestScope("U8ToF32 C++", [&]() {
+        U8ToF32_Generic((float*)f32[0].data(), (unorm8*)rgba_u8.data(), num_pixels * 4);
+    }, num_try);
+#ifdef muSIMD_PixelConversion
+    TestScope("U8ToF32 ISPC", [&]() {
+        U8ToF32_ISPC((float*)f32[1].data(), (unorm8*)rgba_u8.data(), num_pixels * 4);
+    }, num_try);
+    check(NearEqual(f32[0].data(), f32[1].data(), num_pixels));
+#endif
+    TestScope("F32ToU8 C++", [&]() {
+        F32ToU8_Generic((unorm8*)tmp_u8[0].data(), (float*)f32[0].data(), num_pixels * 4);
+    }, num_try);
+#ifdef muSIMD_PixelConversion
+    TestScope("F32ToU8 ISPC", [&]() {
+        F32ToU8_ISPC((unorm8*)tmp_u8[1].data(), (float*)f32[0].data(), num_pixels * 4);
+    }, num_try);
+    check(tmp_u8[1] == rgba_u8);
+#endif
+    check(tmp_u8[0] == rgba_u8);
+
+    RawVector<half4> f16;
+    f16.resize(num_pixels);
+    TestScope("ConvertPixels U8 -> F16", [&]() {
+        ConvertPixels(f16.data(), PixelType::F16, rgba_u8.data(), PixelType::U8, num_pixels * 4);
+    }, num_try);
+    TestScope("ConvertPixels F16 -> U8", [&]() {
+        ConvertPixels(tmp_u8[0].data(), PixelType::U8, f16.data(), PixelType::F16, num_pixels * 4);
+    }, num_try);
+    check(tmp_u8[0] == rgba_u8);
+
+    // f16 -> i16 -> f32. values out of range are clamped.
+    RawVector<snorm16> i16;
+    i16.resize(num_pixels * 4);
+    ConvertPixels(i16.data(), PixelType::I16, rgba_f16.data(), PixelType::F16, num_pixels * 4);
+    ConvertPixels(f32[0].data(), PixelType::F32, i16.data(), PixelType::I16, num_pixels * 4);
+    ConvertPixels(f32[1].data(), PixelType::F32, rgba_f16.data(), PixelType::F16, num_pixels * 4);
+    for (auto& c : f32[1]) {
+        for (int i = 0; i < 4; ++i)
+            c[i] = clamp01(c[i]);
+    }
+    check(NearEqual(f32[0].data(), f32[1].data(), num_pixels, 1e-3f));
+
+    // sRGB <-> linear
+    ConvertPixels(f32[0].data(), PixelType::F32, rgba_f16.data(), PixelType::F16, num_pixels * 4);
+    f32[1] = f32[0];
+    TestScope("LinearToSRGB C++", [&]() {
+        f32[0] = f32[1];
+        LinearToSRGB_Generic(f32[0].data(), num_pixels);
+    }, num_try);
+#ifdef muSIMD_ColorSpace
+    RawVector<float4> srgb;
+    TestScope("LinearToSRGB ISPC", [&]() {
+        srgb = f32[1];
+        LinearToSRGB_ISPC(srgb.data(), num_pixels);
+    }, num_try);
+    check(NearEqual(f32[0].data(), srgb.data(), num_pixels, 1e-4f));
+#endif
+    SRGBToLinear(f32[0].data(), num_pixels);
+    check(NearEqual(f32[0].data(), f32[1].data(), num_pixels, 1e-3f));
+
+    tmp_u8[0] = rgba_u8;
+    SRGBToLinear(tmp_u8[0].data(), num_pixels);
+    LinearToSRGB(tmp_u8[0].data(), num_pixels);
+    bool near = true;
+    for (int i = 0; i < num_pixels; ++i) {
+        // dark values lose precision in linear 8 bit
+        if (rgba_u8[i].x.value > 64 && std::abs(tmp_u8[0][i].x.value - rgba_u8[i].x.value) > 1)
+            near = false;
+    }
+    check(near);
+
+    // premultiply
+    ConvertPixels(f32[0].data(), PixelType::F32, rgba_u8.data(), PixelType::U8, num_pixels * 4);
+    f32[1] = f32[0];
+    TestScope("Premultiply C++", [&]() {
+        Premultiply_Generic(f32[0].data(), num_pixels);
+    });
+#ifdef muSIMD_Premultiply4
+    TestScope("Premultiply ISPC", [&]() {
+        Premultiply_ISPC(f32[1].data(), num_pixels);
+    });
+    check(NearEqual(f32[0].data(), f32[1].data(), num_pixels));
+#endif
+    tmp_u8[0] = rgba_u8;
+    Premultiply(tmp_u8[0].data(), num_pixels);
+    ConvertPixels(tmp_u8[1].data(), PixelType::U8, f32[0].data(), PixelType::F32, num_pixels * 4);
+    check(tmp_u8[0] == tmp_u8[1]);
+
+    // vertical flip, in place and out of place
+    tmp_u8[0] = rgba_u8;
+    TestScope("FlipY", [&]() {
+        FlipY(tmp_u8[1].data(), tmp_u8[0].data(), width * sizeof(unorm8x4), height);
+    }, num_try);
+    FlipY(tmp_u8[1].data(), tmp_u8[1].data(), width * sizeof(unorm8x4), height);
+    check(tmp_u8[1] == rgba_u8);
+}
+
+
 TestCase(TestRayTrianglesIntersection)
 {
     RawVector<float3> vertices;
@@ -710,3 +955,39 @@ TestCase(TestMatrixExtraction)
     Print("ok");
 }
 
+TestCase(TestFlatHashMap)
+{
+    const int N = 100000;
+    FlatHashMap<int, std::unique_ptr<int>> map;
+    for (int i = 0; i < N; ++i)
+        map[i * 16].reset(new int(i));
+    bool ok = map.size() == N;
+
+    // erase odd values while iterating. erase() doesn't move other entries.
+    int visited = 0;
+    for (auto i = map.begin(); i != map.end(); /**/) {
+        ++visited;
+        if (*i->second % 2 == 1)
+            map.erase(i++);
+        else
+            ++i;
+    }
+    ok = ok && visited == N && map.size() == N / 2;
+    for (int i = 0; ok && i < N; ++i) {
+        auto it = map.find(i * 16);
+        ok = (i % 2 == 0) ? (it != map.end() && *it->second == i) : it == map.end();
+    }
+
+    // re-insertion reuses tombstones and doesn't grow the table
+    auto capacity = map.capacity();
+    for (int i = 1; i < N; i += 2)
+        map[i * 16].reset(new int(i));
+    ok = ok && map.size() == N && map.capacity() == capacity;
+
+    FlatHashMap<std::string, int> paths;
+    paths["/Root/Child"] = 1;
+    paths["/Root"] = 2;
+    ok = ok && paths.count("/Root/Child") && paths["/Root"] == 2 && paths.erase("/Root") == 1 && paths.count("/Root") == 0;
+
+    Print("    %d entries, capacity %d: %s\n", (int)map.size(), (int)map.capacity(), ok ? "OK" : "*** validation failed ***");
+}